@@ -21,7 +21,7 @@ $(foreach VAR,$(SILENT),$(eval override $(VAR) = @$($(VAR))))
 $(eval INSTALL = @$(call ECHO,INSTALL,$$(^:$(SRC_DIR)/%=%)); $(INSTALL))
 endif
 
-ALLBVLIBS = bvutil bvdevice bvserver bvconfig bvsystem bvmedia bvcodec
+ALLBVLIBS = bvutil bvdevice bvserver bvconfig bvsystem bvmedia bvcodec bvprotocol
 
 # NASM requires -I path terminated with /
 IFLAGS     := -I. -I$(SRC_PATH)/
@@ -0,0 +1,609 @@
+/* Automatically generated by configure - do not modify! */
+#ifndef BVBASE_CONFIG_H
+#define BVBASE_CONFIG_H
+#define BVBASE_CONFIGURATION "--disable-doc --disable-debug --disable-yasm --disable-zlib --disable-bzlib --enable-openssl"
+#define BVBASE_LICENSE "LGPL version 2.1 or later"
+#define CONFIG_THIS_YEAR 2014
+#define BVBASE_DATADIR "/usr/local/share/bvbase"
+#define AVCONV_DATADIR "/usr/local/share/bvbase"
+#define CC_IDENT "gcc 12 (Debian 12.2.0-14+deb12u1)"
+#define bv_restrict restrict
+#define EXTERN_PREFIX ""
+#define EXTERN_ASM 
+#define BUILDSUF ""
+#define SLIBSUF ".so"
+#define BV_HAVE_MMX2 BV_HAVE_MMXEXT
+#define SWS_MAX_FILTER_SIZE 256
+#define BV_ARCH_AARCH64 0
+#define BV_ARCH_ALPHA 0
+#define BV_ARCH_ARM 0
+#define BV_ARCH_AVR32 0
+#define BV_ARCH_AVR32_AP 0
+#define BV_ARCH_AVR32_UC 0
+#define BV_ARCH_BFIN 0
+#define BV_ARCH_IA64 0
+#define BV_ARCH_M68K 0
+#define BV_ARCH_MIPS 0
+#define BV_ARCH_MIPS64 0
+#define BV_ARCH_PARISC 0
+#define BV_ARCH_PPC 0
+#define BV_ARCH_PPC64 0
+#define BV_ARCH_S390 0
+#define BV_ARCH_SH4 0
+#define BV_ARCH_SPARC 0
+#define BV_ARCH_SPARC64 0
+#define BV_ARCH_TILEGX 0
+#define BV_ARCH_TILEPRO 0
+#define BV_ARCH_TOMI 0
+#define BV_ARCH_X86 1
+#define BV_ARCH_X86_32 0
+#define BV_ARCH_X86_64 1
+#define BV_HAVE_ARMV5TE 0
+#define BV_HAVE_ARMV6 0
+#define BV_HAVE_ARMV6T2 0
+#define BV_HAVE_ARMV8 0
+#define BV_HAVE_NEON 0
+#define BV_HAVE_VFP 0
+#define BV_HAVE_VFPV3 0
+#define BV_HAVE_SETEND 0
+#define BV_HAVE_ALTIVEC 0
+#define BV_HAVE_DCBZL 1
+#define BV_HAVE_LDBRX 1
+#define BV_HAVE_PPC4XX 0
+#define BV_HAVE_VSX 0
+#define BV_HAVE_AMD3DNOW 1
+#define BV_HAVE_AMD3DNOWEXT 1
+#define BV_HAVE_AVX 1
+#define BV_HAVE_AVX2 1
+#define BV_HAVE_FMA3 1
+#define BV_HAVE_FMA4 1
+#define BV_HAVE_MMX 1
+#define BV_HAVE_MMXEXT 1
+#define BV_HAVE_SSE 1
+#define BV_HAVE_SSE2 1
+#define BV_HAVE_SSE3 1
+#define BV_HAVE_SSE4 1
+#define BV_HAVE_SSE42 1
+#define BV_HAVE_SSSE3 1
+#define BV_HAVE_XOP 1
+#define BV_HAVE_CPUNOP 1
+#define BV_HAVE_I686 1
+#define BV_HAVE_MIPSFPU 0
+#define BV_HAVE_MIPS32R2 0
+#define BV_HAVE_MIPSDSPR1 0
+#define BV_HAVE_MIPSDSPR2 0
+#define BV_HAVE_LOONGSON 1
+#define BV_HAVE_ARMV5TE_EXTERNAL 0
+#define BV_HAVE_ARMV6_EXTERNAL 0
+#define BV_HAVE_ARMV6T2_EXTERNAL 0
+#define BV_HAVE_ARMV8_EXTERNAL 0
+#define BV_HAVE_NEON_EXTERNAL 0
+#define BV_HAVE_VFP_EXTERNAL 0
+#define BV_HAVE_VFPV3_EXTERNAL 0
+#define BV_HAVE_SETEND_EXTERNAL 0
+#define BV_HAVE_ALTIVEC_EXTERNAL 0
+#define BV_HAVE_DCBZL_EXTERNAL 0
+#define BV_HAVE_LDBRX_EXTERNAL 0
+#define BV_HAVE_PPC4XX_EXTERNAL 0
+#define BV_HAVE_VSX_EXTERNAL 0
+#define BV_HAVE_AMD3DNOW_EXTERNAL 0
+#define BV_HAVE_AMD3DNOWEXT_EXTERNAL 0
+#define BV_HAVE_AVX_EXTERNAL 0
+#define BV_HAVE_AVX2_EXTERNAL 0
+#define BV_HAVE_FMA3_EXTERNAL 0
+#define BV_HAVE_FMA4_EXTERNAL 0
+#define BV_HAVE_MMX_EXTERNAL 0
+#define BV_HAVE_MMXEXT_EXTERNAL 0
+#define BV_HAVE_SSE_EXTERNAL 0
+#define BV_HAVE_SSE2_EXTERNAL 0
+#define BV_HAVE_SSE3_EXTERNAL 0
+#define BV_HAVE_SSE4_EXTERNAL 0
+#define BV_HAVE_SSE42_EXTERNAL 0
+#define BV_HAVE_SSSE3_EXTERNAL 0
+#define BV_HAVE_XOP_EXTERNAL 0
+#define BV_HAVE_CPUNOP_EXTERNAL 0
+#define BV_HAVE_I686_EXTERNAL 0
+#define BV_HAVE_MIPSFPU_EXTERNAL 0
+#define BV_HAVE_MIPS32R2_EXTERNAL 0
+#define BV_HAVE_MIPSDSPR1_EXTERNAL 0
+#define BV_HAVE_MIPSDSPR2_EXTERNAL 0
+#define BV_HAVE_LOONGSON_EXTERNAL 0
+#define BV_HAVE_ARMV5TE_INLINE 0
+#define BV_HAVE_ARMV6_INLINE 0
+#define BV_HAVE_ARMV6T2_INLINE 0
+#define BV_HAVE_ARMV8_INLINE 0
+#define BV_HAVE_NEON_INLINE 0
+#define BV_HAVE_VFP_INLINE 0
+#define BV_HAVE_VFPV3_INLINE 0
+#define BV_HAVE_SETEND_INLINE 0
+#define BV_HAVE_ALTIVEC_INLINE 0
+#define BV_HAVE_DCBZL_INLINE 0
+#define BV_HAVE_LDBRX_INLINE 0
+#define BV_HAVE_PPC4XX_INLINE 0
+#define BV_HAVE_VSX_INLINE 0
+#define BV_HAVE_AMD3DNOW_INLINE 1
+#define BV_HAVE_AMD3DNOWEXT_INLINE 1
+#define BV_HAVE_AVX_INLINE 1
+#define BV_HAVE_AVX2_INLINE 1
+#define BV_HAVE_FMA3_INLINE 1
+#define BV_HAVE_FMA4_INLINE 1
+#define BV_HAVE_MMX_INLINE 1
+#define BV_HAVE_MMXEXT_INLINE 1
+#define BV_HAVE_SSE_INLINE 1
+#define BV_HAVE_SSE2_INLINE 1
+#define BV_HAVE_SSE3_INLINE 1
+#define BV_HAVE_SSE4_INLINE 1
+#define BV_HAVE_SSE42_INLINE 1
+#define BV_HAVE_SSSE3_INLINE 1
+#define BV_HAVE_XOP_INLINE 1
+#define BV_HAVE_CPUNOP_INLINE 0
+#define BV_HAVE_I686_INLINE 0
+#define BV_HAVE_MIPSFPU_INLINE 0
+#define BV_HAVE_MIPS32R2_INLINE 0
+#define BV_HAVE_MIPSDSPR1_INLINE 0
+#define BV_HAVE_MIPSDSPR2_INLINE 0
+#define BV_HAVE_LOONGSON_INLINE 0
+#define BV_HAVE_ALIGNED_STACK 1
+#define BV_HAVE_FAST_64BIT 1
+#define BV_HAVE_FAST_CLZ 1
+#define BV_HAVE_FAST_CMOV 1
+#define BV_HAVE_LOCAL_ALIGNED_8 1
+#define BV_HAVE_LOCAL_ALIGNED_16 1
+#define BV_HAVE_LOCAL_ALIGNED_32 1
+#define BV_HAVE_SIMD_ALIGN_16 1
+#define BV_HAVE_ATOMICS_GCC 1
+#define BV_HAVE_ATOMICS_SUNCC 0
+#define BV_HAVE_ATOMICS_WIN32 0
+#define BV_HAVE_ATOMIC_CAS_PTR 0
+#define BV_HAVE_ATOMIC_COMPARE_EXCHANGE 1
+#define BV_HAVE_MACHINE_RW_BARRIER 0
+#define BV_HAVE_MEMORYBARRIER 0
+#define BV_HAVE_MM_EMPTY 1
+#define BV_HAVE_RDTSC 0
+#define BV_HAVE_SARESTART 1
+#define BV_HAVE_SYNC_VAL_COMPARE_AND_SWAP 1
+#define BV_HAVE_INLINE_ASM 1
+#define BV_HAVE_SYMVER 1
+#define BV_HAVE_YASM 0
+#define BV_HAVE_BIGENDIAN 0
+#define BV_HAVE_FAST_UNALIGNED 1
+#define BV_HAVE_INCOMPATIBLE_LIBBV_ABI 0
+#define BV_HAVE_ALSA_ASOUNDLIB_H 0
+#define BV_HAVE_ALTIVEC_H 0
+#define BV_HAVE_ARPA_INET_H 1
+#define BV_HAVE_ASM_TYPES_H 1
+#define BV_HAVE_CDIO_PARANOIA_H 0
+#define BV_HAVE_CDIO_PARANOIA_PARANOIA_H 0
+#define BV_HAVE_CL_CL_H 0
+#define BV_HAVE_DEV_BKTR_IOCTL_BT848_H 0
+#define BV_HAVE_DEV_BKTR_IOCTL_METEOR_H 0
+#define BV_HAVE_DEV_IC_BT8XX_H 0
+#define BV_HAVE_DEV_VIDEO_BKTR_IOCTL_BT848_H 0
+#define BV_HAVE_DEV_VIDEO_METEOR_IOCTL_METEOR_H 0
+#define BV_HAVE_DIRECT_H 0
+#define BV_HAVE_DLFCN_H 1
+#define BV_HAVE_DXVA_H 0
+#define BV_HAVE_ES2_GL_H 0
+#define BV_HAVE_GSM_H 0
+#define BV_HAVE_IO_H 0
+#define BV_HAVE_LINUX_FILTER_H 1
+#define BV_HAVE_MACH_MACH_TIME_H 0
+#define BV_HAVE_MACHINE_IOCTL_BT848_H 0
+#define BV_HAVE_MACHINE_IOCTL_METEOR_H 0
+#define BV_HAVE_MALLOC_H 1
+#define BV_HAVE_OPENJPEG_1_5_OPENJPEG_H 0
+#define BV_HAVE_OPENGL_GL3_H 0
+#define BV_HAVE_POLL_H 1
+#define BV_HAVE_SNDIO_H 0
+#define BV_HAVE_SOUNDCARD_H 0
+#define BV_HAVE_SYS_EPOLL_H 1
+#define BV_HAVE_SYS_EVENTFD_H 1
+#define BV_HAVE_SYS_MMAN_H 1
+#define BV_HAVE_SYS_PARAM_H 1
+#define BV_HAVE_SYS_RESOURCE_H 1
+#define BV_HAVE_SYS_SELECT_H 1
+#define BV_HAVE_SYS_SENDFILE_H 1
+#define BV_HAVE_SYS_SOUNDCARD_H 1
+#define BV_HAVE_SYS_TIME_H 1
+#define BV_HAVE_SYS_UN_H 1
+#define BV_HAVE_SYS_VIDEOIO_H 0
+#define BV_HAVE_TERMIOS_H 1
+#define BV_HAVE_UDPLITE_H 0
+#define BV_HAVE_UNISTD_H 1
+#define BV_HAVE_WINDOWS_H 0
+#define BV_HAVE_WINSOCK2_H 0
+#define BV_HAVE_INTRINSICS_NEON 0
+#define BV_HAVE_ATANF 1
+#define BV_HAVE_ATAN2F 1
+#define BV_HAVE_CBRT 1
+#define BV_HAVE_CBRTF 1
+#define BV_HAVE_COSF 1
+#define BV_HAVE_EXP2 1
+#define BV_HAVE_EXP2F 1
+#define BV_HAVE_EXPF 1
+#define BV_HAVE_ISINF 1
+#define BV_HAVE_ISNAN 1
+#define BV_HAVE_LDEXPF 1
+#define BV_HAVE_LLRINT 1
+#define BV_HAVE_LLRINTF 1
+#define BV_HAVE_LOG2 1
+#define BV_HAVE_LOG2F 1
+#define BV_HAVE_LOG10F 1
+#define BV_HAVE_LRINT 1
+#define BV_HAVE_LRINTF 1
+#define BV_HAVE_POWF 1
+#define BV_HAVE_RINT 1
+#define BV_HAVE_ROUND 1
+#define BV_HAVE_ROUNDF 1
+#define BV_HAVE_SINF 1
+#define BV_HAVE_TRUNC 1
+#define BV_HAVE_TRUNCF 1
+#define BV_HAVE_ACCESS 1
+#define BV_HAVE_ALIGNED_MALLOC 0
+#define BV_HAVE_CLOCK_GETTIME 1
+#define BV_HAVE_CLOSESOCKET 0
+#define BV_HAVE_COMMANDLINETOARGVW 0
+#define BV_HAVE_COTASKMEMFREE 0
+#define BV_HAVE_CRYPTGENRANDOM 0
+#define BV_HAVE_DLOPEN 1
+#define BV_HAVE_FCNTL 1
+#define BV_HAVE_FLT_LIM 1
+#define BV_HAVE_FORK 1
+#define BV_HAVE_GETADDRINFO 1
+#define BV_HAVE_GETHRTIME 0
+#define BV_HAVE_GETOPT 1
+#define BV_HAVE_GETPROCESSAFFINITYMASK 0
+#define BV_HAVE_GETPROCESSMEMORYINFO 0
+#define BV_HAVE_GETPROCESSTIMES 0
+#define BV_HAVE_GETRUSAGE 1
+#define BV_HAVE_GETSERVBYPORT 1
+#define BV_HAVE_GETSYSTEMTIMEASFILETIME 0
+#define BV_HAVE_GETTIMEOFDAY 1
+#define BV_HAVE_GLOB 1
+#define BV_HAVE_GLXGETPROCADDRESS 0
+#define BV_HAVE_GMTIME_R 1
+#define BV_HAVE_INET_ATON 1
+#define BV_HAVE_ISATTY 1
+#define BV_HAVE_JACK_PORT_GET_LATENCY_RANGE 0
+#define BV_HAVE_KBHIT 0
+#define BV_HAVE_LOCALTIME_R 1
+#define BV_HAVE_LZO1X_999_COMPRESS 0
+#define BV_HAVE_MACH_ABSOLUTE_TIME 0
+#define BV_HAVE_MAPVIEWOFFILE 0
+#define BV_HAVE_MEMALIGN 1
+#define BV_HAVE_MKSTEMP 1
+#define BV_HAVE_MMAP 1
+#define BV_HAVE_MPROTECT 1
+#define BV_HAVE_NANOSLEEP 1
+#define BV_HAVE_PEEKNAMEDPIPE 0
+#define BV_HAVE_POSIX_MEMALIGN 1
+#define BV_HAVE_PTHREAD_CANCEL 1
+#define BV_HAVE_SCHED_GETAFFINITY 1
+#define BV_HAVE_SETCONSOLETEXTATTRIBUTE 0
+#define BV_HAVE_SETMODE 0
+#define BV_HAVE_SETRLIMIT 1
+#define BV_HAVE_SLEEP 0
+#define BV_HAVE_STRERROR_R 1
+#define BV_HAVE_SYSCONF 1
+#define BV_HAVE_SYSCTL 0
+#define BV_HAVE_USLEEP 1
+#define BV_HAVE_VIRTUALALLOC 0
+#define BV_HAVE_WGLGETPROCADDRESS 0
+#define BV_HAVE_PTHREADS 1
+#define BV_HAVE_OS2THREADS 0
+#define BV_HAVE_W32THREADS 0
+#define BV_HAVE_AS_DN_DIRECTIVE 0
+#define BV_HAVE_AS_FUNC 0
+#define BV_HAVE_ASM_MOD_Q 0
+#define BV_HAVE_ATTRIBUTE_MAY_ALIAS 1
+#define BV_HAVE_ATTRIBUTE_PACKED 1
+#define BV_HAVE_EBP_AVAILABLE 1
+#define BV_HAVE_EBX_AVAILABLE 1
+#define BV_HAVE_GNU_AS 0
+#define BV_HAVE_GNU_WINDRES 0
+#define BV_HAVE_IBM_ASM 0
+#define BV_HAVE_INLINE_ASM_LABELS 1
+#define BV_HAVE_INLINE_ASM_NONLOCAL_LABELS 1
+#define BV_HAVE_INLINE_ASM_DIRECT_SYMBOL_REFS 1
+#define BV_HAVE_PRAGMA_DEPRECATED 1
+#define BV_HAVE_RSYNC_CONTIMEOUT 0
+#define BV_HAVE_SYMVER_ASM_LABEL 0
+#define BV_HAVE_SYMVER_GNU_ASM 1
+#define BV_HAVE_VFP_ARGS 0
+#define BV_HAVE_XFORM_ASM 0
+#define BV_HAVE_XMM_CLOBBERS 1
+#define BV_HAVE_CONDITION_VARIABLE_PTR 0
+#define BV_HAVE_SOCKLEN_T 1
+#define BV_HAVE_STRUCT_ADDRINFO 1
+#define BV_HAVE_STRUCT_GROUP_SOURCE_REQ 1
+#define BV_HAVE_STRUCT_IP_MREQ_SOURCE 1
+#define BV_HAVE_STRUCT_IPV6_MREQ 1
+#define BV_HAVE_STRUCT_POLLFD 1
+#define BV_HAVE_STRUCT_RUSAGE_RU_MAXRSS 1
+#define BV_HAVE_STRUCT_SCTP_EVENT_SUBSCRIBE 0
+#define BV_HAVE_STRUCT_SOCKADDR_IN6 1
+#define BV_HAVE_STRUCT_SOCKADDR_SA_LEN 0
+#define BV_HAVE_STRUCT_SOCKADDR_STORAGE 1
+#define BV_HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC 1
+#define BV_HAVE_STRUCT_V4L2_FRMIVALENUM_DISCRETE 1
+#define BV_HAVE_ATOMICS_NATIVE 1
+#define BV_HAVE_DOS_PATHS 0
+#define BV_HAVE_DXVA2API_COBJ 0
+#define BV_HAVE_DXVA2_LIB 0
+#define BV_HAVE_LIBC_MSVCRT 0
+#define BV_HAVE_LIBDC1394_1 0
+#define BV_HAVE_LIBDC1394_2 0
+#define BV_HAVE_MAKEINFO 0
+#define BV_HAVE_MAKEINFO_HTML 0
+#define BV_HAVE_PERL 1
+#define BV_HAVE_POD2MAN 1
+#define BV_HAVE_SDL 0
+#define BV_HAVE_SECTION_DATA_REL_RO 1
+#define BV_HAVE_TEXI2HTML 0
+#define BV_HAVE_THREADS 1
+#define BV_HAVE_VDPAU_X11 0
+#define BV_HAVE_XLIB 1
+#define BV_CONFIG_BVPARSERS 1
+#define BV_CONFIG_BVPROTOCOLS 1
+#define BV_CONFIG_BVDEVICES 1
+#define BV_CONFIG_BVINDEVS 0
+#define BV_CONFIG_BVOUTDEVS 0
+#define BV_CONFIG_BVMUXERS 1
+#define BV_CONFIG_BVDEMUXERS 1
+#define BV_CONFIG_BVDRIVERS 1
+#define BV_CONFIG_BVSYSTEMS 1
+#define BV_CONFIG_BVCONFIGS 1
+#define BV_CONFIG_BVCFILES 0
+#define BV_CONFIG_BVSERVERS 1
+#define BV_CONFIG_BVFILTERS 0
+#define BV_CONFIG_DOC 0
+#define BV_CONFIG_HTMLPAGES 0
+#define BV_CONFIG_MANPAGES 1
+#define BV_CONFIG_PODPAGES 1
+#define BV_CONFIG_TXTPAGES 0
+#define BV_CONFIG_AVIO_READING_EXAMPLE 1
+#define BV_CONFIG_DECODING_ENCODING_EXAMPLE 0
+#define BV_CONFIG_DEMUXING_DECODING_EXAMPLE 0
+#define BV_CONFIG_EXTRACT_MVS_EXAMPLE 0
+#define BV_CONFIG_FILTER_AUDIO_EXAMPLE 0
+#define BV_CONFIG_FILTERING_AUDIO_EXAMPLE 0
+#define BV_CONFIG_FILTERING_VIDEO_EXAMPLE 0
+#define BV_CONFIG_METADATA_EXAMPLE 0
+#define BV_CONFIG_MUXING_EXAMPLE 0
+#define BV_CONFIG_REMUXING_EXAMPLE 0
+#define BV_CONFIG_RESAMPLING_AUDIO_EXAMPLE 0
+#define BV_CONFIG_SCALING_VIDEO_EXAMPLE 0
+#define BV_CONFIG_TRANSCODE_AAC_EXAMPLE 0
+#define BV_CONFIG_TRANSCODING_EXAMPLE 0
+#define BV_CONFIG_AVISYNTH 0
+#define BV_CONFIG_BZLIB 0
+#define BV_CONFIG_CRYSTALHD 0
+#define BV_CONFIG_DECKLINK 0
+#define BV_CONFIG_FREI0R 0
+#define BV_CONFIG_GNUTLS 0
+#define BV_CONFIG_ICONV 1
+#define BV_CONFIG_LADSPA 0
+#define BV_CONFIG_LIBAACPLUS 0
+#define BV_CONFIG_LIBASS 0
+#define BV_CONFIG_LIBBLURAY 0
+#define BV_CONFIG_LIBBS2B 0
+#define BV_CONFIG_LIBCACA 0
+#define BV_CONFIG_LIBCDIO 0
+#define BV_CONFIG_LIBCELT 0
+#define BV_CONFIG_LIBDC1394 0
+#define BV_CONFIG_LIBFAAC 0
+#define BV_CONFIG_LIBFDK_AAC 0
+#define BV_CONFIG_LIBFLITE 0
+#define BV_CONFIG_LIBFONTCONFIG 0
+#define BV_CONFIG_LIBFREETYPE 0
+#define BV_CONFIG_LIBFRIBIDI 0
+#define BV_CONFIG_LIBGME 0
+#define BV_CONFIG_LIBGSM 0
+#define BV_CONFIG_LIBIEC61883 0
+#define BV_CONFIG_LIBILBC 0
+#define BV_CONFIG_LIBMODPLUG 0
+#define BV_CONFIG_LIBMP3LAME 0
+#define BV_CONFIG_LIBNUT 0
+#define BV_CONFIG_LIBOPENCORE_AMRNB 0
+#define BV_CONFIG_LIBOPENCORE_AMRWB 0
+#define BV_CONFIG_LIBOPENCV 0
+#define BV_CONFIG_LIBOPENJPEG 0
+#define BV_CONFIG_LIBOPUS 0
+#define BV_CONFIG_LIBPULSE 0
+#define BV_CONFIG_LIBQUVI 0
+#define BV_CONFIG_LIBRTMP 0
+#define BV_CONFIG_LIBSCHROEDINGER 0
+#define BV_CONFIG_LIBSHINE 0
+#define BV_CONFIG_LIBSMBCLIENT 0
+#define BV_CONFIG_LIBSOXR 0
+#define BV_CONFIG_LIBSPEEX 0
+#define BV_CONFIG_LIBSSH 0
+#define BV_CONFIG_LIBSTAGEFRIGHT_H264 0
+#define BV_CONFIG_LIBTHEORA 0
+#define BV_CONFIG_LIBTWOLAME 0
+#define BV_CONFIG_LIBUTVIDEO 0
+#define BV_CONFIG_LIBV4L2 0
+#define BV_CONFIG_LIBVIDSTAB 0
+#define BV_CONFIG_LIBVO_AACENC 0
+#define BV_CONFIG_LIBVO_AMRWBENC 0
+#define BV_CONFIG_LIBVORBIS 0
+#define BV_CONFIG_LIBVPX 0
+#define BV_CONFIG_LIBWAVPACK 0
+#define BV_CONFIG_LIBWEBP 0
+#define BV_CONFIG_LIBX264 0
+#define BV_CONFIG_LIBONVIFC 0
+#define BV_CONFIG_LIBAVFORMAT 0
+#define BV_CONFIG_LIBJANSSON 0
+#define BV_CONFIG_LIBBVFS 0
+#define BV_CONFIG_HIS3515 0
+#define BV_CONFIG_LIBX265 0
+#define BV_CONFIG_LIBXAVS 0
+#define BV_CONFIG_LIBXCB 1
+#define BV_CONFIG_LIBXCB_SHM 0
+#define BV_CONFIG_LIBXCB_SHAPE 0
+#define BV_CONFIG_LIBXCB_XFIXES 0
+#define BV_CONFIG_LIBXVID 0
+#define BV_CONFIG_LIBZMQ 0
+#define BV_CONFIG_LIBZVBI 0
+#define BV_CONFIG_LZMA 0
+#define BV_CONFIG_NVENC 0
+#define BV_CONFIG_OPENAL 0
+#define BV_CONFIG_OPENCL 0
+#define BV_CONFIG_OPENGL 0
+#define BV_CONFIG_OPENSSL 1
+#define BV_CONFIG_SDL 0
+#define BV_CONFIG_X11GRAB 0
+#define BV_CONFIG_XLIB 1
+#define BV_CONFIG_ZLIB 0
+#define BV_CONFIG_FTRAPV 0
+#define BV_CONFIG_GRAY 0
+#define BV_CONFIG_HARDCODED_TABLES 0
+#define BV_CONFIG_RUNTIME_CPUDETECT 1
+#define BV_CONFIG_SAFE_BITSTREAM_READER 1
+#define BV_CONFIG_SHARED 1
+#define BV_CONFIG_SMALL 0
+#define BV_CONFIG_STATIC 1
+#define BV_CONFIG_SWSCALE_ALPHA 0
+#define BV_CONFIG_DXVA2 0
+#define BV_CONFIG_VAAPI 0
+#define BV_CONFIG_VDA 0
+#define BV_CONFIG_VDPAU 0
+#define BV_CONFIG_XVMC 0
+#define BV_CONFIG_GPL 0
+#define BV_CONFIG_NONFREE 0
+#define BV_CONFIG_VERSION3 0
+#define BV_CONFIG_BVUTIL 1
+#define BV_CONFIG_BVMEDIA 1
+#define BV_CONFIG_BVCODEC 1
+#define BV_CONFIG_BVDEVICE 1
+#define BV_CONFIG_BVCONFIG 1
+#define BV_CONFIG_BVSYSTEM 1
+#define BV_CONFIG_BVSERVER 1
+#define BV_CONFIG_BVPROTOCOL 1
+#define BV_CONFIG_BVFILTER 1
+#define BV_CONFIG_FFPLAY 0
+#define BV_CONFIG_FFPROBE 0
+#define BV_CONFIG_FFSERVER 0
+#define BV_CONFIG_FFMPEG 0
+#define BV_CONFIG_DCT 0
+#define BV_CONFIG_DWT 0
+#define BV_CONFIG_ERROR_RESILIENCE 1
+#define BV_CONFIG_FAAN 1
+#define BV_CONFIG_FAST_UNALIGNED 1
+#define BV_CONFIG_FFT 0
+#define BV_CONFIG_LSP 0
+#define BV_CONFIG_LZO 0
+#define BV_CONFIG_MDCT 0
+#define BV_CONFIG_PIXELUTILS 1
+#define BV_CONFIG_NETWORK 1
+#define BV_CONFIG_RDFT 0
+#define BV_CONFIG_FONTCONFIG 0
+#define BV_CONFIG_INCOMPATIBLE_LIBBV_ABI 0
+#define BV_CONFIG_MEMALIGN_HACK 0
+#define BV_CONFIG_MEMORY_POISONING 0
+#define BV_CONFIG_NEON_CLOBBER_TEST 0
+#define BV_CONFIG_PIC 1
+#define BV_CONFIG_POD2MAN 1
+#define BV_CONFIG_RAISE_MAJOR 0
+#define BV_CONFIG_THUMB 0
+#define BV_CONFIG_XMM_CLOBBER_TEST 0
+#define BV_CONFIG_AANDCTTABLES 0
+#define BV_CONFIG_AC3DSP 0
+#define BV_CONFIG_AUDIO_FRAME_QUEUE 0
+#define BV_CONFIG_AUDIODSP 0
+#define BV_CONFIG_BLOCKDSP 0
+#define BV_CONFIG_BSWAPDSP 0
+#define BV_CONFIG_CABAC 1
+#define BV_CONFIG_DVPROFILE 0
+#define BV_CONFIG_EXIF 0
+#define BV_CONFIG_FAANDCT 1
+#define BV_CONFIG_FAANIDCT 1
+#define BV_CONFIG_FDCTDSP 1
+#define BV_CONFIG_FRAME_THREAD_ENCODER 0
+#define BV_CONFIG_GCRYPT 0
+#define BV_CONFIG_GOLOMB 1
+#define BV_CONFIG_GPLV3 0
+#define BV_CONFIG_H263DSP 0
+#define BV_CONFIG_H264CHROMA 1
+#define BV_CONFIG_H264DSP 1
+#define BV_CONFIG_H264PRED 1
+#define BV_CONFIG_H264QPEL 1
+#define BV_CONFIG_HPELDSP 0
+#define BV_CONFIG_HUFFMAN 0
+#define BV_CONFIG_HUFFYUVDSP 0
+#define BV_CONFIG_HUFFYUVENCDSP 0
+#define BV_CONFIG_IDCTDSP 1
+#define BV_CONFIG_IIRFILTER 0
+#define BV_CONFIG_INTRAX8 0
+#define BV_CONFIG_LGPLV3 0
+#define BV_CONFIG_LLAUDDSP 0
+#define BV_CONFIG_LLVIDDSP 0
+#define BV_CONFIG_LPC 0
+#define BV_CONFIG_ME_CMP 1
+#define BV_CONFIG_MPEG_ER 0
+#define BV_CONFIG_MPEGAUDIO 0
+#define BV_CONFIG_MPEGAUDIODSP 0
+#define BV_CONFIG_MPEGVIDEO 0
+#define BV_CONFIG_MPEGVIDEOENC 0
+#define BV_CONFIG_NETTLE 0
+#define BV_CONFIG_PIXBLOCKDSP 1
+#define BV_CONFIG_QPELDSP 0
+#define BV_CONFIG_RANGECODER 0
+#define BV_CONFIG_RIFFDEC 1
+#define BV_CONFIG_RIFFENC 0
+#define BV_CONFIG_RTPDEC 1
+#define BV_CONFIG_RTPENC_CHAIN 0
+#define BV_CONFIG_SINEWIN 0
+#define BV_CONFIG_STARTCODE 1
+#define BV_CONFIG_TPELDSP 0
+#define BV_CONFIG_VIDEODSP 1
+#define BV_CONFIG_VP3DSP 0
+#define BV_CONFIG_WMA_FREQS 0
+#define BV_CONFIG_DXVA2 0
+#define BV_CONFIG_VAAPI 0
+#define BV_CONFIG_VDA 0
+#define BV_CONFIG_VDPAU 0
+#define BV_CONFIG_XVMC 0
+#define BV_CONFIG_H264_PARSER 1
+#define BV_CONFIG_GPS_DEVICE 1
+#define BV_CONFIG_SERIAL_DEVICE 1
+#define BV_CONFIG_PTZ_DEVICE 1
+#define BV_CONFIG_ONVIF_DEV_DEVICE 0
+#define BV_CONFIG_ONVIF_PTZ_DEVICE 0
+#define BV_CONFIG_DISK_DEV_DEVICE 0
+#define BV_CONFIG_LOCAL_CONFIG 1
+#define BV_CONFIG_ONVIF_CONFIG 0
+#define BV_CONFIG_JSON_CFILE 0
+#define BV_CONFIG_BVS_SERVER 1
+#define BV_CONFIG_BVC_SERVER 1
+#define BV_CONFIG_MTC_SERVER 1
+#define BV_CONFIG_X86_SYSTEM 1
+#define BV_CONFIG_HIS3515_SYSTEM 0
+#define BV_CONFIG_HISAVI_INDEV 0
+#define BV_CONFIG_HISAVE_INDEV 0
+#define BV_CONFIG_ONVIFAVE_INDEV 0
+#define BV_CONFIG_HISAVO_OUTDEV 0
+#define BV_CONFIG_HISAVD_OUTDEV 0
+#define BV_CONFIG_DAV_MUXER 1
+#define BV_CONFIG_SHMBUS_MUXER 1
+#define BV_CONFIG_DAV_DEMUXER 1
+#define BV_CONFIG_SHMBUS_DEMUXER 1
+#define BV_CONFIG_RTSP_DEMUXER 1
+#define BV_CONFIG_TW2866_DRIVER 1
+#define BV_CONFIG_TLV320AIC23_DRIVER 1
+#define BV_CONFIG_FILE_PROTOCOL 1
+#define BV_CONFIG_TCP_PROTOCOL 1
+#define BV_CONFIG_TLS_PROTOCOL 1
+#define BV_CONFIG_UDP_PROTOCOL 1
+#define BV_CONFIG_BVFS_PROTOCOL 0
+#define BV_CONFIG_HTTP_PROTOCOL 1
+#define BV_CONFIG_HTTPS_PROTOCOL 1
+#define BV_CONFIG_HTTPPROXY_PROTOCOL 1
+#define BV_CONFIG_MEM_PROTOCOL 1
+#define BV_CONFIG_UNIX_PROTOCOL 1
+#define BV_CONFIG_CACHE_PROTOCOL 1
+#define BV_CONFIG_CRYPTO_PROTOCOL 1
+#define BV_CONFIG_CONCAT_PROTOCOL 1
+#define BV_CONFIG_FEC_PROTOCOL 1
+#define BV_CONFIG_ARQ_PROTOCOL 1
+#endif /* BVBASE_CONFIG_H */
@@ -0,0 +1,746 @@
+# Automatically generated by configure - do not modify!
+ifndef BVBASE_CONFIG_MAK
+BVBASE_CONFIG_MAK=1
+BVBASE_CONFIGURATION=--disable-doc --disable-debug --disable-yasm --disable-zlib --disable-bzlib --enable-openssl
+prefix=/usr/local
+LIBDIR=$(DESTDIR)${prefix}/lib
+SHLIBDIR=$(DESTDIR)${LIBDIR}
+INCDIR=$(DESTDIR)${prefix}/include
+BINDIR=$(DESTDIR)${prefix}/bin
+DATADIR=$(DESTDIR)${prefix}/share/bvbase
+DOCDIR=$(DESTDIR)${prefix}/share/doc/bvbase
+MANDIR=$(DESTDIR)${prefix}/share/man
+SRC_PATH=.
+ifndef MAIN_MAKEFILE
+SRC_PATH:=$(SRC_PATH:.%=..%)
+endif
+CC_IDENT=gcc 12 (Debian 12.2.0-14+deb12u1)
+ARCH=x86
+INTRINSICS=none
+CC=gcc
+CXX=g++
+AS=gcc
+LD=gcc
+DEPCC=gcc
+DEPCCFLAGS= $(CPPFLAGS)
+DEPAS=gcc
+DEPASFLAGS= $(CPPFLAGS)
+YASM=yasm
+DEPYASM=yasm
+AR=ar
+ARFLAGS=rc
+AR_O=$@
+RANLIB=ranlib
+STRIP=strip
+CP=cp -p
+LN_S=ln -s -f
+CPPFLAGS= -D_ISOC99_SOURCE -D_FILE_OFFSET_BITS=64 -D_LARGEFILE_SOURCE -D_POSIX_C_SOURCE=200112 -D_XOPEN_SOURCE=600 -DPIC
+CFLAGS=   -std=gnu99 -fomit-frame-pointer -fPIC -pthread  -Wdeclaration-after-statement -Wall -Wdisabled-optimization -Wpointer-arith -Wredundant-decls -Wwrite-strings -Wtype-limits -Wundef -Wmissing-prototypes -Wno-pointer-to-int-cast -Wstrict-prototypes -Wempty-body -Wno-parentheses -Wno-switch -Wno-format-zero-length -Wno-pointer-sign -O3 -fno-math-errno -fno-signed-zeros -fno-tree-vectorize -Werror=format-security -Werror=implicit-function-declaration -Werror=missing-prototypes -Werror=return-type -Werror=vla -Wformat -Wno-maybe-uninitialized
+CXXFLAGS=  -D__STDC_CONSTANT_MACROS
+ASFLAGS=   -fPIC
+AS_C=-c
+AS_O=-o $@
+CC_C=-c
+CC_E=-E -o $@
+CC_O=-o $@
+CXX_C=-c
+CXX_O=-o $@
+LD_O=-o $@
+LD_LIB=-l%
+LD_PATH=-L
+DLLTOOL=
+WINDRES=windres
+DEPWINDRES=gcc
+DOXYGEN=doxygen
+LDFLAGS=  -Wl,--as-needed -Wl,-z,noexecstack -Wl,--warn-common -Wl,-rpath-link=libbvconfig:libbvserver:libbvsystem:libbvmedia::libbvcodec:libavutil
+LDEXEFLAGS=
+SHFLAGS=-shared -Wl,-soname,$$(@F) -Wl,-Bsymbolic -Wl,--version-script,$(SUBDIR)lib$(NAME).ver
+ASMSTRIPFLAGS= -wN '..@*'
+YASMFLAGS=
+BUILDSUF=
+PROGSSUF=
+FULLNAME=$(NAME)$(BUILDSUF)
+LIBPREF=lib
+LIBSUF=.a
+LIBNAME=$(LIBPREF)$(FULLNAME)$(LIBSUF)
+SLIBPREF=lib
+SLIBSUF=.so
+EXESUF=
+EXTRA_VERSION=
+CCDEP=
+CXXDEP=
+CCDEP_FLAGS=
+ASDEP=
+ASDEP_FLAGS=
+CC_DEPFLAGS=-MMD -MF $(@:.o=.d) -MT $@
+AS_DEPFLAGS=-MMD -MF $(@:.o=.d) -MT $@
+HOSTCC=gcc
+HOSTLD=gcc
+HOSTCFLAGS=  -std=gnu99 -Wall -O3
+HOSTCPPFLAGS= -D_ISOC99_SOURCE -D_POSIX_C_SOURCE=200112 -D_XOPEN_SOURCE=600
+HOSTEXESUF=
+HOSTLDFLAGS= 
+HOSTLIBS=-lm
+DEPHOSTCC=gcc
+DEPHOSTCCFLAGS= $(HOSTCCFLAGS)
+HOSTCCDEP=
+HOSTCCDEP_FLAGS=
+HOSTCC_DEPFLAGS=-MMD -MF $(@:.o=.d) -MT $@
+HOSTCC_C=-c
+HOSTCC_O=-o $@
+HOSTLD_O=-o $@
+TARGET_EXEC= 
+TARGET_PATH=$(CURDIR)
+TARGET_SAMPLES=$(SAMPLES)
+CFLAGS-ffplay=
+ZLIB=-lz
+LIB_INSTALL_EXTRA_CMD=$$(RANLIB) "$(LIBDIR)/$(LIBNAME)"
+EXTRALIBS=-lxcb -lX11 -lssl -lcrypto -lm -llzma -pthread 
+COMPAT_OBJS=
+EXEOBJS=
+INSTALL=install
+LIBTARGET=
+SLIBNAME=$(SLIBPREF)$(FULLNAME)$(SLIBSUF)
+SLIBNAME_WITH_VERSION=$(SLIBNAME).$(LIBVERSION)
+SLIBNAME_WITH_MAJOR=$(SLIBNAME).$(LIBMAJOR)
+SLIB_CREATE_DEF_CMD=
+SLIB_EXTRA_CMD=
+SLIB_INSTALL_NAME=$(SLIBNAME_WITH_VERSION)
+SLIB_INSTALL_LINKS=$(SLIBNAME_WITH_MAJOR) $(SLIBNAME)
+SLIB_INSTALL_EXTRA_LIB=
+SLIB_INSTALL_EXTRA_SHLIB=
+SAMPLES:=$(FATE_SAMPLES)
+NOREDZONE_FLAGS=-mno-red-zone
+libbvutil_VERSION=0.0.3
+libbvutil_VERSION_MAJOR=0
+libbvutil_VERSION_MINOR=0
+libbvmedia_VERSION=0.0.3
+libbvmedia_VERSION_MAJOR=0
+libbvmedia_VERSION_MINOR=0
+libbvcodec_VERSION=0.0.1
+libbvcodec_VERSION_MAJOR=0
+libbvcodec_VERSION_MINOR=0
+libbvdevice_VERSION=0.0.3
+libbvdevice_VERSION_MAJOR=0
+libbvdevice_VERSION_MINOR=0
+libbvconfig_VERSION=0.0.3
+libbvconfig_VERSION_MAJOR=0
+libbvconfig_VERSION_MINOR=0
+libbvsystem_VERSION=0.0.1
+libbvsystem_VERSION_MAJOR=0
+libbvsystem_VERSION_MINOR=0
+libbvserver_VERSION=0.0.1
+libbvserver_VERSION_MAJOR=0
+libbvserver_VERSION_MINOR=0
+libbvprotocol_VERSION=0.0.3
+libbvprotocol_VERSION_MAJOR=0
+libbvprotocol_VERSION_MINOR=0
+libbvfilter_VERSION=0.0.1
+libbvfilter_VERSION_MAJOR=0
+libbvfilter_VERSION_MINOR=0
+bvutil_FFLIBS=
+bvmedia_FFLIBS=
+bvcodec_FFLIBS=
+bvdevice_FFLIBS=
+bvconfig_FFLIBS=
+bvsystem_FFLIBS=
+bvserver_FFLIBS=
+bvprotocol_FFLIBS=
+bvfilter_FFLIBS=
+LIBS-ffplay=
+LIBS-ffprobe=
+LIBS-ffserver=
+LIBS-ffmpeg=
+!BV_ARCH_AARCH64=yes
+!BV_ARCH_ALPHA=yes
+!BV_ARCH_ARM=yes
+!BV_ARCH_AVR32=yes
+!BV_ARCH_AVR32_AP=yes
+!BV_ARCH_AVR32_UC=yes
+!BV_ARCH_BFIN=yes
+!BV_ARCH_IA64=yes
+!BV_ARCH_M68K=yes
+!BV_ARCH_MIPS=yes
+!BV_ARCH_MIPS64=yes
+!BV_ARCH_PARISC=yes
+!BV_ARCH_PPC=yes
+!BV_ARCH_PPC64=yes
+!BV_ARCH_S390=yes
+!BV_ARCH_SH4=yes
+!BV_ARCH_SPARC=yes
+!BV_ARCH_SPARC64=yes
+!BV_ARCH_TILEGX=yes
+!BV_ARCH_TILEPRO=yes
+!BV_ARCH_TOMI=yes
+BV_ARCH_X86=yes
+!BV_ARCH_X86_32=yes
+BV_ARCH_X86_64=yes
+!BV_HAVE_ARMV5TE=yes
+!BV_HAVE_ARMV6=yes
+!BV_HAVE_ARMV6T2=yes
+!BV_HAVE_ARMV8=yes
+!BV_HAVE_NEON=yes
+!BV_HAVE_VFP=yes
+!BV_HAVE_VFPV3=yes
+!BV_HAVE_SETEND=yes
+!BV_HAVE_ALTIVEC=yes
+BV_HAVE_DCBZL=yes
+BV_HAVE_LDBRX=yes
+!BV_HAVE_PPC4XX=yes
+!BV_HAVE_VSX=yes
+BV_HAVE_AMD3DNOW=yes
+BV_HAVE_AMD3DNOWEXT=yes
+BV_HAVE_AVX=yes
+BV_HAVE_AVX2=yes
+BV_HAVE_FMA3=yes
+BV_HAVE_FMA4=yes
+BV_HAVE_MMX=yes
+BV_HAVE_MMXEXT=yes
+BV_HAVE_SSE=yes
+BV_HAVE_SSE2=yes
+BV_HAVE_SSE3=yes
+BV_HAVE_SSE4=yes
+BV_HAVE_SSE42=yes
+BV_HAVE_SSSE3=yes
+BV_HAVE_XOP=yes
+BV_HAVE_CPUNOP=yes
+BV_HAVE_I686=yes
+!BV_HAVE_MIPSFPU=yes
+!BV_HAVE_MIPS32R2=yes
+!BV_HAVE_MIPSDSPR1=yes
+!BV_HAVE_MIPSDSPR2=yes
+BV_HAVE_LOONGSON=yes
+!BV_HAVE_ARMV5TE_EXTERNAL=yes
+!BV_HAVE_ARMV6_EXTERNAL=yes
+!BV_HAVE_ARMV6T2_EXTERNAL=yes
+!BV_HAVE_ARMV8_EXTERNAL=yes
+!BV_HAVE_NEON_EXTERNAL=yes
+!BV_HAVE_VFP_EXTERNAL=yes
+!BV_HAVE_VFPV3_EXTERNAL=yes
+!BV_HAVE_SETEND_EXTERNAL=yes
+!BV_HAVE_ALTIVEC_EXTERNAL=yes
+!BV_HAVE_DCBZL_EXTERNAL=yes
+!BV_HAVE_LDBRX_EXTERNAL=yes
+!BV_HAVE_PPC4XX_EXTERNAL=yes
+!BV_HAVE_VSX_EXTERNAL=yes
+!BV_HAVE_AMD3DNOW_EXTERNAL=yes
+!BV_HAVE_AMD3DNOWEXT_EXTERNAL=yes
+!BV_HAVE_AVX_EXTERNAL=yes
+!BV_HAVE_AVX2_EXTERNAL=yes
+!BV_HAVE_FMA3_EXTERNAL=yes
+!BV_HAVE_FMA4_EXTERNAL=yes
+!BV_HAVE_MMX_EXTERNAL=yes
+!BV_HAVE_MMXEXT_EXTERNAL=yes
+!BV_HAVE_SSE_EXTERNAL=yes
+!BV_HAVE_SSE2_EXTERNAL=yes
+!BV_HAVE_SSE3_EXTERNAL=yes
+!BV_HAVE_SSE4_EXTERNAL=yes
+!BV_HAVE_SSE42_EXTERNAL=yes
+!BV_HAVE_SSSE3_EXTERNAL=yes
+!BV_HAVE_XOP_EXTERNAL=yes
+!BV_HAVE_CPUNOP_EXTERNAL=yes
+!BV_HAVE_I686_EXTERNAL=yes
+!BV_HAVE_MIPSFPU_EXTERNAL=yes
+!BV_HAVE_MIPS32R2_EXTERNAL=yes
+!BV_HAVE_MIPSDSPR1_EXTERNAL=yes
+!BV_HAVE_MIPSDSPR2_EXTERNAL=yes
+!BV_HAVE_LOONGSON_EXTERNAL=yes
+!BV_HAVE_ARMV5TE_INLINE=yes
+!BV_HAVE_ARMV6_INLINE=yes
+!BV_HAVE_ARMV6T2_INLINE=yes
+!BV_HAVE_ARMV8_INLINE=yes
+!BV_HAVE_NEON_INLINE=yes
+!BV_HAVE_VFP_INLINE=yes
+!BV_HAVE_VFPV3_INLINE=yes
+!BV_HAVE_SETEND_INLINE=yes
+!BV_HAVE_ALTIVEC_INLINE=yes
+!BV_HAVE_DCBZL_INLINE=yes
+!BV_HAVE_LDBRX_INLINE=yes
+!BV_HAVE_PPC4XX_INLINE=yes
+!BV_HAVE_VSX_INLINE=yes
+BV_HAVE_AMD3DNOW_INLINE=yes
+BV_HAVE_AMD3DNOWEXT_INLINE=yes
+BV_HAVE_AVX_INLINE=yes
+BV_HAVE_AVX2_INLINE=yes
+BV_HAVE_FMA3_INLINE=yes
+BV_HAVE_FMA4_INLINE=yes
+BV_HAVE_MMX_INLINE=yes
+BV_HAVE_MMXEXT_INLINE=yes
+BV_HAVE_SSE_INLINE=yes
+BV_HAVE_SSE2_INLINE=yes
+BV_HAVE_SSE3_INLINE=yes
+BV_HAVE_SSE4_INLINE=yes
+BV_HAVE_SSE42_INLINE=yes
+BV_HAVE_SSSE3_INLINE=yes
+BV_HAVE_XOP_INLINE=yes
+!BV_HAVE_CPUNOP_INLINE=yes
+!BV_HAVE_I686_INLINE=yes
+!BV_HAVE_MIPSFPU_INLINE=yes
+!BV_HAVE_MIPS32R2_INLINE=yes
+!BV_HAVE_MIPSDSPR1_INLINE=yes
+!BV_HAVE_MIPSDSPR2_INLINE=yes
+!BV_HAVE_LOONGSON_INLINE=yes
+BV_HAVE_ALIGNED_STACK=yes
+BV_HAVE_FAST_64BIT=yes
+BV_HAVE_FAST_CLZ=yes
+BV_HAVE_FAST_CMOV=yes
+BV_HAVE_LOCAL_ALIGNED_8=yes
+BV_HAVE_LOCAL_ALIGNED_16=yes
+BV_HAVE_LOCAL_ALIGNED_32=yes
+BV_HAVE_SIMD_ALIGN_16=yes
+BV_HAVE_ATOMICS_GCC=yes
+!BV_HAVE_ATOMICS_SUNCC=yes
+!BV_HAVE_ATOMICS_WIN32=yes
+!BV_HAVE_ATOMIC_CAS_PTR=yes
+BV_HAVE_ATOMIC_COMPARE_EXCHANGE=yes
+!BV_HAVE_MACHINE_RW_BARRIER=yes
+!BV_HAVE_MEMORYBARRIER=yes
+BV_HAVE_MM_EMPTY=yes
+!BV_HAVE_RDTSC=yes
+BV_HAVE_SARESTART=yes
+BV_HAVE_SYNC_VAL_COMPARE_AND_SWAP=yes
+BV_HAVE_INLINE_ASM=yes
+BV_HAVE_SYMVER=yes
+!BV_HAVE_YASM=yes
+!BV_HAVE_BIGENDIAN=yes
+BV_HAVE_FAST_UNALIGNED=yes
+!BV_HAVE_INCOMPATIBLE_LIBBV_ABI=yes
+!BV_HAVE_ALSA_ASOUNDLIB_H=yes
+!BV_HAVE_ALTIVEC_H=yes
+BV_HAVE_ARPA_INET_H=yes
+BV_HAVE_ASM_TYPES_H=yes
+!BV_HAVE_CDIO_PARANOIA_H=yes
+!BV_HAVE_CDIO_PARANOIA_PARANOIA_H=yes
+!BV_HAVE_CL_CL_H=yes
+!BV_HAVE_DEV_BKTR_IOCTL_BT848_H=yes
+!BV_HAVE_DEV_BKTR_IOCTL_METEOR_H=yes
+!BV_HAVE_DEV_IC_BT8XX_H=yes
+!BV_HAVE_DEV_VIDEO_BKTR_IOCTL_BT848_H=yes
+!BV_HAVE_DEV_VIDEO_METEOR_IOCTL_METEOR_H=yes
+!BV_HAVE_DIRECT_H=yes
+BV_HAVE_DLFCN_H=yes
+!BV_HAVE_DXVA_H=yes
+!BV_HAVE_ES2_GL_H=yes
+!BV_HAVE_GSM_H=yes
+!BV_HAVE_IO_H=yes
+BV_HAVE_LINUX_FILTER_H=yes
+!BV_HAVE_MACH_MACH_TIME_H=yes
+!BV_HAVE_MACHINE_IOCTL_BT848_H=yes
+!BV_HAVE_MACHINE_IOCTL_METEOR_H=yes
+BV_HAVE_MALLOC_H=yes
+!BV_HAVE_OPENJPEG_1_5_OPENJPEG_H=yes
+!BV_HAVE_OPENGL_GL3_H=yes
+BV_HAVE_POLL_H=yes
+!BV_HAVE_SNDIO_H=yes
+!BV_HAVE_SOUNDCARD_H=yes
+BV_HAVE_SYS_EPOLL_H=yes
+BV_HAVE_SYS_EVENTFD_H=yes
+BV_HAVE_SYS_MMAN_H=yes
+BV_HAVE_SYS_PARAM_H=yes
+BV_HAVE_SYS_RESOURCE_H=yes
+BV_HAVE_SYS_SELECT_H=yes
+BV_HAVE_SYS_SENDFILE_H=yes
+BV_HAVE_SYS_SOUNDCARD_H=yes
+BV_HAVE_SYS_TIME_H=yes
+BV_HAVE_SYS_UN_H=yes
+!BV_HAVE_SYS_VIDEOIO_H=yes
+BV_HAVE_TERMIOS_H=yes
+!BV_HAVE_UDPLITE_H=yes
+BV_HAVE_UNISTD_H=yes
+!BV_HAVE_WINDOWS_H=yes
+!BV_HAVE_WINSOCK2_H=yes
+!BV_HAVE_INTRINSICS_NEON=yes
+BV_HAVE_ATANF=yes
+BV_HAVE_ATAN2F=yes
+BV_HAVE_CBRT=yes
+BV_HAVE_CBRTF=yes
+BV_HAVE_COSF=yes
+BV_HAVE_EXP2=yes
+BV_HAVE_EXP2F=yes
+BV_HAVE_EXPF=yes
+BV_HAVE_ISINF=yes
+BV_HAVE_ISNAN=yes
+BV_HAVE_LDEXPF=yes
+BV_HAVE_LLRINT=yes
+BV_HAVE_LLRINTF=yes
+BV_HAVE_LOG2=yes
+BV_HAVE_LOG2F=yes
+BV_HAVE_LOG10F=yes
+BV_HAVE_LRINT=yes
+BV_HAVE_LRINTF=yes
+BV_HAVE_POWF=yes
+BV_HAVE_RINT=yes
+BV_HAVE_ROUND=yes
+BV_HAVE_ROUNDF=yes
+BV_HAVE_SINF=yes
+BV_HAVE_TRUNC=yes
+BV_HAVE_TRUNCF=yes
+BV_HAVE_ACCESS=yes
+!BV_HAVE_ALIGNED_MALLOC=yes
+BV_HAVE_CLOCK_GETTIME=yes
+!BV_HAVE_CLOSESOCKET=yes
+!BV_HAVE_COMMANDLINETOARGVW=yes
+!BV_HAVE_COTASKMEMFREE=yes
+!BV_HAVE_CRYPTGENRANDOM=yes
+BV_HAVE_DLOPEN=yes
+BV_HAVE_FCNTL=yes
+BV_HAVE_FLT_LIM=yes
+BV_HAVE_FORK=yes
+BV_HAVE_GETADDRINFO=yes
+!BV_HAVE_GETHRTIME=yes
+BV_HAVE_GETOPT=yes
+!BV_HAVE_GETPROCESSAFFINITYMASK=yes
+!BV_HAVE_GETPROCESSMEMORYINFO=yes
+!BV_HAVE_GETPROCESSTIMES=yes
+BV_HAVE_GETRUSAGE=yes
+BV_HAVE_GETSERVBYPORT=yes
+!BV_HAVE_GETSYSTEMTIMEASFILETIME=yes
+BV_HAVE_GETTIMEOFDAY=yes
+BV_HAVE_GLOB=yes
+!BV_HAVE_GLXGETPROCADDRESS=yes
+BV_HAVE_GMTIME_R=yes
+BV_HAVE_INET_ATON=yes
+BV_HAVE_ISATTY=yes
+!BV_HAVE_JACK_PORT_GET_LATENCY_RANGE=yes
+!BV_HAVE_KBHIT=yes
+BV_HAVE_LOCALTIME_R=yes
+!BV_HAVE_LZO1X_999_COMPRESS=yes
+!BV_HAVE_MACH_ABSOLUTE_TIME=yes
+!BV_HAVE_MAPVIEWOFFILE=yes
+BV_HAVE_MEMALIGN=yes
+BV_HAVE_MKSTEMP=yes
+BV_HAVE_MMAP=yes
+BV_HAVE_MPROTECT=yes
+BV_HAVE_NANOSLEEP=yes
+!BV_HAVE_PEEKNAMEDPIPE=yes
+BV_HAVE_POSIX_MEMALIGN=yes
+BV_HAVE_PTHREAD_CANCEL=yes
+BV_HAVE_SCHED_GETAFFINITY=yes
+!BV_HAVE_SETCONSOLETEXTATTRIBUTE=yes
+!BV_HAVE_SETMODE=yes
+BV_HAVE_SETRLIMIT=yes
+!BV_HAVE_SLEEP=yes
+BV_HAVE_STRERROR_R=yes
+BV_HAVE_SYSCONF=yes
+!BV_HAVE_SYSCTL=yes
+BV_HAVE_USLEEP=yes
+!BV_HAVE_VIRTUALALLOC=yes
+!BV_HAVE_WGLGETPROCADDRESS=yes
+BV_HAVE_PTHREADS=yes
+!BV_HAVE_OS2THREADS=yes
+!BV_HAVE_W32THREADS=yes
+!BV_HAVE_AS_DN_DIRECTIVE=yes
+!BV_HAVE_AS_FUNC=yes
+!BV_HAVE_ASM_MOD_Q=yes
+BV_HAVE_ATTRIBUTE_MAY_ALIAS=yes
+BV_HAVE_ATTRIBUTE_PACKED=yes
+BV_HAVE_EBP_AVAILABLE=yes
+BV_HAVE_EBX_AVAILABLE=yes
+!BV_HAVE_GNU_AS=yes
+!BV_HAVE_GNU_WINDRES=yes
+!BV_HAVE_IBM_ASM=yes
+BV_HAVE_INLINE_ASM_LABELS=yes
+BV_HAVE_INLINE_ASM_NONLOCAL_LABELS=yes
+BV_HAVE_INLINE_ASM_DIRECT_SYMBOL_REFS=yes
+BV_HAVE_PRAGMA_DEPRECATED=yes
+!BV_HAVE_RSYNC_CONTIMEOUT=yes
+!BV_HAVE_SYMVER_ASM_LABEL=yes
+BV_HAVE_SYMVER_GNU_ASM=yes
+!BV_HAVE_VFP_ARGS=yes
+!BV_HAVE_XFORM_ASM=yes
+BV_HAVE_XMM_CLOBBERS=yes
+!BV_HAVE_CONDITION_VARIABLE_PTR=yes
+BV_HAVE_SOCKLEN_T=yes
+BV_HAVE_STRUCT_ADDRINFO=yes
+BV_HAVE_STRUCT_GROUP_SOURCE_REQ=yes
+BV_HAVE_STRUCT_IP_MREQ_SOURCE=yes
+BV_HAVE_STRUCT_IPV6_MREQ=yes
+BV_HAVE_STRUCT_POLLFD=yes
+BV_HAVE_STRUCT_RUSAGE_RU_MAXRSS=yes
+!BV_HAVE_STRUCT_SCTP_EVENT_SUBSCRIBE=yes
+BV_HAVE_STRUCT_SOCKADDR_IN6=yes
+!BV_HAVE_STRUCT_SOCKADDR_SA_LEN=yes
+BV_HAVE_STRUCT_SOCKADDR_STORAGE=yes
+BV_HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC=yes
+BV_HAVE_STRUCT_V4L2_FRMIVALENUM_DISCRETE=yes
+BV_HAVE_ATOMICS_NATIVE=yes
+!BV_HAVE_DOS_PATHS=yes
+!BV_HAVE_DXVA2API_COBJ=yes
+!BV_HAVE_DXVA2_LIB=yes
+!BV_HAVE_LIBC_MSVCRT=yes
+!BV_HAVE_LIBDC1394_1=yes
+!BV_HAVE_LIBDC1394_2=yes
+!BV_HAVE_MAKEINFO=yes
+!BV_HAVE_MAKEINFO_HTML=yes
+BV_HAVE_PERL=yes
+BV_HAVE_POD2MAN=yes
+!BV_HAVE_SDL=yes
+BV_HAVE_SECTION_DATA_REL_RO=yes
+!BV_HAVE_TEXI2HTML=yes
+BV_HAVE_THREADS=yes
+!BV_HAVE_VDPAU_X11=yes
+BV_HAVE_XLIB=yes
+BV_CONFIG_BVPARSERS=yes
+BV_CONFIG_BVPROTOCOLS=yes
+BV_CONFIG_BVDEVICES=yes
+!BV_CONFIG_BVINDEVS=yes
+!BV_CONFIG_BVOUTDEVS=yes
+BV_CONFIG_BVMUXERS=yes
+BV_CONFIG_BVDEMUXERS=yes
+BV_CONFIG_BVDRIVERS=yes
+BV_CONFIG_BVSYSTEMS=yes
+BV_CONFIG_BVCONFIGS=yes
+!BV_CONFIG_BVCFILES=yes
+BV_CONFIG_BVSERVERS=yes
+!BV_CONFIG_BVFILTERS=yes
+!BV_CONFIG_DOC=yes
+!BV_CONFIG_HTMLPAGES=yes
+BV_CONFIG_MANPAGES=yes
+BV_CONFIG_PODPAGES=yes
+!BV_CONFIG_TXTPAGES=yes
+BV_CONFIG_AVIO_READING_EXAMPLE=yes
+!BV_CONFIG_DECODING_ENCODING_EXAMPLE=yes
+!BV_CONFIG_DEMUXING_DECODING_EXAMPLE=yes
+!BV_CONFIG_EXTRACT_MVS_EXAMPLE=yes
+!BV_CONFIG_FILTER_AUDIO_EXAMPLE=yes
+!BV_CONFIG_FILTERING_AUDIO_EXAMPLE=yes
+!BV_CONFIG_FILTERING_VIDEO_EXAMPLE=yes
+!BV_CONFIG_METADATA_EXAMPLE=yes
+!BV_CONFIG_MUXING_EXAMPLE=yes
+!BV_CONFIG_REMUXING_EXAMPLE=yes
+!BV_CONFIG_RESAMPLING_AUDIO_EXAMPLE=yes
+!BV_CONFIG_SCALING_VIDEO_EXAMPLE=yes
+!BV_CONFIG_TRANSCODE_AAC_EXAMPLE=yes
+!BV_CONFIG_TRANSCODING_EXAMPLE=yes
+!BV_CONFIG_AVISYNTH=yes
+!BV_CONFIG_BZLIB=yes
+!BV_CONFIG_CRYSTALHD=yes
+!BV_CONFIG_DECKLINK=yes
+!BV_CONFIG_FREI0R=yes
+!BV_CONFIG_GNUTLS=yes
+BV_CONFIG_ICONV=yes
+!BV_CONFIG_LADSPA=yes
+!BV_CONFIG_LIBAACPLUS=yes
+!BV_CONFIG_LIBASS=yes
+!BV_CONFIG_LIBBLURAY=yes
+!BV_CONFIG_LIBBS2B=yes
+!BV_CONFIG_LIBCACA=yes
+!BV_CONFIG_LIBCDIO=yes
+!BV_CONFIG_LIBCELT=yes
+!BV_CONFIG_LIBDC1394=yes
+!BV_CONFIG_LIBFAAC=yes
+!BV_CONFIG_LIBFDK_AAC=yes
+!BV_CONFIG_LIBFLITE=yes
+!BV_CONFIG_LIBFONTCONFIG=yes
+!BV_CONFIG_LIBFREETYPE=yes
+!BV_CONFIG_LIBFRIBIDI=yes
+!BV_CONFIG_LIBGME=yes
+!BV_CONFIG_LIBGSM=yes
+!BV_CONFIG_LIBIEC61883=yes
+!BV_CONFIG_LIBILBC=yes
+!BV_CONFIG_LIBMODPLUG=yes
+!BV_CONFIG_LIBMP3LAME=yes
+!BV_CONFIG_LIBNUT=yes
+!BV_CONFIG_LIBOPENCORE_AMRNB=yes
+!BV_CONFIG_LIBOPENCORE_AMRWB=yes
+!BV_CONFIG_LIBOPENCV=yes
+!BV_CONFIG_LIBOPENJPEG=yes
+!BV_CONFIG_LIBOPUS=yes
+!BV_CONFIG_LIBPULSE=yes
+!BV_CONFIG_LIBQUVI=yes
+!BV_CONFIG_LIBRTMP=yes
+!BV_CONFIG_LIBSCHROEDINGER=yes
+!BV_CONFIG_LIBSHINE=yes
+!BV_CONFIG_LIBSMBCLIENT=yes
+!BV_CONFIG_LIBSOXR=yes
+!BV_CONFIG_LIBSPEEX=yes
+!BV_CONFIG_LIBSSH=yes
+!BV_CONFIG_LIBSTAGEFRIGHT_H264=yes
+!BV_CONFIG_LIBTHEORA=yes
+!BV_CONFIG_LIBTWOLAME=yes
+!BV_CONFIG_LIBUTVIDEO=yes
+!BV_CONFIG_LIBV4L2=yes
+!BV_CONFIG_LIBVIDSTAB=yes
+!BV_CONFIG_LIBVO_AACENC=yes
+!BV_CONFIG_LIBVO_AMRWBENC=yes
+!BV_CONFIG_LIBVORBIS=yes
+!BV_CONFIG_LIBVPX=yes
+!BV_CONFIG_LIBWAVPACK=yes
+!BV_CONFIG_LIBWEBP=yes
+!BV_CONFIG_LIBX264=yes
+!BV_CONFIG_LIBONVIFC=yes
+!BV_CONFIG_LIBAVFORMAT=yes
+!BV_CONFIG_LIBJANSSON=yes
+!BV_CONFIG_LIBBVFS=yes
+!BV_CONFIG_HIS3515=yes
+!BV_CONFIG_LIBX265=yes
+!BV_CONFIG_LIBXAVS=yes
+BV_CONFIG_LIBXCB=yes
+!BV_CONFIG_LIBXCB_SHM=yes
+!BV_CONFIG_LIBXCB_SHAPE=yes
+!BV_CONFIG_LIBXCB_XFIXES=yes
+!BV_CONFIG_LIBXVID=yes
+!BV_CONFIG_LIBZMQ=yes
+!BV_CONFIG_LIBZVBI=yes
+!BV_CONFIG_LZMA=yes
+!BV_CONFIG_NVENC=yes
+!BV_CONFIG_OPENAL=yes
+!BV_CONFIG_OPENCL=yes
+!BV_CONFIG_OPENGL=yes
+BV_CONFIG_OPENSSL=yes
+!BV_CONFIG_SDL=yes
+!BV_CONFIG_X11GRAB=yes
+BV_CONFIG_XLIB=yes
+!BV_CONFIG_ZLIB=yes
+!BV_CONFIG_FTRAPV=yes
+!BV_CONFIG_GRAY=yes
+!BV_CONFIG_HARDCODED_TABLES=yes
+BV_CONFIG_RUNTIME_CPUDETECT=yes
+BV_CONFIG_SAFE_BITSTREAM_READER=yes
+BV_CONFIG_SHARED=yes
+!BV_CONFIG_SMALL=yes
+BV_CONFIG_STATIC=yes
+!BV_CONFIG_SWSCALE_ALPHA=yes
+!BV_CONFIG_DXVA2=yes
+!BV_CONFIG_VAAPI=yes
+!BV_CONFIG_VDA=yes
+!BV_CONFIG_VDPAU=yes
+!BV_CONFIG_XVMC=yes
+!BV_CONFIG_GPL=yes
+!BV_CONFIG_NONFREE=yes
+!BV_CONFIG_VERSION3=yes
+BV_CONFIG_BVUTIL=yes
+BV_CONFIG_BVMEDIA=yes
+BV_CONFIG_BVCODEC=yes
+BV_CONFIG_BVDEVICE=yes
+BV_CONFIG_BVCONFIG=yes
+BV_CONFIG_BVSYSTEM=yes
+BV_CONFIG_BVSERVER=yes
+BV_CONFIG_BVPROTOCOL=yes
+BV_CONFIG_BVFILTER=yes
+!BV_CONFIG_FFPLAY=yes
+!BV_CONFIG_FFPROBE=yes
+!BV_CONFIG_FFSERVER=yes
+!BV_CONFIG_FFMPEG=yes
+!BV_CONFIG_DCT=yes
+!BV_CONFIG_DWT=yes
+BV_CONFIG_ERROR_RESILIENCE=yes
+BV_CONFIG_FAAN=yes
+BV_CONFIG_FAST_UNALIGNED=yes
+!BV_CONFIG_FFT=yes
+!BV_CONFIG_LSP=yes
+!BV_CONFIG_LZO=yes
+!BV_CONFIG_MDCT=yes
+BV_CONFIG_PIXELUTILS=yes
+BV_CONFIG_NETWORK=yes
+!BV_CONFIG_RDFT=yes
+!BV_CONFIG_FONTCONFIG=yes
+!BV_CONFIG_INCOMPATIBLE_LIBBV_ABI=yes
+!BV_CONFIG_MEMALIGN_HACK=yes
+!BV_CONFIG_MEMORY_POISONING=yes
+!BV_CONFIG_NEON_CLOBBER_TEST=yes
+BV_CONFIG_PIC=yes
+BV_CONFIG_POD2MAN=yes
+!BV_CONFIG_RAISE_MAJOR=yes
+!BV_CONFIG_THUMB=yes
+!BV_CONFIG_XMM_CLOBBER_TEST=yes
+!BV_CONFIG_AANDCTTABLES=yes
+!BV_CONFIG_AC3DSP=yes
+!BV_CONFIG_AUDIO_FRAME_QUEUE=yes
+!BV_CONFIG_AUDIODSP=yes
+!BV_CONFIG_BLOCKDSP=yes
+!BV_CONFIG_BSWAPDSP=yes
+BV_CONFIG_CABAC=yes
+!BV_CONFIG_DVPROFILE=yes
+!BV_CONFIG_EXIF=yes
+BV_CONFIG_FAANDCT=yes
+BV_CONFIG_FAANIDCT=yes
+BV_CONFIG_FDCTDSP=yes
+!BV_CONFIG_FRAME_THREAD_ENCODER=yes
+!BV_CONFIG_GCRYPT=yes
+BV_CONFIG_GOLOMB=yes
+!BV_CONFIG_GPLV3=yes
+!BV_CONFIG_H263DSP=yes
+BV_CONFIG_H264CHROMA=yes
+BV_CONFIG_H264DSP=yes
+BV_CONFIG_H264PRED=yes
+BV_CONFIG_H264QPEL=yes
+!BV_CONFIG_HPELDSP=yes
+!BV_CONFIG_HUFFMAN=yes
+!BV_CONFIG_HUFFYUVDSP=yes
+!BV_CONFIG_HUFFYUVENCDSP=yes
+BV_CONFIG_IDCTDSP=yes
+!BV_CONFIG_IIRFILTER=yes
+!BV_CONFIG_INTRAX8=yes
+!BV_CONFIG_LGPLV3=yes
+!BV_CONFIG_LLAUDDSP=yes
+!BV_CONFIG_LLVIDDSP=yes
+!BV_CONFIG_LPC=yes
+BV_CONFIG_ME_CMP=yes
+!BV_CONFIG_MPEG_ER=yes
+!BV_CONFIG_MPEGAUDIO=yes
+!BV_CONFIG_MPEGAUDIODSP=yes
+!BV_CONFIG_MPEGVIDEO=yes
+!BV_CONFIG_MPEGVIDEOENC=yes
+!BV_CONFIG_NETTLE=yes
+BV_CONFIG_PIXBLOCKDSP=yes
+!BV_CONFIG_QPELDSP=yes
+!BV_CONFIG_RANGECODER=yes
+BV_CONFIG_RIFFDEC=yes
+!BV_CONFIG_RIFFENC=yes
+BV_CONFIG_RTPDEC=yes
+!BV_CONFIG_RTPENC_CHAIN=yes
+!BV_CONFIG_SINEWIN=yes
+BV_CONFIG_STARTCODE=yes
+!BV_CONFIG_TPELDSP=yes
+BV_CONFIG_VIDEODSP=yes
+!BV_CONFIG_VP3DSP=yes
+!BV_CONFIG_WMA_FREQS=yes
+!BV_CONFIG_DXVA2=yes
+!BV_CONFIG_VAAPI=yes
+!BV_CONFIG_VDA=yes
+!BV_CONFIG_VDPAU=yes
+!BV_CONFIG_XVMC=yes
+BV_CONFIG_H264_PARSER=yes
+BV_CONFIG_GPS_DEVICE=yes
+BV_CONFIG_SERIAL_DEVICE=yes
+BV_CONFIG_PTZ_DEVICE=yes
+!BV_CONFIG_ONVIF_DEV_DEVICE=yes
+!BV_CONFIG_ONVIF_PTZ_DEVICE=yes
+!BV_CONFIG_DISK_DEV_DEVICE=yes
+BV_CONFIG_LOCAL_CONFIG=yes
+!BV_CONFIG_ONVIF_CONFIG=yes
+!BV_CONFIG_JSON_CFILE=yes
+BV_CONFIG_BVS_SERVER=yes
+BV_CONFIG_BVC_SERVER=yes
+BV_CONFIG_MTC_SERVER=yes
+BV_CONFIG_X86_SYSTEM=yes
+!BV_CONFIG_HIS3515_SYSTEM=yes
+!BV_CONFIG_HISAVI_INDEV=yes
+!BV_CONFIG_HISAVE_INDEV=yes
+!BV_CONFIG_ONVIFAVE_INDEV=yes
+!BV_CONFIG_HISAVO_OUTDEV=yes
+!BV_CONFIG_HISAVD_OUTDEV=yes
+BV_CONFIG_DAV_MUXER=yes
+BV_CONFIG_SHMBUS_MUXER=yes
+BV_CONFIG_DAV_DEMUXER=yes
+BV_CONFIG_SHMBUS_DEMUXER=yes
+BV_CONFIG_RTSP_DEMUXER=yes
+BV_CONFIG_TW2866_DRIVER=yes
+BV_CONFIG_TLV320AIC23_DRIVER=yes
+BV_CONFIG_FILE_PROTOCOL=yes
+BV_CONFIG_TCP_PROTOCOL=yes
+BV_CONFIG_TLS_PROTOCOL=yes
+BV_CONFIG_UDP_PROTOCOL=yes
+!BV_CONFIG_BVFS_PROTOCOL=yes
+BV_CONFIG_HTTP_PROTOCOL=yes
+BV_CONFIG_HTTPS_PROTOCOL=yes
+BV_CONFIG_HTTPPROXY_PROTOCOL=yes
+BV_CONFIG_MEM_PROTOCOL=yes
+BV_CONFIG_UNIX_PROTOCOL=yes
+BV_CONFIG_CACHE_PROTOCOL=yes
+BV_CONFIG_CRYPTO_PROTOCOL=yes
+BV_CONFIG_CONCAT_PROTOCOL=yes
+BV_CONFIG_FEC_PROTOCOL=yes
+BV_CONFIG_ARQ_PROTOCOL=yes
+endif # BVBASE_CONFIG_MAK
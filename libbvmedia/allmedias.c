@@ -62,10 +62,6 @@
             bv_media_driver_register(&bv_##x##_driver);               \
     }
 
-
-#if BV_CONFIG_ONVIFAVE_INDEV
-#include <libavformat/avformat.h>
-#endif
 void bv_media_register_all(void)
 {
     static int initialized;
@@ -77,12 +73,11 @@ void bv_media_register_all(void)
     REGISTER_INDEV(ONVIFAVE, onvifave);
     REGISTER_MUXER(DAV, dav);
     REGISTER_DEMUXER(DAV, dav);
+    REGISTER_MUXER(SHMBUS, shmbus);
+    REGISTER_DEMUXER(SHMBUS, shmbus);
+    REGISTER_DEMUXER(RTSP, rtsp);
     REGISTER_OUTDEV(HISAVO, hisavo);
     REGISTER_OUTDEV(HISAVD, hisavd);
-#if BV_CONFIG_ONVIFAVE_INDEV
-    av_register_all();
-    avformat_network_init();
-#endif
 
     REGISTER_DRIVER(TW2866, tw2866);
     REGISTER_DRIVER(TLV320AIC23, tlv320aic23);
@@ -42,6 +42,13 @@ struct _BVMediaContext;
 
 #define BV_MEDIA_FLAGS_NOSTREAMS    0x1000
 
+/**
+ * BVMediaContext.flags: bv_input_media_read() does not wait for input and
+ * returns 0 when no packet is ready. Demuxers supporting it answer
+ * BV_MEDIA_MESSAGE_TYPE_POLL_INFO.
+ */
+#define BV_MEDIA_CONTEXT_FLAG_NONBLOCK  0x0001
+
 enum BVMediaMessageType {
     BV_MEDIA_MESSAGE_TYPE_NONE = -1,
     BV_MEDIA_MESSAGE_TYPE_AUDIO_MUTE,           //静音
@@ -61,9 +68,18 @@ enum BVMediaMessageType {
     BV_MEDIA_MESSAGE_TYPE_OSD_SHOW,             //显示OSD
     BV_MEDIA_MESSAGE_TYPE_OSD_UPDATE,           //更新OSD数据
     BV_MEDIA_MESSAGE_TYPE_OSD_UPCFG,            //更新OSD配置
+    BV_MEDIA_MESSAGE_TYPE_POLL_INFO,            //查询非阻塞读需要等待的文件描述符 pkt_out->data BVMediaPollInfo
     BV_MEDIA_MESSAGE_TYPE_UNKNOW
 };
 
+#define BV_MEDIA_MAX_POLL_FDS       32
+
+typedef struct _BVMediaPollInfo {
+    int fds[BV_MEDIA_MAX_POLL_FDS];     ///< to watch for reading
+    int nb_fds;
+    int64_t timeout;    ///< microseconds after which to read even without input, -1 for none
+} BVMediaPollInfo;
+
 typedef struct _BVInputMedia {
     const char *name;
     const char *extensions;
@@ -109,6 +125,7 @@ typedef struct _BVMediaContext {
     char filename[1024];
     int nb_streams;
     BVStream **streams;
+    int flags;          ///< BV_MEDIA_CONTEXT_FLAG_*
 } BVMediaContext;
 
 void bv_input_media_register(BVInputMedia *ifmt);
@@ -23,34 +23,197 @@
 
 #line 25 "davdmx.c"
 
+#include <libbvutil/intreadwrite.h>
+
 #include "bvmedia.h"
+#include "dav.h"
 
 /**
  *  read stream info from dav file 
+ *
+ *  The frames are parsed in place with bv_io_peek(), only the payload is
+ *  copied, into the packet. Damaged frames are skipped up to the next
+ *  header flag.
  */
 
+#define DAV_HEADER_SIZE     24
+#define DAV_ENDER_SIZE      8
+#define DAV_MAX_FRAME_SIZE  (8 << 20)
+
 typedef struct DavDeMuxContext {
     const BVClass *bv_class;
+    int stream_index[2];        ///< video, audio
+    int64_t pts[2];             ///< milliseconds
+    int last_ms[2];
 } DavDeMuxContext;
 
 static int dav_probe(BVMediaContext *s, BVProbeData *p)
 {
+    if (p->buf && p->buf_size >= 4 && !memcmp(p->buf, "ZLAV", 4))
+        return BV_PROBE_SCORE_MAX / 2;
     return 0;
 }
 
+static int dav_header_valid(const uint8_t *p)
+{
+    uint8_t crc = 0;
+    int i, len = BV_RL32(p + 12);
+
+    if (memcmp(p, "ZLAV", 4))
+        return 0;
+    for (i = 0; i < DAV_HEADER_SIZE - 1; i++)
+        crc += p[i];
+    return crc == p[DAV_HEADER_SIZE - 1] && len <= DAV_MAX_FRAME_SIZE &&
+           len >= DAV_HEADER_SIZE + p[22] + DAV_ENDER_SIZE;
+}
+
+/**
+ * Peek the next valid frame of s->pb as a whole.
+ *
+ * @return size of the frame at *frame, or a negative error code
+ */
+static int dav_peek_frame(BVMediaContext *s, const uint8_t **frame)
+{
+    const uint8_t *p;
+    int ret, len, skip;
+
+    for (;;) {
+        if ((ret = bv_io_peek(s->pb, DAV_HEADER_SIZE, &p)) < DAV_HEADER_SIZE)
+            return ret < 0 ? ret : BVERROR_EOF;
+        if (dav_header_valid(p)) {
+            len = BV_RL32(p + 12);
+            if ((ret = bv_io_peek(s->pb, len, &p)) < len)
+                return ret < 0 ? ret : BVERROR_EOF;
+            if (!memcmp(p + len - DAV_ENDER_SIZE, "zlav", 4) && BV_RL32(p + len - 4) == len) {
+                *frame = p;
+                return len;
+            }
+        }
+        for (skip = 1; skip + 4 <= ret && memcmp(p + skip, "ZLAV", 4); skip++);
+        bv_log(s, BV_LOG_DEBUG, "skipping %d bytes of damaged data\n", skip);
+        bv_io_skip_consumed(s->pb, skip);
+    }
+}
+
+static enum BVCodecID dav_video_codec(int type)
+{
+    return type == VIDEO_ENCODE_MPEG4 ? BV_CODEC_ID_MPEG : BV_CODEC_ID_H264;
+}
+
+static enum BVCodecID dav_audio_codec(int type)
+{
+    switch (type) {
+    case AUDIO_ENCODE_G711U:    return BV_CODEC_ID_G711U;
+    case AUDIO_ENCODE_G726:     return BV_CODEC_ID_G726;
+    default:                    return BV_CODEC_ID_G711A;
+    }
+}
+
+static int dav_sample_rate(int rate)
+{
+    static const int rates[] = { 4000, 8000, 11025, 16000, 20000, 22050, 32000, 44100, 48000 };
+    return rate >= SAMPLE_FREQ_4000 && rate <= SAMPLE_FREQ_48000 ? rates[rate - SAMPLE_FREQ_4000] : 8000;
+}
+
+/**
+ * Take the stream parameters from the added data of key and audio frames.
+ */
+static void dav_update_codec(BVMediaContext *s, const uint8_t *p)
+{
+    DavDeMuxContext *davctx = s->priv_data;
+    const uint8_t *added = p + DAV_HEADER_SIZE;
+    BVCodecContext *codec;
+
+    if (p[4] == FRAME_TYPE_I_SLICE && p[22] >= sizeof(IDRFrameAddedHeader)) {
+        codec = s->streams[davctx->stream_index[0]]->codec;
+        codec->width    = added[2] << 3;
+        codec->height   = added[3] << 3;
+        codec->codec_id = dav_video_codec(added[6]);
+    } else if (p[4] == FRAME_TYPE_AUDIO && p[22] >= sizeof(AudioFrameAddHeader)) {
+        codec = s->streams[davctx->stream_index[1]]->codec;
+        codec->channels    = added[1] ? added[1] : 1;
+        codec->codec_id    = dav_audio_codec(added[2]);
+        codec->sample_rate = dav_sample_rate(added[3]);
+    }
+}
+
 static int dav_read_header(BVMediaContext *s)
 {
-    return BVERROR(ENOSYS);
+    DavDeMuxContext *davctx = s->priv_data;
+    enum BVMediaType types[2] = { BV_MEDIA_TYPE_VIDEO, BV_MEDIA_TYPE_AUDIO };
+    const uint8_t *p;
+    BVStream *stream;
+    int i;
+
+    if (!s->pb) {
+        bv_log(s, BV_LOG_ERROR, "file pb is NULL, open protocol first\n");
+        return BVERROR(EINVAL);
+    }
+    for (i = 0; i < 2; i++) {
+        if (!(stream = bv_stream_new(s, NULL)))
+            return BVERROR(ENOMEM);
+        stream->codec->codec_type = types[i];
+        stream->codec->codec_id   = i ? BV_CODEC_ID_G711A : BV_CODEC_ID_H264;
+        stream->time_base         = (BVRational) { 1, 1000 };
+        davctx->stream_index[i]   = stream->index;
+        davctx->last_ms[i]        = -1;
+    }
+    s->streams[davctx->stream_index[1]]->codec->sample_rate = 8000;
+    s->streams[davctx->stream_index[1]]->codec->channels    = 1;
+    if (dav_peek_frame(s, &p) > 0)
+        dav_update_codec(s, p);
+    return 0;
 }
 
 static int dav_read_packet(BVMediaContext *s, BVPacket *pkt)
 {
-    return BVERROR(ENOSYS);
+    DavDeMuxContext *davctx = s->priv_data;
+    const uint8_t *p;
+    int len, size, ms, type, ret;
+
+    for (;;) {
+        if ((len = dav_peek_frame(s, &p)) < 0)
+            return len;
+        switch (p[4]) {
+        case FRAME_TYPE_I_SLICE:
+        case FRAME_TYPE_P_SLICE:
+        case FRAME_TYPE_B_SLICE:
+        case FRAME_TYPE_STATIC_IMAGE:
+            type = 0;
+            break;
+        case FRAME_TYPE_AUDIO:
+            type = 1;
+            break;
+        default:
+            bv_io_skip_consumed(s->pb, len);
+            continue;
+        }
+        break;
+    }
+
+    dav_update_codec(s, p);
+    size = len - DAV_HEADER_SIZE - p[22] - DAV_ENDER_SIZE;
+    if ((ret = bv_packet_new(pkt, size)) < 0)
+        return ret;
+    memcpy(pkt->data, p + DAV_HEADER_SIZE + p[22], size);
+    pkt->stream_index = davctx->stream_index[type];
+    if (p[4] == FRAME_TYPE_I_SLICE || type)
+        pkt->flags |= BV_PKT_FLAG_KEY;
+
+    /* the muxer stores milliseconds modulo 65535 */
+    ms = BV_RL16(p + 20);
+    if (davctx->last_ms[type] >= 0)
+        davctx->pts[type] += (ms - davctx->last_ms[type] + 65535) % 65535;
+    davctx->last_ms[type] = ms;
+    pkt->pts = pkt->dts = davctx->pts[type];
+
+    bv_io_skip_consumed(s->pb, len);
+    return pkt->size;
 }
 
 static int dav_read_close(BVMediaContext *s) 
 {
-    return BVERROR(ENOSYS);
+    return 0;
 }
 
 static int dav_media_control(BVMediaContext *s, enum BVMediaMessageType type, const BVControlPacket *pkt_in, BVControlPacket *pkt_out)
@@ -84,3 +247,164 @@ BVInputMedia bv_dav_demuxer = {
     .read_close         = dav_read_close,
     .media_control      = dav_media_control,
 };
+
+#ifdef TEST
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <libbvprotocol/bvurl.h>
+
+#undef printf
+
+/* stream, key, pts in microseconds, size */
+static const struct {
+    int stream, key, pts, size;
+} test_frames[] = {
+    { 0, 1,      0, 100 },
+    { 1, 1,  20000, 160 },
+    { 0, 0,  40000,  50 },         ///< cut in half
+    { 1, 1,  60000, 160 },
+    { 0, 0,  80000,  70 },
+    { 0, 1, 120000, 120 },         ///< cut at the tail
+};
+
+/* frame index, pts in milliseconds of what is read back */
+static const int test_expect[][2] = {
+    { 0, 0 }, { 1, 0 }, { 3, 40 }, { 4, 80 },
+};
+
+#define CHECK(x) do { if (!(x)) { printf("line %d: %s\n", __LINE__, #x); goto fail; } } while (0)
+
+static int test_mux(const char *url)
+{
+    BVMediaContext *s = NULL;
+    BVIOContext *pb = NULL;
+    BVStream *st;
+    BVPacket pkt;
+    int i, ret;
+
+    if ((ret = bv_io_open(&pb, url, BV_IO_FLAG_WRITE, NULL, NULL)) < 0)
+        return ret;
+    if (!(s = bv_media_context_alloc()))
+        return BVERROR(ENOMEM);
+    s->pb = pb;
+    if ((ret = bv_output_media_open(&s, NULL, "dav", NULL, NULL)) < 0)
+        goto end;
+    for (i = 0; i < 2; i++) {
+        if (!(st = bv_stream_new(s, NULL))) {
+            ret = BVERROR(ENOMEM);
+            goto end;
+        }
+        st->codec->codec_type = i ? BV_MEDIA_TYPE_AUDIO : BV_MEDIA_TYPE_VIDEO;
+        st->codec->codec_id   = i ? BV_CODEC_ID_G711U : BV_CODEC_ID_H264;
+        st->codec->width      = 352;
+        st->codec->height     = 288;
+        st->codec->time_base  = (BVRational) { 25, 1 };
+        st->codec->sample_rate = 16000;
+        st->codec->channels   = 1;
+    }
+    if ((ret = bv_output_media_write_header(s, NULL)) < 0)
+        goto end;
+    for (i = 0; i < BV_ARRAY_ELEMS(test_frames); i++) {
+        bv_packet_init(&pkt);
+        if ((ret = bv_packet_new(&pkt, test_frames[i].size)) < 0)
+            goto end;
+        memset(pkt.data, i, pkt.size);
+        pkt.stream_index = test_frames[i].stream;
+        pkt.flags = test_frames[i].key ? BV_PKT_FLAG_KEY : 0;
+        pkt.pts = test_frames[i].pts;
+        ret = bv_output_media_write(s, &pkt);
+        bv_packet_free(&pkt);
+        if (ret < 0)
+            goto end;
+    }
+    ret = bv_output_media_write_trailer(s);
+end:
+    bv_output_media_close(&s);
+    bv_io_close(pb);
+    return ret;
+}
+
+/**
+ * Rewrite the muxed file with junk in front, frame 2 cut in half and
+ * frame 5 cut short.
+ */
+static int test_damage(const char *path)
+{
+    static const char junk[] = "xZLAVjunk-junk-junk-junk-junk";
+    uint8_t buf[4096];
+    FILE *f;
+    int i, len, size = 0, pos = 0;
+
+    if (!(f = fopen(path, "rb")))
+        return -1;
+    size = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+    if (!(f = fopen(path, "wb")))
+        return -1;
+    fwrite(junk, 1, sizeof(junk) - 1, f);
+    for (i = 0; i < BV_ARRAY_ELEMS(test_frames) && pos + DAV_HEADER_SIZE <= size; i++) {
+        len = BV_RL32(buf + pos + 12);
+        if (i == 2 || i == 5)
+            fwrite(buf + pos, 1, len / 2, f);
+        else
+            fwrite(buf + pos, 1, len, f);
+        pos += len;
+    }
+    fclose(f);
+    return i == BV_ARRAY_ELEMS(test_frames) && pos == size ? 0 : -1;
+}
+
+int main(void)
+{
+    BVMediaContext *s = NULL;
+    BVIOContext *pb = NULL;
+    BVPacket pkt;
+    char path[64], url[80];
+    int i, n, errors = 0;
+
+    bv_protocol_register_all();
+    bv_media_register_all();
+    bv_packet_init(&pkt);
+    snprintf(path, sizeof(path), "/tmp/davdmx-test-%d.dav", getpid());
+    snprintf(url, sizeof(url), "file:%s", path);
+
+    CHECK(test_mux(url) >= 0);
+    CHECK(!test_damage(path));
+
+    CHECK(bv_io_open(&pb, url, BV_IO_FLAG_READ, NULL, NULL) >= 0);
+    CHECK(s = bv_media_context_alloc());
+    s->pb = pb;
+    CHECK(bv_input_media_open(&s, NULL, url, &bv_dav_demuxer, NULL) >= 0);
+    CHECK(s->nb_streams == 2);
+    CHECK(s->streams[0]->codec->width == 352 && s->streams[0]->codec->height == 288);
+
+    for (n = 0; n < BV_ARRAY_ELEMS(test_expect); n++) {
+        i = test_expect[n][0];
+        CHECK(bv_input_media_read(s, &pkt) == test_frames[i].size);
+        CHECK(pkt.stream_index == test_frames[i].stream);
+        CHECK(!!(pkt.flags & BV_PKT_FLAG_KEY) == test_frames[i].key);
+        CHECK(pkt.pts == test_expect[n][1]);
+        CHECK(pkt.data[0] == i && pkt.data[pkt.size - 1] == i);
+        bv_packet_free(&pkt);
+    }
+    CHECK(s->streams[1]->codec->codec_id == BV_CODEC_ID_G711U);
+    CHECK(s->streams[1]->codec->sample_rate == 16000);
+    CHECK(bv_input_media_read(s, &pkt) == BVERROR_EOF);
+
+    if (0) {
+fail:
+        errors++;
+    }
+    bv_packet_free(&pkt);
+    if (s)
+        bv_input_media_close(&s);
+    if (pb)
+        bv_io_close(pb);
+    unlink(path);
+    printf("%s\n", errors ? "FAIL" : "OK");
+    return !!errors;
+}
+
+#endif /* TEST */
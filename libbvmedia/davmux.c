@@ -27,7 +27,8 @@
 #include <time.h>
 
 typedef struct DavMuxContext {
-    uint8_t channel;
+    const BVClass *bv_class;
+    int channel;
     int width;
     int height;
     int fps;
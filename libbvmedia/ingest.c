@@ -0,0 +1,851 @@
+/*************************************************************************
+    > File Name: ingest.c
+    > Author: albertfang
+    > Mail: fang.qi@besovideo.com
+    > Created Time: 2026年10月22日 星期四 09时13分02秒
+ ************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) albert@BesoVideo, 2026
+ */
+
+#line 25 "ingest.c"
+
+#include "config.h"
+
+#if BV_HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+#include <libbvutil/atomic.h>
+#include <libbvutil/bvstring.h>
+#include <libbvutil/eventloop.h>
+#include <libbvutil/lfg.h>
+#include <libbvutil/mem.h>
+#include <libbvutil/random_seed.h>
+#include <libbvutil/threadmessage.h>
+#include <libbvutil/time.h>
+
+#include "ingest.h"
+
+#if BV_HAVE_PTHREADS
+
+#define INGEST_MAX_JOBS         256
+#define INGEST_MAX_BURST        64          ///< packets read before the other channels get a turn
+#define INGEST_REQUEUE_DELAY    100000      ///< opener queue full
+#define INGEST_MIN_BACKOFF      500000
+#define INGEST_MAX_BACKOFF      30000000
+#define INGEST_STABLE_TIME      10000000    ///< a session this old resets the backoff
+
+typedef struct IngestLoop {
+    BVEventLoop *loop;
+    pthread_t thread;
+    int started;
+    int nb_channels;            ///< protected by BVIngest.lock
+    BVLFG lfg;
+} IngestLoop;
+
+typedef struct IngestChannel {
+    struct BVIngest *ingest;
+    IngestLoop *loop;
+    int id;
+    char *url;
+    BVInputMedia *media;
+    BVDictionary *options;
+    BVThreadMessageQueue *queue;
+    volatile int refs;          ///< the loop's, plus one per running bv_ingest_read()
+
+    /* owned by the loop thread, or by the opener while opening is set */
+    BVMediaContext *s;
+    BVMediaContext *pending;
+    int pending_ret;
+    int opening;
+    int removed;
+
+    int fds[BV_MEDIA_MAX_POLL_FDS];
+    int nb_fds;
+    BVEventTimer *timer;
+    int64_t timer_due;
+    int64_t started;
+    int64_t backoff;
+    uint64_t video_mask;        ///< streams dropped up to a key frame
+    int wait_key;
+    uint32_t dropped;
+} IngestChannel;
+
+struct BVIngest {
+    IngestLoop *loops;
+    int nb_loops;
+    pthread_t *openers;
+    int nb_openers;
+    BVThreadMessageQueue *jobs;         ///< IngestChannel * to open
+
+    pthread_mutex_t lock;
+    IngestChannel **channels;           ///< indexed by channel id
+    int nb_channels;
+    int closing;
+
+    BVIngestStateCallback cb;
+    void *opaque;
+};
+
+static void channel_timer(BVEventLoop *loop, BVEventTimer *timer, void *opaque);
+static void channel_service(IngestChannel *ch);
+
+static void channel_set_state(IngestChannel *ch, enum BVIngestState state)
+{
+    BVIngest *ingest = ch->ingest;
+
+    if (ingest->cb)
+        ingest->cb(ingest->opaque, ch->id, state, state == BV_INGEST_STATE_RUNNING ? ch->s : NULL);
+}
+
+/**
+ * Make sure the channel is looked at in timeout microseconds at the
+ * latest. An earlier timer is kept, looking too early is harmless.
+ */
+static void channel_schedule(IngestChannel *ch, int64_t timeout)
+{
+    int64_t due = bv_gettime_relative() + timeout;
+
+    if (ch->timer && ch->timer_due <= due)
+        return;
+    bv_event_loop_del_timer(ch->loop->loop, ch->timer);
+    ch->timer     = bv_event_loop_add_timer(ch->loop->loop, timeout, 0, channel_timer, ch);
+    ch->timer_due = due;
+    if (!ch->timer)
+        bv_log(NULL, BV_LOG_ERROR, "ingest %d: cannot arm timer\n", ch->id);
+}
+
+static void channel_fd(BVEventLoop *loop, int fd, int events, void *opaque)
+{
+    channel_service(opaque);
+}
+
+/**
+ * Follow the fds and the next deadline the demuxer asks for.
+ */
+static int channel_update(IngestChannel *ch, int again)
+{
+    BVEventLoop *loop = ch->loop->loop;
+    BVMediaPollInfo info;
+    BVControlPacket out = { .size = sizeof(info), .data = &info };
+    int i, j, ret;
+
+    if ((ret = bv_media_context_control(ch->s, BV_MEDIA_MESSAGE_TYPE_POLL_INFO, NULL, &out)) < 0)
+        return ret;
+    for (i = 0; i < ch->nb_fds; i++) {
+        for (j = 0; j < info.nb_fds && info.fds[j] != ch->fds[i]; j++);
+        if (j == info.nb_fds)
+            bv_event_loop_del_fd(loop, ch->fds[i]);
+    }
+    for (j = 0; j < info.nb_fds; j++) {
+        for (i = 0; i < ch->nb_fds && ch->fds[i] != info.fds[j]; i++);
+        if (i == ch->nb_fds &&
+            (ret = bv_event_loop_add_fd(loop, info.fds[j], BV_EVENT_READ, channel_fd, ch)) < 0) {
+            ch->nb_fds = 0;
+            return ret;
+        }
+    }
+    memcpy(ch->fds, info.fds, info.nb_fds * sizeof(*info.fds));
+    ch->nb_fds = info.nb_fds;
+
+    if (again)
+        channel_schedule(ch, 0);
+    else if (info.timeout >= 0)
+        channel_schedule(ch, info.timeout);
+    return 0;
+}
+
+static void channel_close_session(IngestChannel *ch)
+{
+    int i;
+
+    for (i = 0; i < ch->nb_fds; i++)
+        bv_event_loop_del_fd(ch->loop->loop, ch->fds[i]);
+    ch->nb_fds = 0;
+    bv_event_loop_del_timer(ch->loop->loop, ch->timer);
+    ch->timer = NULL;
+    if (ch->s)
+        bv_input_media_close(&ch->s);
+}
+
+static void channel_unref(IngestChannel *ch)
+{
+    BVPacket pkt;
+
+    if (bvpriv_atomic_int_add_and_fetch(&ch->refs, -1))
+        return;
+    if (ch->queue) {
+        while (bv_thread_message_queue_recv(ch->queue, &pkt, BV_THREAD_MESSAGE_NONBLOCK) >= 0)
+            bv_packet_free(&pkt);
+        bv_thread_message_queue_free(&ch->queue);
+    }
+    bv_free(ch->url);
+    bv_dict_free(&ch->options);
+    bv_free(ch);
+}
+
+/**
+ * Drop the loop's reference, the session is closed. Readers still in
+ * bv_ingest_read() return and the last of them frees the channel.
+ */
+static void channel_free(IngestChannel *ch)
+{
+    BVIngest *ingest = ch->ingest;
+
+    pthread_mutex_lock(&ingest->lock);
+    ch->loop->nb_channels--;
+    pthread_mutex_unlock(&ingest->lock);
+    bv_thread_message_queue_set_err_recv(ch->queue, BVERROR_EOF);
+    channel_unref(ch);
+}
+
+static void channel_connect(IngestChannel *ch)
+{
+    ch->opening = 1;
+    if (bv_thread_message_queue_send(ch->ingest->jobs, &ch, BV_THREAD_MESSAGE_NONBLOCK) < 0) {
+        ch->opening = 0;
+        channel_schedule(ch, INGEST_REQUEUE_DELAY);
+        return;
+    }
+    channel_set_state(ch, BV_INGEST_STATE_CONNECTING);
+}
+
+static void channel_retry(IngestChannel *ch)
+{
+    int64_t now = bv_gettime_relative(), delay;
+
+    if (ch->started && now - ch->started > INGEST_STABLE_TIME)
+        ch->backoff = 0;
+    ch->started = 0;
+    ch->backoff = ch->backoff ? BBMIN(ch->backoff * 2, INGEST_MAX_BACKOFF) : INGEST_MIN_BACKOFF;
+    /* +-25%, so that cameras behind one broken link do not come back in step */
+    delay = ch->backoff * 3 / 4 + bv_lfg_get(&ch->loop->lfg) % (ch->backoff / 2 + 1);
+    channel_set_state(ch, BV_INGEST_STATE_RETRYING);
+    channel_schedule(ch, delay);
+}
+
+static void channel_fail(IngestChannel *ch, int err)
+{
+    if (err != BVERROR_EXIT)
+        bv_log(NULL, BV_LOG_WARNING, "ingest %d: %s: %s\n", ch->id, ch->url, bv_err2str(err));
+    channel_close_session(ch);
+    channel_retry(ch);
+}
+
+static void channel_queue(IngestChannel *ch, BVPacket *pkt)
+{
+    int video = pkt->stream_index < 64 && (ch->video_mask >> pkt->stream_index & 1);
+
+    if (video && ch->wait_key) {
+        if (!(pkt->flags & BV_PKT_FLAG_KEY))
+            goto drop;
+        ch->wait_key = 0;
+    }
+    if (bv_thread_message_queue_send(ch->queue, pkt, BV_THREAD_MESSAGE_NONBLOCK) >= 0)
+        return;
+    /* the reader is behind, the frames after a dropped one are useless */
+    if (video)
+        ch->wait_key = 1;
+drop:
+    if (!(ch->dropped++ & 1023))
+        bv_log(NULL, BV_LOG_WARNING, "ingest %d: reader too slow, %u packets dropped\n",
+               ch->id, ch->dropped);
+    bv_packet_free(pkt);
+}
+
+static void channel_service(IngestChannel *ch)
+{
+    BVPacket pkt;
+    int i, ret;
+
+    for (i = 0; i < INGEST_MAX_BURST; i++) {
+        bv_packet_init(&pkt);
+        ret = bv_input_media_read(ch->s, &pkt);
+        if (ret < 0) {
+            bv_packet_free(&pkt);
+            channel_fail(ch, ret);
+            return;
+        }
+        if (!ret)
+            break;
+        channel_queue(ch, &pkt);
+    }
+    /* a full burst may have left data behind, which raises no event */
+    if ((ret = channel_update(ch, i == INGEST_MAX_BURST)) < 0)
+        channel_fail(ch, ret);
+}
+
+static void channel_timer(BVEventLoop *loop, BVEventTimer *timer, void *opaque)
+{
+    IngestChannel *ch = opaque;
+
+    ch->timer = NULL;
+    if (ch->s)
+        channel_service(ch);
+    else
+        channel_connect(ch);
+}
+
+static void channel_opened(BVEventLoop *loop, void *opaque)
+{
+    IngestChannel *ch = opaque;
+    BVMediaContext *s = ch->pending;
+    int i, ret;
+
+    ch->opening = 0;
+    ch->pending = NULL;
+    if (ch->removed) {
+        if (s)
+            bv_input_media_close(&s);
+        channel_free(ch);
+        return;
+    }
+    if (ch->pending_ret < 0) {
+        channel_fail(ch, ch->pending_ret);
+        return;
+    }
+
+    ch->s = s;
+    s->flags |= BV_MEDIA_CONTEXT_FLAG_NONBLOCK;
+    ch->started    = bv_gettime_relative();
+    ch->wait_key   = 1;
+    ch->video_mask = 0;
+    for (i = 0; i < BBMIN(s->nb_streams, 64); i++) {
+        if (s->streams[i]->codec->codec_type == BV_MEDIA_TYPE_VIDEO)
+            ch->video_mask |= 1ULL << i;
+    }
+    if ((ret = channel_update(ch, 1)) < 0) {
+        channel_fail(ch, ret);
+        return;
+    }
+    channel_set_state(ch, BV_INGEST_STATE_RUNNING);
+}
+
+static void channel_start(BVEventLoop *loop, void *opaque)
+{
+    channel_connect(opaque);
+}
+
+static void channel_remove(BVEventLoop *loop, void *opaque)
+{
+    IngestChannel *ch = opaque;
+
+    ch->removed = 1;
+    /* the opener hands the channel back to channel_opened() */
+    if (ch->opening)
+        return;
+    channel_close_session(ch);
+    channel_free(ch);
+}
+
+static void *opener_run(void *arg)
+{
+    BVIngest *ingest = arg;
+    IngestChannel *ch;
+    int closing;
+
+    while (bv_thread_message_queue_recv(ingest->jobs, &ch, 0) >= 0) {
+        pthread_mutex_lock(&ingest->lock);
+        closing = ingest->closing;
+        pthread_mutex_unlock(&ingest->lock);
+
+        ch->pending = NULL;
+        if (closing)
+            ch->pending_ret = BVERROR_EXIT;
+        else
+            ch->pending_ret = bv_input_media_open(&ch->pending, NULL, ch->url, ch->media, &ch->options);
+        while (bv_event_loop_call(ch->loop->loop, channel_opened, ch) < 0)
+            bv_usleep(10000);
+    }
+    return NULL;
+}
+
+static void *loop_run(void *arg)
+{
+    IngestLoop *il = arg;
+
+    bv_event_loop_run(il->loop);
+    return NULL;
+}
+
+static void loop_shutdown(BVEventLoop *loop, void *opaque)
+{
+    BVIngest *ingest = opaque;
+    IngestChannel *ch;
+    int i, n;
+
+    for (i = 0; ; i++) {
+        pthread_mutex_lock(&ingest->lock);
+        n  = ingest->nb_channels;
+        ch = i < n ? ingest->channels[i] : NULL;
+        if (ch && ch->loop->loop == loop)
+            ingest->channels[i] = NULL;
+        else
+            ch = NULL;
+        pthread_mutex_unlock(&ingest->lock);
+        if (i >= n)
+            break;
+        if (ch)
+            channel_remove(loop, ch);
+    }
+    bv_event_loop_stop(loop);
+}
+
+int bv_ingest_alloc(BVIngest **pingest, int nb_threads, int nb_openers)
+{
+    BVIngest *ingest;
+    int i, ret;
+
+    if (nb_threads <= 0 || nb_openers <= 0)
+        return BVERROR(EINVAL);
+    if (!(ingest = bv_mallocz(sizeof(*ingest))))
+        return BVERROR(ENOMEM);
+    pthread_mutex_init(&ingest->lock, NULL);
+    ingest->loops   = bv_mallocz_array(nb_threads, sizeof(*ingest->loops));
+    ingest->openers = bv_mallocz_array(nb_openers, sizeof(*ingest->openers));
+    if (!ingest->loops || !ingest->openers) {
+        ret = BVERROR(ENOMEM);
+        goto fail;
+    }
+    if ((ret = bv_thread_message_queue_alloc(&ingest->jobs, INGEST_MAX_JOBS, sizeof(IngestChannel *))) < 0)
+        goto fail;
+
+    for (i = 0; i < nb_threads; i++) {
+        IngestLoop *il = &ingest->loops[i];
+        ingest->nb_loops++;
+        bv_lfg_init(&il->lfg, bv_get_random_seed());
+        if ((ret = bv_event_loop_alloc(&il->loop)) < 0)
+            goto fail;
+        if ((ret = pthread_create(&il->thread, NULL, loop_run, il))) {
+            ret = BVERROR(ret);
+            goto fail;
+        }
+        il->started = 1;
+    }
+    for (i = 0; i < nb_openers; i++) {
+        if ((ret = pthread_create(&ingest->openers[i], NULL, opener_run, ingest))) {
+            ret = BVERROR(ret);
+            goto fail;
+        }
+        ingest->nb_openers++;
+    }
+    *pingest = ingest;
+    return 0;
+fail:
+    bv_ingest_free(&ingest);
+    return ret;
+}
+
+void bv_ingest_set_callback(BVIngest *ingest, BVIngestStateCallback cb, void *opaque)
+{
+    ingest->cb     = cb;
+    ingest->opaque = opaque;
+}
+
+int bv_ingest_add(BVIngest *ingest, const char *url, BVInputMedia *media,
+                  BVDictionary **options, int queue_size)
+{
+    IngestChannel *ch, **channels;
+    IngestLoop *il;
+    int i, j, ret;
+
+    if (!url || queue_size <= 0)
+        return BVERROR(EINVAL);
+    if (!(ch = bv_mallocz(sizeof(*ch))))
+        return BVERROR(ENOMEM);
+    ch->ingest = ingest;
+    ch->media  = media;
+    ch->refs   = 1;
+    ch->url    = bv_strdup(url);
+    if (options)
+        bv_dict_copy(&ch->options, *options, 0);
+    if (!ch->url) {
+        ret = BVERROR(ENOMEM);
+        goto fail;
+    }
+    if ((ret = bv_thread_message_queue_alloc(&ch->queue, queue_size, sizeof(BVPacket))) < 0)
+        goto fail;
+
+    pthread_mutex_lock(&ingest->lock);
+    for (i = 0; i < ingest->nb_channels && ingest->channels[i]; i++);
+    if (i == ingest->nb_channels) {
+        channels = bv_realloc_array(ingest->channels, i + 1, sizeof(*channels));
+        if (!channels) {
+            pthread_mutex_unlock(&ingest->lock);
+            ret = BVERROR(ENOMEM);
+            goto fail;
+        }
+        ingest->channels = channels;
+        ingest->nb_channels++;
+    }
+    il = &ingest->loops[0];
+    for (j = 1; j < ingest->nb_loops; j++) {
+        if (ingest->loops[j].nb_channels < il->nb_channels)
+            il = &ingest->loops[j];
+    }
+    ch->id   = i;
+    ch->loop = il;
+    il->nb_channels++;
+    ingest->channels[i] = ch;
+    pthread_mutex_unlock(&ingest->lock);
+
+    if ((ret = bv_event_loop_call(il->loop, channel_start, ch)) < 0) {
+        pthread_mutex_lock(&ingest->lock);
+        ingest->channels[i] = NULL;
+        pthread_mutex_unlock(&ingest->lock);
+        channel_free(ch);
+        return ret;
+    }
+    return i;
+fail:
+    bv_thread_message_queue_free(&ch->queue);
+    bv_free(ch->url);
+    bv_dict_free(&ch->options);
+    bv_free(ch);
+    return ret;
+}
+
+int bv_ingest_remove(BVIngest *ingest, int channel)
+{
+    IngestChannel *ch = NULL;
+    int ret;
+
+    pthread_mutex_lock(&ingest->lock);
+    if (channel >= 0 && channel < ingest->nb_channels) {
+        ch = ingest->channels[channel];
+        ingest->channels[channel] = NULL;
+    }
+    /* the loop may free the channel as soon as it is told */
+    if (ch)
+        bvpriv_atomic_int_add_and_fetch(&ch->refs, 1);
+    pthread_mutex_unlock(&ingest->lock);
+    if (!ch)
+        return BVERROR(EINVAL);
+    if ((ret = bv_event_loop_call(ch->loop->loop, channel_remove, ch)) < 0) {
+        pthread_mutex_lock(&ingest->lock);
+        ingest->channels[channel] = ch;
+        pthread_mutex_unlock(&ingest->lock);
+    } else {
+        /* waiting readers need not wait for the loop to get to it */
+        bv_thread_message_queue_set_err_recv(ch->queue, BVERROR_EOF);
+    }
+    channel_unref(ch);
+    return ret;
+}
+
+int bv_ingest_read(BVIngest *ingest, int channel, BVPacket *pkt, int flags)
+{
+    IngestChannel *ch = NULL;
+    int ret;
+
+    pthread_mutex_lock(&ingest->lock);
+    if (channel >= 0 && channel < ingest->nb_channels)
+        ch = ingest->channels[channel];
+    /* under the lock, so that the channel cannot be freed meanwhile */
+    if (ch)
+        bvpriv_atomic_int_add_and_fetch(&ch->refs, 1);
+    pthread_mutex_unlock(&ingest->lock);
+    if (!ch)
+        return BVERROR(EINVAL);
+    ret = bv_thread_message_queue_recv(ch->queue, pkt,
+                                       flags & BV_INGEST_FLAG_NONBLOCK ? BV_THREAD_MESSAGE_NONBLOCK : 0);
+    channel_unref(ch);
+    return ret;
+}
+
+void bv_ingest_free(BVIngest **pingest)
+{
+    BVIngest *ingest = *pingest;
+    int i;
+
+    if (!ingest)
+        return;
+    pthread_mutex_lock(&ingest->lock);
+    ingest->closing = 1;
+    pthread_mutex_unlock(&ingest->lock);
+
+    /* openers skip what is still queued, their answers precede the shutdown */
+    if (ingest->jobs) {
+        bv_thread_message_queue_set_err_recv(ingest->jobs, BVERROR_EOF);
+        bv_thread_message_queue_set_err_send(ingest->jobs, BVERROR_EOF);
+    }
+    for (i = 0; i < ingest->nb_openers; i++)
+        pthread_join(ingest->openers[i], NULL);
+    for (i = 0; i < ingest->nb_loops; i++) {
+        IngestLoop *il = &ingest->loops[i];
+        if (il->started) {
+            while (bv_event_loop_call(il->loop, loop_shutdown, ingest) < 0)
+                bv_usleep(10000);
+            pthread_join(il->thread, NULL);
+        }
+        bv_event_loop_free(&il->loop);
+    }
+
+    bv_thread_message_queue_free(&ingest->jobs);
+    bv_free(ingest->channels);
+    bv_free(ingest->loops);
+    bv_free(ingest->openers);
+    pthread_mutex_destroy(&ingest->lock);
+    bv_freep(pingest);
+}
+
+#else
+
+int bv_ingest_alloc(BVIngest **pingest, int nb_threads, int nb_openers)
+{
+    return BVERROR(ENOSYS);
+}
+
+void bv_ingest_set_callback(BVIngest *ingest, BVIngestStateCallback cb, void *opaque)
+{
+}
+
+int bv_ingest_add(BVIngest *ingest, const char *url, BVInputMedia *media,
+                  BVDictionary **options, int queue_size)
+{
+    return BVERROR(ENOSYS);
+}
+
+int bv_ingest_remove(BVIngest *ingest, int channel)
+{
+    return BVERROR(ENOSYS);
+}
+
+int bv_ingest_read(BVIngest *ingest, int channel, BVPacket *pkt, int flags)
+{
+    return BVERROR(ENOSYS);
+}
+
+void bv_ingest_free(BVIngest **pingest)
+{
+}
+
+#endif /* BV_HAVE_PTHREADS */
+
+#ifdef TEST
+
+#include <stdio.h>
+
+#undef printf
+
+#if BV_HAVE_PTHREADS
+
+#define TEST_PACKETS    5
+
+/*
+ * A stand-in source: "test://N" hands out TEST_PACKETS video packets per
+ * session, a key frame first, with pts 1000 * session + n, then breaks.
+ * With "?fail", the first opening is refused.
+ */
+static volatile int test_opens[8];
+static volatile int test_states[8][3];
+
+typedef struct TestSource {
+    int session;
+    int n;
+} TestSource;
+
+static int test_read_header(BVMediaContext *s)
+{
+    TestSource *t = s->priv_data;
+    BVStream *st;
+    int id = strtol(s->filename + 7, NULL, 10);
+
+    t->session = bvpriv_atomic_int_add_and_fetch(&test_opens[id], 1);
+    if (strstr(s->filename, "?fail") && t->session == 1)
+        return BVERROR(ECONNREFUSED);
+    if (!(st = bv_stream_new(s, NULL)))
+        return BVERROR(ENOMEM);
+    st->codec->codec_type = BV_MEDIA_TYPE_VIDEO;
+    st->codec->codec_id   = BV_CODEC_ID_H264;
+    return 0;
+}
+
+static int test_read_packet(BVMediaContext *s, BVPacket *pkt)
+{
+    TestSource *t = s->priv_data;
+    int ret;
+
+    if (t->n == TEST_PACKETS)
+        return BVERROR_EOF;
+    if ((ret = bv_packet_new(pkt, 16)) < 0)
+        return ret;
+    pkt->pts = 1000 * t->session + t->n;
+    if (!t->n++)
+        pkt->flags |= BV_PKT_FLAG_KEY;
+    return pkt->size;
+}
+
+static int test_control(BVMediaContext *s, enum BVMediaMessageType type,
+                        const BVControlPacket *pkt_in, BVControlPacket *pkt_out)
+{
+    BVMediaPollInfo *info;
+
+    if (type != BV_MEDIA_MESSAGE_TYPE_POLL_INFO)
+        return BVERROR(ENOSYS);
+    info = pkt_out->data;
+    info->nb_fds  = 0;
+    info->timeout = 0;
+    return 0;
+}
+
+static BVInputMedia test_media = {
+    .name           = "test",
+    .priv_data_size = sizeof(TestSource),
+    .flags          = BV_MEDIA_FLAGS_NOFILE,
+    .read_header    = test_read_header,
+    .read_packet    = test_read_packet,
+    .media_control  = test_control,
+};
+
+static void test_state(void *opaque, int channel, enum BVIngestState state,
+                       const BVMediaContext *s)
+{
+    if (channel < BV_ARRAY_ELEMS(test_states))
+        bvpriv_atomic_int_add_and_fetch(&test_states[channel][state], 1);
+}
+
+typedef struct TestReader {
+    BVIngest *ingest;
+    int channel;
+    pthread_t thread;
+    int ret;
+} TestReader;
+
+static void *test_reader(void *arg)
+{
+    TestReader *r = arg;
+    BVPacket pkt;
+
+    for (;;) {
+        bv_packet_init(&pkt);
+        if ((r->ret = bv_ingest_read(r->ingest, r->channel, &pkt, 0)) < 0)
+            break;
+        bv_packet_free(&pkt);
+    }
+    return NULL;
+}
+
+/**
+ * Read n packets of a channel, which must be pts, pts + 1, ... with a
+ * break every TEST_PACKETS.
+ */
+static int test_read(BVIngest *ingest, int channel, int n, int pts)
+{
+    BVPacket pkt;
+    int i, ret;
+
+    for (i = 0; i < n; i++) {
+        bv_packet_init(&pkt);
+        if ((ret = bv_ingest_read(ingest, channel, &pkt, 0)) < 0)
+            return ret;
+        ret = pkt.pts == pts + i / TEST_PACKETS * 1000 + i % TEST_PACKETS &&
+              !(pkt.flags & BV_PKT_FLAG_KEY) == !!(i % TEST_PACKETS);
+        bv_packet_free(&pkt);
+        if (!ret) {
+            printf("channel %d: unexpected packet %d\n", channel, i);
+            return BVERROR_INVALIDDATA;
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    BVIngest *ingest = NULL;
+    TestReader readers[4];
+    BVPacket pkt;
+    int ch0, ch1, ch, i, k, errors = 0;
+
+    if (bv_ingest_alloc(&ingest, 2, 2) < 0)
+        return 1;
+    bv_ingest_set_callback(ingest, test_state, NULL);
+    ch0 = bv_ingest_add(ingest, "test://0", &test_media, NULL, 16);
+    ch1 = bv_ingest_add(ingest, "test://1?fail", &test_media, NULL, 16);
+    if (ch0 != 0 || ch1 != 1) {
+        bv_ingest_free(&ingest);
+        return 1;
+    }
+
+    /* two sessions of channel 0, the second after a reconnect */
+    if (test_read(ingest, ch0, 2 * TEST_PACKETS, 1000) < 0)
+        errors++;
+    /* channel 1 only gets going on the second try */
+    if (test_read(ingest, ch1, TEST_PACKETS, 2000) < 0)
+        errors++;
+    if (test_states[ch1][BV_INGEST_STATE_RUNNING] < 1 ||
+        test_states[ch1][BV_INGEST_STATE_RETRYING] < 1 ||
+        test_states[ch0][BV_INGEST_STATE_RUNNING] < 2) {
+        printf("missing state changes\n");
+        errors++;
+    }
+
+    /* removing wakes up the readers, later reads find no channel */
+    for (i = 0; i < 2; i++) {
+        readers[i] = (TestReader) { ingest, i ? ch1 : ch0 };
+        pthread_create(&readers[i].thread, NULL, test_reader, &readers[i]);
+    }
+    bv_usleep(100000);
+    if (bv_ingest_remove(ingest, ch0) < 0 || bv_ingest_remove(ingest, ch1) < 0)
+        errors++;
+    for (i = 0; i < 2; i++) {
+        pthread_join(readers[i].thread, NULL);
+        if (readers[i].ret != BVERROR_EOF) {
+            printf("reader %d: %s\n", i, bv_err2str(readers[i].ret));
+            errors++;
+        }
+    }
+    if (bv_ingest_read(ingest, ch0, &pkt, BV_INGEST_FLAG_NONBLOCK) != BVERROR(EINVAL) ||
+        bv_ingest_remove(ingest, ch0) != BVERROR(EINVAL))
+        errors++;
+
+    /* removal racing with readers and with the opening of the session */
+    for (k = 0; k < 50; k++) {
+        if ((ch = bv_ingest_add(ingest, "test://2", &test_media, NULL, 4)) < 0) {
+            errors++;
+            break;
+        }
+        for (i = 0; i < BV_ARRAY_ELEMS(readers); i++) {
+            readers[i] = (TestReader) { ingest, ch };
+            pthread_create(&readers[i].thread, NULL, test_reader, &readers[i]);
+        }
+        if (k & 1)
+            bv_usleep(k * 100);
+        if (bv_ingest_remove(ingest, ch) < 0)
+            errors++;
+        for (i = 0; i < BV_ARRAY_ELEMS(readers); i++) {
+            pthread_join(readers[i].thread, NULL);
+            if (readers[i].ret != BVERROR_EOF && readers[i].ret != BVERROR(EINVAL))
+                errors++;
+        }
+    }
+
+    bv_ingest_free(&ingest);
+    printf("%s\n", errors ? "FAIL" : "OK");
+    return !!errors;
+}
+
+#else
+
+int main(void)
+{
+    printf("OK\n");
+    return 0;
+}
+
+#endif /* BV_HAVE_PTHREADS */
+#endif /* TEST */
@@ -0,0 +1,126 @@
+/*************************************************************************
+    > File Name: ingest.h
+    > Author: albertfang
+    > Mail: fang.qi@besovideo.com
+    > Created Time: 2026年10月22日 星期四 09时12分35秒
+ ************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) albert@BesoVideo, 2026
+ */
+
+#ifndef BV_MEDIA_INGEST_H
+#define BV_MEDIA_INGEST_H
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include "bvmedia.h"
+
+/**
+ * @defgroup lbvm_ingest Ingest
+ * Receive many network streams with a few threads.
+ *
+ * Each channel is a BVMediaContext read with BV_MEDIA_CONTEXT_FLAG_NONBLOCK
+ * from one of nb_threads event loops, instead of one blocking thread per
+ * camera. The demuxer must support nonblocking reads and answer
+ * BV_MEDIA_MESSAGE_TYPE_POLL_INFO, as rtsp does. Opening a session is
+ * blocking, it runs on a separate pool of nb_openers threads so that a
+ * camera slow to answer does not stall the others.
+ *
+ * Packets go to a bounded queue per channel. When the reader falls behind,
+ * packets are dropped, video up to the next key frame. A session which
+ * fails to open or breaks is opened again after a backoff growing from
+ * 0.5 s to 30 s.
+ * @{
+ */
+
+enum BVIngestState {
+    BV_INGEST_STATE_CONNECTING,
+    BV_INGEST_STATE_RUNNING,        ///< the BVMediaContext is given to the callback
+    BV_INGEST_STATE_RETRYING,
+};
+
+/**
+ * bv_ingest_read(): return BVERROR(EAGAIN) instead of waiting for a packet.
+ */
+#define BV_INGEST_FLAG_NONBLOCK     0x0001
+
+typedef struct BVIngest BVIngest;
+
+/**
+ * Called on the event loop thread of the channel. In the RUNNING state,
+ * s may be used to look at the streams, only until the callback returns.
+ */
+typedef void (*BVIngestStateCallback)(void *opaque, int channel, enum BVIngestState state,
+                                      const BVMediaContext *s);
+
+/**
+ * @param nb_threads event loop threads
+ * @param nb_openers threads opening sessions
+ */
+int bv_ingest_alloc(BVIngest **ingest, int nb_threads, int nb_openers);
+
+/**
+ * Must be set before the first channel is added.
+ */
+void bv_ingest_set_callback(BVIngest *ingest, BVIngestStateCallback cb, void *opaque);
+
+/**
+ * Start receiving url.
+ *
+ * @param media      demuxer to use, probed from url if NULL
+ * @param options    copied, used on every opening of the session
+ * @param queue_size packets buffered for the reader
+ * @return channel id (>= 0) on success, a negative error code otherwise
+ */
+int bv_ingest_add(BVIngest *ingest, const char *url, BVInputMedia *media,
+                  BVDictionary **options, int queue_size);
+
+/**
+ * Stop receiving a channel. The session is closed on its event loop
+ * thread soon after. May be called while other threads read the channel:
+ * bv_ingest_read() calls waiting on it return BVERROR_EOF, later ones
+ * BVERROR(EINVAL), and the channel is freed once the last of them is out.
+ */
+int bv_ingest_remove(BVIngest *ingest, int channel);
+
+/**
+ * Take the next packet of a channel, waiting for it unless
+ * BV_INGEST_FLAG_NONBLOCK is set. The stream_index refers to the streams
+ * last passed with BV_INGEST_STATE_RUNNING.
+ *
+ * @return 0 on success, BVERROR(EAGAIN) if no packet is there in
+ *         nonblocking mode, BVERROR(EINVAL) if there is no such channel,
+ *         BVERROR_EOF if it was removed meanwhile
+ */
+int bv_ingest_read(BVIngest *ingest, int channel, BVPacket *pkt, int flags);
+
+/**
+ * Close all channels and stop the threads. Readers still waiting return
+ * BVERROR_EOF; no other call may start once this one has.
+ */
+void bv_ingest_free(BVIngest **ingest);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of include guard: BV_MEDIA_INGEST_H */
@@ -25,8 +25,6 @@
  * @file
  * onvif video encode main file
  */
-#include <libavformat/avformat.h>
-
 #include <libbvutil/bvstring.h>
 #include <libbvutil/time.h>
 #include <libbvutil/log.h>
@@ -55,7 +53,9 @@ typedef struct OnvifContext {
     char *media_url;
     int timeout;
     struct soap *soap;
-    AVFormatContext *onvif;
+    BVMediaContext *rtsp;
+    int rtsp_index[8];          ///< our stream index of each rtsp stream, -1 if dropped
+    int nb_rtsp_index;          ///< rtsp streams mapped, later ones are dropped
     BVIOContext *snapshot;
     struct SOAP_ENV__Header soap_header;
 } OnvifContext;
@@ -67,78 +67,62 @@ static int onvif_probe(BVMediaContext *s, BVProbeData *p)
     return 0;
 }
 
-static enum BVCodecID avid_to_bvid(enum AVCodecID codec_id)
-{
-    int i = 0;
-    struct {
-        enum AVCodecID avid;
-        enum BVCodecID bvid;
-    }IDS[] = {
-        {AV_CODEC_ID_NONE, BV_CODEC_ID_NONE},
-        {AV_CODEC_ID_H264, BV_CODEC_ID_H264},
-        {AV_CODEC_ID_MPEG4, BV_CODEC_ID_MPEG},
-        {AV_CODEC_ID_JPEG2000, BV_CODEC_ID_JPEG},
-        {AV_CODEC_ID_PCM_ALAW, BV_CODEC_ID_G711A},
-        {AV_CODEC_ID_PCM_MULAW, BV_CODEC_ID_G711U},
-        {AV_CODEC_ID_ADPCM_G726, BV_CODEC_ID_G726},
-        {AV_CODEC_ID_AAC, BV_CODEC_ID_AAC},
-    };
-    for (i = 0; i < BV_ARRAY_ELEMS(IDS); i++) {
-        if (IDS[i].avid == codec_id)
-            return IDS[i].bvid;
-    }
-    return BV_CODEC_ID_NONE;
-}
-
-static void set_video_info(OnvifContext *onvifctx, BVStream *bvst, AVStream *avst)
+static void set_video_info(OnvifContext *onvifctx, BVStream *bvst, BVStream *st)
 {
-    bvst->time_base = (BVRational){avst->time_base.num, avst->time_base.den};
+    bvst->time_base = st->time_base;
     bvst->codec->codec_type = BV_MEDIA_TYPE_VIDEO;
     bvst->codec->width = onvifctx->width;
     bvst->codec->height = onvifctx->height;
     bvst->codec->time_base = (BVRational){1, onvifctx->framerate};
-    bvst->codec->bit_rate = avst->codec->bit_rate;
-    bvst->codec->codec_id = avid_to_bvid(avst->codec->codec_id);
-    bvst->codec->gop_size = avst->codec->gop_size;
-    bvst->codec->profile  = avst->codec->profile;
-    if (avst->codec->extradata_size > 0) {
-        bvst->codec->extradata = bv_memdup(avst->codec->extradata, avst->codec->extradata_size);
+    bvst->codec->codec_id = st->codec->codec_id;
+    if (st->codec->extradata_size > 0) {
+        bvst->codec->extradata = bv_memdup(st->codec->extradata, st->codec->extradata_size);
         if (bvst->codec->extradata) {
-            bvst->codec->extradata_size = avst->codec->extradata_size;
+            bvst->codec->extradata_size = st->codec->extradata_size;
         }
     }
 }
 
-static void set_audio_info(OnvifContext *onvifctx, BVStream *bvst, AVStream *avst)
+static void set_audio_info(OnvifContext *onvifctx, BVStream *bvst, BVStream *st)
 {
     bvst->codec->codec_type = BV_MEDIA_TYPE_AUDIO;
-    bvst->codec->sample_rate = avst->codec->sample_rate;
-    bvst->time_base = (BVRational){avst->time_base.num, avst->time_base.den};
-    bvst->codec->channels = avst->codec->channels;
-    bvst->codec->sample_fmt = (enum BVSampleFormat )avst->codec->sample_fmt;
-    bvst->codec->codec_id = avid_to_bvid(avst->codec->codec_id);
+    bvst->codec->sample_rate = st->codec->sample_rate;
+    bvst->time_base = st->time_base;
+    bvst->codec->channels = st->codec->channels;
+    bvst->codec->sample_fmt = BV_SAMPLE_FMT_S16;
+    bvst->codec->codec_id = st->codec->codec_id;
 }
 
-static int set_avcodec_info(BVMediaContext *s, OnvifContext *onvifctx)
+static int set_codec_info(BVMediaContext *s, OnvifContext *onvifctx)
 {
-    AVFormatContext *onvif = onvifctx->onvif;
+    BVMediaContext *rtsp = onvifctx->rtsp;
     int i;
     BVStream *bvst = NULL;
-    AVStream *avst = NULL;
-    for (i = 0; i < onvif->nb_streams; i++) {
-        avst = onvif->streams[i];
-        if (avst->codec->codec_type == AVMEDIA_TYPE_VIDEO && onvifctx->vtoken) {
+    BVStream *st = NULL;
+    for (i = 0; i < rtsp->nb_streams && i < BV_ARRAY_ELEMS(onvifctx->rtsp_index); i++) {
+        st = rtsp->streams[i];
+        onvifctx->rtsp_index[i] = -1;
+        if (st->codec->codec_type == BV_MEDIA_TYPE_VIDEO && onvifctx->vtoken) {
             bvst = bv_stream_new(s, NULL);
-            set_video_info(onvifctx, bvst, avst);
+            if (!bvst)
+                return BVERROR(ENOMEM);
+            set_video_info(onvifctx, bvst, st);
             onvifctx->vindex = bvst->index;
-        } else if (avst->codec->codec_type == AVMEDIA_TYPE_AUDIO && onvifctx->atoken) {
+        } else if (st->codec->codec_type == BV_MEDIA_TYPE_AUDIO && onvifctx->atoken) {
             bvst = bv_stream_new(s, NULL);
-            set_audio_info(onvifctx, bvst, avst);
+            if (!bvst)
+                return BVERROR(ENOMEM);
+            set_audio_info(onvifctx, bvst, st);
             onvifctx->aindex = bvst->index;
         } else {
-            bv_log(s, BV_LOG_WARNING, "Drop CodecType %d\n", avst->codec->codec_type);
+            bv_log(s, BV_LOG_WARNING, "Drop CodecType %d\n", st->codec->codec_type);
+            continue;
         }
+        onvifctx->rtsp_index[i] = bvst->index;
     }
+    onvifctx->nb_rtsp_index = i;
+    if (rtsp->nb_streams > i)
+        bv_log(s, BV_LOG_WARNING, "Drop %d streams beyond the first %d\n", rtsp->nb_streams - i, i);
     return 0;
 }
 #define ONVIF_TMO (-5000)
@@ -296,6 +280,7 @@ static int onvif_stream_open(BVMediaContext *s)
 {
     int ret = 0;
     OnvifContext *onvifctx = s->priv_data;
+    BVDictionary *opts = NULL;
     ret = onvif_stream_uri(onvifctx);
     if (ret < 0) {
         bv_log(onvifctx, BV_LOG_ERROR, "onvif get stream uri error\n");
@@ -303,26 +288,26 @@ static int onvif_stream_open(BVMediaContext *s)
     }
 
     /**
-     *  RTSP 流的处理协议的解析等等 现在使用FFmpeg中的，已有的功能。
-     *  抓拍流是HTTP的协议也是用FFmpeg中的
-     *  自己开发估计耗时太久。
-     *  FIXME
-     *      依赖 libavformat libavcodec libavutil
-     *  以后可能RTSP协议处理会添加在libbvprotocol中
+     *  RTSP 流使用 libbvmedia 的 rtsp demuxer, SDP 中已有编码参数, 不再探测
+     *  抓拍流是HTTP的协议, 使用 libbvprotocol
      */
-    if(avformat_open_input(&onvifctx->onvif, onvifctx->onvif_url, NULL, NULL) < 0) {
+    if (onvifctx->timeout > 0)
+        bv_dict_set_int(&opts, "timeout", onvifctx->timeout * 1000000LL, 0);
+    if (!onvifctx->vtoken)
+        bv_dict_set(&opts, "media_types", "audio", 0);
+    else if (!onvifctx->atoken)
+        bv_dict_set(&opts, "media_types", "video", 0);
+    ret = bv_input_media_open(&onvifctx->rtsp, NULL, onvifctx->onvif_url, bv_input_media_find("rtsp"), &opts);
+    bv_dict_free(&opts);
+    if (ret < 0) {
         bv_log(onvifctx, BV_LOG_ERROR, "open onvif stream error\n");
-        return BVERROR(EIO);
+        return ret;
     }
-#if 0
-    if (avformat_find_stream_info(onvifctx->onvif, NULL) < 0) {
-        avformat_close_input(&onvifctx->onvif);
-        bv_log(onvifctx, BV_LOG_ERROR, "get onvif stream info error\n");
-        return -1;
+    ret = set_codec_info(s, onvifctx);
+    if (ret < 0) {
+        bv_input_media_close(&onvifctx->rtsp);
+        return ret;
     }
-#endif
-    av_dump_format(onvifctx->onvif, 0, onvifctx->onvif_url, 0);
-    set_avcodec_info(s, onvifctx);
 
     return 0;
 }
@@ -415,46 +400,26 @@ fail:
     return ret;
 }
 
-static int copy_data(BVPacket *pkt, AVPacket *rpkt, int index)
-{
-    if (bv_packet_new(pkt, rpkt->size) < 0) {
-        bv_log(NULL, BV_LOG_ERROR, "NoMem at %s %d\n", __FILE__, __LINE__);
-        return BVERROR(ENOMEM);
-    }
-    memcpy(pkt->data, rpkt->data, rpkt->size);
-    pkt->size = rpkt->size;
-    pkt->pts = rpkt->pts;
-    pkt->dts = rpkt->dts;
-    if (rpkt->flags & AV_PKT_FLAG_KEY)
-        pkt->flags |= BV_PKT_FLAG_KEY;
-    pkt->stream_index = index;
-    return 0;
-}
-
 static int onvif_read_stream(BVMediaContext *s, BVPacket *pkt) 
 {
     OnvifContext *onvifctx = s->priv_data;
-    AVStream *avstream = NULL;
-    AVPacket rpkt;
-    int size = 0;
-    if (onvifctx->onvif == NULL) {
+    int ret;
+    if (onvifctx->rtsp == NULL) {
         return BVERROR(EINVAL);
     }
-    av_init_packet(&rpkt);
-    if(av_read_frame(onvifctx->onvif, &rpkt) < 0) {
-        return BVERROR(EIO);
+    /* the rtsp packets are handed over as they are, no copy */
+    ret = bv_input_media_read(onvifctx->rtsp, pkt);
+    if (ret <= 0) {
+        return ret;
     }
-    size = rpkt.size;
-    avstream = onvifctx->onvif->streams[rpkt.stream_index];
-    if ((avstream->codec->codec_type == AVMEDIA_TYPE_VIDEO) && (onvifctx->vindex != -1)) {
-        copy_data(pkt, &rpkt, onvifctx->vindex);
-    } else if ((avstream->codec->codec_type == AVMEDIA_TYPE_AUDIO) && (onvifctx->aindex != -1)) {
-        copy_data(pkt, &rpkt, onvifctx->aindex);
-    } else {
-        size = BVERROR(EAGAIN);
+    /* rtsp may add streams after the open, they are not mapped */
+    if (pkt->stream_index < 0 || pkt->stream_index >= onvifctx->nb_rtsp_index ||
+        onvifctx->rtsp_index[pkt->stream_index] < 0) {
+        bv_packet_free(pkt);
+        return BVERROR(EAGAIN);
     }
-    av_free_packet(&rpkt);
-    return size;
+    pkt->stream_index = onvifctx->rtsp_index[pkt->stream_index];
+    return ret;
 }
 
 static int onvif_read_snapshot(BVMediaContext *s, BVPacket *pkt)
@@ -500,8 +465,8 @@ static int onvif_read_packet(BVMediaContext *s, BVPacket *pkt)
 static bv_cold int onvif_read_close(BVMediaContext * s)
 {
     OnvifContext *onvifctx = s->priv_data;
-    if (onvifctx->vcodec_id != BV_CODEC_ID_JPEG) {
-        avformat_close_input(&onvifctx->onvif);
+    if (onvifctx->rtsp) {
+        bv_input_media_close(&onvifctx->rtsp);
     }
     bv_soap_free(onvifctx->soap);
     return 0;
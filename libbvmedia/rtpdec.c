@@ -0,0 +1,523 @@
+/*************************************************************************
+    > File Name: rtpdec.c
+    > Author: albertfang
+    > Mail: fang.qi@besovideo.com
+    > Created Time: 2026年10月20日 星期二 09时41分26秒
+ ************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) albert@BesoVideo, 2026
+ */
+
+#line 25 "rtpdec.c"
+
+#include <libbvutil/base64.h>
+#include <libbvutil/intreadwrite.h>
+#include <libbvutil/log.h>
+#include <libbvutil/mem.h>
+#include <libbvutil/time.h>
+
+#include "rtpdec.h"
+
+#define MAX_DROPOUT     3000
+#define MAX_MISORDER    100
+#define MAX_FRAME_SIZE  (16 << 20)
+
+static const uint8_t start_code[4] = { 0, 0, 0, 1 };
+
+int bv_rtp_demux_open(RTPDemuxContext **pd, enum BVCodecID codec_id, int payload_type,
+                      int clock_rate, int stream_index, int flags)
+{
+    RTPDemuxContext *d = bv_mallocz(sizeof(*d));
+
+    if (!d)
+        return BVERROR(ENOMEM);
+    d->codec_id     = codec_id;
+    d->payload_type = payload_type;
+    d->clock_rate   = clock_rate > 0 ? clock_rate : 90000;
+    d->stream_index = stream_index;
+    d->flags        = flags;
+    /* nothing decodes before the first IDR */
+    d->wait_key     = codec_id == BV_CODEC_ID_H264 && (flags & RTP_DEMUX_FLAG_DROP_CORRUPT);
+    /* grown on demand, a frame that does not fit is copied once */
+    d->pool_size    = codec_id == BV_CODEC_ID_H264 ? 128 << 10 : 4096;
+    d->pool = bv_buffer_pool_init(d->pool_size, NULL);
+    if (!d->pool) {
+        bv_free(d);
+        return BVERROR(ENOMEM);
+    }
+    *pd = d;
+    return 0;
+}
+
+void bv_rtp_demux_set_start(RTPDemuxContext *d, uint32_t rtptime)
+{
+    d->has_start = 1;
+    d->ts_init   = 1;
+    d->last_ts   = rtptime;
+    d->ts_acc    = 0;
+}
+
+static int64_t unwrap_timestamp(RTPDemuxContext *d, uint32_t ts)
+{
+    if (!d->ts_init) {
+        d->ts_init = 1;
+        d->last_ts = ts;
+    }
+    d->ts_acc += (int32_t)(ts - d->last_ts);
+    d->last_ts = ts;
+    return d->ts_acc;
+}
+
+/**
+ * Track the sequence number.
+ *
+ * @return number of packets lost before this one, or -1 if the packet is
+ *         a duplicate or arrived too late to be used
+ */
+static int update_seq(RTPDemuxContext *d, uint16_t seq)
+{
+    uint16_t udelta = seq - d->max_seq;
+
+    if (!d->seq_init) {
+        d->seq_init = 1;
+        d->base_seq = seq;
+        d->max_seq  = seq;
+        d->received = 1;
+        return 0;
+    }
+    if (!udelta)
+        return -1;
+    d->received++;
+    if (udelta < MAX_DROPOUT) {
+        if (seq < d->max_seq)
+            d->cycles += 1 << 16;
+        d->max_seq = seq;
+        return udelta - 1;
+    }
+    if (udelta <= (1 << 16) - MAX_MISORDER) {
+        /* the sender restarted, start over */
+        d->base_seq       = seq;
+        d->max_seq        = seq;
+        d->cycles         = 0;
+        d->received       = 1;
+        d->expected_prior = 0;
+        d->received_prior = 0;
+        return 1;
+    }
+    return -1;
+}
+
+static void update_jitter(RTPDemuxContext *d, uint32_t ts)
+{
+    int64_t arrival = bv_gettime_relative() * d->clock_rate / 1000000;
+    int64_t transit = arrival - ts;
+    int64_t delta;
+
+    if (d->transit) {
+        delta = transit - d->transit;
+        if (delta < 0)
+            delta = -delta;
+        d->jitter += delta - ((d->jitter + 8) >> 4);
+    }
+    d->transit = transit;
+}
+
+static int resize_pool(RTPDemuxContext *d, int need)
+{
+    BVBufferPool *pool;
+    int size = d->pool_size;
+
+    while (size < need)
+        size *= 2;
+    pool = bv_buffer_pool_init(size, NULL);
+    if (!pool)
+        return BVERROR(ENOMEM);
+    /* buffers of the old pool go away once their packets are freed */
+    bv_buffer_pool_uninit(&d->pool);
+    d->pool      = pool;
+    d->pool_size = size;
+    return 0;
+}
+
+static int frame_append(RTPDemuxContext *d, const uint8_t *data, int size)
+{
+    int need = d->size + size + BV_INPUT_BUFFER_PADDING_SIZE;
+    BVBufferRef *buf;
+    int ret;
+
+    if (need > MAX_FRAME_SIZE) {
+        d->corrupt = 1;
+        return BVERROR_INVALIDDATA;
+    }
+    if (!d->buf || need > d->buf->size) {
+        if (need > d->pool_size && (ret = resize_pool(d, need)) < 0)
+            return ret;
+        if (!(buf = bv_buffer_pool_get(d->pool)))
+            return BVERROR(ENOMEM);
+        if (d->buf) {
+            memcpy(buf->data, d->buf->data, d->size);
+            bv_buffer_unref(&d->buf);
+        }
+        d->buf = buf;
+    }
+    memcpy(d->buf->data + d->size, data, size);
+    d->size += size;
+    return 0;
+}
+
+/**
+ * @return 1 if the frame is to be dropped rather than handed out
+ */
+static int frame_drop(RTPDemuxContext *d)
+{
+    if (!(d->flags & RTP_DEMUX_FLAG_DROP_CORRUPT) || d->codec_id != BV_CODEC_ID_H264)
+        return 0;
+    if (d->corrupt) {
+        if (!d->wait_key)
+            bv_log(NULL, BV_LOG_DEBUG, "rtp frame damaged, waiting for a key frame\n");
+        d->wait_key = 1;
+        d->need_key = 1;
+        return 1;
+    }
+    if (d->keyframe)
+        d->wait_key = 0;
+    return d->wait_key;
+}
+
+static void frame_finish(RTPDemuxContext *d)
+{
+    BVPacket *pkt;
+
+    if (d->size && frame_drop(d)) {
+        /* the buffer is kept for the next frame */
+    } else if (d->size && d->nb_ready < RTP_MAX_READY) {
+        pkt = &d->ready[d->nb_ready++];
+        bv_packet_init(pkt);
+        memset(d->buf->data + d->size, 0, BV_INPUT_BUFFER_PADDING_SIZE);
+        pkt->buf          = d->buf;
+        pkt->data         = d->buf->data;
+        pkt->size         = d->size;
+        pkt->pts          = d->pts;
+        pkt->dts          = d->pts;
+        pkt->stream_index = d->stream_index;
+        if (d->keyframe)
+            pkt->flags |= BV_PKT_FLAG_KEY;
+        if (d->corrupt)
+            pkt->flags |= BV_PKT_FLAG_CORRUPT;
+        d->buf = NULL;
+    } else if (d->size) {
+        bv_log(NULL, BV_LOG_WARNING, "rtp frames not taken, dropping one\n");
+    }
+    /* an empty frame keeps its buffer for the next one */
+    d->size       = 0;
+    d->in_frame   = 0;
+    d->keyframe   = 0;
+    d->corrupt    = 0;
+    d->fu_started = 0;
+}
+
+static int h264_append_nal(RTPDemuxContext *d, const uint8_t *nal, int size)
+{
+    int ret;
+
+    if (size < 1)
+        return BVERROR_INVALIDDATA;
+    if ((nal[0] & 0x1f) == 5)
+        d->keyframe = 1;
+    if ((ret = frame_append(d, start_code, sizeof(start_code))) < 0)
+        return ret;
+    return frame_append(d, nal, size);
+}
+
+static int h264_depacketize(RTPDemuxContext *d, const uint8_t *buf, int len)
+{
+    int type = buf[0] & 0x1f;
+    int size, ret;
+    uint8_t nal;
+
+    if (type >= 1 && type <= 23)
+        return h264_append_nal(d, buf, len);
+
+    switch (type) {
+    case 24:    /* STAP-A */
+        buf++;
+        len--;
+        while (len > 2) {
+            size = BV_RB16(buf);
+            buf += 2;
+            len -= 2;
+            if (size > len)
+                break;
+            if ((ret = h264_append_nal(d, buf, size)) < 0)
+                return ret;
+            buf += size;
+            len -= size;
+        }
+        if (len) {
+            d->corrupt = 1;
+            return BVERROR_INVALIDDATA;
+        }
+        return 0;
+    case 28:    /* FU-A */
+        if (len < 3)
+            return BVERROR_INVALIDDATA;
+        if (buf[1] & 0x80) {
+            nal = (buf[0] & 0xe0) | (buf[1] & 0x1f);
+            if ((nal & 0x1f) == 5)
+                d->keyframe = 1;
+            if ((ret = frame_append(d, start_code, sizeof(start_code))) < 0 ||
+                (ret = frame_append(d, &nal, 1)) < 0)
+                return ret;
+            d->fu_started = 1;
+        } else if (!d->fu_started) {
+            /* the start of this NAL unit was lost */
+            d->corrupt = 1;
+            return 0;
+        }
+        if ((ret = frame_append(d, buf + 2, len - 2)) < 0)
+            return ret;
+        if (buf[1] & 0x40)
+            d->fu_started = 0;
+        return 0;
+    default:
+        if (!d->unsupported_logged++)
+            bv_log(NULL, BV_LOG_WARNING, "unsupported H.264 RTP packetization %d\n", type);
+        d->corrupt = 1;
+        return BVERROR(ENOSYS);
+    }
+}
+
+int bv_rtp_demux_parse(RTPDemuxContext *d, const uint8_t *buf, int len)
+{
+    int hdr, lost, marker, ret = 0;
+    uint16_t seq;
+    uint32_t ts;
+
+    if (len < 12 || (buf[0] >> 6) != RTP_VERSION)
+        return BVERROR_INVALIDDATA;
+    if ((buf[1] & 0x7f) != d->payload_type)
+        return d->nb_ready;
+    marker = buf[1] & 0x80;
+    seq    = BV_RB16(buf + 2);
+    ts     = BV_RB32(buf + 4);
+    hdr    = 12 + 4 * (buf[0] & 0x0f);
+    if (buf[0] & 0x10) {
+        if (len < hdr + 4)
+            return BVERROR_INVALIDDATA;
+        hdr += 4 + 4 * BV_RB16(buf + hdr + 2);
+    }
+    if (buf[0] & 0x20) {
+        if (buf[len - 1] > len)
+            return BVERROR_INVALIDDATA;
+        len -= buf[len - 1];
+    }
+    if (len <= hdr)
+        return BVERROR_INVALIDDATA;
+    d->ssrc = BV_RB32(buf + 8);
+
+    lost = update_seq(d, seq);
+    if (lost < 0)
+        return d->nb_ready;
+    update_jitter(d, ts);
+
+    if (d->in_frame && ts != d->timestamp) {
+        /* the marker of the previous frame was lost */
+        d->corrupt |= d->codec_id == BV_CODEC_ID_H264;
+        frame_finish(d);
+    }
+    if (!d->in_frame) {
+        d->in_frame  = 1;
+        d->timestamp = ts;
+        d->pts       = unwrap_timestamp(d, ts);
+    }
+    if (lost && d->codec_id == BV_CODEC_ID_H264) {
+        d->corrupt    = 1;
+        d->fu_started = 0;
+    }
+
+    buf += hdr;
+    len -= hdr;
+    if (d->codec_id == BV_CODEC_ID_H264) {
+        ret = h264_depacketize(d, buf, len);
+    } else {
+        /* each packet of a sample based payload is a frame of its own */
+        ret = frame_append(d, buf, len);
+        marker = 1;
+    }
+    if (marker)
+        frame_finish(d);
+    return ret < 0 && ret != BVERROR(ENOSYS) ? ret : d->nb_ready;
+}
+
+int bv_rtp_demux_get(RTPDemuxContext *d, BVPacket *pkt)
+{
+    if (!d->nb_ready)
+        return BVERROR(EAGAIN);
+    *pkt = d->ready[0];
+    memmove(d->ready, d->ready + 1, --d->nb_ready * sizeof(*d->ready));
+    return 0;
+}
+
+int bv_rtp_demux_parse_rtcp(RTPDemuxContext *d, const uint8_t *buf, int len)
+{
+    int size;
+
+    while (len >= 4) {
+        if ((buf[0] >> 6) != RTP_VERSION)
+            return BVERROR_INVALIDDATA;
+        size = (BV_RB16(buf + 2) + 1) * 4;
+        if (size > len)
+            return BVERROR_INVALIDDATA;
+        if (buf[1] == RTCP_SR && size >= 20) {
+            /* middle 32 bits of the NTP timestamp, echoed in LSR */
+            d->last_sr      = BV_RB32(buf + 10);
+            d->last_sr_time = bv_gettime_relative();
+        }
+        buf += size;
+        len -= size;
+    }
+    return 0;
+}
+
+int bv_rtp_demux_rtcp_rr(RTPDemuxContext *d, uint32_t ssrc, uint8_t *buf, int size)
+{
+    static const char cname[] = "bvbase";
+    uint32_t extended_max, expected, expected_interval, received_interval, dlsr = 0;
+    int32_t lost, lost_interval;
+    int fraction = 0, sdes_len;
+
+    /* RR with one report block, SDES with one CNAME chunk */
+    sdes_len = BBALIGN(4 + 2 + sizeof(cname) - 1 + 1, 4);
+    if (size < 32 + 4 + sdes_len)
+        return BVERROR(ENOSPC);
+    if (!d->seq_init)
+        return 0;
+
+    extended_max      = d->cycles + d->max_seq;
+    expected          = extended_max - d->base_seq + 1;
+    lost              = BBMIN(BBMAX((int32_t)(expected - d->received), -0x800000), 0x7fffff);
+    expected_interval = expected - d->expected_prior;
+    received_interval = d->received - d->received_prior;
+    lost_interval     = expected_interval - received_interval;
+    d->expected_prior = expected;
+    d->received_prior = d->received;
+    if (expected_interval && lost_interval > 0)
+        fraction = ((uint32_t)lost_interval << 8) / expected_interval;
+    if (d->last_sr_time)
+        dlsr = (bv_gettime_relative() - d->last_sr_time) * 65536 / 1000000;
+
+    buf[0] = (RTP_VERSION << 6) | 1;
+    buf[1] = RTCP_RR;
+    BV_WB16(buf + 2, 7);
+    BV_WB32(buf + 4, ssrc);
+    BV_WB32(buf + 8, d->ssrc);
+    BV_WB32(buf + 12, ((uint32_t)fraction << 24) | (lost & 0xffffff));
+    BV_WB32(buf + 16, extended_max);
+    BV_WB32(buf + 20, d->jitter >> 4);
+    BV_WB32(buf + 24, d->last_sr);
+    BV_WB32(buf + 28, d->last_sr ? dlsr : 0);
+
+    buf += 32;
+    memset(buf, 0, 4 + sdes_len);
+    buf[0] = (RTP_VERSION << 6) | 1;
+    buf[1] = RTCP_SDES;
+    BV_WB16(buf + 2, sdes_len / 4);
+    BV_WB32(buf + 4, ssrc);
+    buf[8] = 1;
+    buf[9] = sizeof(cname) - 1;
+    memcpy(buf + 10, cname, sizeof(cname) - 1);
+    return 32 + 4 + sdes_len;
+}
+
+static int rtcp_feedback(RTPDemuxContext *d, int type, int fmt, uint32_t ssrc,
+                         int fci_size, uint8_t *buf, int size)
+{
+    if (size < 12 + fci_size)
+        return BVERROR(ENOSPC);
+    buf[0] = (RTP_VERSION << 6) | fmt;
+    buf[1] = type;
+    BV_WB16(buf + 2, 2 + fci_size / 4);
+    BV_WB32(buf + 4, ssrc);
+    BV_WB32(buf + 8, d->ssrc);
+    return 12 + fci_size;
+}
+
+int bv_rtp_demux_rtcp_nack(RTPDemuxContext *d, uint32_t ssrc, uint16_t seq, uint16_t blp,
+                           uint8_t *buf, int size)
+{
+    int ret = rtcp_feedback(d, RTCP_RTPFB, 1, ssrc, 4, buf, size);
+
+    if (ret < 0)
+        return ret;
+    BV_WB16(buf + 12, seq);
+    BV_WB16(buf + 14, blp);
+    return ret;
+}
+
+int bv_rtp_demux_rtcp_pli(RTPDemuxContext *d, uint32_t ssrc, uint8_t *buf, int size)
+{
+    return rtcp_feedback(d, RTCP_PSFB, 1, ssrc, 0, buf, size);
+}
+
+void bv_rtp_demux_close(RTPDemuxContext **pd)
+{
+    RTPDemuxContext *d = *pd;
+
+    if (!d)
+        return;
+    while (d->nb_ready)
+        bv_packet_free(&d->ready[--d->nb_ready]);
+    bv_buffer_unref(&d->buf);
+    bv_buffer_pool_uninit(&d->pool);
+    bv_freep(pd);
+}
+
+int bv_rtp_h264_parse_sprop(const char *value, uint8_t **extradata, int *size)
+{
+    uint8_t *data = NULL, *tmp;
+    char base64[1024];
+    const char *p = value;
+    int len, total = 0;
+    uint8_t nal[768];
+
+    while (*p) {
+        len = strcspn(p, ",");
+        if (len && len < sizeof(base64)) {
+            memcpy(base64, p, len);
+            base64[len] = 0;
+            len = bv_base64_decode(nal, base64, sizeof(nal));
+            if (len > 0) {
+                tmp = bv_realloc(data, total + sizeof(start_code) + len +
+                                 BV_INPUT_BUFFER_PADDING_SIZE);
+                if (!tmp) {
+                    bv_free(data);
+                    return BVERROR(ENOMEM);
+                }
+                data = tmp;
+                memcpy(data + total, start_code, sizeof(start_code));
+                memcpy(data + total + sizeof(start_code), nal, len);
+                total += sizeof(start_code) + len;
+                memset(data + total, 0, BV_INPUT_BUFFER_PADDING_SIZE);
+            }
+        }
+        p += strcspn(p, ",");
+        if (*p)
+            p++;
+    }
+    *extradata = data;
+    *size      = total;
+    return 0;
+}
@@ -0,0 +1,180 @@
+/*************************************************************************
+    > File Name: rtpdec.h
+    > Author: albertfang
+    > Mail: fang.qi@besovideo.com
+    > Created Time: 2026年10月20日 星期二 09时41分26秒
+ ************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) albert@BesoVideo, 2026
+ */
+
+#ifndef BV_MEDIA_RTPDEC_H
+#define BV_MEDIA_RTPDEC_H
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <libbvutil/buffer.h>
+#include <libbvutil/packet.h>
+#include <libbvcodec/bvcodec.h>
+
+#define RTP_VERSION             2
+#define RTP_MAX_PACKET_SIZE     65536
+
+#define RTCP_SR                 200
+#define RTCP_RR                 201
+#define RTCP_SDES               202
+#define RTCP_BYE                203
+#define RTCP_RTPFB              205
+#define RTCP_PSFB               206
+
+#define RTP_MAX_READY           4
+
+/**
+ * Drop H.264 frames damaged by loss, and the frames after them up to the
+ * next IDR, instead of flagging them BV_PKT_FLAG_CORRUPT; need_key is set
+ * so that the caller can ask the sender for a key frame.
+ */
+#define RTP_DEMUX_FLAG_DROP_CORRUPT 0x0001
+
+/**
+ * Depacketizer of one RTP stream.
+ *
+ * H.264 (RFC 6184 single NAL units, STAP-A and FU-A) is reassembled into
+ * access units with Annex B start codes, G.711 payloads are passed as they
+ * come. Frames are assembled in buffers of a pool owned by the context, so
+ * that the packets handed out need no further copy. Timestamps are the RTP
+ * timestamps relative to the start of the stream, in 1/clock_rate units.
+ */
+typedef struct RTPDemuxContext {
+    enum BVCodecID codec_id;
+    int payload_type;
+    int clock_rate;
+    int stream_index;
+    int flags;
+
+    BVBufferPool *pool;
+    int pool_size;
+
+    /* frame being assembled */
+    BVBufferRef *buf;
+    int size;
+    int in_frame;
+    uint32_t timestamp;
+    int64_t pts;
+    int keyframe;
+    int corrupt;
+    int fu_started;
+    int wait_key;               ///< dropping until the next IDR
+    int need_key;               ///< set when a key frame should be requested
+
+    BVPacket ready[RTP_MAX_READY];
+    int nb_ready;
+
+    /* timestamp unwrapping */
+    int ts_init;
+    int has_start;
+    uint32_t last_ts;
+    int64_t ts_acc;
+
+    /* reception statistics, RFC 3550 appendix A */
+    uint32_t ssrc;
+    int seq_init;
+    uint16_t max_seq;
+    uint32_t cycles;
+    uint32_t base_seq;
+    uint32_t received;
+    uint32_t expected_prior;
+    uint32_t received_prior;
+    int64_t transit;
+    uint32_t jitter;
+    uint32_t last_sr;
+    int64_t last_sr_time;
+    int unsupported_logged;
+} RTPDemuxContext;
+
+/**
+ * @param payload_type RTP payload type to accept, other types are ignored
+ * @param clock_rate   RTP clock rate of the payload
+ * @param stream_index set on the packets returned
+ * @param flags        RTP_DEMUX_FLAG_*
+ */
+int bv_rtp_demux_open(RTPDemuxContext **pd, enum BVCodecID codec_id, int payload_type,
+                      int clock_rate, int stream_index, int flags);
+
+/**
+ * Set the RTP timestamp which maps to pts 0, as announced in RTP-Info.
+ * Streams started this way share a time origin.
+ */
+void bv_rtp_demux_set_start(RTPDemuxContext *d, uint32_t rtptime);
+
+/**
+ * Feed one RTP packet.
+ *
+ * @return number of frames ready to be taken with bv_rtp_demux_get(), or
+ *         a negative error code; invalid packets are dropped and reported
+ *         with BVERROR_INVALIDDATA
+ */
+int bv_rtp_demux_parse(RTPDemuxContext *d, const uint8_t *buf, int len);
+
+/**
+ * Take the oldest complete frame.
+ *
+ * @return 0 on success, BVERROR(EAGAIN) if no frame is ready
+ */
+int bv_rtp_demux_get(RTPDemuxContext *d, BVPacket *pkt);
+
+/**
+ * Feed one RTCP compound packet received for the stream.
+ */
+int bv_rtp_demux_parse_rtcp(RTPDemuxContext *d, const uint8_t *buf, int len);
+
+/**
+ * Write an RTCP receiver report with a CNAME for the stream into buf.
+ *
+ * @return size of the report, or a negative error code
+ */
+int bv_rtp_demux_rtcp_rr(RTPDemuxContext *d, uint32_t ssrc, uint8_t *buf, int size);
+
+/**
+ * Write an RTCP generic NACK (RFC 4585 6.2.1) for packet seq and those
+ * flagged in blp.
+ *
+ * @return size of the packet, or a negative error code
+ */
+int bv_rtp_demux_rtcp_nack(RTPDemuxContext *d, uint32_t ssrc, uint16_t seq, uint16_t blp,
+                           uint8_t *buf, int size);
+
+/**
+ * Write an RTCP picture loss indication (RFC 4585 6.3.1).
+ *
+ * @return size of the packet, or a negative error code
+ */
+int bv_rtp_demux_rtcp_pli(RTPDemuxContext *d, uint32_t ssrc, uint8_t *buf, int size);
+
+void bv_rtp_demux_close(RTPDemuxContext **pd);
+
+/**
+ * Decode an H.264 sprop-parameter-sets value into Annex B extradata.
+ */
+int bv_rtp_h264_parse_sprop(const char *value, uint8_t **extradata, int *size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of include guard: BV_MEDIA_RTPDEC_H */
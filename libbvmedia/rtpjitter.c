@@ -0,0 +1,348 @@
+/*************************************************************************
+    > File Name: rtpjitter.c
+    > Author: albertfang
+    > Mail: fang.qi@besovideo.com
+    > Created Time: 2026年10月21日 星期三 10时06分12秒
+ ************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) albert@BesoVideo, 2026
+ */
+
+#line 25 "rtpjitter.c"
+
+#include <libbvutil/common.h>
+#include <libbvutil/error.h>
+#include <libbvutil/intreadwrite.h>
+#include <libbvutil/mem.h>
+
+#include "rtpdec.h"
+#include "rtpjitter.h"
+
+#define SLOT(j, seq)    (&(j)->slots[(seq) & (RTP_JITTER_SIZE - 1)])
+
+int bv_rtp_jitter_alloc(RTPJitterBuffer **pj, int clock_rate, int min_delay, int max_delay)
+{
+    RTPJitterBuffer *j;
+
+    if (clock_rate <= 0 || min_delay < 0 || max_delay < min_delay)
+        return BVERROR(EINVAL);
+    if (!(j = bv_mallocz(sizeof(*j))))
+        return BVERROR(ENOMEM);
+    j->clock_rate = clock_rate;
+    j->min_delay  = min_delay;
+    j->max_delay  = max_delay;
+    j->floor      = min_delay;
+    *pj = j;
+    return 0;
+}
+
+int bv_rtp_jitter_target(RTPJitterBuffer *j)
+{
+    return bv_clip64(3 * j->jitter, j->floor, j->max_delay);
+}
+
+static void jitter_reset(RTPJitterBuffer *j, uint16_t seq)
+{
+    int i;
+
+    for (i = 0; i < RTP_JITTER_SIZE; i++) {
+        if (j->slots[i].used) {
+            j->slots[i].used = 0;
+            j->lost++;
+        }
+    }
+    j->count    = 0;
+    j->next_seq = seq;
+    j->max_seq  = seq - 1;
+    j->bad_seq  = -1;
+    j->has_last = 0;
+}
+
+static void jitter_report_gap(RTPJitterBuffer *j, uint16_t seq, int count)
+{
+    uint16_t blp;
+    int n;
+
+    while (count > 0) {
+        n   = BBMIN(count - 1, 16);
+        blp = (1 << n) - 1;
+        j->nack(j->opaque, seq, blp);
+        seq   += n + 1;
+        count -= n + 1;
+    }
+}
+
+int bv_rtp_jitter_put(RTPJitterBuffer *j, const uint8_t *buf, int len, int64_t now)
+{
+    RTPJitterSlot *slot;
+    uint16_t seq;
+    uint32_t ts, ssrc;
+    int diff, gap;
+    int64_t d;
+
+    if (len < 12 || (buf[0] >> 6) != RTP_VERSION)
+        return BVERROR_INVALIDDATA;
+    seq  = BV_RB16(buf + 2);
+    ts   = BV_RB32(buf + 4);
+    ssrc = BV_RB32(buf + 8);
+
+    if (!j->init || ssrc != j->ssrc) {
+        j->init = 1;
+        j->ssrc = ssrc;
+        jitter_reset(j, seq);
+    }
+    diff = (int16_t)(seq - j->next_seq);
+    if (diff >= RTP_JITTER_SIZE || diff < -RTP_JITTER_SIZE) {
+        /*
+         * A stale packet, or the sender restarted or lost more than a
+         * window: only the latter goes on from here.
+         */
+        if (seq != j->bad_seq) {
+            j->bad_seq = (uint16_t)(seq + 1);
+            j->late++;
+            return 0;
+        }
+        jitter_reset(j, seq);
+        diff = 0;
+    }
+    j->bad_seq = -1;
+    if (diff < 0) {
+        if ((uint16_t)(seq - j->skip_start) < (uint16_t)(j->skip_end - j->skip_start)) {
+            /* given up too early, wait longer from now on */
+            j->late++;
+            j->floor = BBMIN(BBMAX(j->floor * 2, 1000), j->max_delay);
+        } else {
+            j->duplicates++;
+        }
+        return 0;
+    }
+
+    slot = SLOT(j, seq);
+    if (slot->used) {
+        j->duplicates++;
+        return 0;
+    }
+    bv_fast_malloc(&slot->data, &slot->alloc, len);
+    if (!slot->data)
+        return BVERROR(ENOMEM);
+    memcpy(slot->data, buf, len);
+    slot->len     = len;
+    slot->used    = 1;
+    slot->arrival = now;
+    j->count++;
+
+    if ((int16_t)(seq - j->max_seq) <= 0) {
+        j->reordered++;
+        return 0;
+    }
+    gap = (uint16_t)(seq - j->max_seq - 1);
+    if (gap && j->nack)
+        jitter_report_gap(j, j->max_seq + 1, gap);
+    j->max_seq = seq;
+
+    if (j->has_last) {
+        d = (now - j->last_arrival) - (int64_t)(int32_t)(ts - j->last_ts) * 1000000 / j->clock_rate;
+        j->jitter += (BBABS(d) - j->jitter) / 16;
+    }
+    j->has_last     = 1;
+    j->last_arrival = now;
+    j->last_ts      = ts;
+    return 0;
+}
+
+/**
+ * First packet behind the missing next_seq, there is one if count > 0.
+ */
+static RTPJitterSlot *jitter_first_after_gap(RTPJitterBuffer *j, uint16_t *pseq)
+{
+    uint16_t seq;
+
+    for (seq = j->next_seq + 1; seq != (uint16_t)(j->max_seq + 1); seq++) {
+        if (SLOT(j, seq)->used)
+            break;
+    }
+    *pseq = seq;
+    return SLOT(j, seq);
+}
+
+int bv_rtp_jitter_get(RTPJitterBuffer *j, const uint8_t **buf, int *len, int64_t now)
+{
+    RTPJitterSlot *slot;
+    uint16_t seq;
+
+    while (j->count) {
+        slot = SLOT(j, j->next_seq);
+        if (slot->used) {
+            slot->used = 0;
+            j->count--;
+            j->next_seq++;
+            if (j->floor > j->min_delay)
+                j->floor -= (j->floor - j->min_delay + 255) >> 8;
+            *buf = slot->data;
+            *len = slot->len;
+            return 0;
+        }
+        slot = jitter_first_after_gap(j, &seq);
+        if (now < slot->arrival + bv_rtp_jitter_target(j))
+            break;
+        j->lost      += (uint16_t)(seq - j->next_seq);
+        j->skip_start = j->next_seq;
+        j->skip_end   = seq;
+        j->next_seq   = seq;
+    }
+    return BVERROR(EAGAIN);
+}
+
+int64_t bv_rtp_jitter_deadline(RTPJitterBuffer *j)
+{
+    uint16_t seq;
+
+    if (!j->count)
+        return INT64_MAX;
+    if (SLOT(j, j->next_seq)->used)
+        return 0;
+    return jitter_first_after_gap(j, &seq)->arrival + bv_rtp_jitter_target(j);
+}
+
+void bv_rtp_jitter_free(RTPJitterBuffer **pj)
+{
+    RTPJitterBuffer *j = *pj;
+    int i;
+
+    if (!j)
+        return;
+    for (i = 0; i < RTP_JITTER_SIZE; i++)
+        bv_free(j->slots[i].data);
+    bv_freep(pj);
+}
+
+#ifdef TEST
+
+#include <stdio.h>
+
+#undef printf
+
+static int nb_nacks;
+static uint16_t last_nack;
+
+static void test_nack(void *opaque, uint16_t seq, uint16_t blp)
+{
+    nb_nacks++;
+    last_nack = seq;
+}
+
+static int test_put(RTPJitterBuffer *j, uint32_t ssrc, uint16_t seq, int64_t now)
+{
+    uint8_t buf[13] = { RTP_VERSION << 6, 96 };
+
+    BV_WB16(buf + 2, seq);
+    BV_WB32(buf + 4, 0);
+    BV_WB32(buf + 8, ssrc);
+    buf[12] = seq;
+    return bv_rtp_jitter_put(j, buf, sizeof(buf), now);
+}
+
+/**
+ * @return the sequence number of the packet handed out, -1 if none
+ */
+static int test_get(RTPJitterBuffer *j, int64_t now)
+{
+    const uint8_t *buf;
+    int len;
+
+    if (bv_rtp_jitter_get(j, &buf, &len, now) < 0)
+        return -1;
+    return len == 13 && buf[12] == (BV_RB16(buf + 2) & 0xff) ? BV_RB16(buf + 2) : -2;
+}
+
+#define CHECK(x) do { if (!(x)) { printf("line %d: %s\n", __LINE__, #x); goto fail; } } while (0)
+
+int main(void)
+{
+    RTPJitterBuffer *j = NULL;
+    int64_t now = 1000000;
+    int seq, target;
+
+    if (bv_rtp_jitter_alloc(&j, 90000, 10000, 500000) < 0)
+        return 1;
+    j->nack = test_nack;
+
+    /* in order: out at once */
+    for (seq = 0; seq < 10; seq++) {
+        CHECK(!test_put(j, 1, seq, now));
+        CHECK(test_get(j, now) == seq);
+    }
+    CHECK(test_get(j, now) == -1 && bv_rtp_jitter_deadline(j) == INT64_MAX);
+
+    /* swapped: out once the first turns up */
+    CHECK(!test_put(j, 1, 11, now));
+    CHECK(test_get(j, now) == -1);
+    CHECK(!test_put(j, 1, 10, now));
+    CHECK(test_get(j, now) == 10 && test_get(j, now) == 11);
+    CHECK(j->reordered == 1 && nb_nacks == 1 && last_nack == 10);
+
+    /* a loss: 13 waits for 12 up to the target delay */
+    CHECK(!test_put(j, 1, 13, now));
+    CHECK(nb_nacks == 2 && last_nack == 12);
+    target = bv_rtp_jitter_target(j);
+    CHECK(bv_rtp_jitter_deadline(j) == now + target);
+    CHECK(test_get(j, now + target - 1) == -1);
+    now += target;
+    CHECK(test_get(j, now) == 13 && j->lost == 1);
+
+    /* 12 after all: late, the target goes up */
+    CHECK(!test_put(j, 1, 12, now));
+    CHECK(test_get(j, now) == -1);
+    CHECK(j->late == 1 && bv_rtp_jitter_target(j) > target);
+
+    /* a duplicate */
+    CHECK(!test_put(j, 1, 13, now));
+    CHECK(j->duplicates == 1);
+
+    /* stale packets alone do not flush the window: 15 is kept */
+    CHECK(!test_put(j, 1, 15, now));
+    CHECK(!test_put(j, 1, 15 - 2 * RTP_JITTER_SIZE, now));
+    CHECK(!test_put(j, 1, 15 + 3 * RTP_JITTER_SIZE, now));
+    CHECK(!test_put(j, 1, 14, now));
+    CHECK(test_get(j, now) == 14 && test_get(j, now) == 15);
+    CHECK(j->late == 3 && j->lost == 1);
+
+    /* a lasting jump: the second packet in sequence starts over */
+    CHECK(!test_put(j, 1, 30000, now));
+    CHECK(test_get(j, now) == -1);
+    CHECK(!test_put(j, 1, 30001, now));
+    CHECK(test_get(j, now) == 30001 && test_get(j, now) == -1);
+    CHECK(!test_put(j, 1, 30002, now));
+    CHECK(test_get(j, now) == 30002);
+
+    /* a new source starts over at once, across the sequence wrap too */
+    CHECK(!test_put(j, 2, 5, now));
+    CHECK(test_get(j, now) == 5);
+    for (seq = 65534; seq != 2; seq = (seq + 1) & 0xffff) {
+        CHECK(!test_put(j, 3, seq, now));
+        CHECK(test_get(j, now) == seq);
+    }
+
+    bv_rtp_jitter_free(&j);
+    printf("OK\n");
+    return 0;
+fail:
+    bv_rtp_jitter_free(&j);
+    printf("FAIL\n");
+    return 1;
+}
+
+#endif /* TEST */
@@ -0,0 +1,133 @@
+/*************************************************************************
+    > File Name: rtpjitter.h
+    > Author: albertfang
+    > Mail: fang.qi@besovideo.com
+    > Created Time: 2026年10月21日 星期三 10时05分47秒
+ ************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) albert@BesoVideo, 2026
+ */
+
+#ifndef BV_MEDIA_RTPJITTER_H
+#define BV_MEDIA_RTPJITTER_H
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <stdint.h>
+
+#define RTP_JITTER_SIZE         1024    ///< slots, power of two
+
+typedef struct RTPJitterSlot {
+    uint8_t *data;
+    unsigned int alloc;
+    int len;
+    int used;
+    int64_t arrival;
+} RTPJitterSlot;
+
+/**
+ * Reorder stage for RTP received over udp, placed in front of the
+ * depacketizer.
+ *
+ * Packets are handed out in sequence order as soon as they are in order,
+ * so a clean stream is not delayed at all. When a packet is missing the
+ * buffer waits for it at most the target delay, measured from the arrival
+ * of the first packet behind the gap, then gives it up as lost. The target
+ * follows the interarrival jitter (RFC 3550 6.4.1) between min_delay and
+ * max_delay, and is raised when packets turn up after they were given up.
+ *
+ * A packet more than a window away from the expected one is dropped as
+ * stale. The buffer starts over only when the packet after it follows, i.e.
+ * the sender really jumped, or at once when the SSRC changes.
+ *
+ * Slot buffers are kept from one packet to the next, so a running stream
+ * does not allocate.
+ */
+typedef struct RTPJitterBuffer {
+    int clock_rate;
+    int min_delay;              ///< microseconds
+    int max_delay;              ///< microseconds
+
+    /**
+     * Called when a gap shows up, with the first missing sequence number
+     * and a bitmask of the 16 following ones also missing, as in an RTCP
+     * generic NACK. May be NULL.
+     */
+    void (*nack)(void *opaque, uint16_t seq, uint16_t blp);
+    void *opaque;
+
+    RTPJitterSlot slots[RTP_JITTER_SIZE];
+    int count;
+    int init;
+    uint32_t ssrc;
+    int bad_seq;                ///< resync on this one, -1 if none (RFC 3550 A.1)
+    uint16_t next_seq;          ///< next to hand out
+    uint16_t max_seq;           ///< highest received
+    uint16_t skip_start;        ///< last range given up as lost
+    uint16_t skip_end;
+
+    int has_last;
+    int64_t last_arrival;
+    uint32_t last_ts;
+    int64_t jitter;             ///< microseconds
+    int floor;                  ///< lower bound of the target, raised by late packets
+
+    uint32_t lost;
+    uint32_t late;
+    uint32_t duplicates;
+    uint32_t reordered;
+} RTPJitterBuffer;
+
+int bv_rtp_jitter_alloc(RTPJitterBuffer **pj, int clock_rate, int min_delay, int max_delay);
+
+/**
+ * Store one RTP packet.
+ *
+ * @param now arrival time, bv_gettime_relative() clock
+ * @return 0 on success (late, stale and duplicate packets are dropped silently),
+ *         a negative error code otherwise
+ */
+int bv_rtp_jitter_put(RTPJitterBuffer *j, const uint8_t *buf, int len, int64_t now);
+
+/**
+ * Take the next packet in sequence order, if it is there or if waiting
+ * for the missing ones is over.
+ *
+ * @param buf set to the packet, valid until the next call on j
+ * @return 0 on success, BVERROR(EAGAIN) if nothing can be handed out yet
+ */
+int bv_rtp_jitter_get(RTPJitterBuffer *j, const uint8_t **buf, int *len, int64_t now);
+
+/**
+ * @return time at which bv_rtp_jitter_get() can hand out the next packet,
+ *         INT64_MAX if the buffer is empty
+ */
+int64_t bv_rtp_jitter_deadline(RTPJitterBuffer *j);
+
+/**
+ * @return current target delay in microseconds
+ */
+int bv_rtp_jitter_target(RTPJitterBuffer *j);
+
+void bv_rtp_jitter_free(RTPJitterBuffer **pj);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of include guard: BV_MEDIA_RTPJITTER_H */
@@ -0,0 +1,1324 @@
+/*************************************************************************
+    > File Name: rtsp.c
+    > Author: albertfang
+    > Mail: fang.qi@besovideo.com
+    > Created Time: 2026年10月20日 星期二 14时12分08秒
+ ************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) albert@BesoVideo, 2026
+ */
+
+#line 25 "rtsp.c"
+
+/**
+ * @file
+ * RTSP client: DESCRIBE / SETUP / PLAY over the tcp protocol, RTP either
+ * interleaved in the RTSP connection or on a pair of udp sockets per track.
+ *
+ * The stream parameters come from the SDP, nothing is probed; only H.264
+ * and G.711 tracks are set up, others are skipped. Frames are reassembled by
+ * rtpdec into pooled buffers and handed out without another copy.
+ *
+ * Over udp the packets go through a jitter buffer first, which puts them
+ * back in order and asks for lost ones with RTCP NACKs. H.264 frames still
+ * damaged by loss are dropped up to the next IDR, which is requested with
+ * a PLI.
+ *
+ * With BV_MEDIA_CONTEXT_FLAG_NONBLOCK set, read_packet returns EAGAIN
+ * instead of waiting, and BV_MEDIA_MESSAGE_TYPE_POLL_INFO tells what to
+ * wait on, so that one thread can serve many sessions.
+ */
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <libbvutil/bvstring.h>
+#include <libbvutil/intreadwrite.h>
+#include <libbvutil/network.h>
+#include <libbvutil/opt.h>
+#include <libbvutil/random_seed.h>
+#include <libbvutil/time.h>
+#include <libbvprotocol/bvurl.h>
+#include <libbvprotocol/httpauth.h>
+
+#include "bvmedia.h"
+#include "rtpdec.h"
+#include "rtpjitter.h"
+
+#define RTSP_DEFAULT_PORT       554
+#define RTSP_MAX_STREAMS        8
+#define RTSP_BUF_SIZE           (4 + RTP_MAX_PACKET_SIZE)  ///< any interleaved frame fits
+#define RTSP_MAX_LINE           4096
+#define RTSP_MAX_BODY           65536
+#define RTSP_RTCP_INTERVAL      5000000
+#define RTSP_PLI_INTERVAL       500000
+#define RTSP_SESSION_TIMEOUT    60
+
+enum RTSPTransport {
+    RTSP_TRANSPORT_TCP,
+    RTSP_TRANSPORT_UDP,
+};
+
+#define RTSP_MEDIA_VIDEO        0x0001
+#define RTSP_MEDIA_AUDIO        0x0002
+
+typedef struct RTSPStream {
+    enum BVMediaType type;
+    enum BVCodecID codec_id;
+    int payload_type;
+    int clock_rate;
+    int channels;
+    uint8_t *extradata;
+    int extradata_size;
+    char control_url[1024];
+
+    int stream_index;           ///< -1 if the track is not set up
+    int interleaved;            ///< RTP channel, RTCP uses the next one
+    BVURLContext *rtp_hd;
+    BVURLContext *rtcp_hd;
+    int server_rtcp_port;
+    RTPDemuxContext *rtp;
+    RTPJitterBuffer *jb;        ///< udp only
+    int64_t last_pli;
+    BVMediaContext *s;
+} RTSPStream;
+
+typedef struct RTSPReply {
+    int status;
+    int seq;
+    int content_length;
+    int timeout;
+    char content_base[1024];
+    char session_id[256];
+    char transport[512];
+    char rtp_info[1024];
+} RTSPReply;
+
+typedef struct RTSPContext {
+    const BVClass *bv_class;
+    int transport;
+    int media_types;
+    int timeout;
+    char *user_agent;
+    int min_port;
+    int max_port;
+    int buffer_size;
+    int jitter_min_delay;
+    int jitter_max_delay;
+    int drop_corrupt;
+    int rtcp_fb;
+
+    BVURLContext *hd;
+    char url[1024];             ///< request url, without credentials
+    char control_url[1024];     ///< aggregate control url
+    char auth[256];
+    HTTPAuthState auth_state;
+    int seq;
+    char session_id[256];
+    int session_timeout;
+    uint32_t ssrc;
+    int64_t last_request;
+    int64_t last_rtcp;
+    int64_t last_data;
+    struct sockaddr_storage peer;
+    socklen_t peer_len;
+
+    RTSPStream *streams[RTSP_MAX_STREAMS];
+    int nb_streams;
+    int next_stream;
+
+    uint8_t *rbuf;
+    int rpos, rend;
+    int discard;                ///< body bytes of a dropped message still to skip
+    uint8_t *pbuf;              ///< udp datagrams
+} RTSPContext;
+
+static int rtsp_probe(BVMediaContext *s, BVProbeData *p)
+{
+    if (p->filename && bv_strstart(p->filename, "rtsp://", NULL))
+        return BV_PROBE_SCORE_MAX;
+    return 0;
+}
+
+/**
+ * Make sure at least n bytes are buffered contiguously from rpos on.
+ */
+static int rtsp_need(BVMediaContext *s, int n)
+{
+    RTSPContext *ctx = s->priv_data;
+    int ret;
+
+    while (ctx->rend - ctx->rpos < n) {
+        if (RTSP_BUF_SIZE - ctx->rpos < n) {
+            memmove(ctx->rbuf, ctx->rbuf + ctx->rpos, ctx->rend - ctx->rpos);
+            ctx->rend -= ctx->rpos;
+            ctx->rpos  = 0;
+        }
+        ret = bv_url_read(ctx->hd, ctx->rbuf + ctx->rend, RTSP_BUF_SIZE - ctx->rend);
+        if (ret == 0)
+            return BVERROR_EOF;
+        if (ret < 0)
+            return ret;
+        ctx->rend += ret;
+    }
+    return 0;
+}
+
+static int rtsp_skip_body(BVMediaContext *s)
+{
+    RTSPContext *ctx = s->priv_data;
+    int n, ret;
+
+    while (ctx->discard) {
+        if (ctx->rpos == ctx->rend && (ret = rtsp_need(s, 1)) < 0)
+            return ret;
+        n = BBMIN(ctx->discard, ctx->rend - ctx->rpos);
+        ctx->rpos    += n;
+        ctx->discard -= n;
+    }
+    return 0;
+}
+
+static int rtsp_write(BVMediaContext *s, const uint8_t *buf, int size)
+{
+    RTSPContext *ctx = s->priv_data;
+    int flags = ctx->hd->flags, ret;
+
+    /* messages are small, rather wait for a full send buffer than tear one */
+    ctx->hd->flags &= ~BV_IO_FLAG_NONBLOCK;
+    ret = bv_url_write(ctx->hd, buf, size);
+    ctx->hd->flags = flags;
+    return ret;
+}
+
+static int rtsp_read_line(BVMediaContext *s, char *line, int size)
+{
+    RTSPContext *ctx = s->priv_data;
+    uint8_t *p;
+    int len, ret;
+
+    for (;;) {
+        p = memchr(ctx->rbuf + ctx->rpos, '\n', ctx->rend - ctx->rpos);
+        if (p) {
+            len = p - (ctx->rbuf + ctx->rpos);
+            if (len && p[-1] == '\r')
+                len--;
+            len = BBMIN(len, size - 1);
+            memcpy(line, ctx->rbuf + ctx->rpos, len);
+            line[len] = 0;
+            ctx->rpos = p + 1 - ctx->rbuf;
+            return 0;
+        }
+        if (ctx->rend - ctx->rpos >= RTSP_MAX_LINE)
+            return BVERROR_INVALIDDATA;
+        if ((ret = rtsp_need(s, ctx->rend - ctx->rpos + 1)) < 0)
+            return ret;
+    }
+}
+
+/**
+ * Read a reply, or a request of the server which is then answered by
+ * nothing. The body is returned only if body is not NULL, otherwise it is
+ * skipped by rtsp_skip_body().
+ */
+static int rtsp_read_reply(BVMediaContext *s, RTSPReply *reply, char **body)
+{
+    RTSPContext *ctx = s->priv_data;
+    char line[RTSP_MAX_LINE];
+    const char *p;
+    char *value;
+    int ret;
+
+    memset(reply, 0, sizeof(*reply));
+    if ((ret = rtsp_read_line(s, line, sizeof(line))) < 0)
+        return ret;
+    if (bv_strstart(line, "RTSP/", &p)) {
+        p += strcspn(p, " ");
+        reply->status = strtol(p, NULL, 10);
+    }
+    bv_log(s, BV_LOG_DEBUG, "reply: '%s'\n", line);
+
+    for (;;) {
+        if ((ret = rtsp_read_line(s, line, sizeof(line))) < 0)
+            return ret;
+        if (!line[0])
+            break;
+        value = strchr(line, ':');
+        if (!value)
+            continue;
+        *value++ = 0;
+        value += strspn(value, " \t");
+
+        if (!bv_strcasecmp(line, "CSeq")) {
+            reply->seq = strtol(value, NULL, 10);
+        } else if (!bv_strcasecmp(line, "Content-Length")) {
+            reply->content_length = strtol(value, NULL, 10);
+        } else if (!bv_strcasecmp(line, "Content-Base") ||
+                   (!bv_strcasecmp(line, "Content-Location") && !reply->content_base[0])) {
+            bv_strlcpy(reply->content_base, value, sizeof(reply->content_base));
+        } else if (!bv_strcasecmp(line, "Session")) {
+            int len = strcspn(value, ";");
+            if ((p = strstr(value + len, "timeout=")))
+                reply->timeout = strtol(p + 8, NULL, 10);
+            bv_strlcpy(reply->session_id, value, BBMIN(len + 1, sizeof(reply->session_id)));
+        } else if (!bv_strcasecmp(line, "Transport")) {
+            bv_strlcpy(reply->transport, value, sizeof(reply->transport));
+        } else if (!bv_strcasecmp(line, "RTP-Info")) {
+            bv_strlcpy(reply->rtp_info, value, sizeof(reply->rtp_info));
+        } else if (!bv_strcasecmp(line, "WWW-Authenticate")) {
+            bv_http_auth_handle_header(&ctx->auth_state, "WWW-Authenticate", value);
+        }
+    }
+
+    if (reply->content_length < 0 || reply->content_length > RTSP_MAX_BODY)
+        return BVERROR_INVALIDDATA;
+    if (reply->content_length && body) {
+        if ((ret = rtsp_need(s, reply->content_length)) < 0)
+            return ret;
+        if (!(*body = bv_malloc(reply->content_length + 1)))
+            return BVERROR(ENOMEM);
+        memcpy(*body, ctx->rbuf + ctx->rpos, reply->content_length);
+        (*body)[reply->content_length] = 0;
+        ctx->rpos += reply->content_length;
+    } else {
+        ctx->discard = reply->content_length;
+    }
+    return 0;
+}
+
+static int rtsp_send_request(BVMediaContext *s, const char *method, const char *url,
+                             const char *headers)
+{
+    RTSPContext *ctx = s->priv_data;
+    char buf[4096];
+    char *auth;
+
+    snprintf(buf, sizeof(buf), "%s %s RTSP/1.0\r\nCSeq: %d\r\nUser-Agent: %s\r\n",
+             method, url, ++ctx->seq, ctx->user_agent);
+    if (ctx->session_id[0])
+        bv_strlcatf(buf, sizeof(buf), "Session: %s\r\n", ctx->session_id);
+    if (ctx->auth[0] && ctx->auth_state.auth_type != HTTP_AUTH_NONE) {
+        auth = bv_http_auth_create_response(&ctx->auth_state, ctx->auth, url, method);
+        if (auth) {
+            bv_strlcat(buf, auth, sizeof(buf));
+            bv_free(auth);
+        }
+    }
+    if (headers)
+        bv_strlcat(buf, headers, sizeof(buf));
+    bv_strlcat(buf, "\r\n", sizeof(buf));
+
+    bv_log(s, BV_LOG_DEBUG, "request: %s %s\n", method, url);
+    ctx->last_request = bv_gettime_relative();
+    return rtsp_write(s, buf, strlen(buf));
+}
+
+static int rtsp_handle_interleaved(BVMediaContext *s);
+
+static int rtsp_request(BVMediaContext *s, const char *method, const char *url,
+                        const char *headers, RTSPReply *reply, char **body)
+{
+    RTSPContext *ctx = s->priv_data;
+    int i, ret;
+
+    for (i = 0; i < 2; i++) {
+        if ((ret = rtsp_send_request(s, method, url, headers)) < 0)
+            return ret;
+        for (;;) {
+            if ((ret = rtsp_skip_body(s)) < 0 || (ret = rtsp_need(s, 1)) < 0)
+                return ret;
+            if (ctx->rbuf[ctx->rpos] == '$') {
+                if ((ret = rtsp_handle_interleaved(s)) < 0)
+                    return ret;
+                continue;
+            }
+            if ((ret = rtsp_read_reply(s, reply, body)) < 0)
+                return ret;
+            if (reply->status && reply->seq == ctx->seq)
+                break;
+            if (body)
+                bv_freep(body);
+        }
+        /* the challenge came with the reply, answer it once */
+        if (reply->status != 401 || !ctx->auth[0] || i ||
+            ctx->auth_state.auth_type == HTTP_AUTH_NONE)
+            break;
+        if (body)
+            bv_freep(body);
+    }
+
+    if (reply->status == 200)
+        return 0;
+    bv_log(s, BV_LOG_ERROR, "%s %s failed: %d\n", method, url, reply->status);
+    if (body)
+        bv_freep(body);
+    switch (reply->status) {
+    case 401: return BVERROR(EACCES);
+    case 404: return BVERROR(ENOENT);
+    case 461: return BVERROR(EPROTONOSUPPORT);
+    default:  return BVERROR(EIO);
+    }
+}
+
+static void rtsp_resolve_control(char *dst, int size, const char *base, const char *control)
+{
+    int len;
+
+    if (!strcmp(control, "*")) {
+        bv_strlcpy(dst, base, size);
+    } else if (bv_stristart(control, "rtsp://", NULL)) {
+        bv_strlcpy(dst, control, size);
+    } else {
+        bv_strlcpy(dst, base, size);
+        len = strlen(dst);
+        if (len && dst[len - 1] != '/')
+            bv_strlcat(dst, "/", size);
+        bv_strlcat(dst, control, size);
+    }
+}
+
+static void sdp_parse_rtpmap(RTSPStream *st, const char *p)
+{
+    char name[32];
+    int len;
+
+    if (strtol(p, (char **)&p, 10) != st->payload_type)
+        return;
+    p += strspn(p, " ");
+    len = strcspn(p, "/");
+    bv_strlcpy(name, p, BBMIN(len + 1, sizeof(name)));
+    p += len;
+    if (*p == '/')
+        st->clock_rate = strtol(p + 1, (char **)&p, 10);
+    if (*p == '/')
+        st->channels = strtol(p + 1, NULL, 10);
+
+    if (!bv_strcasecmp(name, "H264"))
+        st->codec_id = BV_CODEC_ID_H264;
+    else if (!bv_strcasecmp(name, "PCMU"))
+        st->codec_id = BV_CODEC_ID_G711U;
+    else if (!bv_strcasecmp(name, "PCMA"))
+        st->codec_id = BV_CODEC_ID_G711A;
+    else
+        st->codec_id = BV_CODEC_ID_NONE;
+}
+
+static void sdp_parse_fmtp(RTSPStream *st, const char *p)
+{
+    char value[1024];
+
+    if (strtol(p, (char **)&p, 10) != st->payload_type || st->codec_id != BV_CODEC_ID_H264)
+        return;
+    if (!(p = strstr(p, "sprop-parameter-sets=")))
+        return;
+    p += strlen("sprop-parameter-sets=");
+    bv_strlcpy(value, p, BBMIN(strcspn(p, "; ") + 1, sizeof(value)));
+    bv_freep(&st->extradata);
+    if (bv_rtp_h264_parse_sprop(value, &st->extradata, &st->extradata_size) < 0)
+        st->extradata_size = 0;
+}
+
+static int sdp_parse(BVMediaContext *s, const char *sdp, const char *base)
+{
+    RTSPContext *ctx = s->priv_data;
+    RTSPStream *st = NULL;
+    char line[1024];
+    const char *p = sdp, *v;
+    int len;
+
+    bv_strlcpy(ctx->control_url, base, sizeof(ctx->control_url));
+    while (*p) {
+        len = strcspn(p, "\r\n");
+        bv_strlcpy(line, p, BBMIN(len + 1, sizeof(line)));
+        p += len;
+        p += strspn(p, "\r\n");
+        if (line[0] == 0 || line[1] != '=')
+            continue;
+
+        if (line[0] == 'm') {
+            st = NULL;
+            if (ctx->nb_streams == RTSP_MAX_STREAMS)
+                continue;
+            if (!(st = bv_mallocz(sizeof(*st))))
+                return BVERROR(ENOMEM);
+            ctx->streams[ctx->nb_streams++] = st;
+            st->stream_index = -1;
+            if (bv_strstart(line + 2, "video ", NULL))
+                st->type = BV_MEDIA_TYPE_VIDEO;
+            else if (bv_strstart(line + 2, "audio ", NULL))
+                st->type = BV_MEDIA_TYPE_AUDIO;
+            else
+                st->type = BV_MEDIA_TYPE_UNKNOWN;
+            /* media, port and proto come before the first format */
+            for (v = line + 2, len = 0; len < 3; len++) {
+                v += strcspn(v, " ");
+                v += strspn(v, " ");
+            }
+            st->payload_type = strtol(v, NULL, 10);
+            st->channels     = 1;
+            /* static payload types, RFC 3551 */
+            if (st->payload_type == 0 || st->payload_type == 8) {
+                st->codec_id   = st->payload_type ? BV_CODEC_ID_G711A : BV_CODEC_ID_G711U;
+                st->clock_rate = 8000;
+            }
+            bv_strlcpy(st->control_url, ctx->control_url, sizeof(st->control_url));
+        } else if (bv_strstart(line, "a=control:", &v)) {
+            if (st)
+                rtsp_resolve_control(st->control_url, sizeof(st->control_url), base, v);
+            else
+                rtsp_resolve_control(ctx->control_url, sizeof(ctx->control_url), base, v);
+        } else if (st && bv_strstart(line, "a=rtpmap:", &v)) {
+            sdp_parse_rtpmap(st, v);
+        } else if (st && bv_strstart(line, "a=fmtp:", &v)) {
+            sdp_parse_fmtp(st, v);
+        }
+    }
+    return 0;
+}
+
+static int rtsp_open_udp(BVMediaContext *s, RTSPStream *st, int *port)
+{
+    RTSPContext *ctx = s->priv_data;
+    int min = (ctx->min_port + 1) & ~1;
+    int range = (ctx->max_port - min) / 2;
+    int i, start, p;
+    char buf[256];
+
+    if (range <= 0)
+        return BVERROR(EINVAL);
+    start = bv_get_random_seed() % range;
+    for (i = 0; i < range; i++) {
+        p = min + (start + i) % range * 2;
+        snprintf(buf, sizeof(buf), "udp://?localport=%d&fifo_size=0", p);
+        if (ctx->buffer_size > 0)
+            bv_strlcatf(buf, sizeof(buf), "&buffer_size=%d", ctx->buffer_size);
+        if (bv_url_open(&st->rtp_hd, buf, BV_IO_FLAG_READ | BV_IO_FLAG_NONBLOCK, NULL, NULL) < 0)
+            continue;
+        snprintf(buf, sizeof(buf), "udp://?localport=%d&fifo_size=0", p + 1);
+        if (bv_url_open(&st->rtcp_hd, buf, BV_IO_FLAG_READ | BV_IO_FLAG_NONBLOCK, NULL, NULL) < 0) {
+            bv_url_closep(&st->rtp_hd);
+            continue;
+        }
+        *port = p;
+        return 0;
+    }
+    bv_log(s, BV_LOG_ERROR, "no free udp port pair in %d-%d\n", ctx->min_port, ctx->max_port);
+    return BVERROR(EADDRINUSE);
+}
+
+static int rtsp_setup(BVMediaContext *s, RTSPStream *st, int index)
+{
+    RTSPContext *ctx = s->priv_data;
+    RTSPReply reply;
+    char headers[256];
+    const char *p;
+    int port = 0, ret;
+
+    if (ctx->transport == RTSP_TRANSPORT_TCP) {
+        st->interleaved = 2 * index;
+        snprintf(headers, sizeof(headers),
+                 "Transport: RTP/AVP/TCP;unicast;interleaved=%d-%d\r\n",
+                 st->interleaved, st->interleaved + 1);
+    } else {
+        if ((ret = rtsp_open_udp(s, st, &port)) < 0)
+            return ret;
+        snprintf(headers, sizeof(headers),
+                 "Transport: RTP/AVP;unicast;client_port=%d-%d\r\n", port, port + 1);
+    }
+    if ((ret = rtsp_request(s, "SETUP", st->control_url, headers, &reply, NULL)) < 0)
+        return ret;
+
+    if (!ctx->session_id[0]) {
+        if (!reply.session_id[0]) {
+            bv_log(s, BV_LOG_ERROR, "no session in the SETUP reply\n");
+            return BVERROR_INVALIDDATA;
+        }
+        bv_strlcpy(ctx->session_id, reply.session_id, sizeof(ctx->session_id));
+        ctx->session_timeout = reply.timeout > 0 ? reply.timeout : RTSP_SESSION_TIMEOUT;
+    }
+    if (ctx->transport == RTSP_TRANSPORT_TCP) {
+        if ((p = strstr(reply.transport, "interleaved=")))
+            st->interleaved = strtol(p + 12, NULL, 10);
+    } else {
+        if (!(p = strstr(reply.transport, "server_port="))) {
+            bv_log(s, BV_LOG_ERROR, "no server_port in '%s'\n", reply.transport);
+            return BVERROR_INVALIDDATA;
+        }
+        st->server_rtcp_port = strtol(p + 12, (char **)&p, 10) + 1;
+        if (*p == '-')
+            st->server_rtcp_port = strtol(p + 1, NULL, 10);
+    }
+    return 0;
+}
+
+/**
+ * RTP-Info: url=rtsp://host/track1;seq=12;rtptime=3456,url=...
+ */
+static void rtsp_parse_rtp_info(BVMediaContext *s, const char *info)
+{
+    RTSPContext *ctx = s->priv_data;
+    char entry[512], url[512];
+    const char *p, *q;
+    int i, len, ulen, clen;
+
+    while (*info) {
+        len = strcspn(info, ",");
+        bv_strlcpy(entry, info, BBMIN(len + 1, sizeof(entry)));
+        info += len;
+        info += strspn(info, ", ");
+
+        url[0] = 0;
+        if ((p = strstr(entry, "url=")))
+            bv_strlcpy(url, p + 4, BBMIN(strcspn(p + 4, ";") + 1, sizeof(url)));
+        if (!(q = strstr(entry, "rtptime=")))
+            continue;
+        ulen = strlen(url);
+        for (i = 0; i < ctx->nb_streams; i++) {
+            RTSPStream *st = ctx->streams[i];
+            if (!st->rtp)
+                continue;
+            clen = strlen(st->control_url);
+            /* servers are free to send the url relative or absolute */
+            if (!ulen || (ulen <= clen && !strcmp(st->control_url + clen - ulen, url))) {
+                bv_rtp_demux_set_start(st->rtp, strtoul(q + 8, NULL, 10));
+                break;
+            }
+        }
+    }
+}
+
+static int rtsp_read_close(BVMediaContext *s)
+{
+    RTSPContext *ctx = s->priv_data;
+    int i;
+
+    if (ctx->hd && ctx->session_id[0])
+        rtsp_send_request(s, "TEARDOWN", ctx->control_url, NULL);
+    for (i = 0; i < ctx->nb_streams; i++) {
+        RTSPStream *st = ctx->streams[i];
+        bv_url_closep(&st->rtp_hd);
+        bv_url_closep(&st->rtcp_hd);
+        bv_rtp_jitter_free(&st->jb);
+        bv_rtp_demux_close(&st->rtp);
+        bv_free(st->extradata);
+        bv_freep(&ctx->streams[i]);
+    }
+    ctx->nb_streams = 0;
+    ctx->session_id[0] = 0;
+    bv_url_closep(&ctx->hd);
+    bv_freep(&ctx->rbuf);
+    bv_freep(&ctx->pbuf);
+    return 0;
+}
+
+static void rtsp_nack(void *opaque, uint16_t seq, uint16_t blp);
+
+static int rtsp_read_header(BVMediaContext *s)
+{
+    RTSPContext *ctx = s->priv_data;
+    char proto[16], host[256], path[1024], buf[1024];
+    const char *base;
+    char *sdp = NULL;
+    RTSPReply reply;
+    int port, i, ret;
+
+    bv_url_split(proto, sizeof(proto), ctx->auth, sizeof(ctx->auth), host, sizeof(host),
+                 &port, path, sizeof(path), s->filename);
+    if (bv_strcasecmp(proto, "rtsp") || !host[0])
+        return BVERROR(EINVAL);
+    if (port < 0)
+        port = RTSP_DEFAULT_PORT;
+    bv_url_join(ctx->url, sizeof(ctx->url), "rtsp", NULL, host, port, "%s", path);
+    memset(&ctx->auth_state, 0, sizeof(ctx->auth_state));
+
+    ctx->rbuf = bv_malloc(RTSP_BUF_SIZE);
+    if (ctx->transport == RTSP_TRANSPORT_UDP)
+        ctx->pbuf = bv_malloc(RTP_MAX_PACKET_SIZE);
+    if (!ctx->rbuf || (ctx->transport == RTSP_TRANSPORT_UDP && !ctx->pbuf)) {
+        ret = BVERROR(ENOMEM);
+        goto fail;
+    }
+    ctx->rpos = ctx->rend = 0;
+
+    bv_url_join(buf, sizeof(buf), "tcp", NULL, host, port, "?timeout=%d", ctx->timeout);
+    if ((ret = bv_url_open(&ctx->hd, buf, BV_IO_FLAG_READ_WRITE, NULL, NULL)) < 0)
+        goto fail;
+    ctx->peer_len = sizeof(ctx->peer);
+    if (getpeername(bv_url_get_file_handle(ctx->hd), (struct sockaddr *)&ctx->peer, &ctx->peer_len) < 0)
+        ctx->peer_len = 0;
+    ctx->ssrc = bv_get_random_seed();
+
+    if ((ret = rtsp_request(s, "DESCRIBE", ctx->url, "Accept: application/sdp\r\n", &reply, &sdp)) < 0)
+        goto fail;
+    if (!sdp) {
+        bv_log(s, BV_LOG_ERROR, "DESCRIBE returned no SDP\n");
+        ret = BVERROR_INVALIDDATA;
+        goto fail;
+    }
+    bv_log(s, BV_LOG_DEBUG, "SDP:\n%s\n", sdp);
+    base = reply.content_base[0] ? reply.content_base : ctx->url;
+    ret = sdp_parse(s, sdp, base);
+    bv_free(sdp);
+    if (ret < 0)
+        goto fail;
+
+    for (i = 0; i < ctx->nb_streams; i++) {
+        RTSPStream *st = ctx->streams[i];
+        BVStream *stream;
+
+        if (st->codec_id == BV_CODEC_ID_NONE || st->type == BV_MEDIA_TYPE_UNKNOWN ||
+            (st->type == BV_MEDIA_TYPE_VIDEO && !(ctx->media_types & RTSP_MEDIA_VIDEO)) ||
+            (st->type == BV_MEDIA_TYPE_AUDIO && !(ctx->media_types & RTSP_MEDIA_AUDIO))) {
+            bv_log(s, BV_LOG_VERBOSE, "skipping track %s\n", st->control_url);
+            continue;
+        }
+        if ((ret = rtsp_setup(s, st, s->nb_streams)) < 0)
+            goto fail;
+        if (!(stream = bv_stream_new(s, NULL))) {
+            ret = BVERROR(ENOMEM);
+            goto fail;
+        }
+        st->stream_index = stream->index;
+        ret = bv_rtp_demux_open(&st->rtp, st->codec_id, st->payload_type,
+                                st->clock_rate, st->stream_index,
+                                ctx->drop_corrupt ? RTP_DEMUX_FLAG_DROP_CORRUPT : 0);
+        if (ret < 0)
+            goto fail;
+        st->s = s;
+        if (ctx->transport == RTSP_TRANSPORT_UDP) {
+            ret = bv_rtp_jitter_alloc(&st->jb, st->rtp->clock_rate,
+                                      ctx->jitter_min_delay, ctx->jitter_max_delay);
+            if (ret < 0)
+                goto fail;
+            st->jb->nack   = rtsp_nack;
+            st->jb->opaque = st;
+        }
+        stream->codec->codec_type  = st->type;
+        stream->codec->codec_id    = st->codec_id;
+        stream->time_base          = (BVRational) { 1, st->rtp->clock_rate };
+        if (st->type == BV_MEDIA_TYPE_AUDIO) {
+            stream->codec->sample_rate = st->clock_rate;
+            stream->codec->channels    = st->channels;
+        }
+        if (st->extradata_size) {
+            stream->codec->extradata      = st->extradata;
+            stream->codec->extradata_size = st->extradata_size;
+            st->extradata = NULL;
+        }
+    }
+    if (!s->nb_streams) {
+        bv_log(s, BV_LOG_ERROR, "no supported track in %s\n", ctx->url);
+        ret = BVERROR(ENOSYS);
+        goto fail;
+    }
+
+    if ((ret = rtsp_request(s, "PLAY", ctx->control_url, "Range: npt=0.000-\r\n", &reply, NULL)) < 0)
+        goto fail;
+    rtsp_parse_rtp_info(s, reply.rtp_info);
+    ctx->last_rtcp = ctx->last_data = bv_gettime_relative();
+    return 0;
+
+fail:
+    rtsp_read_close(s);
+    return ret;
+}
+
+static RTSPStream *rtsp_find_channel(RTSPContext *ctx, int channel)
+{
+    int i;
+
+    for (i = 0; i < ctx->nb_streams; i++) {
+        RTSPStream *st = ctx->streams[i];
+        if (st->rtp && (channel & ~1) == st->interleaved)
+            return st;
+    }
+    return NULL;
+}
+
+static int rtsp_handle_interleaved(BVMediaContext *s)
+{
+    RTSPContext *ctx = s->priv_data;
+    RTSPStream *st;
+    int channel, len, ret;
+    uint8_t *p;
+
+    if ((ret = rtsp_need(s, 4)) < 0)
+        return ret;
+    channel = ctx->rbuf[ctx->rpos + 1];
+    len     = BV_RB16(ctx->rbuf + ctx->rpos + 2);
+    if ((ret = rtsp_need(s, 4 + len)) < 0)
+        return ret;
+    p = ctx->rbuf + ctx->rpos + 4;
+    ctx->rpos += 4 + len;
+    ctx->last_data = bv_gettime_relative();
+
+    if (!(st = rtsp_find_channel(ctx, channel)))
+        return 0;
+    if (channel & 1)
+        ret = bv_rtp_demux_parse_rtcp(st->rtp, p, len);
+    else
+        ret = bv_rtp_demux_parse(st->rtp, p, len);
+    if (ret == BVERROR_INVALIDDATA) {
+        bv_log(s, BV_LOG_DEBUG, "invalid packet on channel %d\n", channel);
+        ret = 0;
+    }
+    return ret < 0 ? ret : 0;
+}
+
+static int rtsp_send_rtcp(BVMediaContext *s, RTSPStream *st, const uint8_t *data, int len)
+{
+    RTSPContext *ctx = s->priv_data;
+    struct sockaddr_storage addr;
+    uint8_t buf[4 + 128];
+
+    if (ctx->transport == RTSP_TRANSPORT_TCP) {
+        if (len > sizeof(buf) - 4)
+            return BVERROR(EINVAL);
+        buf[0] = '$';
+        buf[1] = st->interleaved + 1;
+        BV_WB16(buf + 2, len);
+        memcpy(buf + 4, data, len);
+        return rtsp_write(s, buf, 4 + len);
+    }
+    if (!ctx->peer_len)
+        return 0;
+    addr = ctx->peer;
+    if (addr.ss_family == AF_INET)
+        ((struct sockaddr_in *)&addr)->sin_port = htons(st->server_rtcp_port);
+#if BV_HAVE_STRUCT_SOCKADDR_IN6
+    else if (addr.ss_family == AF_INET6)
+        ((struct sockaddr_in6 *)&addr)->sin6_port = htons(st->server_rtcp_port);
+#endif
+    sendto(bv_url_get_file_handle(st->rtcp_hd), data, len, 0,
+           (struct sockaddr *)&addr, ctx->peer_len);
+    return 0;
+}
+
+static void rtsp_nack(void *opaque, uint16_t seq, uint16_t blp)
+{
+    RTSPStream *st = opaque;
+    RTSPContext *ctx = st->s->priv_data;
+    uint8_t buf[16];
+    int len;
+
+    if (!ctx->rtcp_fb)
+        return;
+    len = bv_rtp_demux_rtcp_nack(st->rtp, ctx->ssrc, seq, blp, buf, sizeof(buf));
+    if (len > 0)
+        rtsp_send_rtcp(st->s, st, buf, len);
+}
+
+static int rtsp_keepalive(BVMediaContext *s)
+{
+    RTSPContext *ctx = s->priv_data;
+    int64_t now = bv_gettime_relative();
+    uint8_t buf[128];
+    int i, len, ret;
+
+    /* the reply is read and dropped with the media data */
+    if (now - ctx->last_request > ctx->session_timeout * 1000000LL / 2 &&
+        (ret = rtsp_send_request(s, "OPTIONS", ctx->url, NULL)) < 0)
+        return ret;
+    for (i = 0; i < ctx->nb_streams; i++) {
+        RTSPStream *st = ctx->streams[i];
+        if (!st->rtp)
+            continue;
+        if (st->rtp->need_key && now - st->last_pli >= RTSP_PLI_INTERVAL) {
+            st->rtp->need_key = 0;
+            st->last_pli = now;
+            len = bv_rtp_demux_rtcp_pli(st->rtp, ctx->ssrc, buf, sizeof(buf));
+            if (ctx->rtcp_fb && len > 0 && (ret = rtsp_send_rtcp(s, st, buf, len)) < 0)
+                return ret;
+        }
+        if (now - ctx->last_rtcp >= RTSP_RTCP_INTERVAL) {
+            len = bv_rtp_demux_rtcp_rr(st->rtp, ctx->ssrc, buf, sizeof(buf));
+            if (len > 0 && (ret = rtsp_send_rtcp(s, st, buf, len)) < 0)
+                return ret;
+        }
+    }
+    if (now - ctx->last_rtcp >= RTSP_RTCP_INTERVAL)
+        ctx->last_rtcp = now;
+    return 0;
+}
+
+static int rtsp_header_complete(RTSPContext *ctx)
+{
+    const uint8_t *p   = ctx->rbuf + ctx->rpos;
+    const uint8_t *end = ctx->rbuf + ctx->rend;
+
+    while (end - p >= 4 && (p = memchr(p, '\r', end - p - 3))) {
+        if (!memcmp(p, "\r\n\r\n", 4))
+            return 1;
+        p++;
+    }
+    return 0;
+}
+
+static int rtsp_read_control(BVMediaContext *s)
+{
+    RTSPContext *ctx = s->priv_data;
+    RTSPReply reply;
+    int ret;
+
+    if ((ret = rtsp_skip_body(s)) < 0 || (ret = rtsp_need(s, 1)) < 0)
+        return ret;
+    if (ctx->rbuf[ctx->rpos] == '$')
+        return rtsp_handle_interleaved(s);
+    /* a header cut short cannot be resumed, wait for all of it */
+    while ((s->flags & BV_MEDIA_CONTEXT_FLAG_NONBLOCK) && !rtsp_header_complete(ctx)) {
+        if (ctx->rend - ctx->rpos >= RTSP_BUF_SIZE)
+            return BVERROR_INVALIDDATA;
+        if ((ret = rtsp_need(s, ctx->rend - ctx->rpos + 1)) < 0)
+            return ret;
+    }
+    /* replies to keepalives, or requests of the server */
+    return rtsp_read_reply(s, &reply, NULL);
+}
+
+/**
+ * Move the packets that are due from the jitter buffers to the
+ * depacketizers.
+ *
+ * @param deadline set to the time the next packet is due
+ */
+static int rtsp_drain_jitter(BVMediaContext *s, int64_t *deadline)
+{
+    RTSPContext *ctx = s->priv_data;
+    int64_t now = bv_gettime_relative();
+    const uint8_t *data;
+    int i, len, ret;
+
+    *deadline = INT64_MAX;
+    for (i = 0; i < ctx->nb_streams; i++) {
+        RTSPStream *st = ctx->streams[i];
+        if (!st->jb)
+            continue;
+        while (st->rtp->nb_ready < RTP_MAX_READY &&
+               !bv_rtp_jitter_get(st->jb, &data, &len, now)) {
+            ret = bv_rtp_demux_parse(st->rtp, data, len);
+            if (ret < 0 && ret != BVERROR_INVALIDDATA)
+                return ret;
+        }
+        *deadline = BBMIN(*deadline, bv_rtp_jitter_deadline(st->jb));
+    }
+    return 0;
+}
+
+static int rtsp_read_udp(BVMediaContext *s)
+{
+    RTSPContext *ctx = s->priv_data;
+    struct pollfd fds[1 + 2 * RTSP_MAX_STREAMS];
+    BVURLContext *hds[1 + 2 * RTSP_MAX_STREAMS];
+    RTSPStream *sts[1 + 2 * RTSP_MAX_STREAMS];
+    int i, n = 1, len, ret, timeout = 100;
+    int64_t deadline, now;
+
+    if (ctx->rpos < ctx->rend && (ret = rtsp_read_control(s)) != BVERROR(EAGAIN))
+        return ret;
+
+    if ((ret = rtsp_drain_jitter(s, &deadline)) < 0)
+        return ret;
+    for (i = 0; i < ctx->nb_streams; i++) {
+        if (ctx->streams[i]->rtp && ctx->streams[i]->rtp->nb_ready)
+            return 0;
+    }
+    now = bv_gettime_relative();
+    if (deadline != INT64_MAX)
+        timeout = bv_clip((deadline - now + 999) / 1000, 0, timeout);
+    if (s->flags & BV_MEDIA_CONTEXT_FLAG_NONBLOCK)
+        timeout = 0;
+
+    fds[0].fd     = bv_url_get_file_handle(ctx->hd);
+    fds[0].events = POLLIN;
+    for (i = 0; i < ctx->nb_streams; i++) {
+        RTSPStream *st = ctx->streams[i];
+        if (!st->rtp)
+            continue;
+        hds[n] = st->rtp_hd;
+        sts[n] = st;
+        fds[n].fd = bv_url_get_file_handle(st->rtp_hd);
+        fds[n++].events = POLLIN;
+        hds[n] = st->rtcp_hd;
+        sts[n] = st;
+        fds[n].fd = bv_url_get_file_handle(st->rtcp_hd);
+        fds[n++].events = POLLIN;
+    }
+
+    ret = poll(fds, n, timeout);
+    if (ret < 0)
+        return bv_neterrno() == BVERROR(EINTR) ? 0 : bv_neterrno();
+    if (!ret) {
+        if (bv_gettime_relative() - ctx->last_data > ctx->timeout)
+            return BVERROR(ETIMEDOUT);
+        if (s->flags & BV_MEDIA_CONTEXT_FLAG_NONBLOCK &&
+            (deadline == INT64_MAX || deadline > now))
+            return BVERROR(EAGAIN);
+        return 0;
+    }
+
+    for (i = 1; i < n; i++) {
+        if (!fds[i].revents)
+            continue;
+        /* the jitter buffer holds a window, drain the socket */
+        while ((len = bv_url_read(hds[i], ctx->pbuf, RTP_MAX_PACKET_SIZE)) > 0) {
+            ctx->last_data = bv_gettime_relative();
+            if (hds[i] == sts[i]->rtcp_hd)
+                ret = bv_rtp_demux_parse_rtcp(sts[i]->rtp, ctx->pbuf, len);
+            else
+                ret = bv_rtp_jitter_put(sts[i]->jb, ctx->pbuf, len, ctx->last_data);
+            if (ret < 0 && ret != BVERROR_INVALIDDATA)
+                return ret;
+        }
+        if (len < 0 && len != BVERROR(EAGAIN))
+            return len;
+    }
+    if (fds[0].revents && (ret = rtsp_read_control(s)) != BVERROR(EAGAIN))
+        return ret;
+    return 0;
+}
+
+static int rtsp_read_packet(BVMediaContext *s, BVPacket *pkt)
+{
+    RTSPContext *ctx = s->priv_data;
+    int i, ret;
+
+    if (s->flags & BV_MEDIA_CONTEXT_FLAG_NONBLOCK)
+        ctx->hd->flags |= BV_IO_FLAG_NONBLOCK;
+    else
+        ctx->hd->flags &= ~BV_IO_FLAG_NONBLOCK;
+
+    for (;;) {
+        /* round robin, so that a busy video track does not starve audio */
+        for (i = 0; i < ctx->nb_streams; i++) {
+            RTSPStream *st = ctx->streams[(ctx->next_stream + i) % ctx->nb_streams];
+            if (st->rtp && !bv_rtp_demux_get(st->rtp, pkt)) {
+                ctx->next_stream = (ctx->next_stream + i + 1) % ctx->nb_streams;
+                return pkt->size;
+            }
+        }
+        if ((ret = rtsp_keepalive(s)) < 0)
+            return ret;
+        if (ctx->transport == RTSP_TRANSPORT_TCP) {
+            ret = rtsp_read_control(s);
+            if (ret == BVERROR(EAGAIN) && bv_gettime_relative() - ctx->last_data > ctx->timeout)
+                ret = BVERROR(ETIMEDOUT);
+        } else {
+            ret = rtsp_read_udp(s);
+        }
+        if (ret < 0)
+            return ret;
+    }
+}
+
+static int rtsp_poll_info(BVMediaContext *s, BVMediaPollInfo *info)
+{
+    RTSPContext *ctx = s->priv_data;
+    int64_t now = bv_gettime_relative(), next;
+    int i;
+
+    info->nb_fds = 0;
+    info->fds[info->nb_fds++] = bv_url_get_file_handle(ctx->hd);
+    next = BBMIN(ctx->last_data + ctx->timeout,
+                 ctx->last_request + ctx->session_timeout * 1000000LL / 2);
+    next = BBMIN(next, ctx->last_rtcp + RTSP_RTCP_INTERVAL);
+    /* bytes already buffered raise no event */
+    if (ctx->rpos < ctx->rend && !ctx->discard)
+        next = now;
+    for (i = 0; i < ctx->nb_streams; i++) {
+        RTSPStream *st = ctx->streams[i];
+        if (!st->rtp)
+            continue;
+        if (st->rtp->nb_ready)
+            next = now;
+        if (st->rtp->need_key)
+            next = BBMIN(next, st->last_pli + RTSP_PLI_INTERVAL);
+        if (st->jb)
+            next = BBMIN(next, bv_rtp_jitter_deadline(st->jb));
+        if (st->rtp_hd && st->rtcp_hd && info->nb_fds + 2 <= BV_MEDIA_MAX_POLL_FDS) {
+            info->fds[info->nb_fds++] = bv_url_get_file_handle(st->rtp_hd);
+            info->fds[info->nb_fds++] = bv_url_get_file_handle(st->rtcp_hd);
+        }
+    }
+    info->timeout = BBMAX(next - now, 0);
+    return 0;
+}
+
+static int rtsp_media_control(BVMediaContext *s, enum BVMediaMessageType type, const BVControlPacket *pkt_in, BVControlPacket *pkt_out)
+{
+    switch (type) {
+    case BV_MEDIA_MESSAGE_TYPE_POLL_INFO:
+        if (!pkt_out || !pkt_out->data || pkt_out->size < sizeof(BVMediaPollInfo))
+            return BVERROR(EINVAL);
+        return rtsp_poll_info(s, pkt_out->data);
+    default:
+        return BVERROR(ENOSYS);
+    }
+}
+
+#define OFFSET(x) offsetof(RTSPContext, x)
+#define DEC BV_OPT_FLAG_DECODING_PARAM
+static const BVOption options[] = {
+    { "rtsp_transport", "set RTSP lower transport", OFFSET(transport), BV_OPT_TYPE_INT, {.i64 = RTSP_TRANSPORT_TCP}, RTSP_TRANSPORT_TCP, RTSP_TRANSPORT_UDP, DEC, "rtsp_transport" },
+    { "tcp", "interleaved in the RTSP connection", 0, BV_OPT_TYPE_CONST, {.i64 = RTSP_TRANSPORT_TCP}, 0, 0, DEC, "rtsp_transport" },
+    { "udp", "one udp socket pair per track", 0, BV_OPT_TYPE_CONST, {.i64 = RTSP_TRANSPORT_UDP}, 0, 0, DEC, "rtsp_transport" },
+    { "media_types", "set media types to set up", OFFSET(media_types), BV_OPT_TYPE_FLAGS, {.i64 = RTSP_MEDIA_VIDEO | RTSP_MEDIA_AUDIO}, 0, INT_MAX, DEC, "media_types" },
+    { "video", "", 0, BV_OPT_TYPE_CONST, {.i64 = RTSP_MEDIA_VIDEO}, 0, 0, DEC, "media_types" },
+    { "audio", "", 0, BV_OPT_TYPE_CONST, {.i64 = RTSP_MEDIA_AUDIO}, 0, 0, DEC, "media_types" },
+    { "timeout", "set timeout (in microseconds) of socket I/O operations", OFFSET(timeout), BV_OPT_TYPE_INT, {.i64 = 5000000}, 1, INT_MAX, DEC },
+    { "user_agent", "set the User-Agent header", OFFSET(user_agent), BV_OPT_TYPE_STRING, {.str = "BVBase"}, 0, 0, DEC },
+    { "min_port", "set minimum local UDP port", OFFSET(min_port), BV_OPT_TYPE_INT, {.i64 = 5000}, 0, 65535, DEC },
+    { "max_port", "set maximum local UDP port", OFFSET(max_port), BV_OPT_TYPE_INT, {.i64 = 65000}, 0, 65535, DEC },
+    { "buffer_size", "set UDP receive buffer size", OFFSET(buffer_size), BV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, DEC },
+    { "jitter_min_delay", "set minimum time (in microseconds) to wait for a missing udp packet", OFFSET(jitter_min_delay), BV_OPT_TYPE_INT, {.i64 = 10000}, 0, INT_MAX, DEC },
+    { "jitter_max_delay", "set maximum time (in microseconds) to wait for a missing udp packet", OFFSET(jitter_max_delay), BV_OPT_TYPE_INT, {.i64 = 500000}, 0, INT_MAX, DEC },
+    { "drop_corrupt", "drop video frames damaged by loss up to the next key frame", OFFSET(drop_corrupt), BV_OPT_TYPE_INT, {.i64 = 1}, 0, 1, DEC },
+    { "rtcp_fb", "send RTCP NACK and PLI feedback", OFFSET(rtcp_fb), BV_OPT_TYPE_INT, {.i64 = 1}, 0, 1, DEC },
+    { NULL }
+};
+
+static const BVClass rtsp_demuxer_class = {
+    .class_name         = "rtsp demuxer",
+    .item_name          = bv_default_item_name,
+    .option             = options,
+    .version            = LIBBVUTIL_VERSION_INT,
+    .category           = BV_CLASS_CATEGORY_DEMUXER,
+};
+
+BVInputMedia bv_rtsp_demuxer = {
+    .name               = "rtsp",
+    .priv_class         = &rtsp_demuxer_class,
+    .priv_data_size     = sizeof(RTSPContext),
+    .flags              = BV_MEDIA_FLAGS_NOFILE,
+    .read_probe         = rtsp_probe,
+    .read_header        = rtsp_read_header,
+    .read_packet        = rtsp_read_packet,
+    .read_close         = rtsp_read_close,
+    .media_control      = rtsp_media_control,
+};
+
+#ifdef TEST
+
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#undef printf
+
+/*
+ * A stand-in camera: answers DESCRIBE, SETUP and PLAY, then sends an IDR
+ * in one packet, a G.711 frame and a P frame cut in two FU-A fragments,
+ * interleaved or over udp, and answers all further requests until the
+ * client leaves.
+ */
+typedef struct TestServer {
+    int port;
+    int udp;
+    int client_port[2];
+} TestServer;
+
+static const char test_sdp[] =
+    "v=0\r\n"
+    "o=- 0 0 IN IP4 127.0.0.1\r\n"
+    "s=test\r\n"
+    "t=0 0\r\n"
+    "a=control:*\r\n"
+    "m=video 0 RTP/AVP 96\r\n"
+    "a=rtpmap:96 H264/90000\r\n"
+    "a=fmtp:96 packetization-mode=1\r\n"
+    "a=control:track1\r\n"
+    "m=audio 0 RTP/AVP 0\r\n"
+    "a=control:track2\r\n";
+
+static int test_read_request(BVURLContext *hd, char *req, int size)
+{
+    int len = 0;
+
+    while (len < size - 1) {
+        if (bv_url_read(hd, (uint8_t *)req + len, 1) <= 0)
+            return -1;
+        if (++len >= 4 && !memcmp(req + len - 4, "\r\n\r\n", 4))
+            break;
+    }
+    req[len] = 0;
+    return len;
+}
+
+static void test_send_rtp(TestServer *t, BVURLContext *hd, BVURLContext **udp, int track,
+                          int pt, int marker, int seq, uint32_t ts,
+                          const uint8_t *payload, int len)
+{
+    uint8_t buf[4 + 12 + 256];
+
+    buf[0] = '$';
+    buf[1] = 2 * track;
+    BV_WB16(buf + 2, 12 + len);
+    buf[4] = RTP_VERSION << 6;
+    buf[5] = (marker ? 0x80 : 0) | pt;
+    BV_WB16(buf + 6, seq);
+    BV_WB32(buf + 8, ts);
+    BV_WB32(buf + 12, 0x12345678 + track);
+    memcpy(buf + 16, payload, len);
+    if (t->udp)
+        bv_url_write(udp[track], buf + 4, 12 + len);
+    else
+        bv_url_write(hd, buf, 16 + len);
+}
+
+static void *test_server(void *arg)
+{
+    static const uint8_t idr[]   = { 0x65, 0xaa, 0xbb };
+    static const uint8_t fu1[]   = { 0x7c, 0x81, 1, 2, 3 };
+    static const uint8_t fu2[]   = { 0x7c, 0x41, 4, 5 };
+    uint8_t pcm[160];
+    TestServer *t = arg;
+    BVURLContext *hd = NULL, *udp[2] = { NULL };
+    char url[128], req[2048], reply[2048], method[16];
+    const char *p;
+    int i, cseq, track;
+
+    snprintf(url, sizeof(url), "tcp://127.0.0.1:%d?listen=1&listen_timeout=5000", t->port);
+    if (bv_url_open(&hd, url, BV_IO_FLAG_READ_WRITE, NULL, NULL) < 0)
+        return NULL;
+    while (test_read_request(hd, req, sizeof(req)) > 0) {
+        sscanf(req, "%15s", method);
+        cseq = (p = bv_stristr(req, "CSeq:")) ? strtol(p + 5, NULL, 10) : 0;
+        track = strstr(req, "track2") ? 1 : 0;
+        if (!strcmp(method, "DESCRIBE")) {
+            snprintf(reply, sizeof(reply),
+                     "RTSP/1.0 200 OK\r\nCSeq: %d\r\n"
+                     "Content-Base: rtsp://127.0.0.1:%d/live/\r\n"
+                     "Content-Type: application/sdp\r\n"
+                     "Content-Length: %d\r\n\r\n%s",
+                     cseq, t->port, (int)strlen(test_sdp), test_sdp);
+        } else if (!strcmp(method, "SETUP")) {
+            if (t->udp && (p = strstr(req, "client_port=")))
+                t->client_port[track] = strtol(p + 12, NULL, 10);
+            snprintf(reply, sizeof(reply),
+                     "RTSP/1.0 200 OK\r\nCSeq: %d\r\nSession: 1234;timeout=60\r\n"
+                     "Transport: %s;unicast;%s=%d-%d\r\n\r\n", cseq,
+                     t->udp ? "RTP/AVP" : "RTP/AVP/TCP",
+                     t->udp ? "server_port" : "interleaved",
+                     t->udp ? 9 : 2 * track, t->udp ? 10 : 2 * track + 1);
+        } else {
+            snprintf(reply, sizeof(reply),
+                     "RTSP/1.0 200 OK\r\nCSeq: %d\r\nSession: 1234\r\n%s\r\n", cseq,
+                     !strcmp(method, "PLAY") ? "RTP-Info: url=track1;seq=0;rtptime=0,"
+                                               "url=track2;seq=0;rtptime=0\r\n" : "");
+        }
+        bv_url_write(hd, (uint8_t *)reply, strlen(reply));
+        if (!strcmp(method, "TEARDOWN"))
+            break;
+        if (strcmp(method, "PLAY"))
+            continue;
+
+        for (i = 0; t->udp && i < 2; i++) {
+            snprintf(url, sizeof(url), "udp://127.0.0.1:%d", t->client_port[i]);
+            if (bv_url_open(&udp[i], url, BV_IO_FLAG_WRITE, NULL, NULL) < 0)
+                goto end;
+        }
+        memset(pcm, 0xff, sizeof(pcm));
+        test_send_rtp(t, hd, udp, 0, 96, 1, 0, 0,    idr, sizeof(idr));
+        test_send_rtp(t, hd, udp, 1, 0,  1, 0, 0,    pcm, sizeof(pcm));
+        /* out of order over udp, the jitter buffer sorts it out */
+        if (t->udp)
+            test_send_rtp(t, hd, udp, 0, 96, 1, 2, 3000, fu2, sizeof(fu2));
+        test_send_rtp(t, hd, udp, 0, 96, 0, 1, 3000, fu1, sizeof(fu1));
+        if (!t->udp)
+            test_send_rtp(t, hd, udp, 0, 96, 1, 2, 3000, fu2, sizeof(fu2));
+    }
+end:
+    bv_url_closep(&udp[0]);
+    bv_url_closep(&udp[1]);
+    bv_url_closep(&hd);
+    return NULL;
+}
+
+static int test_session(int udp)
+{
+    static const uint8_t frame1[] = { 0, 0, 0, 1, 0x65, 0xaa, 0xbb };
+    static const uint8_t frame2[] = { 0, 0, 0, 1, 0x61, 1, 2, 3, 4, 5 };
+    TestServer t = { 20000 + getpid() % 20000 + 2 * udp, udp };
+    BVMediaContext *s = NULL;
+    BVDictionary *opts = NULL;
+    BVPacket pkt;
+    pthread_t thread;
+    char url[128];
+    int nb_video = 0, nb_audio = 0, ret = -1, i;
+
+    bv_packet_init(&pkt);
+    if (pthread_create(&thread, NULL, test_server, &t))
+        return -1;
+    snprintf(url, sizeof(url), "rtsp://127.0.0.1:%d/live", t.port);
+    bv_dict_set(&opts, "rtsp_transport", udp ? "udp" : "tcp", 0);
+    for (i = 0; i < 100; i++) {
+        if (bv_input_media_open(&s, NULL, url, NULL, &opts) >= 0)
+            break;
+        s = NULL;
+        bv_usleep(20000);
+    }
+    bv_dict_free(&opts);
+    if (!s)
+        goto end;
+    if (s->nb_streams != 2 ||
+        s->streams[0]->codec->codec_id != BV_CODEC_ID_H264 ||
+        s->streams[1]->codec->codec_id != BV_CODEC_ID_G711U)
+        goto end;
+
+    while (nb_video < 2 || nb_audio < 1) {
+        bv_packet_init(&pkt);
+        if (bv_input_media_read(s, &pkt) < 0)
+            goto end;
+        if (pkt.stream_index == 1) {
+            if (pkt.size != 160 || pkt.pts != 0)
+                goto end;
+            nb_audio++;
+        } else if (nb_video++ == 0) {
+            if (pkt.size != sizeof(frame1) || memcmp(pkt.data, frame1, pkt.size) ||
+                !(pkt.flags & BV_PKT_FLAG_KEY) || pkt.pts != 0)
+                goto end;
+        } else {
+            if (pkt.size != sizeof(frame2) || memcmp(pkt.data, frame2, pkt.size) ||
+                (pkt.flags & (BV_PKT_FLAG_KEY | BV_PKT_FLAG_CORRUPT)) || pkt.pts != 3000)
+                goto end;
+        }
+        bv_packet_free(&pkt);
+    }
+    ret = 0;
+end:
+    if (ret < 0)
+        printf("%s: %d video, %d audio packets\n", udp ? "udp" : "tcp", nb_video, nb_audio);
+    bv_packet_free(&pkt);
+    if (s)
+        bv_input_media_close(&s);
+    pthread_join(thread, NULL);
+    return ret;
+}
+
+int main(void)
+{
+    int ret;
+
+    bv_media_register_all();
+    bv_protocol_register_all();
+    bv_network_init();
+
+    ret = test_session(0) | test_session(1);
+    printf("%s\n", ret ? "FAIL" : "OK");
+    return !!ret;
+}
+
+#endif /* TEST */
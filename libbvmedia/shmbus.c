@@ -0,0 +1,821 @@
+/*************************************************************************
+    > File Name: shmbus.c
+    > Author: albertfang
+    > Mail: fang.qi@besovideo.com
+    > Created Time: 2026年10月18日 星期日 21时03分17秒
+ ************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) albert@BesoVideo, 2026
+ */
+
+#line 25 "shmbus.c"
+
+/**
+ * @file
+ * Shared memory packet bus: one publisher process writes packets into a
+ * memfd backed ring, any number of subscriber processes read them without
+ * the publisher copying anything per consumer.
+ *
+ * shmbus:/run/cam0.bus names a unix socket on which the publisher hands the
+ * memfd to every subscriber that connects. Subscribers map the whole bus
+ * read-only and keep their own cursor; the publisher never waits for them.
+ * A subscriber that falls more than a ring behind is resynchronised to the
+ * newest key frame and the overrun is logged.
+ *
+ * Since the publisher may reuse a slot at any time, each subscriber copies
+ * a packet out once, checking afterwards that it was not overwritten
+ * meanwhile. Handing out references into the ring would need the
+ * publisher to wait for the slowest subscriber instead.
+ */
+
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#if defined(__linux__)
+#include <linux/futex.h>
+#endif
+
+#include <libbvutil/atomic.h>
+#include <libbvutil/bvstring.h>
+#include <libbvutil/network.h>
+#include <libbvutil/opt.h>
+#include <libbvutil/time.h>
+
+#include "bvmedia.h"
+
+#define SHMBUS_MAGIC        MKTAG('B', 'V', 'S', 'B')
+#define SHMBUS_VERSION      2
+#define SHMBUS_HEADER_SIZE  65536       ///< multiple of any page size, data follows
+#define SHMBUS_MAX_STREAMS  8
+#define SHMBUS_MAX_EXTRADATA 1024
+#define SHMBUS_POLL_TIME    100000
+
+typedef struct ShmBusStreamInfo {
+    int32_t codec_type;
+    int32_t codec_id;
+    int32_t width, height;
+    int32_t time_base_num, time_base_den;
+    int32_t sample_rate;
+    int32_t channels;
+    int32_t extradata_size;
+    uint8_t extradata[SHMBUS_MAX_EXTRADATA];
+} ShmBusStreamInfo;
+
+/**
+ * Ring positions are free running byte counters, (pos & (size - 1)) is the
+ * offset in the data area. Only the publisher writes head, reserve, last_key.
+ */
+typedef struct ShmBusHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;              ///< data ring size, power of two
+    uint32_t nb_streams;
+    volatile int seq;           ///< futex word, bumped and woken after every packet
+    volatile int closed;
+    volatile int has_key;
+    volatile int head;          ///< end of the last complete record
+    volatile int reserve;       ///< end of the record being written
+    volatile int last_key;      ///< start of the newest key frame record
+    int reserved[2];
+    ShmBusStreamInfo streams[SHMBUS_MAX_STREAMS];
+} ShmBusHeader;
+
+typedef struct ShmBusRecord {
+    uint32_t size;              ///< payload bytes following the record
+    int32_t  stream_index;
+    int32_t  flags;
+    uint32_t reserved;
+    int64_t  pts;
+    int64_t  dts;
+} ShmBusRecord;
+
+#define RECORD_SIZE(size) BBALIGN(sizeof(ShmBusRecord) + (size), 8)
+
+typedef struct ShmBusContext {
+    const BVClass *bv_class;
+    int buffer_size;
+    int start;
+    int64_t rw_timeout;
+    int64_t open_timeout;
+
+    ShmBusHeader *hdr;
+    uint8_t *data;
+    unsigned size;
+    unsigned tail;              ///< subscriber cursor
+    uint32_t overruns;
+
+    BVBufferRef *shm;           ///< publisher mapping
+    int listen_fd;
+    int abort_request;
+    int thread_started;
+    pthread_t thread;
+} ShmBusContext;
+
+enum ShmBusStart {
+    SHMBUS_START_LIVE,
+    SHMBUS_START_KEY,
+};
+
+static const char *shmbus_path(BVMediaContext *s)
+{
+    const char *path = s->filename;
+    bv_strstart(path, "shmbus:", &path);
+    return path;
+}
+
+static int shmbus_futex_wait(volatile int *addr, int val, int64_t timeout)
+{
+#if defined(__linux__) && defined(SYS_futex)
+    struct timespec ts = { timeout / 1000000, (timeout % 1000000) * 1000 };
+    return syscall(SYS_futex, addr, FUTEX_WAIT, val, &ts, NULL, 0);
+#else
+    bv_usleep(BBMIN(timeout, 1000));
+    return 0;
+#endif
+}
+
+static void shmbus_futex_wake(volatile int *addr)
+{
+#if defined(__linux__) && defined(SYS_futex)
+    syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#endif
+}
+
+static void ring_write(ShmBusContext *ctx, unsigned pos, const void *buf, int size)
+{
+    unsigned off = pos & (ctx->size - 1);
+    int len = BBMIN(size, ctx->size - off);
+    memcpy(ctx->data + off, buf, len);
+    memcpy(ctx->data, (const uint8_t *)buf + len, size - len);
+}
+
+static void ring_read(ShmBusContext *ctx, unsigned pos, void *buf, int size)
+{
+    unsigned off = pos & (ctx->size - 1);
+    int len = BBMIN(size, ctx->size - off);
+    memcpy(buf, ctx->data + off, len);
+    memcpy((uint8_t *)buf + len, ctx->data, size - len);
+}
+
+static int shmbus_send_fd(int sock, int fd)
+{
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } cmsg = { { 0 } };
+    uint32_t magic = SHMBUS_MAGIC;
+    struct iovec iov = { &magic, sizeof(magic) };
+    struct msghdr msg = { 0 };
+    struct cmsghdr *c;
+
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = cmsg.buf;
+    msg.msg_controllen = sizeof(cmsg.buf);
+    c = CMSG_FIRSTHDR(&msg);
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type  = SCM_RIGHTS;
+    c->cmsg_len   = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(c), &fd, sizeof(int));
+    return sendmsg(sock, &msg, MSG_NOSIGNAL) < 0 ? bv_neterrno() : 0;
+}
+
+static int shmbus_recv_fd(int sock)
+{
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } cmsg;
+    uint32_t magic = 0;
+    struct iovec iov = { &magic, sizeof(magic) };
+    struct msghdr msg = { 0 };
+    struct cmsghdr *c;
+    int fd = -1;
+
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = cmsg.buf;
+    msg.msg_controllen = sizeof(cmsg.buf);
+    if (recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) < 0)
+        return bv_neterrno();
+    for (c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS &&
+            c->cmsg_len == CMSG_LEN(sizeof(int)))
+            memcpy(&fd, CMSG_DATA(c), sizeof(int));
+    }
+    if (fd >= 0 && magic != SHMBUS_MAGIC) {
+        close(fd);
+        fd = -1;
+    }
+    return fd < 0 ? BVERROR_INVALIDDATA : fd;
+}
+
+/**
+ * Publisher side: hand the memfd to every subscriber that connects.
+ */
+static void *shmbus_listen_task(void *arg)
+{
+    BVMediaContext *s = arg;
+    ShmBusContext *ctx = s->priv_data;
+    int fd = bv_buffer_get_shared_fd(ctx->shm);
+
+    while (!bvpriv_atomic_int_get(&ctx->abort_request)) {
+        struct pollfd p = { ctx->listen_fd, POLLIN, 0 };
+        int client;
+
+        if (poll(&p, 1, SHMBUS_POLL_TIME / 1000) <= 0)
+            continue;
+        client = accept(ctx->listen_fd, NULL, NULL);
+        if (client < 0)
+            continue;
+        if (shmbus_send_fd(client, fd) < 0)
+            bv_log(s, BV_LOG_WARNING, "failed to hand the bus to a subscriber\n");
+        close(client);
+    }
+    return NULL;
+}
+
+static int shmbus_write_stream_info(ShmBusStreamInfo *info, const BVStream *st)
+{
+    const BVCodecContext *codec = st->codec;
+
+    info->codec_type    = codec->codec_type;
+    info->codec_id      = codec->codec_id;
+    info->width         = codec->width;
+    info->height        = codec->height;
+    info->time_base_num = st->time_base.num;
+    info->time_base_den = st->time_base.den;
+    info->sample_rate   = codec->sample_rate;
+    info->channels      = codec->channels;
+    if (codec->extradata && codec->extradata_size > 0) {
+        if (codec->extradata_size > SHMBUS_MAX_EXTRADATA)
+            return BVERROR(EINVAL);
+        info->extradata_size = codec->extradata_size;
+        memcpy(info->extradata, codec->extradata, codec->extradata_size);
+    }
+    return 0;
+}
+
+static int shmbus_write_header(BVMediaContext *s)
+{
+    ShmBusContext *ctx = s->priv_data;
+    struct sockaddr_un addr = { 0 };
+    const char *path = shmbus_path(s);
+    unsigned size = 65536;
+    int i, ret;
+
+    if (s->nb_streams > SHMBUS_MAX_STREAMS) {
+        bv_log(s, BV_LOG_ERROR, "at most %d streams\n", SHMBUS_MAX_STREAMS);
+        return BVERROR(EINVAL);
+    }
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return BVERROR(ENAMETOOLONG);
+
+    while (size < ctx->buffer_size)
+        size <<= 1;
+    ctx->shm = bv_buffer_alloc_shared(SHMBUS_HEADER_SIZE + size);
+    if (!ctx->shm) {
+        bv_log(s, BV_LOG_ERROR, "cannot allocate %u bytes of shared memory\n", size);
+        return BVERROR(ENOMEM);
+    }
+    ctx->hdr  = (ShmBusHeader *)ctx->shm->data;
+    ctx->data = ctx->shm->data + SHMBUS_HEADER_SIZE;
+    ctx->size = size;
+    ctx->hdr->magic      = SHMBUS_MAGIC;
+    ctx->hdr->version    = SHMBUS_VERSION;
+    ctx->hdr->size       = size;
+    ctx->hdr->nb_streams = s->nb_streams;
+    for (i = 0; i < s->nb_streams; i++) {
+        if ((ret = shmbus_write_stream_info(&ctx->hdr->streams[i], s->streams[i])) < 0) {
+            bv_log(s, BV_LOG_ERROR, "extradata of stream %d is larger than %d bytes\n",
+                   i, SHMBUS_MAX_EXTRADATA);
+            bv_buffer_unref(&ctx->shm);
+            ctx->hdr = NULL;
+            return ret;
+        }
+    }
+
+    ctx->listen_fd = bv_socket(AF_UNIX, SOCK_STREAM, 0);
+    if (ctx->listen_fd < 0) {
+        ret = bv_neterrno();
+        goto fail;
+    }
+    addr.sun_family = AF_UNIX;
+    bv_strlcpy(addr.sun_path, path, sizeof(addr.sun_path));
+    unlink(path);
+    if (bind(ctx->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(ctx->listen_fd, 16) < 0) {
+        ret = bv_neterrno();
+        bv_log(s, BV_LOG_ERROR, "cannot listen on %s\n", path);
+        goto fail;
+    }
+    if ((ret = pthread_create(&ctx->thread, NULL, shmbus_listen_task, s))) {
+        ret = BVERROR(ret);
+        unlink(path);
+        goto fail;
+    }
+    ctx->thread_started = 1;
+    return 0;
+
+fail:
+    if (ctx->listen_fd >= 0)
+        closesocket(ctx->listen_fd);
+    ctx->listen_fd = -1;
+    bv_buffer_unref(&ctx->shm);
+    ctx->hdr = NULL;
+    return ret;
+}
+
+static int shmbus_write_packet(BVMediaContext *s, BVPacket *pkt)
+{
+    ShmBusContext *ctx = s->priv_data;
+    ShmBusHeader *hdr = ctx->hdr;
+    ShmBusRecord rec = { 0 };
+    unsigned pos, len;
+
+    if (!hdr)
+        return BVERROR(EINVAL);
+    len = RECORD_SIZE(pkt->size);
+    if (pkt->size < 0 || len > ctx->size / 2) {
+        bv_log(s, BV_LOG_ERROR, "packet of %d bytes does not fit the bus\n", pkt->size);
+        return BVERROR(EINVAL);
+    }
+    rec.size         = pkt->size;
+    rec.stream_index = pkt->stream_index;
+    rec.flags        = pkt->flags;
+    rec.pts          = pkt->pts;
+    rec.dts          = pkt->dts;
+
+    /* announce the bytes about to be overwritten before touching them */
+    pos = hdr->head;
+    bvpriv_atomic_int_set(&hdr->reserve, pos + len);
+    ring_write(ctx, pos, &rec, sizeof(rec));
+    ring_write(ctx, pos + sizeof(rec), pkt->data, pkt->size);
+    if (pkt->flags & BV_PKT_FLAG_KEY) {
+        bvpriv_atomic_int_set(&hdr->last_key, pos);
+        bvpriv_atomic_int_set(&hdr->has_key, 1);
+    }
+    bvpriv_atomic_int_set(&hdr->head, pos + len);
+    bvpriv_atomic_int_add_and_fetch(&hdr->seq, 1);
+    /* subscribers can not write the bus to say they sleep, always wake */
+    shmbus_futex_wake(&hdr->seq);
+    return 0;
+}
+
+static int shmbus_write_trailer(BVMediaContext *s)
+{
+    ShmBusContext *ctx = s->priv_data;
+
+    if (!ctx->hdr)
+        return 0;
+    bvpriv_atomic_int_set(&ctx->hdr->closed, 1);
+    bvpriv_atomic_int_add_and_fetch(&ctx->hdr->seq, 1);
+    shmbus_futex_wake(&ctx->hdr->seq);
+
+    if (ctx->thread_started) {
+        bvpriv_atomic_int_set(&ctx->abort_request, 1);
+        pthread_join(ctx->thread, NULL);
+        ctx->thread_started = 0;
+    }
+    closesocket(ctx->listen_fd);
+    ctx->listen_fd = -1;
+    unlink(shmbus_path(s));
+    /* subscribers keep their own mappings */
+    bv_buffer_unref(&ctx->shm);
+    ctx->hdr = NULL;
+    return 0;
+}
+
+static int shmbus_probe(BVMediaContext *s, BVProbeData *p)
+{
+    if (p->filename && bv_strstart(p->filename, "shmbus:", NULL))
+        return BV_PROBE_SCORE_MAX;
+    return 0;
+}
+
+static int shmbus_read_close(BVMediaContext *s);
+
+static int shmbus_connect(BVMediaContext *s)
+{
+    ShmBusContext *ctx = s->priv_data;
+    struct sockaddr_un addr = { 0 };
+    const char *path = shmbus_path(s);
+    int64_t deadline = bv_gettime() + ctx->open_timeout;
+    int fd, ret;
+
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return BVERROR(ENAMETOOLONG);
+    addr.sun_family = AF_UNIX;
+    bv_strlcpy(addr.sun_path, path, sizeof(addr.sun_path));
+
+    /* the publisher may not be up yet */
+    for (;;) {
+        if ((fd = bv_socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+            return bv_neterrno();
+        ret = bv_listen_connect(fd, (struct sockaddr *)&addr, sizeof(addr),
+                                ctx->open_timeout / 1000, NULL, 0);
+        if (!ret)
+            break;
+        closesocket(fd);
+        if (bv_gettime() >= deadline)
+            return ret;
+        bv_usleep(SHMBUS_POLL_TIME);
+    }
+    ret = bv_network_wait_fd_timeout(fd, 0, ctx->open_timeout, NULL);
+    if (!ret)
+        ret = shmbus_recv_fd(fd);
+    closesocket(fd);
+    return ret;
+}
+
+static int shmbus_read_header(BVMediaContext *s)
+{
+    ShmBusContext *ctx = s->priv_data;
+    ShmBusHeader *hdr;
+    struct stat st;
+    int i, fd, ret;
+
+    fd = shmbus_connect(s);
+    if (fd < 0) {
+        bv_log(s, BV_LOG_ERROR, "cannot reach publisher at %s\n", shmbus_path(s));
+        return fd;
+    }
+    ret = BVERROR_INVALIDDATA;
+    if (fstat(fd, &st) < 0 || st.st_size <= SHMBUS_HEADER_SIZE)
+        goto fail;
+    hdr = mmap(NULL, SHMBUS_HEADER_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+    if (hdr == MAP_FAILED) {
+        ret = BVERROR(errno);
+        goto fail;
+    }
+    ctx->hdr = hdr;
+    if (hdr->magic != SHMBUS_MAGIC || hdr->version != SHMBUS_VERSION ||
+        !hdr->size || (hdr->size & (hdr->size - 1)) ||
+        hdr->size != st.st_size - SHMBUS_HEADER_SIZE ||
+        hdr->nb_streams > SHMBUS_MAX_STREAMS) {
+        bv_log(s, BV_LOG_ERROR, "invalid bus header\n");
+        goto fail;
+    }
+    ctx->size = hdr->size;
+    ctx->data = mmap(NULL, ctx->size, PROT_READ, MAP_SHARED, fd, SHMBUS_HEADER_SIZE);
+    if (ctx->data == MAP_FAILED) {
+        ctx->data = NULL;
+        ret = BVERROR(errno);
+        goto fail;
+    }
+    close(fd);
+    fd = -1;
+
+    for (i = 0; i < hdr->nb_streams; i++) {
+        const ShmBusStreamInfo *info = &hdr->streams[i];
+        BVStream *stream = bv_stream_new(s, NULL);
+        if (!stream) {
+            ret = BVERROR(ENOMEM);
+            goto fail;
+        }
+        stream->codec->codec_type  = info->codec_type;
+        stream->codec->codec_id    = info->codec_id;
+        stream->codec->width       = info->width;
+        stream->codec->height      = info->height;
+        stream->codec->sample_rate = info->sample_rate;
+        stream->codec->channels    = info->channels;
+        stream->time_base          = (BVRational) { info->time_base_num, info->time_base_den };
+        if (info->extradata_size > 0 && info->extradata_size <= SHMBUS_MAX_EXTRADATA) {
+            stream->codec->extradata = bv_mallocz(info->extradata_size + BV_INPUT_BUFFER_PADDING_SIZE);
+            if (!stream->codec->extradata) {
+                ret = BVERROR(ENOMEM);
+                goto fail;
+            }
+            memcpy(stream->codec->extradata, info->extradata, info->extradata_size);
+            stream->codec->extradata_size = info->extradata_size;
+        }
+    }
+
+    ctx->tail = bvpriv_atomic_int_get(&hdr->head);
+    if (ctx->start == SHMBUS_START_KEY && bvpriv_atomic_int_get(&hdr->has_key)) {
+        unsigned key = bvpriv_atomic_int_get(&hdr->last_key);
+        if (ctx->tail - key <= ctx->size / 2)
+            ctx->tail = key;
+    }
+    return 0;
+
+fail:
+    if (fd >= 0)
+        close(fd);
+    shmbus_read_close(s);
+    return ret;
+}
+
+/**
+ * Sleep on the futex until the publisher moves head away from tail.
+ */
+static int shmbus_wait(BVMediaContext *s)
+{
+    ShmBusContext *ctx = s->priv_data;
+    ShmBusHeader *hdr = ctx->hdr;
+    int64_t deadline = ctx->rw_timeout ? bv_gettime() + ctx->rw_timeout : 0;
+
+    for (;;) {
+        int seq = bvpriv_atomic_int_get(&hdr->seq);
+        if ((unsigned)bvpriv_atomic_int_get(&hdr->head) != ctx->tail)
+            return 0;
+        if (bvpriv_atomic_int_get(&hdr->closed))
+            return BVERROR_EOF;
+        if (deadline && bv_gettime() >= deadline)
+            return BVERROR(ETIMEDOUT);
+        shmbus_futex_wait(&hdr->seq, seq, SHMBUS_POLL_TIME);
+    }
+}
+
+/**
+ * Jump over data the publisher has already reused.
+ */
+static void shmbus_resync(BVMediaContext *s)
+{
+    ShmBusContext *ctx = s->priv_data;
+    ShmBusHeader *hdr = ctx->hdr;
+    unsigned head = bvpriv_atomic_int_get(&hdr->head);
+    unsigned tail = head;
+
+    if (bvpriv_atomic_int_get(&hdr->has_key)) {
+        unsigned key = bvpriv_atomic_int_get(&hdr->last_key);
+        if ((int)(key - ctx->tail) > 0 && head - key <= ctx->size / 2)
+            tail = key;
+    }
+    ctx->overruns++;
+    bv_log(s, BV_LOG_WARNING, "subscriber overrun #%u, skipped %u bytes\n",
+           ctx->overruns, tail - ctx->tail);
+    ctx->tail = tail;
+}
+
+static int shmbus_read_packet(BVMediaContext *s, BVPacket *pkt)
+{
+    ShmBusContext *ctx = s->priv_data;
+    ShmBusHeader *hdr = ctx->hdr;
+    ShmBusRecord rec;
+    int ret;
+
+    for (;;) {
+        if ((ret = shmbus_wait(s)) < 0)
+            return ret;
+        if ((unsigned)bvpriv_atomic_int_get(&hdr->head) - ctx->tail > ctx->size) {
+            shmbus_resync(s);
+            continue;
+        }
+        ring_read(ctx, ctx->tail, &rec, sizeof(rec));
+        if ((unsigned)bvpriv_atomic_int_get(&hdr->reserve) - ctx->tail > ctx->size ||
+            RECORD_SIZE(rec.size) > ctx->size / 2) {
+            shmbus_resync(s);
+            continue;
+        }
+        if ((ret = bv_packet_new(pkt, rec.size)) < 0)
+            return ret;
+        ring_read(ctx, ctx->tail + sizeof(rec), pkt->data, rec.size);
+        /* the copy is only valid if the publisher did not lap us meanwhile */
+        if ((unsigned)bvpriv_atomic_int_get(&hdr->reserve) - ctx->tail > ctx->size) {
+            bv_packet_free(pkt);
+            shmbus_resync(s);
+            continue;
+        }
+        break;
+    }
+    ctx->tail += RECORD_SIZE(rec.size);
+    pkt->stream_index = rec.stream_index;
+    pkt->flags        = rec.flags;
+    pkt->pts          = rec.pts;
+    pkt->dts          = rec.dts;
+    return 0;
+}
+
+static int shmbus_read_close(BVMediaContext *s)
+{
+    ShmBusContext *ctx = s->priv_data;
+
+    if (ctx->data)
+        munmap(ctx->data, ctx->size);
+    if (ctx->hdr)
+        munmap(ctx->hdr, SHMBUS_HEADER_SIZE);
+    ctx->data = NULL;
+    ctx->hdr  = NULL;
+    return 0;
+}
+
+#define OFFSET(x) offsetof(ShmBusContext, x)
+#define DEC BV_OPT_FLAG_DECODING_PARAM
+#define ENC BV_OPT_FLAG_ENCODING_PARAM
+static const BVOption options[] = {
+    { "buffer_size", "ring size in bytes", OFFSET(buffer_size), BV_OPT_TYPE_INT, {.i64 = 8 << 20}, 65536, 1 << 30, ENC },
+    { "start", "where a new subscriber starts reading", OFFSET(start), BV_OPT_TYPE_INT, {.i64 = SHMBUS_START_KEY}, SHMBUS_START_LIVE, SHMBUS_START_KEY, DEC, "start" },
+    { "live", "the next packet written", 0, BV_OPT_TYPE_CONST, {.i64 = SHMBUS_START_LIVE}, 0, 0, DEC, "start" },
+    { "key", "the newest key frame still in the ring", 0, BV_OPT_TYPE_CONST, {.i64 = SHMBUS_START_KEY}, 0, 0, DEC, "start" },
+    { "timeout", "read timeout in microseconds, 0 waits forever", OFFSET(rw_timeout), BV_OPT_TYPE_INT64, {.i64 = 0}, 0, INT64_MAX, DEC },
+    { "open_timeout", "how long to wait for the publisher in microseconds", OFFSET(open_timeout), BV_OPT_TYPE_INT64, {.i64 = 5000000}, 0, INT64_MAX, DEC },
+    { NULL }
+};
+
+static const BVClass shmbus_muxer_class = {
+    .class_name         = "shmbus muxer",
+    .item_name          = bv_default_item_name,
+    .option             = options,
+    .version            = LIBBVUTIL_VERSION_INT,
+    .category           = BV_CLASS_CATEGORY_MUXER,
+};
+
+static const BVClass shmbus_demuxer_class = {
+    .class_name         = "shmbus demuxer",
+    .item_name          = bv_default_item_name,
+    .option             = options,
+    .version            = LIBBVUTIL_VERSION_INT,
+    .category           = BV_CLASS_CATEGORY_DEMUXER,
+};
+
+BVOutputMedia bv_shmbus_muxer = {
+    .name               = "shmbus",
+    .priv_class         = &shmbus_muxer_class,
+    .priv_data_size     = sizeof(ShmBusContext),
+    .flags              = BV_MEDIA_FLAGS_NOFILE,
+    .write_header       = shmbus_write_header,
+    .write_packet       = shmbus_write_packet,
+    .write_trailer      = shmbus_write_trailer,
+};
+
+BVInputMedia bv_shmbus_demuxer = {
+    .name               = "shmbus",
+    .priv_class         = &shmbus_demuxer_class,
+    .priv_data_size     = sizeof(ShmBusContext),
+    .flags              = BV_MEDIA_FLAGS_NOFILE,
+    .read_probe         = shmbus_probe,
+    .read_header        = shmbus_read_header,
+    .read_packet        = shmbus_read_packet,
+    .read_close         = shmbus_read_close,
+};
+
+#ifdef TEST
+
+#include <stdio.h>
+
+#undef printf
+
+#define TEST_PKT_SIZE   1000
+#define TEST_GOP        10
+
+static int test_write(BVMediaContext *pub, int n)
+{
+    BVPacket pkt;
+    int ret;
+
+    bv_packet_init(&pkt);
+    if ((ret = bv_packet_new(&pkt, TEST_PKT_SIZE)) < 0)
+        return ret;
+    memset(pkt.data, n, pkt.size);
+    pkt.flags = n % TEST_GOP ? 0 : BV_PKT_FLAG_KEY;
+    pkt.pts = pkt.dts = n;
+    ret = bv_output_media_write(pub, &pkt);
+    bv_packet_free(&pkt);
+    return ret;
+}
+
+/**
+ * @return the pts of the next packet after checking its content, or an error
+ */
+static int test_read(BVMediaContext *sub)
+{
+    BVPacket pkt;
+    int ret;
+
+    bv_packet_init(&pkt);
+    if ((ret = bv_input_media_read(sub, &pkt)) < 0)
+        return ret;
+    ret = pkt.size == TEST_PKT_SIZE && pkt.data[0] == (uint8_t)pkt.pts &&
+          pkt.data[pkt.size - 1] == (uint8_t)pkt.pts &&
+          !(pkt.flags & BV_PKT_FLAG_KEY) == !!(pkt.pts % TEST_GOP) ? pkt.pts : -1000;
+    bv_packet_free(&pkt);
+    return ret;
+}
+
+static int test_open(BVMediaContext **sub, const char *url, const char *start)
+{
+    BVDictionary *opts = NULL;
+    int ret;
+
+    bv_dict_set(&opts, "start", start, 0);
+    bv_dict_set(&opts, "timeout", "100000", 0);
+    ret = bv_input_media_open(sub, NULL, url, &bv_shmbus_demuxer, &opts);
+    bv_dict_free(&opts);
+    return ret;
+}
+
+static void *test_publish(void *arg)
+{
+    BVMediaContext *pub = arg;
+    int n;
+
+    for (n = 300; n < 350; n++) {
+        if (test_write(pub, n) < 0)
+            return (void *)1;
+        bv_usleep(1000);
+    }
+    return NULL;
+}
+
+#define CHECK(x) do { if (!(x)) { printf("line %d: %s\n", __LINE__, #x); goto fail; } } while (0)
+
+int main(void)
+{
+    BVMediaContext *pub = NULL, *fast = NULL, *slow = NULL;
+    ShmBusContext *ctx;
+    BVDictionary *opts = NULL;
+    BVStream *st;
+    pthread_t thread;
+    void *res;
+    char url[64];
+    int n, errors = 0;
+
+    bv_media_register_all();
+    snprintf(url, sizeof(url), "shmbus:/tmp/shmbus-test-%d.bus", getpid());
+
+    bv_dict_set(&opts, "buffer_size", "65536", 0);
+    CHECK(bv_output_media_open(&pub, url, NULL, &bv_shmbus_muxer, &opts) >= 0);
+    CHECK(st = bv_stream_new(pub, NULL));
+    st->codec->codec_type = BV_MEDIA_TYPE_VIDEO;
+    st->codec->codec_id   = BV_CODEC_ID_H264;
+    st->codec->width      = 640;
+    st->codec->height     = 480;
+    CHECK(bv_output_media_write_header(pub, &opts) >= 0);
+
+    /* a live subscriber sees what comes after it joined */
+    for (n = 0; n < 5; n++)
+        CHECK(test_write(pub, n) >= 0);
+    CHECK(test_open(&fast, url, "live") >= 0);
+    CHECK(fast->nb_streams == 1 && fast->streams[0]->codec->width == 640);
+    CHECK(test_read(fast) == BVERROR(ETIMEDOUT));
+    for (; n < 25; n++)
+        CHECK(test_write(pub, n) >= 0);
+
+    /* a new subscriber starts at the newest key frame */
+    CHECK(test_open(&slow, url, "key") >= 0);
+    CHECK(test_read(slow) == 20);
+    for (n = 5; n < 25; n++)
+        CHECK(test_read(fast) == n);
+
+    /* the slow one falls more than a ring behind, ~63 records fit */
+    for (n = 25; n < 300; n++) {
+        CHECK(test_write(pub, n) >= 0);
+        CHECK(test_read(fast) == n);
+    }
+    ctx = slow->priv_data;
+    CHECK(test_read(slow) == 290 && ctx->overruns == 1);
+    for (n = 291; n < 300; n++)
+        CHECK(test_read(slow) == n);
+
+    /* blocked readers are woken by the publisher, then EOF */
+    CHECK(!pthread_create(&thread, NULL, test_publish, pub));
+    for (n = 300; n < 350; n++)
+        CHECK(test_read(fast) == n);
+    pthread_join(thread, &res);
+    CHECK(!res);
+    CHECK(bv_output_media_write_trailer(pub) >= 0);
+    for (n = 300; n < 350; n++)
+        CHECK(test_read(slow) == n);
+    CHECK(test_read(slow) == BVERROR_EOF && test_read(fast) == BVERROR_EOF);
+    CHECK(ctx->overruns == 1);
+
+    if (0) {
+fail:
+        errors++;
+    }
+    bv_dict_free(&opts);
+    if (fast)
+        bv_input_media_close(&fast);
+    if (slow)
+        bv_input_media_close(&slow);
+    if (pub) {
+        bv_output_media_write_trailer(pub);
+        bv_output_media_close(&pub);
+    }
+    printf("%s\n", errors ? "FAIL" : "OK");
+    return !!errors;
+}
+
+#endif /* TEST */
@@ -46,11 +46,19 @@ void bv_protocol_register_all(void)
 
     REGISTER_PROTOCOL(FILE, file);
     REGISTER_PROTOCOL(TCP, tcp);
+    REGISTER_PROTOCOL(TLS, tls);
     REGISTER_PROTOCOL(UDP, udp);
     REGISTER_PROTOCOL(BVFS, bvfs);
     REGISTER_PROTOCOL(HTTP, http);
     REGISTER_PROTOCOL(HTTPS, https);
     REGISTER_PROTOCOL(HTTPPROXY, httpproxy);
+    REGISTER_PROTOCOL(MEM, mem);
+    REGISTER_PROTOCOL(UNIX, unix);
+    REGISTER_PROTOCOL(CACHE, cache);
+    REGISTER_PROTOCOL(CRYPTO, crypto);
+    REGISTER_PROTOCOL(CONCAT, concat);
+    REGISTER_PROTOCOL(FEC, fec);
+    REGISTER_PROTOCOL(ARQ, arq);
 #if BV_CONFIG_LIBBVFS
 //    bvfs_init(1, 0);
 #endif
@@ -0,0 +1,822 @@
+/*************************************************************************
+    > File Name: arq.c
+    > Author: albertfang
+    > Mail: fang.qi@besovideo.com
+    > Created Time: 2026年10月19日 星期一 01时12分48秒
+ ************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) albert@BesoVideo, 2026
+ */
+
+/**
+ * @file
+ * Datagrams with selective retransmission: arq://host:port, arq://:port
+ *
+ * The writing side numbers every datagram and keeps it for the latency
+ * window. The reading side returns datagrams in order, asks for missing
+ * ones with NACKs until they arrive or the window has passed, and
+ * acknowledges regularly so that the sender can measure the round trip
+ * time. A missing datagram delays the stream by at most the window, never
+ * longer, which bounds the end to end latency.
+ *
+ * Either side may leave out the host, it then binds the port and stays
+ * with the first peer whose datagrams make sense to it. One worker thread
+ * per context does all socket I/O.
+ *
+ * sim_loss and sim_delay drop and delay outgoing datagrams to try the
+ * recovery on loopback.
+ *
+ * Wire format, all fields big endian:
+ *   data: 0 flags seq(16) timestamp_us(32) sender_rtt_ms(16) 0(16) payload
+ *   nack: 1 n n * (seq(16) following_16_bitmask(16))
+ *   ack:  2 0 next_seq(16) echo_timestamp(32) echo_delay_us(32)
+ *         received(32) lost(32) 0(32)
+ */
+
+#include <pthread.h>
+
+#include "libbvutil/bvstring.h"
+#include "libbvutil/intreadwrite.h"
+#include "libbvutil/lfg.h"
+#include "libbvutil/network.h"
+#include "libbvutil/opt.h"
+#include "libbvutil/os_support.h"
+#include "libbvutil/parseutils.h"
+#include "libbvutil/random_seed.h"
+#include "libbvutil/time.h"
+
+#include "bvurl.h"
+
+#define ARQ_DATA                0
+#define ARQ_NACK                1
+#define ARQ_ACK                 2
+#define ARQ_FLAG_RETRANSMIT     1
+
+#define DATA_HEADER_SIZE        12
+#define ACK_SIZE                24
+#define MAX_NACK_ENTRIES        64
+#define RING_SIZE               2048        ///< datagrams kept, power of 2
+
+#define ACK_INTERVAL            20000
+#define KEEPALIVE_INTERVAL      250000
+#define MIN_NACK_INTERVAL       10000
+
+enum ARQSlotState {
+    SLOT_EMPTY,
+    SLOT_PRESENT,
+    SLOT_MISSING,
+};
+
+typedef struct ARQSlot {
+    uint16_t seq;
+    enum ARQSlotState state;
+    int len;                    ///< whole datagram when sending, payload when receiving
+    int64_t first;              ///< sent or found missing
+    int64_t last;               ///< last sent or asked for
+    uint8_t *data;
+} ARQSlot;
+
+typedef struct DelayedPacket {
+    struct DelayedPacket *next;
+    int64_t due;
+    int len;
+    uint8_t data[1];
+} DelayedPacket;
+
+typedef struct ARQContext {
+    const BVClass *class;
+    int latency;
+    int pkt_size;
+    int local_port;
+    int buffer_size;
+    int sim_loss;
+    int sim_delay;
+    int timeout;
+
+    int fd;
+    int is_sender;
+    int listen;                 ///< the peer is whoever talks to us first
+    struct sockaddr_storage peer;
+    socklen_t peer_len;
+    uint8_t *pkt;               ///< worker's receive and control buffer
+
+    ARQSlot *slots;
+    uint16_t seq;               ///< next to send
+    int started;
+    uint16_t next_seq;          ///< next to return to the reader
+    uint16_t highest;           ///< highest received
+    uint32_t echo_ts;
+    int64_t echo_time;
+    int64_t last_ack;
+    int got_data;               ///< data arrived since the last ack
+    int peer_rtt;
+    DelayedPacket *delayed, *delayed_tail;
+    BVLFG lfg;
+    BVURLTransportStats stats;
+
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int thread_started;
+    int abort_request;
+} ARQContext;
+
+#define OFFSET(x) offsetof(ARQContext, x)
+#define D BV_OPT_FLAG_DECODING_PARAM
+#define E BV_OPT_FLAG_ENCODING_PARAM
+static const BVOption arq_options[] = {
+    { "latency", "how long a lost datagram is retried, in milliseconds", OFFSET(latency), BV_OPT_TYPE_INT, { .i64 = 300 }, 20, 10000, D|E },
+    { "pkt_size", "largest datagram on the wire", OFFSET(pkt_size), BV_OPT_TYPE_INT, { .i64 = 1472 }, 64, 65507, D|E },
+    { "localport", "local port to bind when sending to a host", OFFSET(local_port), BV_OPT_TYPE_INT, { .i64 = 0 }, 0, 65535, D|E },
+    { "buffer_size", "socket buffer size in bytes", OFFSET(buffer_size), BV_OPT_TYPE_INT, { .i64 = 1 << 20 }, 0, INT_MAX, D|E },
+    { "sim_loss", "drop this many per mille of outgoing datagrams", OFFSET(sim_loss), BV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1000, D|E },
+    { "sim_delay", "delay outgoing datagrams by milliseconds", OFFSET(sim_delay), BV_OPT_TYPE_INT, { .i64 = 0 }, 0, 10000, D|E },
+    { "timeout", "set timeout (in microseconds) of blocking reads", OFFSET(timeout), BV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, D },
+    { NULL }
+};
+
+static const BVClass arq_class = {
+    .class_name = "arq",
+    .item_name  = bv_default_item_name,
+    .option     = arq_options,
+    .version    = LIBBVUTIL_VERSION_INT,
+};
+
+static inline int seq_diff(uint16_t a, uint16_t b)
+{
+    return (int16_t)(a - b);
+}
+
+static ARQSlot *get_slot(ARQContext *s, uint16_t seq, enum ARQSlotState state)
+{
+    ARQSlot *slot = &s->slots[seq & (RING_SIZE - 1)];
+    return slot->state == state && slot->seq == seq ? slot : NULL;
+}
+
+static void send_now(ARQContext *s, const uint8_t *buf, int len)
+{
+    sendto(s->fd, buf, len, 0, (struct sockaddr *)&s->peer, s->peer_len);
+}
+
+/**
+ * Send a datagram, through the loss and delay simulation if enabled.
+ * Called with the mutex held.
+ */
+static void send_packet(ARQContext *s, const uint8_t *buf, int len, int64_t now)
+{
+    DelayedPacket *d;
+
+    if (!s->peer_len)
+        return;
+    if (s->sim_loss && bv_lfg_get(&s->lfg) % 1000 < s->sim_loss)
+        return;
+    if (!s->sim_delay) {
+        send_now(s, buf, len);
+        return;
+    }
+    if (!(d = bv_malloc(sizeof(*d) + len)))
+        return;
+    d->next = NULL;
+    d->due  = now + s->sim_delay * 1000LL;
+    d->len  = len;
+    memcpy(d->data, buf, len);
+    if (s->delayed_tail)
+        s->delayed_tail->next = d;
+    else
+        s->delayed = d;
+    s->delayed_tail = d;
+}
+
+static void flush_delayed(ARQContext *s, int64_t now)
+{
+    DelayedPacket *d;
+
+    while ((d = s->delayed) && d->due <= now) {
+        send_now(s, d->data, d->len);
+        s->delayed = d->next;
+        if (!s->delayed)
+            s->delayed_tail = NULL;
+        bv_free(d);
+    }
+}
+
+static void handle_data(BVURLContext *h, const uint8_t *pkt, int len, int64_t now)
+{
+    ARQContext *s = h->priv_data;
+    uint16_t seq = BV_RB16(pkt + 2), q;
+    ARQSlot *slot;
+
+    len -= DATA_HEADER_SIZE;
+    if (len < 0 || len > s->pkt_size - DATA_HEADER_SIZE)
+        return;
+    if (!s->started) {
+        s->started  = 1;
+        s->next_seq = seq;
+        s->highest  = seq - 1;
+    } else if (seq_diff(seq, s->next_seq) >= RING_SIZE / 2) {
+        bv_log(h, BV_LOG_WARNING, "sequence jumped from %d to %d\n", s->next_seq, seq);
+        s->next_seq = seq;
+        s->highest  = seq - 1;
+    }
+    if (seq_diff(seq, s->next_seq) < 0)
+        return;
+    for (q = s->highest + 1; seq_diff(seq, q) > 0; q++) {
+        slot = &s->slots[q & (RING_SIZE - 1)];
+        slot->seq   = q;
+        slot->state = SLOT_MISSING;
+        slot->first = now;
+        slot->last  = 0;
+    }
+    if (seq_diff(seq, s->highest) > 0)
+        s->highest = seq;
+
+    slot = &s->slots[seq & (RING_SIZE - 1)];
+    if (slot->seq == seq && slot->state == SLOT_PRESENT)
+        return;
+    if (!slot->data && !(slot->data = bv_malloc(s->pkt_size)))
+        return;
+    memcpy(slot->data, pkt + DATA_HEADER_SIZE, len);
+    slot->seq   = seq;
+    slot->len   = len;
+    slot->state = SLOT_PRESENT;
+
+    s->stats.packets_received++;
+    if (pkt[1] & ARQ_FLAG_RETRANSMIT)
+        s->stats.packets_recovered++;
+    s->echo_ts   = BV_RB32(pkt + 4);
+    s->echo_time = now;
+    s->peer_rtt  = BV_RB16(pkt + 8) * 1000;
+    s->got_data  = 1;
+    pthread_cond_signal(&s->cond);
+}
+
+static void handle_nack(BVURLContext *h, const uint8_t *pkt, int len, int64_t now)
+{
+    ARQContext *s = h->priv_data;
+    int i, b, n = pkt[1];
+
+    if (len < 2 + 4 * n)
+        return;
+    s->stats.nacks_received++;
+    for (i = 0; i < n; i++) {
+        uint16_t seq  = BV_RB16(pkt + 2 + 4 * i);
+        unsigned mask = BV_RB16(pkt + 4 + 4 * i) << 1 | 1;
+
+        for (b = 0; b < 17; b++, seq++) {
+            ARQSlot *slot;
+            if (!(mask & (1 << b)) || !(slot = get_slot(s, seq, SLOT_PRESENT)))
+                continue;
+            /* too late to be of use, or already on its way */
+            if (now - slot->first > s->latency * 1000LL ||
+                now - slot->last < s->stats.rtt / 2)
+                continue;
+            slot->data[1] |= ARQ_FLAG_RETRANSMIT;
+            slot->last = now;
+            send_packet(s, slot->data, slot->len, now);
+            s->stats.packets_retransmitted++;
+        }
+    }
+}
+
+static void handle_ack(BVURLContext *h, const uint8_t *pkt, int len, int64_t now)
+{
+    ARQContext *s = h->priv_data;
+    uint32_t echo_ts = BV_RB32(pkt + 4);
+    uint32_t delay   = BV_RB32(pkt + 8);
+    int64_t rtt;
+
+    if (len < ACK_SIZE)
+        return;
+    s->stats.peer_received = BV_RB32(pkt + 12);
+    s->stats.peer_lost     = BV_RB32(pkt + 16);
+    if (!echo_ts)
+        return;
+    rtt = (int64_t)(uint32_t)((uint32_t)now - echo_ts) - delay;
+    if (rtt < 0 || rtt > 10000000)
+        return;
+    if (!s->stats.rtt) {
+        s->stats.rtt     = rtt;
+        s->stats.rtt_var = rtt / 2;
+    } else {
+        s->stats.rtt_var = (3 * s->stats.rtt_var + BBABS(s->stats.rtt - rtt)) / 4;
+        s->stats.rtt     = (7 * s->stats.rtt + rtt) / 8;
+    }
+}
+
+static void send_nacks(ARQContext *s, int64_t now)
+{
+    int interval = BBMAX(MIN_NACK_INTERVAL, s->peer_rtt + s->peer_rtt / 2);
+    int n = 0;
+    uint16_t q;
+
+    for (q = s->next_seq; seq_diff(s->highest, q) >= 0 && n < MAX_NACK_ENTRIES; q++) {
+        ARQSlot *slot = get_slot(s, q, SLOT_MISSING);
+        unsigned mask = 0;
+        uint16_t base = q;
+        int b;
+
+        if (!slot || now - slot->last < interval)
+            continue;
+        slot->last = now;
+        for (b = 0; b < 16 && seq_diff(s->highest, (uint16_t)(base + 1 + b)) >= 0; b++) {
+            ARQSlot *next = get_slot(s, base + 1 + b, SLOT_MISSING);
+            if (next && now - next->last >= interval) {
+                next->last = now;
+                mask |= 1 << b;
+            }
+        }
+        BV_WB16(s->pkt + 2 + 4 * n, base);
+        BV_WB16(s->pkt + 4 + 4 * n, mask);
+        n++;
+        q = base + 16;
+    }
+    if (!n)
+        return;
+    s->pkt[0] = ARQ_NACK;
+    s->pkt[1] = n;
+    send_packet(s, s->pkt, 2 + 4 * n, now);
+    s->stats.nacks_sent++;
+}
+
+static void send_ack(ARQContext *s, int64_t now)
+{
+    s->pkt[0] = ARQ_ACK;
+    s->pkt[1] = 0;
+    BV_WB16(s->pkt + 2, s->highest + 1);
+    BV_WB32(s->pkt + 4, s->echo_ts);
+    BV_WB32(s->pkt + 8, s->echo_ts ? now - s->echo_time : 0);
+    BV_WB32(s->pkt + 12, s->stats.packets_received);
+    BV_WB32(s->pkt + 16, s->stats.packets_lost);
+    BV_WB32(s->pkt + 20, 0);
+    send_packet(s, s->pkt, ACK_SIZE, now);
+    s->last_ack = now;
+    s->got_data = 0;
+}
+
+/**
+ * Give up on datagrams older than the window, ask for missing ones and
+ * acknowledge. Called with the mutex held.
+ */
+static void receiver_tick(BVURLContext *h, int64_t now)
+{
+    ARQContext *s = h->priv_data;
+    ARQSlot *slot;
+
+    while (s->started && seq_diff(s->highest, s->next_seq) >= 0 &&
+           (slot = get_slot(s, s->next_seq, SLOT_MISSING)) &&
+           now - slot->first >= s->latency * 1000LL) {
+        slot->state = SLOT_EMPTY;
+        s->next_seq++;
+        s->stats.packets_lost++;
+        pthread_cond_signal(&s->cond);
+    }
+    if (s->started)
+        send_nacks(s, now);
+    if ((s->got_data && now - s->last_ack >= ACK_INTERVAL) ||
+        now - s->last_ack >= KEEPALIVE_INTERVAL)
+        send_ack(s, now);
+}
+
+/**
+ * In listen mode the peer is taken from the first well formed datagram of
+ * the kind this side expects, everything from elsewhere is ignored after.
+ */
+static int accept_peer(BVURLContext *h, const uint8_t *pkt, int len,
+                       const struct sockaddr_storage *from, socklen_t from_len)
+{
+    ARQContext *s = h->priv_data;
+    char host[256] = "", port[16] = "";
+
+    if (s->peer_len)
+        return s->peer_len == from_len && !memcmp(&s->peer, from, from_len);
+    if (s->is_sender ? !((pkt[0] == ARQ_ACK && len >= ACK_SIZE) ||
+                         (pkt[0] == ARQ_NACK && len >= 2 + 4 * pkt[1]))
+                     : !(pkt[0] == ARQ_DATA && len >= DATA_HEADER_SIZE))
+        return 0;
+    memcpy(&s->peer, from, from_len);
+    s->peer_len = from_len;
+    getnameinfo((const struct sockaddr *)from, from_len, host, sizeof(host),
+                port, sizeof(port), NI_NUMERICHOST | NI_NUMERICSERV);
+    bv_log(h, BV_LOG_VERBOSE, "peer is %s:%s\n", host, port);
+    return 1;
+}
+
+static void *arq_task(void *arg)
+{
+    BVURLContext *h = arg;
+    ARQContext *s = h->priv_data;
+    struct pollfd p = { s->fd, POLLIN, 0 };
+    struct sockaddr_storage from;
+    socklen_t from_len;
+    int64_t now, wait;
+    int len;
+
+    pthread_mutex_lock(&s->mutex);
+    while (!s->abort_request) {
+        now = bv_gettime_relative();
+        flush_delayed(s, now);
+        if (!s->is_sender)
+            receiver_tick(h, now);
+        wait = s->is_sender ? 50000 : MIN_NACK_INTERVAL;
+        if (s->delayed)
+            wait = BBMIN(wait, s->delayed->due - now);
+        pthread_mutex_unlock(&s->mutex);
+
+        poll(&p, 1, BBMAX(wait, 1000) / 1000);
+
+        pthread_mutex_lock(&s->mutex);
+        now = bv_gettime_relative();
+        for (;;) {
+            from_len = sizeof(from);
+            len = recvfrom(s->fd, s->pkt, s->pkt_size, 0, (struct sockaddr *)&from, &from_len);
+            if (len < 4)
+                break;
+            if (s->listen && !accept_peer(h, s->pkt, len, &from, from_len))
+                continue;
+            if (s->pkt[0] == ARQ_DATA && !s->is_sender)
+                handle_data(h, s->pkt, len, now);
+            else if (s->pkt[0] == ARQ_NACK && s->is_sender)
+                handle_nack(h, s->pkt, len, now);
+            else if (s->pkt[0] == ARQ_ACK && s->is_sender)
+                handle_ack(h, s->pkt, len, now);
+        }
+    }
+    pthread_mutex_unlock(&s->mutex);
+    return NULL;
+}
+
+static struct addrinfo *arq_resolve_host(BVURLContext *h, const char *hostname, int port, int flags)
+{
+    struct addrinfo hints = { 0 }, *res = NULL;
+    char sport[16];
+    int error;
+
+    snprintf(sport, sizeof(sport), "%d", port);
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_flags    = flags;
+    if ((error = getaddrinfo(hostname, sport, &hints, &res))) {
+        bv_log(h, BV_LOG_ERROR, "Failed to resolve %s: %s\n",
+               hostname ? hostname : "", gai_strerror(error));
+        return NULL;
+    }
+    return res;
+}
+
+static int arq_open(BVURLContext *h, const char *uri, int flags, BVDictionary **options)
+{
+    ARQContext *s = h->priv_data;
+    struct addrinfo *ai = NULL, *local = NULL;
+    const BVOption *o;
+    char hostname[1024], buf[256];
+    const char *p;
+    int port, ret;
+
+    s->fd = -1;
+    if ((flags & BV_IO_FLAG_READ) && (flags & BV_IO_FLAG_WRITE)) {
+        bv_log(h, BV_LOG_ERROR, "arq either sends or receives\n");
+        return BVERROR(EINVAL);
+    }
+    s->is_sender = !!(flags & BV_IO_FLAG_WRITE);
+
+    /* the query string sets the same options as the dictionary */
+    p = strchr(uri, '?');
+    for (o = arq_options; p && o->name; o++) {
+        if (bv_find_info_tag(buf, sizeof(buf), o->name, p) &&
+            (ret = bv_opt_set(s, o->name, buf, 0)) < 0) {
+            bv_log(h, BV_LOG_ERROR, "Invalid %s '%s'\n", o->name, buf);
+            return ret;
+        }
+    }
+    if (s->pkt_size <= ACK_SIZE + 4 * MAX_NACK_ENTRIES) {
+        bv_log(h, BV_LOG_ERROR, "pkt_size %d too small\n", s->pkt_size);
+        return BVERROR(EINVAL);
+    }
+
+    bv_url_split(NULL, 0, NULL, 0, hostname, sizeof(hostname), &port, NULL, 0, uri);
+    if (port <= 0) {
+        bv_log(h, BV_LOG_ERROR, "Port missing in uri\n");
+        return BVERROR(EINVAL);
+    }
+    s->listen = !hostname[0];
+    if (s->listen) {
+        if (!(local = arq_resolve_host(h, NULL, port, AI_PASSIVE)))
+            return BVERROR(EIO);
+    } else {
+        if (!(ai = arq_resolve_host(h, hostname, port, 0)))
+            return BVERROR(EIO);
+        memcpy(&s->peer, ai->ai_addr, ai->ai_addrlen);
+        s->peer_len = ai->ai_addrlen;
+        if (s->local_port &&
+            !(local = arq_resolve_host(h, ai->ai_family == AF_INET6 ? "::" : "0.0.0.0",
+                                       s->local_port, AI_PASSIVE))) {
+            ret = BVERROR(EIO);
+            goto fail;
+        }
+    }
+
+    s->fd = bv_socket(local ? local->ai_family : ai->ai_family, SOCK_DGRAM, 0);
+    if (s->fd < 0) {
+        ret = bv_neterrno();
+        goto fail;
+    }
+    if (local && bind(s->fd, local->ai_addr, local->ai_addrlen) < 0) {
+        ret = bv_neterrno();
+        bv_log(h, BV_LOG_ERROR, "bind to port %d failed\n", s->listen ? port : s->local_port);
+        goto fail;
+    }
+    if (s->buffer_size) {
+        setsockopt(s->fd, SOL_SOCKET, SO_RCVBUF, &s->buffer_size, sizeof(s->buffer_size));
+        setsockopt(s->fd, SOL_SOCKET, SO_SNDBUF, &s->buffer_size, sizeof(s->buffer_size));
+    }
+    bv_socket_nonblock(s->fd, 1);
+
+    s->slots = bv_mallocz_array(RING_SIZE, sizeof(*s->slots));
+    s->pkt   = bv_malloc(s->pkt_size);
+    if (!s->slots || !s->pkt) {
+        ret = BVERROR(ENOMEM);
+        goto fail;
+    }
+    bv_lfg_init(&s->lfg, bv_get_random_seed());
+
+    pthread_mutex_init(&s->mutex, NULL);
+    pthread_cond_init(&s->cond, NULL);
+    if ((ret = pthread_create(&s->thread, NULL, arq_task, h))) {
+        ret = BVERROR(ret);
+        pthread_cond_destroy(&s->cond);
+        pthread_mutex_destroy(&s->mutex);
+        goto fail;
+    }
+    s->thread_started = 1;
+
+    h->is_streamed     = 1;
+    h->max_packet_size = s->pkt_size - DATA_HEADER_SIZE;
+    h->rw_timeout      = s->timeout;
+    if (ai)
+        freeaddrinfo(ai);
+    if (local)
+        freeaddrinfo(local);
+    return 0;
+
+fail:
+    if (s->fd >= 0)
+        closesocket(s->fd);
+    bv_freep(&s->slots);
+    bv_freep(&s->pkt);
+    if (ai)
+        freeaddrinfo(ai);
+    if (local)
+        freeaddrinfo(local);
+    return ret;
+}
+
+static int arq_read(BVURLContext *h, uint8_t *buf, size_t size)
+{
+    ARQContext *s = h->priv_data;
+    int64_t deadline = h->rw_timeout > 0 ? bv_gettime() + h->rw_timeout : 0, t;
+    struct timespec tv;
+    ARQSlot *slot;
+    int len, ret;
+
+    pthread_mutex_lock(&s->mutex);
+    for (;;) {
+        if (s->started && seq_diff(s->highest, s->next_seq) >= 0 &&
+            (slot = get_slot(s, s->next_seq, SLOT_PRESENT))) {
+            len = slot->len;
+            if (len > size) {
+                bv_log(h, BV_LOG_WARNING, "Part of datagram lost due to insufficient buffer size\n");
+                len = size;
+            }
+            memcpy(buf, slot->data, len);
+            slot->state = SLOT_EMPTY;
+            s->next_seq++;
+            pthread_mutex_unlock(&s->mutex);
+            return len;
+        }
+        if (h->flags & BV_IO_FLAG_NONBLOCK) {
+            ret = BVERROR(EAGAIN);
+            break;
+        }
+        if (bv_check_interrupt(&h->interrupt_callback)) {
+            ret = BVERROR_EXIT;
+            break;
+        }
+        t = bv_gettime() + 100000;
+        if (deadline && t >= deadline) {
+            if (bv_gettime() >= deadline) {
+                ret = BVERROR(ETIMEDOUT);
+                break;
+            }
+            t = deadline;
+        }
+        tv.tv_sec  = t / 1000000;
+        tv.tv_nsec = (t % 1000000) * 1000;
+        pthread_cond_timedwait(&s->cond, &s->mutex, &tv);
+    }
+    pthread_mutex_unlock(&s->mutex);
+    return ret;
+}
+
+static int arq_write(BVURLContext *h, const uint8_t *buf, size_t size)
+{
+    ARQContext *s = h->priv_data;
+    int64_t now = bv_gettime_relative();
+    ARQSlot *slot;
+
+    pthread_mutex_lock(&s->mutex);
+    slot = &s->slots[s->seq & (RING_SIZE - 1)];
+    if (!slot->data && !(slot->data = bv_malloc(s->pkt_size))) {
+        pthread_mutex_unlock(&s->mutex);
+        return BVERROR(ENOMEM);
+    }
+    slot->data[0] = ARQ_DATA;
+    slot->data[1] = 0;
+    BV_WB16(slot->data + 2, s->seq);
+    BV_WB32(slot->data + 4, now);
+    BV_WB16(slot->data + 8, BBMIN(s->stats.rtt / 1000, 65535));
+    BV_WB16(slot->data + 10, 0);
+    memcpy(slot->data + DATA_HEADER_SIZE, buf, size);
+    slot->seq   = s->seq;
+    slot->len   = DATA_HEADER_SIZE + size;
+    slot->state = SLOT_PRESENT;
+    slot->first = slot->last = now;
+    send_packet(s, slot->data, slot->len, now);
+    s->seq++;
+    s->stats.packets_sent++;
+    s->stats.bytes_sent += size;
+    pthread_mutex_unlock(&s->mutex);
+    return size;
+}
+
+static int arq_control(BVURLContext *h, int type, BVControlPacket *pkt_in, BVControlPacket *pkt_out)
+{
+    ARQContext *s = h->priv_data;
+
+    if (type != BV_URL_MESSAGE_TYPE_GET_STATS || !pkt_out || !pkt_out->data)
+        return BVERROR(ENOSYS);
+    pthread_mutex_lock(&s->mutex);
+    memcpy(pkt_out->data, &s->stats, sizeof(s->stats));
+    pthread_mutex_unlock(&s->mutex);
+    pkt_out->size = sizeof(s->stats);
+    return 0;
+}
+
+static int arq_get_file_handle(BVURLContext *h)
+{
+    ARQContext *s = h->priv_data;
+    return s->fd;
+}
+
+static int arq_close(BVURLContext *h)
+{
+    ARQContext *s = h->priv_data;
+    int i;
+
+    if (s->thread_started) {
+        pthread_mutex_lock(&s->mutex);
+        s->abort_request = 1;
+        pthread_mutex_unlock(&s->mutex);
+        pthread_join(s->thread, NULL);
+        pthread_cond_destroy(&s->cond);
+        pthread_mutex_destroy(&s->mutex);
+    }
+    bv_log(h, BV_LOG_DEBUG, "Statistics, sent:%"PRId64" retransmitted:%"PRId64
+           " received:%"PRId64" recovered:%"PRId64" lost:%"PRId64" rtt:%dus\n",
+           s->stats.packets_sent, s->stats.packets_retransmitted, s->stats.packets_received,
+           s->stats.packets_recovered, s->stats.packets_lost, s->stats.rtt);
+    while (s->delayed) {
+        DelayedPacket *d = s->delayed;
+        s->delayed = d->next;
+        bv_free(d);
+    }
+    for (i = 0; i < RING_SIZE; i++)
+        bv_freep(&s->slots[i].data);
+    bv_freep(&s->slots);
+    bv_freep(&s->pkt);
+    closesocket(s->fd);
+    return 0;
+}
+
+BVURLProtocol bv_arq_protocol = {
+    .name                = "arq",
+    .url_open            = arq_open,
+    .url_read            = arq_read,
+    .url_write           = arq_write,
+    .url_control         = arq_control,
+    .url_get_file_handle = arq_get_file_handle,
+    .url_close           = arq_close,
+    .priv_data_size      = sizeof(ARQContext),
+    .priv_class          = &arq_class,
+    .flags               = BV_URL_PROTOCOL_FLAG_NETWORK,
+};
+
+#ifdef TEST
+#include <stdio.h>
+
+#define TEST_COUNT 300
+
+static int test_len(int i)
+{
+    return 16 + i * 53 % 1000;
+}
+
+static void test_fill(uint8_t *buf, int i, int tag)
+{
+    int j;
+    for (j = 0; j < test_len(i); j++)
+        buf[j] = i * 7 + j + tag;
+}
+
+int main(void)
+{
+    BVURLContext *rx = NULL, *tx = NULL, *stray = NULL;
+    uint8_t buf[2048], ref[2048];
+    char url[256];
+    int port = 20000 + getpid() % 20000;
+    int i, len, rcvbuf = 0, err = 1;
+    socklen_t optlen = sizeof(rcvbuf);
+    int64_t t;
+
+    bv_protocol_register_all();
+    bv_network_init();
+
+    snprintf(url, sizeof(url), "arq://:%d?latency=500&timeout=300000&buffer_size=65536", port);
+    if (bv_url_open(&rx, url, BV_IO_FLAG_READ, NULL, NULL) < 0) {
+        printf("open receiver failed\n");
+        goto end;
+    }
+    getsockopt(bv_url_get_file_handle(rx), SOL_SOCKET, SO_RCVBUF, &rcvbuf, &optlen);
+    if (rcvbuf > 2 * 65536) {
+        printf("buffer_size from the url ignored, rcvbuf %d\n", rcvbuf);
+        goto end;
+    }
+
+    /* nothing sent yet, a blocking read waits for the timeout */
+    t = bv_gettime_relative();
+    len = bv_url_read(rx, buf, sizeof(buf));
+    t = bv_gettime_relative() - t;
+    if (len >= 0 || t < 250000) {
+        printf("empty read returned %d after %"PRId64"us\n", len, t);
+        goto end;
+    }
+
+    snprintf(url, sizeof(url), "arq://127.0.0.1:%d?sim_delay=5", port);
+    if (bv_url_open(&tx, url, BV_IO_FLAG_WRITE, NULL, NULL) < 0) {
+        printf("open sender failed\n");
+        goto end;
+    }
+    /* the receiver starts with the first datagram it sees, lose none before */
+    test_fill(buf, 0, 0);
+    bv_url_write(tx, buf, test_len(0));
+    bv_usleep(50000);
+    bv_opt_set(tx->priv_data, "sim_loss", "100", 0);
+
+    /* a second sender must not take over the receiver */
+    snprintf(url, sizeof(url), "arq://127.0.0.1:%d", port);
+    if (bv_url_open(&stray, url, BV_IO_FLAG_WRITE, NULL, NULL) < 0) {
+        printf("open stray sender failed\n");
+        goto end;
+    }
+    /* a few more than read, a loss at the very end is never noticed */
+    for (i = 1; i < TEST_COUNT + 16; i++) {
+        test_fill(buf, i, 0);
+        bv_url_write(tx, buf, test_len(i));
+        test_fill(buf, i, 1);
+        bv_url_write(stray, buf, test_len(i));
+        if (!(i % 16))
+            bv_usleep(2000);
+    }
+
+    for (i = 0; i < TEST_COUNT; i++) {
+        if ((len = bv_url_read(rx, buf, sizeof(buf))) < 0) {
+            printf("read %d failed: %d\n", i, len);
+            goto end;
+        }
+        test_fill(ref, i, 0);
+        if (len != test_len(i) || memcmp(buf, ref, len)) {
+            printf("datagram %d wrong\n", i);
+            goto end;
+        }
+    }
+    err = 0;
+end:
+    bv_url_closep(&stray);
+    bv_url_closep(&tx);
+    bv_url_closep(&rx);
+    printf("%s\n", err ? "FAIL" : "OK");
+    return err;
+}
+#endif /* TEST */
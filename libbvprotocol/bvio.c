@@ -22,6 +22,15 @@
  */
 
 #include <libbvutil/bvassert.h>
+#include <libbvutil/intreadwrite.h>
+#include <libbvutil/fifo.h>
+#include <libbvutil/network.h>
+#include <libbvutil/opt.h>
+#include <libbvutil/time.h>
+
+#if BV_HAVE_PTHREADS
+#include <pthread.h>
+#endif
 
 #include "bvio.h"
 #include "bvurl.h"
@@ -30,6 +39,28 @@
 
 #define SHORT_SEEK_THRESHOLD 4096
 
+#define READAHEAD_DEFAULT_SIZE (4 << 20)  //4M when only a time limit is given
+
+/**
+ * bv_io_alloc_context() hands out this, state the users of BVIOContext
+ * do not need to see goes here.
+ */
+typedef struct BVIOInternal {
+    BVIOContext pub;
+    int nominal_size;       ///< what the buffer shrinks back to after growing for a peek
+    int auto_min_size;      ///< see bv_io_set_auto_buffer_size()
+    int auto_max_size;
+    int auto_syscalls;      ///< target io_read/io_write calls per second, 0 disables
+    int64_t auto_start;
+    int64_t auto_bytes;
+    uint32_t auto_calls;
+} BVIOInternal;
+
+static inline BVIOInternal *io_internal(BVIOContext *s)
+{
+    return (BVIOInternal *)s;
+}
+
 static void *io_url_child_next(void *obj, void *prev)
 {
     BVIOContext *s = obj;
@@ -108,11 +139,12 @@ BVIOContext * bv_io_alloc_context(uint8_t *buffer, int buffer_size, int write_fl
         int (*control)(void *opaque, int type, BVControlPacket *pkt_in, BVControlPacket *pkt_out)
         )
 {
-    BVIOContext *s = bv_mallocz(sizeof(BVIOContext));
-    if (!s)
+    BVIOInternal *ctx = bv_mallocz(sizeof(BVIOInternal));
+    if (!ctx)
         return NULL;
-    bv_io_init_context(s, buffer, buffer_size, write_flag, opaque, read, write, seek, control);
-    return s;
+    bv_io_init_context(&ctx->pub, buffer, buffer_size, write_flag, opaque, read, write, seek, control);
+    ctx->nominal_size = buffer_size;
+    return &ctx->pub;
 }
 
 static int bv_io_fdopen(BVIOContext **s, BVURLContext *h)
@@ -143,10 +175,375 @@ static int bv_io_fdopen(BVIOContext **s, BVURLContext *h)
     return 0;
 }
 
+#if BV_HAVE_PTHREADS
+/**
+ * Read-ahead state. Every operation on the underlying BVURLContext runs
+ * on the worker thread, the consumer only touches the fifo, so protocols
+ * never see concurrent calls.
+ */
+typedef struct BVIOReadAhead {
+    BVURLContext *h;
+    BVIOInterruptCB int_cb;     ///< caller's interrupt callback
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    BVFifoBuffer *fifo;         ///< records of [size:32][data]
+    uint8_t *buf;
+    int record_left;            ///< bytes left of the record at the fifo head
+    int block_size;
+    int capacity;
+    int64_t max_delay;          ///< read-ahead bound in microseconds, 0 for bytes only
+    int64_t rate_start;
+    int64_t rate_bytes;
+    int64_t byte_rate;          ///< consumer throughput, bytes per second
+    int abort_request;
+    int eof;
+    int error;
+    int seek_request;
+    int64_t seek_offset;
+    int seek_whence;
+    int64_t seek_result;
+    int control_request;
+    int control_type;
+    BVControlPacket *control_in;
+    BVControlPacket *control_out;
+    int control_result;
+    int serving;                ///< the worker is running a seek or a control
+} BVIOReadAhead;
+
+/**
+ * Also breaks a worker read when a seek or a control waits for it, a
+ * read interrupted this way returns before taking any data.
+ */
+static int readahead_interrupt(void *opaque)
+{
+    BVIOReadAhead *ra = opaque;
+    return ra->abort_request ||
+           (!ra->serving && (ra->seek_request || ra->control_request)) ||
+           bv_check_interrupt(&ra->int_cb);
+}
+
+/**
+ * Nothing to read yet on a nonblocking protocol, wait on its fd, or for
+ * a request from the consumer when there is no fd. Called locked.
+ */
+static void readahead_wait(BVIOReadAhead *ra)
+{
+    int fd = bv_url_get_file_handle(ra->h);
+    if (fd >= 0) {
+        pthread_mutex_unlock(&ra->mutex);
+        bv_network_wait_fd(fd, 0);
+        pthread_mutex_lock(&ra->mutex);
+    } else {
+        int64_t t = bv_gettime() + 10000;
+        struct timespec tv = { .tv_sec  =  t / 1000000,
+                               .tv_nsec = (t % 1000000) * 1000 };
+        pthread_cond_timedwait(&ra->cond, &ra->mutex, &tv);
+    }
+}
+
+static int readahead_limit(BVIOReadAhead *ra)
+{
+    int64_t limit;
+    if (!ra->max_delay || !ra->byte_rate)
+        return ra->capacity;
+    limit = ra->byte_rate * ra->max_delay / 1000000;
+    return bv_clip64(limit, ra->block_size, ra->capacity);
+}
+
+static void *readahead_task(void *opaque)
+{
+    BVIOReadAhead *ra = opaque;
+    uint8_t *buf = ra->buf;
+    int len, ret;
+
+    pthread_mutex_lock(&ra->mutex);
+    while (!ra->abort_request) {
+        if (ra->seek_request) {
+            int64_t offset = ra->seek_offset;
+            int whence = ra->seek_whence;
+            int64_t res;
+            ra->serving = 1;
+            pthread_mutex_unlock(&ra->mutex);
+            res = bv_url_seek(ra->h, offset, whence);
+            pthread_mutex_lock(&ra->mutex);
+            ra->serving = 0;
+            if (whence != BV_SEEK_SIZE && res >= 0) {
+                bv_fifo_reset(ra->fifo);
+                ra->record_left = 0;
+                ra->eof = ra->error = 0;
+            }
+            ra->seek_result = res;
+            ra->seek_request = 0;
+            pthread_cond_broadcast(&ra->cond);
+            continue;
+        }
+        if (ra->control_request) {
+            ra->serving = 1;
+            pthread_mutex_unlock(&ra->mutex);
+            ret = bv_url_control(ra->h, ra->control_type, ra->control_in, ra->control_out);
+            pthread_mutex_lock(&ra->mutex);
+            ra->serving = 0;
+            ra->control_result = ret;
+            ra->control_request = 0;
+            pthread_cond_broadcast(&ra->cond);
+            continue;
+        }
+        if (ra->eof || ra->error ||
+            bv_fifo_size(ra->fifo) >= readahead_limit(ra) ||
+            bv_fifo_space(ra->fifo) < ra->block_size + 4) {
+            pthread_cond_wait(&ra->cond, &ra->mutex);
+            continue;
+        }
+        pthread_mutex_unlock(&ra->mutex);
+        len = bv_url_read(ra->h, buf, ra->block_size);
+        pthread_mutex_lock(&ra->mutex);
+        /* data read before a seek request belongs to the old position */
+        if (ra->seek_request || ra->abort_request)
+            continue;
+        if (len == BVERROR_EXIT && ra->control_request)
+            continue;
+        if (len > 0) {
+            uint8_t hdr[4];
+            BV_WL32(hdr, len);
+            bv_fifo_generic_write(ra->fifo, hdr, 4, NULL);
+            bv_fifo_generic_write(ra->fifo, buf, len, NULL);
+        } else if (len == 0 || len == BVERROR_EOF) {
+            ra->eof = 1;
+        } else if (len == BVERROR(EAGAIN)) {
+            readahead_wait(ra);
+            continue;
+        } else {
+            ra->error = len;
+        }
+        pthread_cond_broadcast(&ra->cond);
+    }
+    pthread_mutex_unlock(&ra->mutex);
+    return NULL;
+}
+
+static int readahead_read(void *opaque, uint8_t *buf, size_t size)
+{
+    BVIOReadAhead *ra = opaque;
+    int64_t now;
+    int ret = 0;
+
+    pthread_mutex_lock(&ra->mutex);
+    while (!bv_fifo_size(ra->fifo)) {
+        if (ra->error || ra->eof) {
+            ret = ra->error;
+            break;
+        }
+        if (bv_check_interrupt(&ra->int_cb)) {
+            ret = BVERROR_EXIT;
+            break;
+        } else {
+            int64_t t = bv_gettime() + 100000;
+            struct timespec tv = { .tv_sec  =  t / 1000000,
+                                   .tv_nsec = (t % 1000000) * 1000 };
+            pthread_cond_timedwait(&ra->cond, &ra->mutex, &tv);
+        }
+    }
+    if (bv_fifo_size(ra->fifo)) {
+        if (!ra->record_left) {
+            uint8_t hdr[4];
+            bv_fifo_generic_read(ra->fifo, hdr, 4, NULL);
+            ra->record_left = BV_RL32(hdr);
+        }
+        ret = BBMIN(ra->record_left, size);
+        bv_fifo_generic_read(ra->fifo, buf, ret, NULL);
+        ra->record_left -= ret;
+        /* datagrams are never split across reads */
+        if (ra->h->max_packet_size && ra->record_left) {
+            bv_fifo_drain(ra->fifo, ra->record_left);
+            ra->record_left = 0;
+        }
+        pthread_cond_signal(&ra->cond);
+
+        now = bv_gettime_relative();
+        if (!ra->rate_start)
+            ra->rate_start = now;
+        ra->rate_bytes += ret;
+        if (now - ra->rate_start >= 1000000) {
+            int64_t rate = ra->rate_bytes * 1000000 / (now - ra->rate_start);
+            ra->byte_rate = ra->byte_rate ? (ra->byte_rate * 3 + rate) / 4 : rate;
+            ra->rate_start = now;
+            ra->rate_bytes = 0;
+        }
+    }
+    pthread_mutex_unlock(&ra->mutex);
+    return ret;
+}
+
+static int64_t readahead_seek(void *opaque, int64_t offset, int whence)
+{
+    BVIOReadAhead *ra = opaque;
+    int64_t ret;
+
+    pthread_mutex_lock(&ra->mutex);
+    ra->seek_offset = offset;
+    ra->seek_whence = whence;
+    ra->seek_request = 1;
+    pthread_cond_broadcast(&ra->cond);
+    while (ra->seek_request)
+        pthread_cond_wait(&ra->cond, &ra->mutex);
+    ret = ra->seek_result;
+    pthread_mutex_unlock(&ra->mutex);
+    return ret;
+}
+
+static int readahead_control(void *opaque, int type, BVControlPacket *pkt_in, BVControlPacket *pkt_out)
+{
+    BVIOReadAhead *ra = opaque;
+    int ret;
+
+    pthread_mutex_lock(&ra->mutex);
+    while (ra->control_request)
+        pthread_cond_wait(&ra->cond, &ra->mutex);
+    ra->control_type = type;
+    ra->control_in = pkt_in;
+    ra->control_out = pkt_out;
+    ra->control_request = 1;
+    pthread_cond_broadcast(&ra->cond);
+    while (ra->control_request)
+        pthread_cond_wait(&ra->cond, &ra->mutex);
+    ret = ra->control_result;
+    pthread_mutex_unlock(&ra->mutex);
+    return ret;
+}
+
+static void readahead_free(BVIOReadAhead **rap)
+{
+    BVIOReadAhead *ra = *rap;
+    if (!ra)
+        return;
+    bv_fifo_freep(&ra->fifo);
+    bv_freep(&ra->buf);
+    pthread_cond_destroy(&ra->cond);
+    pthread_mutex_destroy(&ra->mutex);
+    bv_freep(rap);
+}
+
+static BVIOReadAhead *readahead_alloc(int64_t size, int64_t max_delay, const BVIOInterruptCB *int_cb)
+{
+    BVIOReadAhead *ra = bv_mallocz(sizeof(BVIOReadAhead));
+    if (!ra)
+        return NULL;
+    if (int_cb)
+        ra->int_cb = *int_cb;
+    ra->capacity = size > 0 ? BBMIN(size, INT_MAX / 2) : READAHEAD_DEFAULT_SIZE;
+    ra->max_delay = max_delay;
+    pthread_mutex_init(&ra->mutex, NULL);
+    pthread_cond_init(&ra->cond, NULL);
+    return ra;
+}
+
+static int readahead_start(BVIOContext *s, BVIOReadAhead *ra, BVURLContext *h)
+{
+    int ret;
+    ra->h = h;
+    ra->block_size = h->max_packet_size ? h->max_packet_size : BV_IO_BUFFER_SIZE;
+    ra->capacity = BBMAX(ra->capacity, 2 * (ra->block_size + 4));
+    ra->fifo = bv_fifo_alloc(ra->capacity);
+    ra->buf = bv_malloc(ra->block_size);
+    if (!ra->fifo || !ra->buf)
+        return BVERROR(ENOMEM);
+    ret = pthread_create(&ra->thread, NULL, readahead_task, ra);
+    if (ret) {
+        bv_log(s, BV_LOG_ERROR, "pthread_create failed : %s\n", strerror(ret));
+        return BVERROR(ret);
+    }
+    s->opaque = ra;
+    s->io_read = readahead_read;
+    s->io_seek = h->is_streamed ? NULL : readahead_seek;
+    s->io_control = readahead_control;
+    s->readahead = ra;
+    return 0;
+}
+
+static void readahead_stop(BVIOReadAhead *ra)
+{
+    pthread_mutex_lock(&ra->mutex);
+    ra->abort_request = 1;
+    pthread_cond_broadcast(&ra->cond);
+    pthread_mutex_unlock(&ra->mutex);
+    pthread_join(ra->thread, NULL);
+}
+#endif /* BV_HAVE_PTHREADS */
+
+/**
+ * Options handled by bv_io_open() itself, the others go to the protocol.
+ */
+typedef struct BVIOOpenOptions {
+    const BVClass *bv_class;
+    int64_t readahead_size;
+    int64_t readahead_time;
+    int auto_buffer_syscalls;
+    int auto_buffer_max;
+} BVIOOpenOptions;
+
+#define OFFSET(x) offsetof(BVIOOpenOptions, x)
+#define D BV_OPT_FLAG_DECODING_PARAM
+#define E BV_OPT_FLAG_ENCODING_PARAM
+static const BVOption io_open_options[] = {
+    { "readahead_size", "read-ahead buffer in bytes", OFFSET(readahead_size), BV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, D },
+    { "readahead_time", "read-ahead bound in microseconds", OFFSET(readahead_time), BV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, D },
+    { "auto_buffer_syscalls", "size the buffer for this many reads/writes per second, 0 for a fixed buffer", OFFSET(auto_buffer_syscalls), BV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, D|E },
+    { "auto_buffer_max", "largest buffer auto sizing may use", OFFSET(auto_buffer_max), BV_OPT_TYPE_INT, { .i64 = 1 << 20 }, BV_IO_BUFFER_SIZE, INT_MAX, D|E },
+    { NULL },
+};
+#undef E
+#undef D
+#undef OFFSET
+
+static const BVClass io_open_class = {
+    .class_name = "BVIOOpen",
+    .item_name  = bv_default_item_name,
+    .option     = io_open_options,
+    .version    = LIBBVUTIL_VERSION_INT,
+};
+
 int bv_io_open(BVIOContext **s, const char *filename, int flags, const BVIOInterruptCB *int_cb, BVDictionary **options)
 {
     BVURLContext *h = NULL;
+    BVIOOpenOptions opts = { &io_open_class };
+    int64_t readahead_size, readahead_time;
     int ret;
+
+    bv_opt_set_defaults(&opts);
+    if ((ret = bv_opt_set_dict(&opts, options)) < 0)
+        return ret;
+    readahead_size = opts.readahead_size;
+    readahead_time = opts.readahead_time;
+
+    if ((readahead_size > 0 || readahead_time > 0) &&
+        !(flags & (BV_IO_FLAG_WRITE | BV_IO_FLAG_NONBLOCK))) {
+#if BV_HAVE_PTHREADS
+        BVIOInterruptCB cb;
+        BVIOReadAhead *ra = readahead_alloc(readahead_size, readahead_time, int_cb);
+        if (!ra)
+            return BVERROR(ENOMEM);
+        /* nested protocols copy the callback at open time, so wrap it now */
+        cb.callback = readahead_interrupt;
+        cb.opaque = ra;
+        ret = bv_url_open(&h, filename, flags, &cb, options);
+        if (ret >= 0)
+            ret = bv_io_fdopen(s, h);
+        if (ret >= 0 && (ret = readahead_start(*s, ra, h)) < 0) {
+            bv_freep(&(*s)->buffer);
+            bv_freep(s);
+        }
+        if (ret < 0) {
+            readahead_free(&ra);
+            bv_url_close(h);
+            return ret;
+        }
+        goto opened;
+#else
+        bv_log(NULL, BV_LOG_WARNING, "read-ahead requires thread support, ignored\n");
+#endif
+    }
+
     ret = bv_url_open(&h, filename, flags, int_cb, options);
     if (ret < 0)
         return ret;
@@ -155,7 +552,77 @@ int bv_io_open(BVIOContext **s, const char *filename, int flags, const BVIOInter
         bv_url_close(h);
         return ret;
     }
-    return ret;
+#if BV_HAVE_PTHREADS
+opened:
+#endif
+    /* a failure only leaves the buffer fixed, it was already logged */
+    if (opts.auto_buffer_syscalls)
+        bv_io_set_auto_buffer_size(*s, (*s)->buffer_size, opts.auto_buffer_max, opts.auto_buffer_syscalls);
+    return 0;
+}
+
+/**
+ * Replace the buffer, dropping what it holds, orig_buffer_size is kept.
+ */
+static int io_resize_buffer(BVIOContext *s, int buf_size)
+{
+    uint8_t *buffer;
+    buffer = bv_malloc(buf_size);
+    if (!buffer)
+        return BVERROR(ENOMEM);
+    bv_free(s->buffer);
+    s->buffer = buffer;
+    s->buffer_size = buf_size;
+    s->buffer_ptr = buffer;
+    s->checksum_ptr = buffer;
+    io_reset_buf(s, s->write_flag ? BV_IO_FLAG_WRITE: BV_IO_FLAG_READ);
+    return 0;
+}
+
+/**
+ * Resize the (empty) buffer so that the observed throughput needs about
+ * auto_syscalls io_read/io_write calls per second. Only called where no
+ * buffered data would be lost.
+ */
+static void io_auto_tune(BVIOContext *s)
+{
+    BVIOInternal *ctx = io_internal(s);
+    int64_t now, elapsed, rate;
+    int size;
+
+    now = bv_gettime_relative();
+    if (!ctx->auto_start) {
+        ctx->auto_start = now;
+        return;
+    }
+    elapsed = now - ctx->auto_start;
+    if (elapsed < 1000000)
+        return;
+
+    rate = ctx->auto_bytes * 1000000 / elapsed;
+    bv_log(s, BV_LOG_DEBUG, "%"PRId64" bytes/s in %"PRId64" calls/s\n",
+           rate, (int64_t)ctx->auto_calls * 1000000 / elapsed);
+    ctx->auto_start = now;
+    ctx->auto_bytes = 0;
+    ctx->auto_calls = 0;
+
+    size = ctx->auto_min_size;
+    while (size < ctx->auto_max_size && size < rate / ctx->auto_syscalls)
+        size <<= 1;
+    size = BBMIN(size, ctx->auto_max_size);
+    if (size < 2 * s->buffer_size && 2 * size > s->buffer_size)
+        return;
+
+    bv_log(s, BV_LOG_DEBUG, "resizing buffer %d -> %d\n", s->buffer_size, size);
+    if (io_resize_buffer(s, size) >= 0)
+        ctx->nominal_size = size;
+}
+
+static inline void io_count(BVIOContext *s, int len)
+{
+    BVIOInternal *ctx = io_internal(s);
+    ctx->auto_bytes += len;
+    ctx->auto_calls ++;
 }
 
 static void write_out(BVIOContext *s, const uint8_t *data, int len)
@@ -168,10 +635,12 @@ static void write_out(BVIOContext *s, const uint8_t *data, int len)
     }
     s->writeout_counts ++;
     s->pos += len;
+    io_count(s, len);
 }
 
 static void fill_buffer(BVIOContext *s)
 {
+    BVIOInternal *ctx = io_internal(s);
     int max_buffer_size = s->max_packet_size ? s->max_packet_size : BV_IO_BUFFER_SIZE;
     uint8_t *dst = s->buffer_end - s->buffer + max_buffer_size < s->buffer_size ? s->buffer_end : s->buffer;
     int len = s->buffer_size - (dst - s->buffer);
@@ -186,12 +655,18 @@ static void fill_buffer(BVIOContext *s)
         }
     }
 
-    if (s->io_read && s->orig_buffer_size && s->buffer_size > s->orig_buffer_size) {
-        if (dst == s->buffer) {
-            bv_io_set_buffer_size(s, s->orig_buffer_size);
-            s->checksum_ptr = dst = s->buffer;
+    if (ctx->auto_syscalls && s->io_read && dst == s->buffer) {
+        io_auto_tune(s);
+        dst = s->buffer;
+        len = s->buffer_size;
+    }
+
+    if (s->io_read && ctx->nominal_size && s->buffer_size > ctx->nominal_size) {
+        if (dst == s->buffer && io_resize_buffer(s, ctx->nominal_size) >= 0) {
+            dst = s->buffer;
+            len = s->buffer_size;
         }
-        bv_assert0(len >= s->orig_buffer_size);
+        bv_assert0(len >= BBMIN(ctx->nominal_size, max_buffer_size));
     }
 
     if (s->io_read)
@@ -207,6 +682,7 @@ static void fill_buffer(BVIOContext *s)
         s->buffer_ptr = dst;
         s->buffer_end = dst + len;
         s->bytes_read += len;
+        io_count(s, len);
     }
     return;
 }
@@ -223,6 +699,8 @@ static void flush_buffer(BVIOContext *s)
     s->buffer_ptr = s->buffer;
     if (!s->write_flag) {
         s->buffer_end = s->buffer;
+    } else if (io_internal(s)->auto_syscalls && !s->direct) {
+        io_auto_tune(s);
     }
 }
 
@@ -269,6 +747,7 @@ int bv_io_read(BVIOContext *s, uint8_t *buffer, size_t size)
                 } else {
                     s->pos += len;
                     s->bytes_read += len;
+                    io_count(s, len);
                     size -= len;
                     buffer += len;
                     s->buffer_ptr = s->buffer;
@@ -297,6 +776,104 @@ int bv_io_read(BVIOContext *s, uint8_t *buffer, size_t size)
     return lsize - size;
 }
 
+/**
+ * Move the avail unread bytes to the start of the buffer, growing it so
+ * that room more bytes fit behind them.
+ */
+static int io_make_room(BVIOContext *s, int avail, int room)
+{
+    if (s->buffer_size - avail < room) {
+        /* fill_buffer() shrinks back to the nominal size once this is drained */
+        uint8_t *buffer = bv_malloc(avail + room);
+        if (!buffer)
+            return BVERROR(ENOMEM);
+        memcpy(buffer, s->buffer_ptr, avail);
+        bv_free(s->buffer);
+        s->buffer = buffer;
+        s->buffer_size = avail + room;
+    } else if (s->buffer_ptr != s->buffer) {
+        memmove(s->buffer, s->buffer_ptr, avail);
+    }
+    s->buffer_ptr = s->buffer;
+    s->buffer_end = s->buffer + avail;
+    s->checksum_ptr = s->buffer;
+    return 0;
+}
+
+int bv_io_peek(BVIOContext *s, int size, const uint8_t **data)
+{
+    int avail, len, room, ret;
+    if (!s || !data || size < 0 || s->write_flag)
+        return BVERROR(EINVAL);
+
+    avail = s->buffer_end - s->buffer_ptr;
+    if (avail >= size) {
+        *data = s->buffer_ptr;
+        return avail;
+    }
+
+    if (s->update_checksum && s->buffer_ptr > s->checksum_ptr)
+        s->checksum = s->update_checksum(s->checksum, s->checksum_ptr, s->buffer_ptr - s->checksum_ptr);
+
+    while (avail < size && !s->eof_reached) {
+        if (!s->io_read) {
+            s->eof_reached = 1;
+            break;
+        }
+        /* a datagram is only ever read whole, leave room for a full one */
+        room = s->max_packet_size ? s->max_packet_size : size - avail;
+        if ((ret = io_make_room(s, avail, room)) < 0)
+            return ret;
+        len = s->io_read(s->opaque, s->buffer_end, s->buffer_size - avail);
+        if (len <= 0) {
+            s->eof_reached = 1;
+            if (len < 0)
+                s->error = len;
+            break;
+        }
+        s->pos += len;
+        s->bytes_read += len;
+        s->buffer_end += len;
+        avail += len;
+    }
+
+    *data = s->buffer_ptr;
+    if (avail == 0)
+        return s->error ? s->error : BVERROR_EOF;
+    return avail;
+}
+
+int bv_io_skip_consumed(BVIOContext *s, int size)
+{
+    if (!s || size < 0 || s->write_flag || size > s->buffer_end - s->buffer_ptr)
+        return BVERROR(EINVAL);
+    s->buffer_ptr += size;
+    return 0;
+}
+
+void bv_io_init_checksum(BVIOContext *s,
+        uint32_t (*update_checksum)(uint32_t checksum, const uint8_t *buf, size_t size),
+        uint32_t checksum)
+{
+    s->update_checksum = update_checksum;
+    if (s->update_checksum) {
+        s->checksum = checksum;
+        s->checksum_ptr = s->buffer_ptr;
+    }
+}
+
+uint32_t bv_io_get_checksum(BVIOContext *s)
+{
+    if (!s)
+        return 0;
+    /* already finished, or never started */
+    if (!s->update_checksum)
+        return s->checksum;
+    s->checksum = s->update_checksum(s->checksum, s->checksum_ptr, s->buffer_ptr - s->checksum_ptr);
+    s->update_checksum = NULL;
+    return s->checksum;
+}
+
 int bv_io_feof(BVIOContext *s)
 {
     if (!s)
@@ -322,6 +899,14 @@ int bv_io_close(BVIOContext *s)
         return 0;
     h = s->opaque;
     bv_io_flush(s);
+#if BV_HAVE_PTHREADS
+    if (s->readahead) {
+        BVIOReadAhead *ra = s->readahead;
+        readahead_stop(ra);
+        h = ra->h;
+        readahead_free(&ra);
+    }
+#endif
     bv_freep(&s->buffer);
     if (s->write_flag)
         bv_log(s, BV_LOG_DEBUG, "Statistics: %u seeks, %u writeouts\n", s->seek_counts, s->writeout_counts);
@@ -343,16 +928,38 @@ int bv_io_closep(BVIOContext **s)
 
 int bv_io_set_buffer_size(BVIOContext *s, int buf_size)
 {
-    uint8_t *buffer;
-    buffer = bv_malloc(buf_size);
-    if (!buffer)
-        return BVERROR(ENOMEM);
-    bv_free(s->buffer);
-    s->buffer = buffer;
+    int ret = io_resize_buffer(s, buf_size);
+    if (ret < 0)
+        return ret;
     s->orig_buffer_size =
-    s->buffer_size = buf_size;
-    s->buffer_ptr = buffer;
-    io_reset_buf(s, s->write_flag ? BV_IO_FLAG_WRITE: BV_IO_FLAG_READ);
+    io_internal(s)->nominal_size = buf_size;
+    return 0;
+}
+
+int bv_io_set_auto_buffer_size(BVIOContext *s, int min_size, int max_size, int syscalls_per_sec)
+{
+    BVIOInternal *ctx;
+    if (!s)
+        return BVERROR(EINVAL);
+    ctx = io_internal(s);
+    if (syscalls_per_sec <= 0) {
+        /* the next refill goes back to the size the context was given */
+        ctx->auto_syscalls = 0;
+        ctx->nominal_size = s->orig_buffer_size;
+        return 0;
+    }
+    if (min_size <= 0 || max_size < min_size)
+        return BVERROR(EINVAL);
+    if (s->max_packet_size || !s->orig_buffer_size) {
+        bv_log(s, BV_LOG_WARNING, "buffer of this context can not be resized\n");
+        return BVERROR(ENOSYS);
+    }
+    ctx->auto_min_size = min_size;
+    ctx->auto_max_size = max_size;
+    ctx->auto_syscalls = syscalls_per_sec;
+    ctx->auto_start = 0;
+    ctx->auto_bytes = 0;
+    ctx->auto_calls = 0;
     return 0;
 }
 
@@ -455,7 +1062,7 @@ int bv_io_control(BVIOContext *s, int type, BVControlPacket *pkt_in, BVControlPa
         return BVERROR(EINVAL);
     if (!s->io_control)
         return BVERROR(ENOSYS);
-    return s->io_control(s, type, pkt_in, pkt_out);
+    return s->io_control(s->opaque, type, pkt_in, pkt_out);
 }
 
 void bv_io_w8(BVIOContext *s, uint8_t val)
@@ -526,6 +1133,11 @@ uint8_t bv_io_r8(BVIOContext *s)
 uint16_t bv_io_rl16(BVIOContext *s)
 {
     uint16_t val;
+    if (s->buffer_end - s->buffer_ptr >= 2) {
+        val = BV_RL16(s->buffer_ptr);
+        s->buffer_ptr += 2;
+        return val;
+    }
     val = bv_io_r8(s);
     val |= bv_io_r8(s) << 8;
     return val;
@@ -540,6 +1152,11 @@ uint32_t bv_io_rl24(BVIOContext *s)
 uint32_t bv_io_rl32(BVIOContext *s)
 {
     uint32_t val;
+    if (s->buffer_end - s->buffer_ptr >= 4) {
+        val = BV_RL32(s->buffer_ptr);
+        s->buffer_ptr += 4;
+        return val;
+    }
     val = bv_io_rl16(s);
     val |= bv_io_rl16(s) << 16;
     return val;
@@ -555,6 +1172,11 @@ uint64_t bv_io_rl64(BVIOContext *s)
 uint16_t bv_io_rb16(BVIOContext *s)
 {
     uint16_t val;
+    if (s->buffer_end - s->buffer_ptr >= 2) {
+        val = BV_RB16(s->buffer_ptr);
+        s->buffer_ptr += 2;
+        return val;
+    }
     val = bv_io_r8(s) << 8;
     val |= bv_io_r8(s);
     return val;
@@ -570,6 +1192,11 @@ uint32_t bv_io_rb24(BVIOContext *s)
 uint32_t bv_io_rb32(BVIOContext *s)
 {
     uint32_t val;
+    if (s->buffer_end - s->buffer_ptr >= 4) {
+        val = BV_RB32(s->buffer_ptr);
+        s->buffer_ptr += 4;
+        return val;
+    }
     val = bv_io_rb16(s) << 16;
     val |= bv_io_rb16(s);
     return val;
@@ -582,3 +1209,95 @@ uint64_t bv_io_rb64(BVIOContext *s)
     return val;
 }
 
+
+#ifdef TEST
+#include <stdio.h>
+
+typedef struct TestSource {
+    int pos;
+    int size;
+    int chunk;          ///< bytes per read, or datagram size
+    int datagram;
+} TestSource;
+
+static uint8_t test_byte(int pos)
+{
+    return pos * 7 + (pos >> 8);
+}
+
+static int test_read(void *opaque, uint8_t *buf, size_t size)
+{
+    TestSource *src = opaque;
+    int i, len = BBMIN(src->chunk, src->size - src->pos);
+
+    if (!len)
+        return 0;
+    /* a datagram does not fit, it would be truncated */
+    if (src->datagram && size < len)
+        return BVERROR(EINVAL);
+    len = BBMIN(len, size);
+    for (i = 0; i < len; i++)
+        buf[i] = test_byte(src->pos + i);
+    src->pos += len;
+    return len;
+}
+
+static int test_peek(int chunk, int datagram, int buffer_size)
+{
+    TestSource src = { .size = 100000, .chunk = chunk, .datagram = datagram };
+    BVIOContext *s;
+    const uint8_t *p;
+    int pos = 0, size, ret, i, errors = 0;
+
+    s = bv_io_alloc_context(bv_malloc(buffer_size), buffer_size, 0, &src, test_read, NULL, NULL, NULL);
+    if (!s)
+        return 1;
+    s->max_packet_size = datagram ? chunk : 0;
+    for (i = 0; pos < src.size; i++) {
+        size = 1 + i * 37 % 300;
+        ret = bv_io_peek(s, size, &p);
+        if (ret < BBMIN(size, src.size - pos)) {
+            printf("short peek of %d at %d: %d\n", size, pos, ret);
+            errors++;
+            break;
+        }
+        size = BBMIN(size, ret);
+        if (p[0] != test_byte(pos) || p[size - 1] != test_byte(pos + size - 1)) {
+            printf("wrong data peeking %d at %d\n", size, pos);
+            errors++;
+        }
+        size = size / 2 + 1;
+        bv_io_skip_consumed(s, size);
+        pos += size;
+        if (i % 3 == 0 && src.size - pos >= 4) {
+            uint32_t v = bv_io_rb32(s);
+            if (v != ((uint32_t)test_byte(pos) << 24 | test_byte(pos + 1) << 16 |
+                      test_byte(pos + 2) << 8 | test_byte(pos + 3))) {
+                printf("wrong rb32 at %d\n", pos);
+                errors++;
+            }
+            pos += 4;
+        }
+    }
+    if (bv_io_peek(s, 1, &p) != BVERROR_EOF) {
+        printf("no EOF after %d bytes\n", pos);
+        errors++;
+    }
+    bv_freep(&s->buffer);
+    bv_free(s);
+    return errors;
+}
+
+int main(void)
+{
+    int errors = 0;
+
+    errors += test_peek(7, 0, 64);
+    errors += test_peek(4096, 0, BV_IO_BUFFER_SIZE);
+    /* datagrams larger than what a peek needs, and smaller */
+    errors += test_peek(1316, 1, 1316);
+    errors += test_peek(40, 1, 40);
+    printf("%s\n", errors ? "FAIL" : "OK");
+    return !!errors;
+}
+#endif
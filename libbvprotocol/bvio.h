@@ -35,6 +35,8 @@ extern "C"{
 
 #include "version.h"
 
+struct BVIOReadAhead;
+
 typedef struct _BVIOContext {
     const BVClass *bv_class;
     void *opaque;
@@ -61,6 +63,7 @@ typedef struct _BVIOContext {
     uint8_t *checksum_ptr;
     uint32_t (*update_checksum)(uint32_t checksum, const uint8_t *buf, size_t size);
     int error;
+    struct BVIOReadAhead *readahead;    ///< background reader, see bv_io_open()
 } BVIOContext;
 
 #define BV_IO_FLAG_READ     1
@@ -79,6 +82,23 @@ BVIOContext * bv_io_alloc_context(uint8_t *buffer, int buffer_size, int write_fl
         int (*control)(void *opaque, int type, BVControlPacket *pkt_in, BVControlPacket *pkt_out)
         );
 
+/**
+ * Open a BVURLContext for filename and wrap it in a BVIOContext.
+ *
+ * Besides the protocol options, options may carry
+ * "readahead_size" (bytes) and/or "readahead_time" (microseconds) to start
+ * a worker thread that keeps reading ahead of the consumer. The worker
+ * stops when it is readahead_size bytes or readahead_time worth of the
+ * observed consumption rate ahead. Seeking discards the read-ahead data,
+ * and int_cb also aborts the worker. Ignored for write and nonblocking
+ * contexts.
+ *
+ * "auto_buffer_syscalls" turns on bv_io_set_auto_buffer_size() with that
+ * many calls per second, between the default buffer size and
+ * "auto_buffer_max" bytes (1M by default).
+ *
+ * Consumed entries are removed from options.
+ */
 int bv_io_open(BVIOContext **s, const char *filename, int flags, const BVIOInterruptCB *int_cb, BVDictionary **options);
 
 int bv_io_write(BVIOContext *s, const uint8_t *buffer, size_t size);
@@ -93,6 +113,46 @@ int bv_io_control(BVIOContext *s, int type, BVControlPacket *pkt_in, BVControlPa
 
 void bv_io_flush(BVIOContext *s);
 
+/**
+ * Make at least size bytes readable without copying them out.
+ *
+ * On success *data points into the internal buffer and stays valid until
+ * the next read, seek or peek on s. The buffer is only compacted (or grown,
+ * when size exceeds it) and refilled if fewer than size bytes are buffered.
+ *
+ * @param s     read context
+ * @param size  number of bytes the caller wants to look at
+ * @param data  set to the first unread byte
+ * @return number of bytes available at *data, which is less than size only
+ *         at end of stream; a negative BVERROR code if nothing is available
+ */
+int bv_io_peek(BVIOContext *s, int size, const uint8_t **data);
+
+/**
+ * Consume size bytes previously made available by bv_io_peek().
+ *
+ * @return 0 on success, BVERROR(EINVAL) if size exceeds the buffered data
+ */
+int bv_io_skip_consumed(BVIOContext *s, int size);
+
+/**
+ * Start checksumming all data read from or written to s from now on.
+ *
+ * bv_crc32c() and bv_crc32_ieee_le() from libbvutil/crc.h can be passed as
+ * update_checksum; they use the CRC32 instructions of the CPU when present.
+ *
+ * @param checksum initial value, e.g. ~0U for a standard CRC-32C
+ */
+void bv_io_init_checksum(BVIOContext *s,
+        uint32_t (*update_checksum)(uint32_t checksum, const uint8_t *buf, size_t size),
+        uint32_t checksum);
+
+/**
+ * Finish the checksum started by bv_io_init_checksum() and return it.
+ * Returns the last finished value (0 if none) when no checksum is running.
+ */
+uint32_t bv_io_get_checksum(BVIOContext *s);
+
 int bv_io_feof(BVIOContext *s);
 
 int bv_io_close(BVIOContext *s);
@@ -101,6 +161,20 @@ int bv_io_closep(BVIOContext **s);
 
 int bv_io_set_buffer_size(BVIOContext *s, int buf_size);
 
+/**
+ * Let the buffer size follow the observed throughput.
+ *
+ * Once a second the bytes transferred are turned into a buffer size that
+ * needs about syscalls_per_sec io_read/io_write calls, rounded to a power
+ * of two times min_size and clamped to max_size. The buffer is only
+ * reallocated when that size is at least twice or at most half the current
+ * one, and only while it is empty.
+ *
+ * @param syscalls_per_sec target rate, 0 turns auto sizing off
+ * @return 0 on success, a negative BVERROR code otherwise
+ */
+int bv_io_set_auto_buffer_size(BVIOContext *s, int min_size, int max_size, int syscalls_per_sec);
+
 void bv_io_w8(BVIOContext *s, uint8_t val);
 void bv_io_wl16(BVIOContext *s, uint16_t val);
 void bv_io_wl24(BVIOContext *s, uint32_t val);
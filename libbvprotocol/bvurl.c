@@ -23,6 +23,12 @@
 
 #line 25 "bvurl.c"
 
+#include "config.h"
+
+#if BV_HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 #include "libbvutil/bvstring.h"
 #include "libbvutil/dict.h"
 #include "libbvutil/opt.h"
@@ -34,6 +40,8 @@
 
 static BVURLProtocol *first_protocol = NULL;
 
+static void async_detach(BVURLContext *h);
+
 BVURLProtocol *bv_url_protocol_next(const BVURLProtocol *prev)
 {
     return prev ? prev->next : first_protocol;
@@ -142,6 +150,7 @@ static int url_alloc_for_protocol(BVURLContext **puc, BVURLProtocol *up,
     uc->flags           = flags;
     uc->is_streamed     = 0; /* default = not streamed */
     uc->max_packet_size = 0; /* default: stream file */
+    uc->nonblock        = !!(up->flags & BV_URL_PROTOCOL_FLAG_NONBLOCK);
     if (up->priv_data_size) {
         uc->priv_data = bv_mallocz(up->priv_data_size);
         if (!uc->priv_data) {
@@ -368,6 +377,8 @@ int bv_url_closep(BVURLContext **hh)
     if (!h)
         return 0;     /* can happen when bv_url_open fails */
 
+    if (h->async)
+        async_detach(h);
     if (h->is_connected && h->prot->url_close)
         ret = h->prot->url_close(h);
 #if BV_CONFIG_NETWORK
@@ -466,3 +477,526 @@ int bv_url_control(BVURLContext *h, int type, BVControlPacket *pkt_in, BVControl
     }
     return h->prot->url_control(h, type, pkt_in, pkt_out);
 }
+
+typedef struct URLCompletion {
+    BVEventCall call;
+    struct BVURLAsync *async;
+    BVURLCallback cb;
+    void *opaque;
+    int ret;
+} URLCompletion;
+
+typedef struct URLAsyncOp {
+    uint8_t *buf;
+    size_t size;
+    size_t done;
+    URLCompletion *completion;  ///< allocated on start, so that completing cannot fail
+    int pending;
+} URLAsyncOp;
+
+typedef struct BVURLAsync {
+    BVURLContext *h;            ///< NULL once the context is closed
+    BVEventLoop *loop;
+    int fd;                     ///< watched file handle, -1 if none
+    int refs;                   ///< the context plus posted completions
+    URLAsyncOp read, write;
+} BVURLAsync;
+
+static void async_unref(BVURLAsync *a)
+{
+    if (!--a->refs)
+        bv_free(a);
+}
+
+static void async_deliver(BVEventLoop *loop, void *opaque)
+{
+    URLCompletion *c = opaque;
+    BVURLAsync *a = c->async;
+
+    if (a->h)
+        c->cb(a->h, c->ret, c->opaque);
+    async_unref(a);
+    bv_free(c);
+}
+
+static void async_complete(BVURLAsync *a, URLAsyncOp *op, int ret)
+{
+    URLCompletion *c = op->completion;
+
+    op->pending    = 0;
+    op->completion = NULL;
+    c->ret = ret;
+    a->refs++;
+    bv_event_loop_post(a->loop, &c->call, async_deliver, c);
+}
+
+/*
+ * One nonblocking attempt, completes op unless it would block. Protocols
+ * with inner contexts pass BV_IO_FLAG_NONBLOCK down themselves.
+ */
+static void async_step(BVURLAsync *a, URLAsyncOp *op, int write)
+{
+    BVURLContext *h = a->h;
+    int flags = h->flags, ret;
+
+    h->flags |= BV_IO_FLAG_NONBLOCK;
+    if (write)
+        ret = h->prot->url_write(h, op->buf + op->done, op->size - op->done);
+    else
+        ret = h->prot->url_read(h, op->buf, op->size);
+    h->flags = flags;
+
+    if (ret == BVERROR(EAGAIN) || ret == BVERROR(EINTR) || (write && !ret))
+        return;
+    if (!write) {
+        async_complete(a, op, ret == BVERROR_EOF ? 0 : ret);
+    } else if (ret < 0) {
+        async_complete(a, op, ret);
+    } else if ((op->done += ret) == op->size) {
+        async_complete(a, op, op->done);
+    }
+}
+
+static void async_fd_cb(BVEventLoop *loop, int fd, int events, void *opaque);
+
+/* watch the file handle for what the pending operations wait on */
+static void async_update(BVURLAsync *a)
+{
+    int events = (a->read.pending  ? BV_EVENT_READ  : 0) |
+                 (a->write.pending ? BV_EVENT_WRITE : 0);
+    int ret = 0;
+
+    if (!events) {
+        if (a->fd >= 0)
+            bv_event_loop_del_fd(a->loop, a->fd);
+        a->fd = -1;
+        return;
+    }
+    if (a->fd >= 0)
+        return (void)bv_event_loop_mod_fd(a->loop, a->fd, events);
+    if ((a->fd = bv_url_get_file_handle(a->h)) < 0)
+        ret = BVERROR(ENOSYS);
+    else if ((ret = bv_event_loop_add_fd(a->loop, a->fd, events, async_fd_cb, a)) < 0)
+        a->fd = -1;
+    if (ret < 0) {
+        bv_log(a->h, BV_LOG_ERROR, "Cannot wait for the file handle of %s\n", a->h->filename);
+        if (a->read.pending)
+            async_complete(a, &a->read, ret);
+        if (a->write.pending)
+            async_complete(a, &a->write, ret);
+    }
+}
+
+static void async_fd_cb(BVEventLoop *loop, int fd, int events, void *opaque)
+{
+    BVURLAsync *a = opaque;
+
+    if (a->read.pending && events & (BV_EVENT_READ | BV_EVENT_ERROR))
+        async_step(a, &a->read, 0);
+    if (a->write.pending && events & (BV_EVENT_WRITE | BV_EVENT_ERROR))
+        async_step(a, &a->write, 1);
+    async_update(a);
+}
+
+static void async_detach(BVURLContext *h)
+{
+    BVURLAsync *a = h->async;
+
+    if (a->fd >= 0)
+        bv_event_loop_del_fd(a->loop, a->fd);
+    bv_freep(&a->read.completion);
+    bv_freep(&a->write.completion);
+    a->h = NULL;
+    h->async = NULL;
+    async_unref(a);
+}
+
+static int async_start(BVURLContext *h, BVEventLoop *loop, int write,
+                       uint8_t *buf, size_t size, BVURLCallback cb, void *opaque)
+{
+    BVURLAsync *a = h->async;
+    URLCompletion *c;
+    URLAsyncOp *op;
+
+    if (!cb || !size)
+        return BVERROR(EINVAL);
+    if (!h->nonblock) {
+        bv_log(h, BV_LOG_ERROR, "%s cannot be read or written without blocking\n", h->prot->name);
+        return BVERROR(ENOSYS);
+    }
+    if (!a) {
+        if (!(a = bv_mallocz(sizeof(*a))))
+            return BVERROR(ENOMEM);
+        a->h    = h;
+        a->loop = loop;
+        a->fd   = -1;
+        a->refs = 1;
+        h->async = a;
+    } else if (a->loop != loop) {
+        return BVERROR(EINVAL);
+    }
+    op = write ? &a->write : &a->read;
+    if (op->pending)
+        return BVERROR(EBUSY);
+    if (!(c = bv_malloc(sizeof(*c))))
+        return BVERROR(ENOMEM);
+    c->async  = a;
+    c->cb     = cb;
+    c->opaque = opaque;
+    op->buf        = buf;
+    op->size       = size;
+    op->done       = 0;
+    op->completion = c;
+    op->pending    = 1;
+    async_step(a, op, write);
+    async_update(a);
+    return 0;
+}
+
+int bv_url_read_async(BVURLContext *h, BVEventLoop *loop, uint8_t *buf, size_t size,
+                      BVURLCallback cb, void *opaque)
+{
+    if (!(h->flags & BV_IO_FLAG_READ))
+        return BVERROR(EIO);
+    return async_start(h, loop, 0, buf, size, cb, opaque);
+}
+
+int bv_url_write_async(BVURLContext *h, BVEventLoop *loop, const uint8_t *buf, size_t size,
+                       BVURLCallback cb, void *opaque)
+{
+    if (!(h->flags & BV_IO_FLAG_WRITE))
+        return BVERROR(EIO);
+    /* packets must go out whole */
+    if (h->max_packet_size && size > h->max_packet_size)
+        return BVERROR(EIO);
+    return async_start(h, loop, 1, (uint8_t *)buf, size, cb, opaque);
+}
+
+#if BV_HAVE_PTHREADS
+typedef struct URLOpenJob {
+    BVEventJob job;
+    BVEventLoop *loop;
+    char *filename;
+    int flags;
+    BVIOInterruptCB int_cb;
+    int has_int_cb;
+    BVDictionary *options;
+    BVURLCallback cb;
+    void *opaque;
+    BVURLContext *h;
+    int ret;
+} URLOpenJob;
+
+static void open_job_free(URLOpenJob *job)
+{
+    bv_dict_free(&job->options);
+    bv_free(job->filename);
+    bv_free(job);
+}
+
+static void open_job_deliver(BVEventLoop *loop, void *opaque)
+{
+    URLOpenJob *job = opaque;
+
+    job->cb(job->h, job->ret, job->opaque);
+    open_job_free(job);
+}
+
+/* the loop was freed before the result could be delivered */
+static void open_job_release(BVEventJob *j)
+{
+    URLOpenJob *job = (URLOpenJob *)j;
+
+    bv_url_closep(&job->h);
+    open_job_free(job);
+}
+
+static void *open_job_run(void *arg)
+{
+    URLOpenJob *job = arg;
+
+    job->ret = bv_url_open(&job->h, job->filename, job->flags,
+                           job->has_int_cb ? &job->int_cb : NULL, &job->options);
+    bv_event_loop_end_job(job->loop, &job->job, open_job_deliver, job);
+    return NULL;
+}
+#endif
+
+int bv_url_open_async(BVEventLoop *loop, const char *filename, int flags,
+                      const BVIOInterruptCB *int_cb, BVDictionary **options,
+                      BVURLCallback cb, void *opaque)
+{
+#if BV_HAVE_PTHREADS
+    URLOpenJob *job;
+    pthread_attr_t attr;
+    pthread_t thread;
+    int ret;
+
+    if (!cb)
+        return BVERROR(EINVAL);
+    if (!(job = bv_mallocz(sizeof(*job))))
+        return BVERROR(ENOMEM);
+    job->loop     = loop;
+    job->flags    = flags;
+    job->cb       = cb;
+    job->opaque   = opaque;
+    job->filename = bv_strdup(filename);
+    if (int_cb) {
+        job->int_cb     = *int_cb;
+        job->has_int_cb = 1;
+    }
+    if (options)
+        bv_dict_copy(&job->options, *options, 0);
+    if (!job->filename) {
+        open_job_free(job);
+        return BVERROR(ENOMEM);
+    }
+    /* the loop tracks the job, the thread itself needs no joining */
+    bv_event_loop_begin_job(loop, &job->job, open_job_release);
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    ret = pthread_create(&thread, &attr, open_job_run, job);
+    pthread_attr_destroy(&attr);
+    if (ret) {
+        /* reported like a failed open, the job is registered already */
+        job->ret = BVERROR(ret);
+        bv_event_loop_end_job(loop, &job->job, open_job_deliver, job);
+    }
+    return 0;
+#else
+    return BVERROR(ENOSYS);
+#endif
+}
+
+#ifdef TEST
+#include <stdio.h>
+#include <unistd.h>
+#undef printf
+
+#define CHECK(x) do { if (!(x)) { printf("line %d: %s\n", __LINE__, #x); goto end; } } while (0)
+
+#define TEST_SIZE (256 * 1024)
+
+typedef struct TestEcho {
+    int port;
+    int listen_timeout;
+    int ret;
+} TestEcho;
+
+/* blocking stand-in peer, echoes everything until end of file */
+static void *echo_task(void *arg)
+{
+    TestEcho *e = arg;
+    BVURLContext *h = NULL;
+    uint8_t buf[4096];
+    char url[128];
+    int len;
+
+    snprintf(url, sizeof(url), "tcp://127.0.0.1:%d?listen=1&listen_timeout=%d",
+             e->port, e->listen_timeout);
+    if ((e->ret = bv_url_open(&h, url, BV_IO_FLAG_READ_WRITE, NULL, NULL)) < 0)
+        return NULL;
+    while ((len = bv_url_read(h, buf, sizeof(buf))) > 0) {
+        if ((e->ret = bv_url_write(h, buf, len)) < 0)
+            break;
+    }
+    bv_url_closep(&h);
+    return NULL;
+}
+
+typedef struct TestClient {
+    BVEventLoop *loop;
+    pthread_t loop_thread;
+    char url[128];
+    int tries;
+    BVURLContext *h;
+    uint8_t *out;
+    uint8_t *in;
+    int in_len;
+    int written;
+    int wrong_thread;
+    int ret;
+} TestClient;
+
+static void client_open(BVEventLoop *loop, BVEventTimer *timer, void *opaque);
+
+static void client_done(TestClient *c, int ret)
+{
+    if (ret < 0 && !c->ret)
+        c->ret = ret;
+    if (c->ret < 0 || (c->written == TEST_SIZE && c->in_len == TEST_SIZE))
+        bv_event_loop_stop(c->loop);
+}
+
+static void client_read(BVURLContext *h, int ret, void *opaque)
+{
+    TestClient *c = opaque;
+
+    c->wrong_thread |= !pthread_equal(pthread_self(), c->loop_thread);
+    if (ret <= 0) {
+        client_done(c, ret ? ret : BVERROR_EOF);
+        return;
+    }
+    c->in_len += ret;
+    if (c->in_len < TEST_SIZE &&
+        (ret = bv_url_read_async(h, c->loop, c->in + c->in_len, TEST_SIZE - c->in_len,
+                                 client_read, c)) < 0)
+        client_done(c, ret);
+    else
+        client_done(c, 0);
+}
+
+static void client_write(BVURLContext *h, int ret, void *opaque)
+{
+    TestClient *c = opaque;
+
+    c->wrong_thread |= !pthread_equal(pthread_self(), c->loop_thread);
+    if (ret >= 0)
+        c->written = ret;
+    client_done(c, ret);
+}
+
+static void client_opened(BVURLContext *h, int ret, void *opaque)
+{
+    TestClient *c = opaque;
+
+    c->wrong_thread |= !pthread_equal(pthread_self(), c->loop_thread);
+    if (ret < 0) {
+        /* the stand-in may not listen yet */
+        if (++c->tries < 100 && bv_event_loop_add_timer(c->loop, 20000, 0, client_open, c))
+            return;
+        client_done(c, ret);
+        return;
+    }
+    c->h = h;
+    /* both directions at once: the echo only drains what it can send back */
+    if ((ret = bv_url_write_async(h, c->loop, c->out, TEST_SIZE, client_write, c)) < 0 ||
+        (ret = bv_url_read_async(h, c->loop, c->in, TEST_SIZE, client_read, c)) < 0)
+        client_done(c, ret);
+}
+
+static void client_open(BVEventLoop *loop, BVEventTimer *timer, void *opaque)
+{
+    TestClient *c = opaque;
+    int ret;
+
+    if ((ret = bv_url_open_async(loop, c->url, BV_IO_FLAG_READ_WRITE, NULL, NULL,
+                                 client_opened, c)) < 0)
+        client_done(c, ret);
+}
+
+static void never_called(BVURLContext *h, int ret, void *opaque)
+{
+    (*(int *)opaque)++;
+}
+
+static void udp_read(BVURLContext *h, int ret, void *opaque)
+{
+    *(int *)opaque = ret;
+}
+
+int main(void)
+{
+    TestClient c = { 0 };
+    TestEcho echo = { 0 };
+    pthread_t echo_thread;
+    int echo_started = 0;
+    BVURLContext *rx = NULL, *tx = NULL;
+    BVEventLoop *loop = NULL;
+    int port = 20000 + getpid() % 20000;
+    int i, calls = 0, ret, err = 1;
+    uint8_t pkt[64];
+    int64_t t;
+    char url[128];
+
+    bv_protocol_register_all();
+    bv_network_init();
+    c.out = bv_malloc(TEST_SIZE);
+    c.in  = bv_malloc(TEST_SIZE);
+    CHECK(c.out && c.in);
+    for (i = 0; i < TEST_SIZE; i++)
+        c.out[i] = i * 7 + (i >> 10);
+
+    /* async open, then a read and a write in flight together */
+    CHECK(bv_event_loop_alloc(&c.loop) >= 0);
+    c.loop_thread = pthread_self();
+    echo.port = port;
+    echo.listen_timeout = 5000;
+    CHECK(!pthread_create(&echo_thread, NULL, echo_task, &echo));
+    echo_started = 1;
+    snprintf(c.url, sizeof(c.url), "tcp://127.0.0.1:%d", port);
+    client_open(c.loop, NULL, &c);
+    CHECK(bv_event_loop_run(c.loop) >= 0);
+    CHECK(c.ret == 0);
+    CHECK(!c.wrong_thread);
+    CHECK(c.written == TEST_SIZE && c.in_len == TEST_SIZE);
+    CHECK(!memcmp(c.in, c.out, TEST_SIZE));
+    bv_url_closep(&c.h);
+    pthread_join(echo_thread, NULL);
+    echo_started = 0;
+    CHECK(echo.ret >= 0);
+    bv_event_loop_free(&c.loop);
+
+    /*
+     * freeing the loop: an open still connecting is waited for, one which
+     * completed without being delivered is closed, no callback runs
+     */
+    CHECK(bv_event_loop_alloc(&loop) >= 0);
+    echo.port = port + 1;
+    echo.listen_timeout = 1000;
+    echo.ret = 0;
+    CHECK(!pthread_create(&echo_thread, NULL, echo_task, &echo));
+    echo_started = 1;
+    snprintf(url, sizeof(url), "tcp://127.0.0.1:%d?listen=1&listen_timeout=300", port + 2);
+    CHECK(bv_url_open_async(loop, url, BV_IO_FLAG_READ_WRITE, NULL, NULL, never_called, &calls) >= 0);
+    /* let the stand-in bind, a refused connect would not be the case under test */
+    bv_usleep(100000);
+    snprintf(url, sizeof(url), "tcp://127.0.0.1:%d", port + 1);
+    CHECK(bv_url_open_async(loop, url, BV_IO_FLAG_READ_WRITE, NULL, NULL, never_called, &calls) >= 0);
+    bv_usleep(100000);
+    t = bv_gettime_relative();
+    bv_event_loop_free(&loop);
+    t = bv_gettime_relative() - t;
+    CHECK(!calls);
+    CHECK(t >= 50000);
+    pthread_join(echo_thread, NULL);
+    echo_started = 0;
+    /* the accepted connection saw end of file once the loop closed it */
+    CHECK(echo.ret >= 0);
+
+    /* udp is nonblocking only without its reader thread */
+    snprintf(url, sizeof(url), "udp://127.0.0.1:%d?localport=%d", port + 3, port + 3);
+    CHECK(bv_url_open(&rx, url, BV_IO_FLAG_READ, NULL, NULL) >= 0);
+    CHECK(!rx->nonblock);
+    CHECK(bv_event_loop_alloc(&loop) >= 0);
+    CHECK(bv_url_read_async(rx, loop, pkt, sizeof(pkt), udp_read, &ret) == BVERROR(ENOSYS));
+    bv_url_closep(&rx);
+    snprintf(url, sizeof(url), "udp://127.0.0.1:%d?localport=%d&fifo_size=0", port + 3, port + 3);
+    CHECK(bv_url_open(&rx, url, BV_IO_FLAG_READ, NULL, NULL) >= 0);
+    CHECK(rx->nonblock);
+    snprintf(url, sizeof(url), "udp://127.0.0.1:%d", port + 3);
+    CHECK(bv_url_open(&tx, url, BV_IO_FLAG_WRITE, NULL, NULL) >= 0);
+    ret = 1;
+    CHECK(bv_url_read_async(rx, loop, pkt, sizeof(pkt), udp_read, &ret) >= 0);
+    CHECK(ret == 1);
+    CHECK(bv_url_write(tx, (const uint8_t *)"datagram", 8) == 8);
+    for (i = 0; i < 100 && ret == 1; i++)
+        CHECK(bv_event_loop_run_once(loop, 20000) >= 0);
+    CHECK(ret == 8);
+    CHECK(!memcmp(pkt, "datagram", 8));
+
+    err = 0;
+end:
+    if (echo_started)
+        pthread_join(echo_thread, NULL);
+    bv_url_closep(&rx);
+    bv_url_closep(&tx);
+    bv_url_closep(&c.h);
+    bv_event_loop_free(&loop);
+    bv_event_loop_free(&c.loop);
+    bv_free(c.out);
+    bv_free(c.in);
+    printf(err ? "FAIL\n" : "OK\n");
+    return err;
+}
+#endif /* TEST */
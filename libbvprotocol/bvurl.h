@@ -29,11 +29,13 @@ extern "C"{
 #endif
 
 #include <libbvutil/bvutil.h>
+#include <libbvutil/eventloop.h>
 #include <libbvutil/opt.h>
 #include <libbvutil/packet.h>
 #include <libbvutil/log.h>
 
 struct _BVURLProtocol;
+struct BVURLAsync;
 #include "bvio.h"
 typedef struct _BVURLContext {
     const BVClass *bv_class;
@@ -46,11 +48,69 @@ typedef struct _BVURLContext {
     int is_streamed;
     int is_connected;
     int max_packet_size;
+    int nonblock;               ///< honours BV_IO_FLAG_NONBLOCK, from BV_URL_PROTOCOL_FLAG_NONBLOCK unless url_open clears it
+    struct BVURLAsync *async;   ///< state of bv_url_*_async() operations
 } BVURLContext;
 #define BV_URL_PROTOCOL_FLAG_NETWORK 0x01
 #define BV_URL_PROTOCOL_FLAG_NESTED_SCHEME  0x02
+#define BV_URL_PROTOCOL_FLAG_NONBLOCK 0x04   ///< url_read/url_write honour BV_IO_FLAG_NONBLOCK, down to any inner context, and the file handle tells when to retry
 #define BV_SEEK_SIZE    (INT_MIN)
 
+/**
+ * bv_url_control() message types
+ */
+enum BVURLMessageType {
+    BV_URL_MESSAGE_TYPE_NONE = -1,
+    /**
+     * Hand a buffer to the peer without copying it (unix protocol).
+     * pkt_in->data: BVBufferRef * from bv_buffer_alloc_shared(),
+     * pkt_in->size: number of valid bytes at its start.
+     * The caller keeps its reference.
+     */
+    BV_URL_MESSAGE_TYPE_SEND_BUFFER,
+    /**
+     * Receive a buffer sent with BV_URL_MESSAGE_TYPE_SEND_BUFFER.
+     * pkt_out->data is set to a new BVBufferRef * owned by the caller,
+     * pkt_out->size to the number of valid bytes.
+     */
+    BV_URL_MESSAGE_TYPE_RECV_BUFFER,
+    /**
+     * Transport statistics (arq protocol).
+     * pkt_out->data: BVURLTransportStats * filled in by the protocol.
+     */
+    BV_URL_MESSAGE_TYPE_GET_STATS,
+    /**
+     * Send a range of a file without copying it through user space
+     * (tcp protocol, tls protocol with kernel TLS).
+     * pkt_in->data: BVURLSendfile * describing the range.
+     * Returns the number of bytes sent, the whole range unless an error
+     * occurred.
+     */
+    BV_URL_MESSAGE_TYPE_SENDFILE,
+    BV_URL_MESSAGE_TYPE_UNKNOW
+};
+
+typedef struct _BVURLSendfile {
+    int fd;                         ///< file to send from
+    int64_t offset;                 ///< position of the range in the file
+    int64_t size;                   ///< number of bytes to send
+} BVURLSendfile;
+
+typedef struct _BVURLTransportStats {
+    int64_t packets_sent;           ///< first transmissions
+    int64_t packets_retransmitted;
+    int64_t bytes_sent;
+    int64_t packets_received;
+    int64_t packets_recovered;      ///< received through a retransmission
+    int64_t packets_lost;           ///< given up after the latency window
+    int64_t nacks_sent;
+    int64_t nacks_received;
+    int64_t peer_received;          ///< packets_received as last reported by the peer
+    int64_t peer_lost;              ///< packets_lost as last reported by the peer
+    int rtt;                        ///< smoothed round trip time in microseconds
+    int rtt_var;                    ///< round trip time variation in microseconds
+} BVURLTransportStats;
+
 extern const BVClass bv_url_context_class;
 typedef struct _BVURLProtocol {
     const char *name;
@@ -102,6 +162,49 @@ int bv_url_get_multi_file_handle(BVURLContext *h, int **handles, int *numhandles
 int bv_url_shutdown(BVURLContext *h, int flags);
 
 int bv_url_control(BVURLContext *h, int type, BVControlPacket *pkt_in, BVControlPacket *pkt_out);
+
+/**
+ * Completion callback of the asynchronous calls below, run on the
+ * event loop thread.
+ *
+ * @param ret number of bytes transferred, 0 on end of file or a negative
+ *            error code; 0 or a negative error code for bv_url_open_async()
+ */
+typedef void (*BVURLCallback)(BVURLContext *h, int ret, void *opaque);
+
+/**
+ * Read up to size bytes without blocking the loop.
+ *
+ * The read is tried at once and otherwise when the file handle of h
+ * becomes readable. Only contexts with nonblock set can do this. One
+ * read and one write may be pending per context, all on the same loop. The callback always runs from the loop, never
+ * from inside this call. bv_url_close() cancels pending operations
+ * without calling their callbacks; it must then be called on the loop
+ * thread.
+ *
+ * @return 0 if the read was started, BVERROR(EBUSY) if one is pending,
+ *         BVERROR(ENOSYS) if the protocol would block
+ */
+int bv_url_read_async(BVURLContext *h, BVEventLoop *loop, uint8_t *buf, size_t size,
+                      BVURLCallback cb, void *opaque);
+
+/**
+ * Write all size bytes without blocking the loop, see bv_url_read_async().
+ * buf must stay valid until the callback runs.
+ */
+int bv_url_write_async(BVURLContext *h, BVEventLoop *loop, const uint8_t *buf, size_t size,
+                       BVURLCallback cb, void *opaque);
+
+/**
+ * Open a url on a helper thread, protocol connects being blocking, and
+ * hand the connected context (NULL on error) to cb on the loop.
+ * The options are copied, entries not consumed by the protocol are lost.
+ * bv_event_loop_free() waits for opens still in progress and closes what
+ * they opened, int_cb can cut them short.
+ */
+int bv_url_open_async(BVEventLoop *loop, const char *filename, int flags,
+                      const BVIOInterruptCB *int_cb, BVDictionary **options,
+                      BVURLCallback cb, void *opaque);
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,650 @@
+/*************************************************************************
+    > File Name: cache.c
+    > Author: albertfang
+    > Mail: fang.qi@besovideo.com
+    > Created Time: 2026年10月18日 星期日 22时06分41秒
+ ************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) albert@BesoVideo, 2026
+ */
+
+/**
+ * @file
+ * Local disk read cache: cache:http://host/record.dav
+ *
+ * The inner url is fetched in blocks that are kept in a sparse temporary
+ * file, a bitmap records which blocks are present. Reading a range a second
+ * time, e.g. when scrubbing back and forth, is served from the file. A
+ * worker thread fetches the blocks following the read position so that
+ * sequential playback does not wait for the network.
+ *
+ * Only one request runs on the inner url at a time: the reader and the
+ * prefetcher take turns through the busy flag.
+ *
+ * With max_size set, the least recently read blocks are dropped from the
+ * file (their space given back with a hole punch where the system has it)
+ * once more than max_size bytes are cached.
+ */
+
+#define _GNU_SOURCE             /* fallocate() */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "libbvutil/bvstring.h"
+#include "libbvutil/file.h"
+#include "libbvutil/opt.h"
+#include "libbvutil/time.h"
+#include "libbvutil/tree.h"
+
+#include "bvurl.h"
+
+#define CACHE_POLL_TIME 100000
+
+/**
+ * A cached block when the cache is bounded, on the LRU list and in the tree.
+ */
+typedef struct CacheEntry {
+    int64_t block;
+    struct CacheEntry *prev;    ///< more recently used
+    struct CacheEntry *next;
+} CacheEntry;
+
+typedef struct CacheContext {
+    const BVClass *class;
+    int block_size;
+    int prefetch;               ///< number of blocks kept ahead of pos
+    int64_t max_size;           ///< 0 for unbounded
+
+    BVURLContext *inner;
+    BVIOInterruptCB int_cb;     ///< caller's interrupt callback
+    int fd;                     ///< sparse cache file
+    int64_t pos;
+    int64_t inner_pos;
+    int64_t size;               ///< -1 until known
+    uint8_t *map;               ///< one bit per cached block
+    int64_t nb_blocks;          ///< blocks covered by map
+    uint8_t *buf;               ///< reader's fetch buffer
+    uint8_t *prefetch_buf;
+    int64_t stalled_at;         ///< block the prefetcher failed on
+    int64_t hit, miss;          ///< bytes served from the file / fetched for the reader
+
+    int64_t max_blocks;         ///< from max_size, 0 for unbounded
+    int64_t nb_entries;
+    struct BVTreeNode *tree;    ///< CacheEntry by block
+    CacheEntry *lru_head;       ///< most recently used
+    CacheEntry *lru_tail;
+    int64_t evicted;
+
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int thread_started;
+    int busy;                   ///< somebody is using inner
+    int abort_request;
+} CacheContext;
+
+#define OFFSET(x) offsetof(CacheContext, x)
+#define D BV_OPT_FLAG_DECODING_PARAM
+static const BVOption options[] = {
+    { "block_size", "cache granularity in bytes", OFFSET(block_size), BV_OPT_TYPE_INT, { .i64 = 65536 }, 4096, 1 << 24, D },
+    { "prefetch", "blocks to fetch ahead of the read position, 0 disables", OFFSET(prefetch), BV_OPT_TYPE_INT, { .i64 = 8 }, 0, 4096, D },
+    { "max_size", "bytes kept in the cache file, least recently read blocks are dropped, 0 for no limit", OFFSET(max_size), BV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, D },
+    { NULL }
+};
+
+static const BVClass cache_class = {
+    .class_name = "cache",
+    .item_name  = bv_default_item_name,
+    .option     = options,
+    .version    = LIBBVUTIL_VERSION_INT,
+};
+
+static int cache_interrupt(void *opaque)
+{
+    CacheContext *s = opaque;
+    return s->abort_request || bv_check_interrupt(&s->int_cb);
+}
+
+static int block_cached(CacheContext *s, int64_t b)
+{
+    return b < s->nb_blocks && (s->map[b >> 3] & (1 << (b & 7)));
+}
+
+static int entry_cmp(void *key, const void *node)
+{
+    int64_t a = *(const int64_t *)key, b = ((const CacheEntry *)node)->block;
+    return (a > b) - (a < b);
+}
+
+static void lru_unlink(CacheContext *s, CacheEntry *e)
+{
+    if (e->prev)
+        e->prev->next = e->next;
+    else
+        s->lru_head = e->next;
+    if (e->next)
+        e->next->prev = e->prev;
+    else
+        s->lru_tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+static void lru_push(CacheContext *s, CacheEntry *e)
+{
+    e->prev = NULL;
+    e->next = s->lru_head;
+    if (s->lru_head)
+        s->lru_head->prev = e;
+    else
+        s->lru_tail = e;
+    s->lru_head = e;
+}
+
+/**
+ * Mark block b as just read. Called with the mutex held.
+ */
+static void block_touch(CacheContext *s, int64_t b)
+{
+    CacheEntry *e;
+    if (!s->max_blocks)
+        return;
+    e = bv_tree_find(s->tree, &b, entry_cmp, NULL);
+    if (e && e != s->lru_head) {
+        lru_unlink(s, e);
+        lru_push(s, e);
+    }
+}
+
+/**
+ * Drop the least recently used block, except the one being read.
+ * Called with the mutex held.
+ */
+static void block_evict(CacheContext *s)
+{
+    int64_t reading = s->pos / s->block_size;
+    struct BVTreeNode *node = NULL;
+    CacheEntry *e = s->lru_tail;
+
+    while (e && e->block == reading)
+        e = e->prev;
+    if (!e)
+        return;
+    s->map[e->block >> 3] &= ~(1 << (e->block & 7));
+#if defined(FALLOC_FL_PUNCH_HOLE) && defined(FALLOC_FL_KEEP_SIZE)
+    fallocate(s->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+              e->block * s->block_size, s->block_size);
+#endif
+    lru_unlink(s, e);
+    bv_tree_insert(&s->tree, &e->block, entry_cmp, &node);
+    bv_free(node);
+    bv_free(e);
+    s->nb_entries--;
+    s->evicted++;
+}
+
+static int block_add_entry(CacheContext *s, int64_t b)
+{
+    struct BVTreeNode *node = bv_tree_node_alloc();
+    CacheEntry *e = bv_mallocz(sizeof(*e));
+
+    if (!node || !e) {
+        bv_free(node);
+        bv_free(e);
+        return BVERROR(ENOMEM);
+    }
+    e->block = b;
+    bv_tree_insert(&s->tree, e, entry_cmp, &node);
+    bv_free(node);
+    lru_push(s, e);
+    s->nb_entries++;
+    while (s->nb_entries > s->max_blocks) {
+        int64_t n = s->nb_entries;
+        block_evict(s);
+        if (s->nb_entries == n)
+            break;
+    }
+    return 0;
+}
+
+static int block_mark(CacheContext *s, int64_t b)
+{
+    if (b >= s->nb_blocks) {
+        int64_t nb = BBMAX(b + 1, 2 * s->nb_blocks);
+        uint8_t *map = bv_realloc(s->map, (nb + 7) >> 3);
+        if (!map)
+            return BVERROR(ENOMEM);
+        memset(map + ((s->nb_blocks + 7) >> 3), 0, ((nb + 7) >> 3) - ((s->nb_blocks + 7) >> 3));
+        s->map = map;
+        s->nb_blocks = nb;
+    }
+    if (block_cached(s, b))
+        return 0;
+    s->map[b >> 3] |= 1 << (b & 7);
+    if (s->max_blocks)
+        return block_add_entry(s, b);
+    return 0;
+}
+
+static int block_past_end(CacheContext *s, int64_t b)
+{
+    return s->size >= 0 && b * s->block_size >= s->size;
+}
+
+/**
+ * Fetch block b from the inner url into the cache file.
+ * Called without the mutex held, by whoever set busy.
+ */
+static int fetch_block(BVURLContext *h, int64_t b, uint8_t *buf)
+{
+    CacheContext *s = h->priv_data;
+    int64_t start = b * s->block_size;
+    int len, ret;
+
+    if (s->inner_pos != start) {
+        int64_t r = bv_url_seek(s->inner, start, SEEK_SET);
+        if (r < 0) {
+            bv_log(h, BV_LOG_ERROR, "inner seek to %"PRId64" failed\n", start);
+            return r;
+        }
+        s->inner_pos = start;
+    }
+    len = bv_url_read_complete(s->inner, buf, s->block_size);
+    if (len < 0)
+        return len;
+    s->inner_pos += len;
+
+    pthread_mutex_lock(&s->mutex);
+    if (len < s->block_size)
+        s->size = start + len;
+    pthread_mutex_unlock(&s->mutex);
+    if (!len)
+        return BVERROR_EOF;
+
+    if (pwrite(s->fd, buf, len, start) != len) {
+        ret = BVERROR(errno);
+        bv_log(h, BV_LOG_ERROR, "cache file write failed\n");
+        return ret;
+    }
+    pthread_mutex_lock(&s->mutex);
+    ret = block_mark(s, b);
+    pthread_mutex_unlock(&s->mutex);
+    return ret;
+}
+
+static void *prefetch_task(void *arg)
+{
+    BVURLContext *h = arg;
+    CacheContext *s = h->priv_data;
+
+    pthread_mutex_lock(&s->mutex);
+    while (!s->abort_request) {
+        int64_t first = s->pos / s->block_size;
+        int64_t b;
+        int ret;
+
+        for (b = first; b < first + s->prefetch; b++)
+            if (!block_cached(s, b))
+                break;
+        if (s->busy || b == first + s->prefetch || block_past_end(s, b) ||
+            b == s->stalled_at) {
+            pthread_cond_wait(&s->cond, &s->mutex);
+            continue;
+        }
+        s->busy = 1;
+        pthread_mutex_unlock(&s->mutex);
+        ret = fetch_block(h, b, s->prefetch_buf);
+        pthread_mutex_lock(&s->mutex);
+        s->busy = 0;
+        /* do not spin on a failing block, retry once the reader moves */
+        s->stalled_at = ret < 0 && ret != BVERROR_EOF ? b : -1;
+        pthread_cond_broadcast(&s->cond);
+    }
+    pthread_mutex_unlock(&s->mutex);
+    return NULL;
+}
+
+static int cache_open(BVURLContext *h, const char *arg, int flags, BVDictionary **options)
+{
+    CacheContext *s = h->priv_data;
+    BVIOInterruptCB cb = { cache_interrupt, s };
+    char *name;
+    int ret;
+
+    bv_strstart(arg, "cache:", &arg);
+    if (flags & BV_IO_FLAG_WRITE)
+        return BVERROR(ENOSYS);
+
+    s->fd = bv_tempfile("bvcache", &name, 0, h);
+    if (s->fd < 0) {
+        bv_log(h, BV_LOG_ERROR, "Failed to create tempfile\n");
+        return s->fd;
+    }
+    /* the file lives as long as the descriptor */
+    unlink(name);
+    bv_freep(&name);
+
+    s->int_cb = h->interrupt_callback;
+    ret = bv_url_open(&s->inner, arg, flags, &cb, options);
+    if (ret < 0)
+        goto fail;
+
+    s->size       = bv_url_size(s->inner);
+    s->size       = s->size < 0 ? -1 : s->size;
+    s->stalled_at = -1;
+    if (s->max_size) {
+        /* the read block and the prefetched ones must fit */
+        s->max_blocks = BBMAX(s->max_size / s->block_size, s->prefetch + 2);
+    }
+    s->buf          = bv_malloc(s->block_size);
+    s->prefetch_buf = bv_malloc(s->block_size);
+    if (!s->buf || !s->prefetch_buf) {
+        ret = BVERROR(ENOMEM);
+        goto fail;
+    }
+    pthread_mutex_init(&s->mutex, NULL);
+    pthread_cond_init(&s->cond, NULL);
+    if (s->prefetch) {
+        if ((ret = pthread_create(&s->thread, NULL, prefetch_task, h))) {
+            ret = BVERROR(ret);
+            goto fail_thread;
+        }
+        s->thread_started = 1;
+    }
+    return 0;
+
+fail_thread:
+    pthread_cond_destroy(&s->cond);
+    pthread_mutex_destroy(&s->mutex);
+fail:
+    bv_url_closep(&s->inner);
+    bv_freep(&s->buf);
+    bv_freep(&s->prefetch_buf);
+    close(s->fd);
+    return ret;
+}
+
+static int cache_read(BVURLContext *h, uint8_t *buf, size_t size)
+{
+    CacheContext *s = h->priv_data;
+    int64_t b = s->pos / s->block_size;
+    int64_t avail;
+    int fetched = 0, ret = 0;
+
+    pthread_mutex_lock(&s->mutex);
+    while (!block_cached(s, b) && !block_past_end(s, b)) {
+        if (s->busy) {
+            /* the prefetcher may be stuck on the network, stay interruptible */
+            int64_t t = bv_gettime() + CACHE_POLL_TIME;
+            struct timespec tv = { t / 1000000, (t % 1000000) * 1000 };
+            if (bv_check_interrupt(&h->interrupt_callback)) {
+                ret = BVERROR_EXIT;
+                break;
+            }
+            pthread_cond_timedwait(&s->cond, &s->mutex, &tv);
+            continue;
+        }
+        s->busy = 1;
+        pthread_mutex_unlock(&s->mutex);
+        ret = fetch_block(h, b, s->buf);
+        pthread_mutex_lock(&s->mutex);
+        s->busy = 0;
+        pthread_cond_broadcast(&s->cond);
+        fetched = 1;
+        if (ret < 0)
+            break;
+    }
+    avail = s->block_size - s->pos % s->block_size;
+    if (s->size >= 0)
+        avail = BBMIN(avail, s->size - s->pos);
+    pthread_mutex_unlock(&s->mutex);
+
+    if (ret < 0)
+        return ret;
+    if (avail <= 0)
+        return BVERROR_EOF;
+
+    size = BBMIN(size, avail);
+    ret = pread(s->fd, buf, size, s->pos);
+    if (ret <= 0)
+        return ret < 0 ? BVERROR(errno) : BVERROR(EIO);
+
+    pthread_mutex_lock(&s->mutex);
+    block_touch(s, b);
+    s->pos += ret;
+    if (fetched)
+        s->miss += ret;
+    else
+        s->hit += ret;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->mutex);
+    return ret;
+}
+
+static int64_t cache_seek(BVURLContext *h, int64_t pos, int whence)
+{
+    CacheContext *s = h->priv_data;
+    int64_t size;
+
+    pthread_mutex_lock(&s->mutex);
+    size = s->size;
+    pthread_mutex_unlock(&s->mutex);
+
+    switch (whence) {
+    case BV_SEEK_SIZE:
+        return size >= 0 ? size : BVERROR(ENOSYS);
+    case SEEK_SET:
+        break;
+    case SEEK_CUR:
+        pos += s->pos;
+        break;
+    case SEEK_END:
+        if (size < 0)
+            return BVERROR(ENOSYS);
+        pos += size;
+        break;
+    default:
+        return BVERROR(EINVAL);
+    }
+    if (pos < 0)
+        return BVERROR(EINVAL);
+
+    pthread_mutex_lock(&s->mutex);
+    s->pos = pos;
+    s->stalled_at = -1;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->mutex);
+    return pos;
+}
+
+static int cache_close(BVURLContext *h)
+{
+    CacheContext *s = h->priv_data;
+
+    if (s->thread_started) {
+        pthread_mutex_lock(&s->mutex);
+        s->abort_request = 1;
+        pthread_cond_broadcast(&s->cond);
+        pthread_mutex_unlock(&s->mutex);
+        pthread_join(s->thread, NULL);
+    }
+    bv_log(h, BV_LOG_DEBUG, "Statistics, cache hits:%"PRId64" cache misses:%"PRId64" evicted blocks:%"PRId64"\n",
+           s->hit, s->miss, s->evicted);
+    pthread_cond_destroy(&s->cond);
+    pthread_mutex_destroy(&s->mutex);
+    bv_url_closep(&s->inner);
+    while (s->lru_head) {
+        CacheEntry *e = s->lru_head;
+        s->lru_head = e->next;
+        bv_free(e);
+    }
+    bv_tree_destroy(s->tree);
+    bv_freep(&s->map);
+    bv_freep(&s->buf);
+    bv_freep(&s->prefetch_buf);
+    close(s->fd);
+    return 0;
+}
+
+BVURLProtocol bv_cache_protocol = {
+    .name                = "cache",
+    .url_open            = cache_open,
+    .url_read            = cache_read,
+    .url_seek            = cache_seek,
+    .url_close           = cache_close,
+    .priv_data_size      = sizeof(CacheContext),
+    .priv_class          = &cache_class,
+    .flags               = BV_URL_PROTOCOL_FLAG_NESTED_SCHEME,
+};
+
+#ifdef TEST
+#include <stdio.h>
+
+#undef printf
+
+#define TEST_BLOCK  4096
+#define TEST_SIZE   (10 * TEST_BLOCK + 100)
+
+static int test_interrupted;
+
+static int test_interrupt(void *opaque)
+{
+    return test_interrupted;
+}
+
+static int test_open(BVURLContext **h, const char *path, const char *prefetch, const char *max_size)
+{
+    static const BVIOInterruptCB cb = { test_interrupt, NULL };
+    BVDictionary *opts = NULL;
+    char url[256];
+    int ret;
+
+    snprintf(url, sizeof(url), "cache:file:%s", path);
+    bv_dict_set(&opts, "block_size", "4096", 0);
+    bv_dict_set(&opts, "prefetch", prefetch, 0);
+    bv_dict_set(&opts, "max_size", max_size, 0);
+    ret = bv_url_open(h, url, BV_IO_FLAG_READ, &cb, &opts);
+    bv_dict_free(&opts);
+    return ret;
+}
+
+/**
+ * Read size bytes from pos and check them against the file pattern.
+ */
+static int test_read(BVURLContext *h, int64_t pos, int size)
+{
+    uint8_t buf[TEST_SIZE];
+    int i, len;
+
+    if (bv_url_seek(h, pos, SEEK_SET) != pos)
+        return -1;
+    if ((len = bv_url_read_complete(h, buf, size)) != size)
+        return -1;
+    for (i = 0; i < len; i++)
+        if (buf[i] != (uint8_t)((pos + i) * 7 + (pos + i) / 251))
+            return -1;
+    return 0;
+}
+
+#define CHECK(x) do { if (!(x)) { printf("line %d: %s\n", __LINE__, #x); goto end; } } while (0)
+
+int main(void)
+{
+    BVURLContext *h = NULL;
+    CacheContext *s;
+    uint8_t buf[TEST_SIZE];
+    char path[64];
+    FILE *f;
+    int64_t hit;
+    int i, err = 1;
+
+    bv_protocol_register_all();
+    snprintf(path, sizeof(path), "/tmp/cache-test-%d", getpid());
+    for (i = 0; i < TEST_SIZE; i++)
+        buf[i] = i * 7 + i / 251;
+    CHECK(f = fopen(path, "wb"));
+    fwrite(buf, 1, TEST_SIZE, f);
+    fclose(f);
+
+    /* the second pass comes from the file */
+    CHECK(test_open(&h, path, "0", "0") >= 0);
+    s = h->priv_data;
+    CHECK(bv_url_seek(h, 0, BV_SEEK_SIZE) == TEST_SIZE);
+    CHECK(!test_read(h, 0, TEST_SIZE));
+    CHECK(s->miss == TEST_SIZE && s->hit == 0);
+    CHECK(!test_read(h, 0, TEST_SIZE));
+    CHECK(s->miss == TEST_SIZE && s->hit == TEST_SIZE);
+    CHECK(bv_url_read(h, buf, 1) == 0);
+    bv_url_closep(&h);
+
+    /* bounded: only the three most recently read blocks stay */
+    CHECK(test_open(&h, path, "0", "12288") >= 0);
+    s = h->priv_data;
+    CHECK(!test_read(h, 0, TEST_SIZE));
+    CHECK(s->nb_entries == 3 && s->evicted == 8);
+    CHECK(!test_read(h, 9 * TEST_BLOCK, 100));
+    CHECK(s->hit == 100);
+    CHECK(!test_read(h, 0, 100));
+    CHECK(s->hit == 100 && s->evicted == 9);
+    /* block 9 was read more recently than block 8 */
+    CHECK(!test_read(h, 9 * TEST_BLOCK, 100) && s->hit == 200);
+    CHECK(!test_read(h, 8 * TEST_BLOCK, 100) && s->hit == 200);
+    CHECK(s->nb_entries == 3);
+    bv_url_closep(&h);
+
+    /* the prefetcher keeps ahead of a slow reader */
+    CHECK(test_open(&h, path, "4", "0") >= 0);
+    s = h->priv_data;
+    /* the prefetcher may beat the reader to block 0 */
+    CHECK(!test_read(h, 0, TEST_BLOCK));
+    for (i = 0; i < 500; i++) {
+        int ahead;
+        pthread_mutex_lock(&s->mutex);
+        ahead = block_cached(s, 4) && !s->busy;
+        pthread_mutex_unlock(&s->mutex);
+        if (ahead)
+            break;
+        bv_usleep(10000);
+    }
+    hit = s->hit;
+    CHECK(!test_read(h, TEST_BLOCK, 4 * TEST_BLOCK));
+    CHECK(s->hit - hit == 4 * TEST_BLOCK);
+
+    /* a reader waiting on a busy prefetcher can be interrupted,
+     * block 9 is past the prefetch window so nothing else fills it */
+    pthread_mutex_lock(&s->mutex);
+    while (s->busy)
+        pthread_cond_wait(&s->cond, &s->mutex);
+    s->busy = 1;
+    pthread_mutex_unlock(&s->mutex);
+    CHECK(bv_url_seek(h, 9 * TEST_BLOCK, SEEK_SET) == 9 * TEST_BLOCK);
+    test_interrupted = 1;
+    CHECK(h->prot->url_read(h, buf, TEST_BLOCK) == BVERROR_EXIT);
+    test_interrupted = 0;
+    pthread_mutex_lock(&s->mutex);
+    s->busy = 0;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->mutex);
+    CHECK(!test_read(h, 5 * TEST_BLOCK, TEST_SIZE - 5 * TEST_BLOCK));
+    err = 0;
+end:
+    bv_url_closep(&h);
+    unlink(path);
+    printf("%s\n", err ? "FAIL" : "OK");
+    return err;
+}
+#endif /* TEST */
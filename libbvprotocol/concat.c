@@ -0,0 +1,564 @@
+/*************************************************************************
+    > File Name: concat.c
+    > Author: albertfang
+    > Mail: fang.qi@besovideo.com
+    > Created Time: 2026年10月18日 星期日 23时41分07秒
+ ************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) albert@BesoVideo, 2026
+ */
+
+/**
+ * @file
+ * Several recording files read as one seekable stream.
+ *
+ * concat:file:/a.dav|file:/b.dav|file:/c.dav
+ * concat:bvfs?channel=2&start_time=1476720000&end_time=1476723600
+ *
+ * The second form looks the files of a channel and time range up on the
+ * disk, the same search the disk device does for
+ * BV_DEV_MESSAGE_TYPE_SEARCH_FILE, and reads them through bvfs://.
+ *
+ * While one file is read the next one is opened by a worker thread, so the
+ * reader does not wait at file boundaries.
+ */
+
+#include "config.h"
+
+#include <pthread.h>
+
+#if BV_CONFIG_BVFS_PROTOCOL
+#include <bvfs.h>
+#endif
+
+#include "libbvutil/bvstring.h"
+#include "libbvutil/opt.h"
+#include "libbvutil/parseutils.h"
+
+#include "bvurl.h"
+
+typedef struct ConcatEntry {
+    char *url;
+    int64_t size;               ///< -1 until known
+} ConcatEntry;
+
+typedef struct ConcatContext {
+    const BVClass *class;
+    int preopen;
+    int channel;
+    int64_t start_time;
+    int64_t end_time;
+    int file_type;
+    int storage_type;
+    int max_files;
+
+    ConcatEntry *entries;
+    int nb_entries;
+    pthread_mutex_t size_lock;  ///< entries[].size, also set by the preopen thread
+    BVDictionary *inner_opts;   ///< options handed to every file
+    BVIOInterruptCB int_cb;
+
+    int cur;
+    BVURLContext *cur_h;
+    int64_t cur_start;          ///< stream offset of entry cur
+    int64_t pos;
+
+    pthread_t thread;
+    int thread_running;
+    int next;                   ///< entry the worker opens
+    BVURLContext *next_h;
+    int next_ret;
+    volatile int abort_next;
+} ConcatContext;
+
+#define OFFSET(x) offsetof(ConcatContext, x)
+#define D BV_OPT_FLAG_DECODING_PARAM
+static const BVOption options[] = {
+    { "preopen", "open the next file while the current one is read", OFFSET(preopen), BV_OPT_TYPE_INT, { .i64 = 1 }, 0, 1, D },
+    { "channel", "bvfs channel", OFFSET(channel), BV_OPT_TYPE_INT, { .i64 = 0 }, 0, 255, D },
+    { "start_time", "bvfs range start, seconds since the epoch", OFFSET(start_time), BV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, D },
+    { "end_time", "bvfs range end, seconds since the epoch", OFFSET(end_time), BV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, D },
+    { "file_type", "bvfs file type, 255 for all", OFFSET(file_type), BV_OPT_TYPE_INT, { .i64 = 255 }, 0, 255, D },
+    { "storage_type", "bvfs storage type", OFFSET(storage_type), BV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, D },
+    { "max_files", "most files a bvfs range resolves to", OFFSET(max_files), BV_OPT_TYPE_INT, { .i64 = 1024 }, 1, INT_MAX, D },
+    { NULL }
+};
+
+static const BVClass concat_class = {
+    .class_name = "concat",
+    .item_name  = bv_default_item_name,
+    .option     = options,
+    .version    = LIBBVUTIL_VERSION_INT,
+};
+
+static int add_entry(ConcatContext *s, char *url, int64_t size)
+{
+    ConcatEntry *entries = bv_realloc(s->entries, (s->nb_entries + 1) * sizeof(*entries));
+    if (!entries) {
+        bv_free(url);
+        return BVERROR(ENOMEM);
+    }
+    s->entries = entries;
+    s->entries[s->nb_entries].url  = url;
+    s->entries[s->nb_entries].size = size;
+    s->nb_entries++;
+    return 0;
+}
+
+static int parse_list(ConcatContext *s, const char *list)
+{
+    int ret;
+
+    while (*list) {
+        char *url = bv_get_token(&list, "|");
+        if (!url)
+            return BVERROR(ENOMEM);
+        if (*list)
+            list++;
+        if (!*url) {
+            bv_free(url);
+            continue;
+        }
+        if ((ret = add_entry(s, url, -1)) < 0)
+            return ret;
+    }
+    return 0;
+}
+
+#if BV_CONFIG_BVFS_PROTOCOL
+static int search_files(BVURLContext *h, const char *arg)
+{
+    ConcatContext *s = h->priv_data;
+    BVFS_FILE_INFO *info;
+    const BVOption *o;
+    const char *p = strchr(arg, '?');
+    char buf[64];
+    int num;
+    int i, ret;
+
+    /* the query string sets the same options as the dictionary */
+    for (o = options; p && o->name; o++) {
+        if (bv_find_info_tag(buf, sizeof(buf), o->name, p) &&
+            (ret = bv_opt_set(s, o->name, buf, 0)) < 0) {
+            bv_log(h, BV_LOG_ERROR, "Invalid %s '%s'\n", o->name, buf);
+            return ret;
+        }
+    }
+    if (s->end_time <= s->start_time) {
+        bv_log(h, BV_LOG_ERROR, "Invalid time range %"PRId64"-%"PRId64"\n",
+               s->start_time, s->end_time);
+        return BVERROR(EINVAL);
+    }
+
+    num  = s->max_files;
+    info = bv_mallocz(s->max_files * sizeof(*info));
+    if (!info)
+        return BVERROR(ENOMEM);
+    if (bvfs_search_file(s->channel, s->start_time, s->end_time, &num, info,
+                         s->file_type, s->storage_type) < 0) {
+        bv_log(h, BV_LOG_ERROR, "search file error\n");
+        bv_free(info);
+        return BVERROR(EIO);
+    }
+    for (i = 0, ret = 0; i < num && ret >= 0; i++) {
+        /* same naming as disk_search_file() */
+        char *url = bv_asprintf("bvfs:///%02d_%02d%s", info[i].disk_id, 0, info[i].file_name);
+        ret = url ? add_entry(s, url, info[i].file_size) : BVERROR(ENOMEM);
+    }
+    bv_free(info);
+    return ret;
+}
+#else
+static int search_files(BVURLContext *h, const char *arg)
+{
+    bv_log(h, BV_LOG_ERROR, "bvfs support not compiled in\n");
+    return BVERROR(ENOSYS);
+}
+#endif
+
+static int concat_interrupt(void *opaque)
+{
+    ConcatContext *s = opaque;
+    return s->abort_next || bv_check_interrupt(&s->int_cb);
+}
+
+static int64_t get_size(ConcatContext *s, int i)
+{
+    int64_t size;
+    pthread_mutex_lock(&s->size_lock);
+    size = s->entries[i].size;
+    pthread_mutex_unlock(&s->size_lock);
+    return size;
+}
+
+static void set_size(ConcatContext *s, int i, int64_t size)
+{
+    pthread_mutex_lock(&s->size_lock);
+    if (s->entries[i].size < 0)
+        s->entries[i].size = size;
+    pthread_mutex_unlock(&s->size_lock);
+}
+
+static int open_entry(BVURLContext *h, int i, BVURLContext **out, const BVIOInterruptCB *cb)
+{
+    ConcatContext *s = h->priv_data;
+    BVDictionary *opts = NULL;
+    int ret;
+
+    bv_dict_copy(&opts, s->inner_opts, 0);
+    ret = bv_url_open(out, s->entries[i].url, BV_IO_FLAG_READ, cb, &opts);
+    bv_dict_free(&opts);
+    if (ret < 0) {
+        bv_log(h, BV_LOG_ERROR, "Unable to open %s\n", s->entries[i].url);
+        return ret;
+    }
+    if (get_size(s, i) < 0)
+        set_size(s, i, bv_url_size(*out));
+    return 0;
+}
+
+static void *preopen_task(void *arg)
+{
+    BVURLContext *h = arg;
+    ConcatContext *s = h->priv_data;
+    BVIOInterruptCB cb = { concat_interrupt, s };
+
+    s->next_ret = open_entry(h, s->next, &s->next_h, &cb);
+    return NULL;
+}
+
+static void start_preopen(BVURLContext *h)
+{
+    ConcatContext *s = h->priv_data;
+
+    if (!s->preopen || s->thread_running || s->next_h || s->cur + 1 >= s->nb_entries)
+        return;
+    s->next       = s->cur + 1;
+    s->next_h     = NULL;
+    s->abort_next = 0;
+    if (pthread_create(&s->thread, NULL, preopen_task, h)) {
+        bv_log(h, BV_LOG_WARNING, "preopen thread failed, opening files on demand\n");
+        return;
+    }
+    s->thread_running = 1;
+}
+
+/**
+ * Wait for the worker. With cancel set the file it opened is dropped,
+ * otherwise it stays in next_h.
+ */
+static void finish_preopen(BVURLContext *h, int cancel)
+{
+    ConcatContext *s = h->priv_data;
+
+    if (s->thread_running) {
+        if (cancel)
+            s->abort_next = 1;
+        pthread_join(s->thread, NULL);
+        s->thread_running = 0;
+    }
+    if (cancel || s->next_ret < 0)
+        bv_url_closep(&s->next_h);
+}
+
+/**
+ * Size of entry i, opening it when nothing told us yet.
+ */
+static int64_t entry_size(BVURLContext *h, int i)
+{
+    ConcatContext *s = h->priv_data;
+    BVURLContext *tmp = NULL;
+    int ret;
+
+    int64_t size;
+
+    if ((size = get_size(s, i)) >= 0)
+        return size;
+    if (s->thread_running && s->next == i)
+        finish_preopen(h, 0);
+    if (get_size(s, i) < 0 && i != s->cur) {
+        if ((ret = open_entry(h, i, &tmp, &h->interrupt_callback)) < 0)
+            return ret;
+        bv_url_closep(&tmp);
+    }
+    return (size = get_size(s, i)) >= 0 ? size : BVERROR(ENOSYS);
+}
+
+static int switch_entry(BVURLContext *h, int i)
+{
+    ConcatContext *s = h->priv_data;
+    int64_t start = 0;
+    int j, ret;
+
+    for (j = 0; j < i; j++) {
+        int64_t size = entry_size(h, j);
+        if (size < 0)
+            return size;
+        start += size;
+    }
+
+    bv_url_closep(&s->cur_h);
+    if (s->next == i && (s->thread_running || s->next_h)) {
+        finish_preopen(h, 0);
+        s->cur_h = s->next_h;
+        s->next_h = NULL;
+        ret = s->next_ret;
+    } else {
+        finish_preopen(h, 1);
+        ret = open_entry(h, i, &s->cur_h, &h->interrupt_callback);
+    }
+    if (ret < 0) {
+        s->cur = -1;
+        return ret;
+    }
+    bv_log(h, BV_LOG_DEBUG, "switched to %s\n", s->entries[i].url);
+    s->cur       = i;
+    s->cur_start = start;
+    start_preopen(h);
+    return 0;
+}
+
+static int concat_open(BVURLContext *h, const char *arg, int flags, BVDictionary **options)
+{
+    ConcatContext *s = h->priv_data;
+    int ret;
+
+    bv_strstart(arg, "concat:", &arg);
+    if (flags & BV_IO_FLAG_WRITE)
+        return BVERROR(ENOSYS);
+    pthread_mutex_init(&s->size_lock, NULL);
+
+    if (bv_strstart(arg, "bvfs", NULL) && (arg[4] == '\0' || arg[4] == '?'))
+        ret = search_files(h, arg);
+    else
+        ret = parse_list(s, arg);
+    if (ret < 0)
+        goto fail;
+    if (!s->nb_entries) {
+        bv_log(h, BV_LOG_ERROR, "No files to concatenate\n");
+        ret = BVERROR(ENOENT);
+        goto fail;
+    }
+
+    if (options)
+        bv_dict_copy(&s->inner_opts, *options, 0);
+    s->int_cb = h->interrupt_callback;
+    s->cur    = -1;
+    if ((ret = switch_entry(h, 0)) < 0)
+        goto fail;
+    h->is_streamed = s->cur_h->is_streamed;
+    return 0;
+
+fail:
+    while (s->nb_entries)
+        bv_free(s->entries[--s->nb_entries].url);
+    bv_freep(&s->entries);
+    bv_dict_free(&s->inner_opts);
+    pthread_mutex_destroy(&s->size_lock);
+    return ret;
+}
+
+static int concat_read(BVURLContext *h, uint8_t *buf, size_t size)
+{
+    ConcatContext *s = h->priv_data;
+    int ret;
+
+    if (!s->cur_h)
+        return BVERROR(EIO);
+    for (;;) {
+        ret = bv_url_read(s->cur_h, buf, size);
+        if (ret > 0) {
+            s->pos += ret;
+            return ret;
+        }
+        if (ret < 0 && ret != BVERROR_EOF)
+            return ret;
+        set_size(s, s->cur, s->pos - s->cur_start);
+        if (s->cur + 1 >= s->nb_entries)
+            return BVERROR_EOF;
+        if ((ret = switch_entry(h, s->cur + 1)) < 0)
+            return ret;
+    }
+}
+
+static int64_t concat_seek(BVURLContext *h, int64_t pos, int whence)
+{
+    ConcatContext *s = h->priv_data;
+    int64_t start = 0, size = 0, total = 0, ret;
+    int i;
+
+    switch (whence) {
+    case BV_SEEK_SIZE:
+    case SEEK_END:
+        for (i = 0; i < s->nb_entries; i++) {
+            if ((size = entry_size(h, i)) < 0)
+                return size;
+            total += size;
+        }
+        if (whence == BV_SEEK_SIZE)
+            return total;
+        pos += total;
+        break;
+    case SEEK_SET:
+        break;
+    case SEEK_CUR:
+        pos += s->pos;
+        break;
+    default:
+        return BVERROR(EINVAL);
+    }
+    if (pos < 0)
+        return BVERROR(EINVAL);
+
+    for (i = 0; i < s->nb_entries; i++) {
+        if ((size = entry_size(h, i)) < 0)
+            return size;
+        if (pos < start + size || i == s->nb_entries - 1)
+            break;
+        start += size;
+    }
+    if (pos > start + size)
+        return BVERROR(EINVAL);
+
+    if (i != s->cur && (ret = switch_entry(h, i)) < 0)
+        return ret;
+    if ((ret = bv_url_seek(s->cur_h, pos - start, SEEK_SET)) < 0)
+        return ret;
+    s->pos = pos;
+    return pos;
+}
+
+static int concat_close(BVURLContext *h)
+{
+    ConcatContext *s = h->priv_data;
+
+    finish_preopen(h, 1);
+    bv_url_closep(&s->cur_h);
+    while (s->nb_entries)
+        bv_free(s->entries[--s->nb_entries].url);
+    bv_freep(&s->entries);
+    bv_dict_free(&s->inner_opts);
+    pthread_mutex_destroy(&s->size_lock);
+    return 0;
+}
+
+BVURLProtocol bv_concat_protocol = {
+    .name                = "concat",
+    .url_open            = concat_open,
+    .url_read            = concat_read,
+    .url_seek            = concat_seek,
+    .url_close           = concat_close,
+    .priv_data_size      = sizeof(ConcatContext),
+    .priv_class          = &concat_class,
+    .flags               = BV_URL_PROTOCOL_FLAG_NESTED_SCHEME,
+};
+
+#ifdef TEST
+#include <stdio.h>
+#include <unistd.h>
+
+#undef printf
+
+static const int test_sizes[] = { 3000, 100, 2000 };
+#define TEST_TOTAL 5100
+
+static uint8_t test_byte(int64_t pos)
+{
+    return pos * 11 + pos / 256;
+}
+
+static int test_check(BVURLContext *h, int64_t pos, int size)
+{
+    uint8_t buf[TEST_TOTAL];
+    int i;
+
+    if (bv_url_seek(h, pos, SEEK_SET) != pos || bv_url_read_complete(h, buf, size) != size)
+        return -1;
+    for (i = 0; i < size; i++)
+        if (buf[i] != test_byte(pos + i))
+            return -1;
+    return 0;
+}
+
+#define CHECK(x) do { if (!(x)) { printf("line %d: %s\n", __LINE__, #x); goto end; } } while (0)
+
+int main(void)
+{
+    BVURLContext *h = NULL;
+    BVDictionary *opts = NULL;
+    ConcatContext *s;
+    char paths[3][64], url[256];
+    uint8_t buf[TEST_TOTAL];
+    int i, j, pos = 0, preopen, err = 1;
+    FILE *f;
+
+    bv_protocol_register_all();
+    for (i = 0; i < BV_ARRAY_ELEMS(test_sizes); i++) {
+        snprintf(paths[i], sizeof(paths[i]), "/tmp/concat-test-%d-%d", getpid(), i);
+        CHECK(f = fopen(paths[i], "wb"));
+        for (j = 0; j < test_sizes[i]; j++, pos++)
+            fputc(test_byte(pos), f);
+        fclose(f);
+    }
+    snprintf(url, sizeof(url), "concat:file:%s|file:%s|file:%s", paths[0], paths[1], paths[2]);
+
+    for (preopen = 0; preopen < 2; preopen++) {
+        bv_dict_set(&opts, "preopen", preopen ? "1" : "0", 0);
+        CHECK(bv_url_open(&h, url, BV_IO_FLAG_READ, NULL, &opts) >= 0);
+        bv_dict_free(&opts);
+        s = h->priv_data;
+        CHECK(s->nb_entries == 3 && s->preopen == preopen);
+        CHECK((s->thread_running || s->next_h) == preopen);
+
+        /* straight through, the parts switch on EOF */
+        CHECK(bv_url_read_complete(h, buf, TEST_TOTAL) == TEST_TOTAL);
+        for (i = 0; i < TEST_TOTAL && buf[i] == test_byte(i); i++);
+        CHECK(i == TEST_TOTAL);
+        CHECK(bv_url_read(h, buf, 1) == 0);
+
+        /* seeks across the part boundaries, backwards too */
+        CHECK(bv_url_seek(h, 0, BV_SEEK_SIZE) == TEST_TOTAL);
+        CHECK(!test_check(h, 2990, 20));
+        CHECK(s->cur == 1);
+        CHECK(!test_check(h, 3099, 2));
+        CHECK(s->cur == 2);
+        CHECK(!test_check(h, 10, 3500));
+        CHECK(!test_check(h, 3000, 100));
+        CHECK(bv_url_seek(h, -50, SEEK_END) == TEST_TOTAL - 50);
+        CHECK(bv_url_read_complete(h, buf, 100) == 50 && buf[0] == test_byte(TEST_TOTAL - 50));
+        CHECK(bv_url_seek(h, TEST_TOTAL, SEEK_SET) == TEST_TOTAL);
+        CHECK(bv_url_seek(h, TEST_TOTAL + 1, SEEK_SET) == BVERROR(EINVAL));
+        bv_url_closep(&h);
+    }
+
+    /* a part that does not open shows up when it is reached */
+    snprintf(url, sizeof(url), "concat:file:%s|file:/nonexistent/concat", paths[0]);
+    CHECK(bv_url_open(&h, url, BV_IO_FLAG_READ, NULL, NULL) >= 0);
+    CHECK(bv_url_read_complete(h, buf, 3000) == 3000);
+    CHECK(bv_url_read(h, buf, 1) < 0);
+    bv_url_closep(&h);
+
+    CHECK(bv_url_open(&h, "concat:bvfs?channel=1&start_time=x", BV_IO_FLAG_READ, NULL, NULL) < 0);
+    err = 0;
+end:
+    bv_dict_free(&opts);
+    bv_url_closep(&h);
+    for (i = 0; i < BV_ARRAY_ELEMS(test_sizes); i++)
+        unlink(paths[i]);
+    printf("%s\n", err ? "FAIL" : "OK");
+    return err;
+}
+#endif /* TEST */
@@ -0,0 +1,602 @@
+/*************************************************************************
+    > File Name: fec.c
+    > Author: albertfang
+    > Mail: fang.qi@besovideo.com
+    > Created Time: 2026年10月19日 星期一 00时27分35秒
+ ************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) albert@BesoVideo, 2026
+ */
+
+/**
+ * @file
+ * Forward error correction for datagram urls: fec:udp://host:port
+ *
+ * The sender arranges its datagrams in a matrix of cols x rows packets, in
+ * the manner of SMPTE 2022-1, and after every row and every matrix sends
+ * the XOR of each row and each column. The receiver rebuilds a lost packet
+ * from any row or column that misses only that one, repeating until no
+ * more can be rebuilt, and returns the datagrams in order. Overhead is
+ * 1/cols for the rows plus 1/rows for the columns.
+ *
+ * Everything goes over the one inner url. Media datagrams get a 4 byte
+ * header, parity datagrams an 8 byte one:
+ *   media:  type(0) 0 seq(16)
+ *   parity: type(1 row, 2 column) count seq_base(16) stride 0 length_xor(16)
+ */
+
+#include "libbvutil/bvstring.h"
+#include "libbvutil/intreadwrite.h"
+#include "libbvutil/opt.h"
+#include "libbvutil/xor.h"
+
+#include "bvurl.h"
+
+#define FEC_MEDIA           0
+#define FEC_ROW             1
+#define FEC_COLUMN          2
+
+#define MEDIA_HEADER_SIZE   4
+#define PARITY_HEADER_SIZE  8
+#define RING_SIZE           2048    ///< received datagrams kept, power of 2
+#define MAX_PARITIES        256
+
+typedef struct FECSlot {
+    uint16_t seq;
+    int valid;
+    int len;
+    uint8_t *data;
+} FECSlot;
+
+typedef struct FECParity {
+    uint16_t base;
+    int stride;
+    int count;
+    int len_xor;
+    int len;
+    int valid;
+    uint8_t *data;
+} FECParity;
+
+typedef struct FECContext {
+    const BVClass *class;
+    int cols;
+    int rows;
+    int row_parity;
+    int latency;
+
+    BVURLContext *inner;
+    int payload_size;           ///< largest media payload
+    uint8_t *pkt;               ///< datagram being sent or received
+
+    /* sender */
+    uint16_t seq;
+    int index;                  ///< position in the matrix
+    uint8_t *row;
+    int row_len, row_len_xor;
+    uint8_t **col;
+    int *col_len, *col_len_xor;
+
+    /* receiver */
+    FECSlot *slots;
+    FECParity *parities;
+    int next_parity;
+    int started;
+    uint16_t next_seq;          ///< next datagram to return
+    uint16_t highest;
+    int window;                 ///< datagrams to wait for a rebuild
+    int64_t recovered, lost;
+} FECContext;
+
+#define OFFSET(x) offsetof(FECContext, x)
+#define D BV_OPT_FLAG_DECODING_PARAM
+#define E BV_OPT_FLAG_ENCODING_PARAM
+static const BVOption options[] = {
+    { "cols", "datagrams per row", OFFSET(cols), BV_OPT_TYPE_INT, { .i64 = 10 }, 1, 255, E },
+    { "rows", "rows per matrix, 0 disables column parity", OFFSET(rows), BV_OPT_TYPE_INT, { .i64 = 10 }, 0, 255, E },
+    { "row_parity", "send row parity", OFFSET(row_parity), BV_OPT_TYPE_INT, { .i64 = 1 }, 0, 1, E },
+    { "latency", "datagrams to wait for a lost one, 0 derives it from the matrix", OFFSET(latency), BV_OPT_TYPE_INT, { .i64 = 0 }, 0, RING_SIZE / 2, D },
+    { NULL }
+};
+
+static const BVClass fec_class = {
+    .class_name = "fec",
+    .item_name  = bv_default_item_name,
+    .option     = options,
+    .version    = LIBBVUTIL_VERSION_INT,
+};
+
+static int fec_close(BVURLContext *h);
+
+static inline int seq_diff(uint16_t a, uint16_t b)
+{
+    return (int16_t)(a - b);
+}
+
+static int fec_open(BVURLContext *h, const char *uri, int flags, BVDictionary **options)
+{
+    FECContext *s = h->priv_data;
+    const char *nested_url;
+    int i, ret;
+
+    if (!bv_strstart(uri, "fec+", &nested_url) &&
+        !bv_strstart(uri, "fec:", &nested_url)) {
+        bv_log(h, BV_LOG_ERROR, "Unsupported url %s\n", uri);
+        return BVERROR(EINVAL);
+    }
+    if ((flags & BV_IO_FLAG_READ) && (flags & BV_IO_FLAG_WRITE)) {
+        bv_log(h, BV_LOG_ERROR, "fec either sends or receives\n");
+        return BVERROR(EINVAL);
+    }
+    if (s->cols * s->rows > 1024) {
+        bv_log(h, BV_LOG_ERROR, "matrix of %dx%d too large\n", s->cols, s->rows);
+        return BVERROR(EINVAL);
+    }
+    if ((ret = bv_url_open(&s->inner, nested_url, flags, &h->interrupt_callback, options)) < 0) {
+        bv_log(h, BV_LOG_ERROR, "Unable to open resource: %s\n", nested_url);
+        return ret;
+    }
+    if (s->inner->max_packet_size <= PARITY_HEADER_SIZE) {
+        bv_log(h, BV_LOG_ERROR, "%s is not a datagram url\n", nested_url);
+        ret = BVERROR(EINVAL);
+        goto fail;
+    }
+    s->payload_size    = s->inner->max_packet_size - PARITY_HEADER_SIZE;
+    h->max_packet_size = s->payload_size;
+    h->is_streamed     = 1;
+
+    s->pkt = bv_malloc(s->inner->max_packet_size);
+    if (!s->pkt)
+        goto enomem;
+    if (flags & BV_IO_FLAG_WRITE) {
+        s->row         = bv_mallocz(s->payload_size);
+        s->col         = bv_mallocz_array(s->cols, sizeof(*s->col));
+        s->col_len     = bv_mallocz_array(s->cols, sizeof(*s->col_len));
+        s->col_len_xor = bv_mallocz_array(s->cols, sizeof(*s->col_len_xor));
+        if (!s->row || !s->col || !s->col_len || !s->col_len_xor)
+            goto enomem;
+        for (i = 0; s->rows && i < s->cols; i++)
+            if (!(s->col[i] = bv_mallocz(s->payload_size)))
+                goto enomem;
+    } else {
+        s->slots    = bv_mallocz_array(RING_SIZE, sizeof(*s->slots));
+        s->parities = bv_mallocz_array(MAX_PARITIES, sizeof(*s->parities));
+        if (!s->slots || !s->parities)
+            goto enomem;
+        s->window = s->latency ? s->latency : 64;
+    }
+    return 0;
+
+enomem:
+    ret = BVERROR(ENOMEM);
+fail:
+    fec_close(h);
+    return ret;
+}
+
+static int send_parity(BVURLContext *h, int type, uint16_t base, int stride,
+                       int count, uint8_t *data, int *len, int *len_xor)
+{
+    FECContext *s = h->priv_data;
+    int ret;
+
+    s->pkt[0] = type;
+    s->pkt[1] = count;
+    BV_WB16(s->pkt + 2, base);
+    s->pkt[4] = stride;
+    s->pkt[5] = 0;
+    BV_WB16(s->pkt + 6, *len_xor);
+    memcpy(s->pkt + PARITY_HEADER_SIZE, data, *len);
+    ret = bv_url_write(s->inner, s->pkt, PARITY_HEADER_SIZE + *len);
+
+    memset(data, 0, *len);
+    *len = *len_xor = 0;
+    return ret;
+}
+
+static int fec_write(BVURLContext *h, const uint8_t *buf, size_t size)
+{
+    FECContext *s = h->priv_data;
+    int c = s->index % s->cols;
+    int matrix = s->rows ? s->cols * s->rows : s->cols;
+    int i, ret;
+
+    s->pkt[0] = FEC_MEDIA;
+    s->pkt[1] = 0;
+    BV_WB16(s->pkt + 2, s->seq);
+    memcpy(s->pkt + MEDIA_HEADER_SIZE, buf, size);
+    if ((ret = bv_url_write(s->inner, s->pkt, MEDIA_HEADER_SIZE + size)) < 0)
+        return ret;
+
+    if (s->row_parity) {
+        bv_memxor(s->row, buf, size);
+        s->row_len      = BBMAX(s->row_len, size);
+        s->row_len_xor ^= size;
+        if (c == s->cols - 1 &&
+            (ret = send_parity(h, FEC_ROW, s->seq - c, 1, s->cols,
+                               s->row, &s->row_len, &s->row_len_xor)) < 0)
+            return ret;
+    }
+    if (s->rows) {
+        bv_memxor(s->col[c], buf, size);
+        s->col_len[c]      = BBMAX(s->col_len[c], size);
+        s->col_len_xor[c] ^= size;
+        if (s->index == matrix - 1) {
+            uint16_t base = s->seq - (matrix - 1);
+            for (i = 0; i < s->cols; i++)
+                if ((ret = send_parity(h, FEC_COLUMN, base + i, s->cols, s->rows,
+                                       s->col[i], &s->col_len[i], &s->col_len_xor[i])) < 0)
+                    return ret;
+        }
+    }
+    s->index = (s->index + 1) % matrix;
+    s->seq++;
+    return size;
+}
+
+static FECSlot *get_slot(FECContext *s, uint16_t seq)
+{
+    FECSlot *slot = &s->slots[seq & (RING_SIZE - 1)];
+    return slot->valid && slot->seq == seq ? slot : NULL;
+}
+
+static FECSlot *new_slot(FECContext *s, uint16_t seq)
+{
+    FECSlot *slot = &s->slots[seq & (RING_SIZE - 1)];
+
+    if (!slot->data && !(slot->data = bv_malloc(s->payload_size)))
+        return NULL;
+    slot->seq   = seq;
+    slot->valid = 1;
+    return slot;
+}
+
+/**
+ * Rebuild with parity p if exactly one of its datagrams is missing.
+ * @return 1 if a datagram was rebuilt, 0 otherwise
+ */
+static int recover(BVURLContext *h, FECParity *p)
+{
+    FECContext *s = h->priv_data;
+    uint16_t missing = 0;
+    int nb_missing = 0, len, k;
+    FECSlot *slot;
+
+    for (k = 0; k < p->count; k++) {
+        uint16_t seq = p->base + k * p->stride;
+        if (seq_diff(seq, s->next_seq) < -RING_SIZE / 2) {
+            /* what it covers has left the ring */
+            p->valid = 0;
+            return 0;
+        }
+        if (!get_slot(s, seq)) {
+            missing = seq;
+            nb_missing++;
+        }
+    }
+    if (nb_missing > 1)
+        return 0;
+    p->valid = 0;
+    if (!nb_missing || seq_diff(missing, s->next_seq) < 0)
+        return 0;
+
+    if (!(slot = new_slot(s, missing)))
+        return 0;
+    memcpy(slot->data, p->data, p->len);
+    len = p->len_xor;
+    for (k = 0; k < p->count; k++) {
+        uint16_t seq = p->base + k * p->stride;
+        FECSlot *other = seq != missing ? get_slot(s, seq) : NULL;
+        if (other) {
+            bv_memxor(slot->data, other->data, other->len);
+            len ^= other->len;
+        }
+    }
+    if (len > p->len) {
+        bv_log(h, BV_LOG_WARNING, "inconsistent parity for %d\n", missing);
+        slot->valid = 0;
+        return 0;
+    }
+    slot->len = len;
+    s->recovered++;
+    return 1;
+}
+
+static void recover_all(BVURLContext *h)
+{
+    FECContext *s = h->priv_data;
+    int i, progress;
+
+    do {
+        progress = 0;
+        for (i = 0; i < MAX_PARITIES; i++)
+            if (s->parities[i].valid)
+                progress |= recover(h, &s->parities[i]);
+    } while (progress);
+}
+
+static void add_media(BVURLContext *h, const uint8_t *pkt, int len)
+{
+    FECContext *s = h->priv_data;
+    uint16_t seq = BV_RB16(pkt + 2);
+    FECSlot *slot;
+
+    len -= MEDIA_HEADER_SIZE;
+    if (len > s->payload_size)
+        return;
+    if (!s->started) {
+        s->started  = 1;
+        s->next_seq = s->highest = seq;
+    } else if (seq_diff(seq, s->next_seq) < -RING_SIZE / 2 ||
+               seq_diff(seq, s->next_seq) >= RING_SIZE / 2) {
+        bv_log(h, BV_LOG_WARNING, "sequence jumped from %d to %d\n", s->next_seq, seq);
+        s->next_seq = s->highest = seq;
+    }
+    if (seq_diff(seq, s->highest) > 0)
+        s->highest = seq;
+    if (!(slot = new_slot(s, seq)))
+        return;
+    memcpy(slot->data, pkt + MEDIA_HEADER_SIZE, len);
+    slot->len = len;
+}
+
+static void add_parity(BVURLContext *h, const uint8_t *pkt, int len)
+{
+    FECContext *s = h->priv_data;
+    FECParity *p = &s->parities[s->next_parity];
+
+    len -= PARITY_HEADER_SIZE;
+    if (len > s->payload_size || !pkt[1] || !pkt[4] || !s->started)
+        return;
+    if (!p->data && !(p->data = bv_malloc(s->payload_size)))
+        return;
+    s->next_parity = (s->next_parity + 1) % MAX_PARITIES;
+
+    p->count   = pkt[1];
+    p->base    = BV_RB16(pkt + 2);
+    p->stride  = pkt[4];
+    p->len_xor = BV_RB16(pkt + 6);
+    p->len     = len;
+    p->valid   = 1;
+    memcpy(p->data, pkt + PARITY_HEADER_SIZE, len);
+
+    if (!s->latency) {
+        /* a column parity arrives after the whole matrix */
+        int window = pkt[0] == FEC_COLUMN ? p->stride * (p->count + 2) : 2 * p->count;
+        s->window = BBMIN(BBMAX(s->window, window), RING_SIZE / 2);
+    }
+}
+
+static int fec_read(BVURLContext *h, uint8_t *buf, size_t size)
+{
+    FECContext *s = h->priv_data;
+    FECSlot *slot;
+    int len;
+
+    for (;;) {
+        if (s->started && seq_diff(s->highest, s->next_seq) >= 0) {
+            if ((slot = get_slot(s, s->next_seq))) {
+                len = slot->len;
+                if (len > size) {
+                    bv_log(h, BV_LOG_WARNING, "Part of datagram lost due to insufficient buffer size\n");
+                    len = size;
+                }
+                memcpy(buf, slot->data, len);
+                s->next_seq++;
+                return len;
+            }
+            if (seq_diff(s->highest, s->next_seq) >= s->window) {
+                s->lost++;
+                s->next_seq++;
+                continue;
+            }
+        }
+
+        len = bv_url_read(s->inner, s->pkt, s->inner->max_packet_size);
+        if (len <= 0) {
+            /* nothing more to wait for, hand out what is there */
+            if (len != BVERROR(EAGAIN) && s->started &&
+                seq_diff(s->highest, s->next_seq) > 0) {
+                s->lost++;
+                s->next_seq++;
+                continue;
+            }
+            return len ? len : BVERROR_EOF;
+        }
+        if (s->pkt[0] == FEC_MEDIA && len >= MEDIA_HEADER_SIZE)
+            add_media(h, s->pkt, len);
+        else if ((s->pkt[0] == FEC_ROW || s->pkt[0] == FEC_COLUMN) && len >= PARITY_HEADER_SIZE)
+            add_parity(h, s->pkt, len);
+        else
+            continue;
+        recover_all(h);
+    }
+}
+
+static int fec_get_file_handle(BVURLContext *h)
+{
+    FECContext *s = h->priv_data;
+    return bv_url_get_file_handle(s->inner);
+}
+
+static int fec_close(BVURLContext *h)
+{
+    FECContext *s = h->priv_data;
+    int i;
+
+    if (s->slots)
+        bv_log(h, BV_LOG_DEBUG, "Statistics, recovered:%"PRId64" lost:%"PRId64"\n",
+               s->recovered, s->lost);
+    bv_url_closep(&s->inner);
+    bv_freep(&s->pkt);
+    bv_freep(&s->row);
+    for (i = 0; s->col && i < s->cols; i++)
+        bv_freep(&s->col[i]);
+    bv_freep(&s->col);
+    bv_freep(&s->col_len);
+    bv_freep(&s->col_len_xor);
+    for (i = 0; s->slots && i < RING_SIZE; i++)
+        bv_freep(&s->slots[i].data);
+    bv_freep(&s->slots);
+    for (i = 0; s->parities && i < MAX_PARITIES; i++)
+        bv_freep(&s->parities[i].data);
+    bv_freep(&s->parities);
+    return 0;
+}
+
+BVURLProtocol bv_fec_protocol = {
+    .name                = "fec",
+    .url_open            = fec_open,
+    .url_read            = fec_read,
+    .url_write           = fec_write,
+    .url_close           = fec_close,
+    .url_get_file_handle = fec_get_file_handle,
+    .priv_data_size      = sizeof(FECContext),
+    .priv_class          = &fec_class,
+    .flags               = BV_URL_PROTOCOL_FLAG_NESTED_SCHEME | BV_URL_PROTOCOL_FLAG_NETWORK,
+};
+
+#ifdef TEST
+#include <stdio.h>
+
+#include "libbvutil/network.h"
+
+#define TEST_PKT_SIZE 1316
+
+static int test_len(int seq)
+{
+    return 100 + seq * 37 % 1200;
+}
+
+static void test_fill(uint8_t *buf, int seq)
+{
+    int i;
+    for (i = 0; i < test_len(seq); i++)
+        buf[i] = seq * 13 + i;
+}
+
+static int test_dropped(const int *drop, int nb_drop, int seq)
+{
+    int i;
+    for (i = 0; i < nb_drop; i++)
+        if (drop[i] == seq)
+            return 1;
+    return 0;
+}
+
+/**
+ * Send nb_pkts datagrams in a cols x rows matrix, lose the media datagrams
+ * listed in drop between sender and receiver, and check what comes out.
+ * @return number of datagrams received intact, -1 on error
+ */
+static int test_fec(int cols, int rows, int nb_pkts, const int *drop, int nb_drop,
+                    int drop_parity, int64_t *recovered)
+{
+    BVURLContext *tx = NULL, *relay_in = NULL, *relay_out = NULL, *rx = NULL;
+    BVDictionary *opts = NULL;
+    uint8_t buf[TEST_PKT_SIZE], ref[TEST_PKT_SIZE];
+    int len, seq, next = 0, good = 0, nb_parity = 0, ret = -1;
+
+    bv_dict_set_int(&opts, "cols", cols, 0);
+    bv_dict_set_int(&opts, "rows", rows, 0);
+    if (bv_url_open(&rx, "fec:mem://fec_test_b?packet=1&pkt_size=1316", BV_IO_FLAG_READ, NULL, NULL) < 0 ||
+        bv_url_open(&relay_out, "mem://fec_test_b?packet=1&pkt_size=1316", BV_IO_FLAG_WRITE, NULL, NULL) < 0 ||
+        bv_url_open(&relay_in, "mem://fec_test_a?packet=1&pkt_size=1316", BV_IO_FLAG_READ, NULL, NULL) < 0 ||
+        bv_url_open(&tx, "fec:mem://fec_test_a?packet=1&pkt_size=1316", BV_IO_FLAG_WRITE, NULL, &opts) < 0) {
+        printf("open failed\n");
+        goto end;
+    }
+
+    for (seq = 0; seq < nb_pkts; seq++) {
+        test_fill(buf, seq);
+        if (bv_url_write(tx, buf, test_len(seq)) < 0) {
+            printf("write %d failed\n", seq);
+            goto end;
+        }
+    }
+    bv_url_closep(&tx);
+
+    /* the lossy link */
+    while ((len = bv_url_read(relay_in, buf, sizeof(buf))) > 0) {
+        if (buf[0] == FEC_MEDIA && test_dropped(drop, nb_drop, BV_RB16(buf + 2)))
+            continue;
+        if (buf[0] != FEC_MEDIA && nb_parity++ == drop_parity)
+            continue;
+        bv_url_write(relay_out, buf, len);
+    }
+    bv_url_closep(&relay_out);
+
+    while ((len = bv_url_read(rx, buf, sizeof(buf))) > 0) {
+        FECContext *s = rx->priv_data;
+        /* next_seq has moved past the datagram just returned */
+        seq = (uint16_t)(s->next_seq - 1);
+        if (seq < next) {
+            printf("datagram %d out of order after %d\n", seq, next);
+            goto end;
+        }
+        next = seq + 1;
+        test_fill(ref, seq);
+        if (len == test_len(seq) && !memcmp(buf, ref, len))
+            good++;
+        else
+            printf("datagram %d corrupted\n", seq);
+    }
+    *recovered = ((FECContext *)rx->priv_data)->recovered;
+    ret = good;
+end:
+    bv_url_closep(&tx);
+    bv_url_closep(&relay_in);
+    bv_url_closep(&relay_out);
+    bv_url_closep(&rx);
+    bv_dict_free(&opts);
+    return ret;
+}
+
+int main(void)
+{
+    /* matrix 0: a row rebuild enables the column ones;
+     * matrix 1: row, then column, then row again */
+    static const int drop1[] = { 1, 5, 6, 20, 21, 24 };
+    /* two by two square, no row or column misses only one */
+    static const int drop2[] = { 20, 21, 24, 25 };
+    /* two in a row, and one whose row parity is lost too */
+    static const int drop3[] = { 5, 6, 12 };
+    int64_t recovered = 0;
+    int ret, err = 0;
+
+    bv_protocol_register_all();
+    bv_network_init();
+
+    ret = test_fec(4, 4, 48, drop1, BV_ARRAY_ELEMS(drop1), 100, &recovered);
+    if (ret != 48 || recovered != 6) {
+        printf("row/column: %d intact, %"PRId64" recovered\n", ret, recovered);
+        err = 1;
+    }
+    ret = test_fec(4, 4, 48, drop2, BV_ARRAY_ELEMS(drop2), 100, &recovered);
+    if (ret != 44 || recovered != 0) {
+        printf("square loss: %d intact, %"PRId64" recovered\n", ret, recovered);
+        err = 1;
+    }
+    /* parity 2 is the one of the third row */
+    ret = test_fec(5, 4, 40, drop3, BV_ARRAY_ELEMS(drop3), 2, &recovered);
+    if (ret != 40 || recovered != 3) {
+        printf("column: %d intact, %"PRId64" recovered\n", ret, recovered);
+        err = 1;
+    }
+    printf("%s\n", err ? "FAIL" : "OK");
+    return err;
+}
+#endif /* TEST */
@@ -99,6 +99,14 @@ typedef struct HTTPContext {
     char *method;
     int reconnect;
     int listen;
+    /* Set if the server allows another request on the connection. */
+    int keep_alive;
+    /* A flag which indicates the last chunk of the reply was read. */
+    int chunked_eof;
+    int pool;
+    int pool_max_idle;
+    int pool_max_conns;
+    int64_t pool_idle_timeout;
 } HTTPContext;
 
 #define OFFSET(x) offsetof(HTTPContext, x)
@@ -131,6 +139,10 @@ static const BVOption options[] = {
     { "method", "Override the HTTP method", OFFSET(method), BV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, E },
     { "reconnect", "auto reconnect after disconnect before EOF", OFFSET(reconnect), BV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, D },
     { "listen", "listen on HTTP", OFFSET(listen), BV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, D | E },
+    { "pool", "share persistent connections through the process wide pool", OFFSET(pool), BV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, D | E },
+    { "pool_max_idle", "maximum number of idle pooled connections per host", OFFSET(pool_max_idle), BV_OPT_TYPE_INT, { .i64 = 4 }, 0, INT_MAX, D | E },
+    { "pool_max_conns", "maximum number of pooled connections in use per host, 0 for no limit", OFFSET(pool_max_conns), BV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, D | E },
+    { "pool_idle_timeout", "close pooled connections idle for longer than this (in microseconds), on the next use of the pool", OFFSET(pool_idle_timeout), BV_OPT_TYPE_INT64, { .i64 = 10000000 }, 0, INT64_MAX, D | E },
     { NULL }
 };
 
@@ -138,6 +150,7 @@ static int http_connect(BVURLContext *h, const char *path, const char *local_pat
                         const char *hoststr, const char *auth,
                         const char *proxyauth, int *new_location);
 static int http_read_header(BVURLContext *h, int *new_location);
+static void http_close_cnx(BVURLContext *h);
 
 void bv_http_init_auth_state(BVURLContext *dest, const BVURLContext *src)
 {
@@ -149,6 +162,21 @@ void bv_http_init_auth_state(BVURLContext *dest, const BVURLContext *src)
            sizeof(HTTPAuthState));
 }
 
+/* Whether a request may be sent again, the server having maybe seen it. */
+static int http_idempotent(BVURLContext *h)
+{
+    static const char *const methods[] = { "GET", "HEAD", "PUT", "DELETE", "OPTIONS", "TRACE" };
+    HTTPContext *s = h->priv_data;
+    int i;
+
+    if (!s->method)
+        return !(h->flags & BV_IO_FLAG_WRITE) && !s->post_data;
+    for (i = 0; i < BV_ARRAY_ELEMS(methods); i++)
+        if (!bv_strcasecmp(s->method, methods[i]))
+            return 1;
+    return 0;
+}
+
 static int http_open_cnx_internal(BVURLContext *h, BVDictionary **options)
 {
     const char *path, *proxy_path, *lower_proto = "tcp", *local_path;
@@ -156,7 +184,7 @@ static int http_open_cnx_internal(BVURLContext *h, BVDictionary **options)
     char auth[1024], proxyauth[1024] = "";
     char path1[MAX_URL_SIZE];
     char buf[1024], urlbuf[MAX_URL_SIZE];
-    int port, use_proxy, err, location_changed = 0;
+    int port, use_proxy, err, location_changed = 0, reused = 0;
     HTTPContext *s = h->priv_data;
 
     bv_url_split(proto, sizeof(proto), auth, sizeof(auth),
@@ -196,15 +224,29 @@ static int http_open_cnx_internal(BVURLContext *h, BVDictionary **options)
             lower_proto, hostname, port);
     bv_url_join(buf, sizeof(buf), lower_proto, NULL, hostname, port, NULL);
 
-    if (!s->hd) {
-        err = bv_url_open(&s->hd, buf, BV_IO_FLAG_READ_WRITE,
-                         &h->interrupt_callback, options);
-        if (err < 0)
-            return err;
-    }
+    for (;;) {
+        if (!s->hd) {
+            if (s->pool)
+                reused = bv_http_pool_open(&s->hd, buf, BV_IO_FLAG_READ_WRITE,
+                                           &h->interrupt_callback, options,
+                                           s->pool_max_conns, h->rw_timeout);
+            else
+                reused = bv_url_open(&s->hd, buf, BV_IO_FLAG_READ_WRITE,
+                                     &h->interrupt_callback, options);
+            if (reused < 0)
+                return reused;
+        }
 
-    err = http_connect(h, path, local_path, hoststr,
-                       auth, proxyauth, &location_changed);
+        s->http_code = 0;
+        err = http_connect(h, path, local_path, hoststr,
+                           auth, proxyauth, &location_changed);
+        /* the server may have dropped the idle connection just now, but
+         * it may also have acted on the request */
+        if (err >= 0 || reused <= 0 || s->http_code || !http_idempotent(h))
+            break;
+        bv_log(h, BV_LOG_DEBUG, "Pooled connection failed, retrying\n");
+        bv_http_pool_close(&s->hd, 0, 0, 0);
+    }
     if (err < 0)
         return err;
 
@@ -230,7 +272,7 @@ redo:
     if (s->http_code == HTTP_STATUS_UNAUTHORIZED) {
         if ((cur_auth_type == HTTP_AUTH_NONE || s->auth_state.stale) &&
             s->auth_state.auth_type != HTTP_AUTH_NONE && attempts < 4) {
-            bv_url_closep(&s->hd);
+            http_close_cnx(h);
             goto redo;
         } else
             goto fail;
@@ -238,7 +280,7 @@ redo:
     if (s->http_code == HTTP_STATUS_PROXY_AUTH_REQUIRED) {
         if ((cur_proxy_auth_type == HTTP_AUTH_NONE || s->proxy_auth_state.stale) &&
             s->proxy_auth_state.auth_type != HTTP_AUTH_NONE && attempts < 4) {
-            bv_url_closep(&s->hd);
+            http_close_cnx(h);
             goto redo;
         } else
             goto fail;
@@ -247,7 +289,7 @@ redo:
          s->http_code == HTTP_STATUS_SEE_OTHER || s->http_code == 307) &&
         location_changed == 1) {
         /* url moved, get next */
-        bv_url_closep(&s->hd);
+        http_close_cnx(h);
         if (redirects++ >= MAX_REDIRECTS)
             return BVERROR(EIO);
         /* Restart the authentication process with the new target, which
@@ -260,8 +302,7 @@ redo:
     return 0;
 
 fail:
-    if (s->hd)
-        bv_url_closep(&s->hd);
+    http_close_cnx(h);
     if (location_changed < 0)
         return location_changed;
     return bv_http_averror(s->http_code, BVERROR(EIO));
@@ -362,45 +403,61 @@ static int http_open(BVURLContext *h, const char *uri, int flags,
     return ret;
 }
 
-static int http_getc(HTTPContext *s)
+/**
+ * Find the next line in the buffered input, refilling it as needed.
+ * The line is left in place in the buffer, NUL-terminated without its
+ * line ending.
+ */
+static int http_next_line(BVURLContext *h, char **line, int *len)
 {
-    int len;
-    if (s->buf_ptr >= s->buf_end) {
-        len = bv_url_read(s->hd, s->buffer, BUFFER_SIZE);
-        if (len < 0) {
-            return len;
-        } else if (len == 0) {
-            return BVERROR_EOF;
-        } else {
+    HTTPContext *s = h->priv_data;
+    uint8_t *nl;
+    int ret, left;
+
+    while (!(nl = memchr(s->buf_ptr, '\n', s->buf_end - s->buf_ptr))) {
+        left = s->buf_end - s->buf_ptr;
+        if (s->buf_ptr > s->buffer) {
+            memmove(s->buffer, s->buf_ptr, left);
             s->buf_ptr = s->buffer;
-            s->buf_end = s->buffer + len;
+            s->buf_end = s->buffer + left;
         }
+        if (left == BUFFER_SIZE) {
+            bv_log(h, BV_LOG_ERROR, "HTTP header line longer than %d bytes\n", BUFFER_SIZE);
+            return BVERROR_INVALIDDATA;
+        }
+        ret = bv_url_read(s->hd, s->buf_end, BUFFER_SIZE - left);
+        if (ret < 0)
+            return ret;
+        if (!ret)
+            return BVERROR_EOF;
+        s->buf_end += ret;
     }
-    return *s->buf_ptr++;
+    *line = (char *)s->buf_ptr;
+    *len  = nl - s->buf_ptr;
+    s->buf_ptr = nl + 1;
+    if (*len && (*line)[*len - 1] == '\r')
+        (*len)--;
+    (*line)[*len] = '\0';
+    return 0;
 }
 
-static int http_get_line(HTTPContext *s, char *line, int line_size)
+int bv_http_split_header(char *line, int len, BVHTTPHeader *hdr)
 {
-    int ch;
-    char *q;
+    char *colon = memchr(line, ':', len), *end = line + len, *p;
 
-    q = line;
-    for (;;) {
-        ch = http_getc(s);
-        if (ch < 0)
-            return ch;
-        if (ch == '\n') {
-            /* process line */
-            if (q > line && q[-1] == '\r')
-                q--;
-            *q = '\0';
-
-            return 0;
-        } else {
-            if ((q - line) < line_size - 1)
-                *q++ = ch;
-        }
-    }
+    if (!colon || colon == line)
+        return BVERROR_INVALIDDATA;
+    *colon = '\0';
+    for (p = colon + 1; p < end && bv_isspace(*p); p++)
+        ;
+    while (end > p && bv_isspace(end[-1]))
+        end--;
+    *end = '\0';
+    hdr->name      = line;
+    hdr->name_len  = colon - line;
+    hdr->value     = p;
+    hdr->value_len = end - p;
+    return 0;
 }
 
 static int check_http_code(BVURLContext *h, int http_code, const char *end)
@@ -540,88 +597,97 @@ static int cookie_string(BVDictionary *dict, char **cookies)
     return 0;
 }
 
-static int process_line(BVURLContext *h, char *line, int line_count,
+#define HEADER_IS(hdr, str) \
+    ((hdr)->name_len == sizeof(str) - 1 && !bv_strncasecmp((hdr)->name, str, sizeof(str) - 1))
+
+static int process_line(BVURLContext *h, char *line, int len, int line_count,
                         int *new_location)
 {
     HTTPContext *s = h->priv_data;
-    char *tag, *p, *end;
+    BVHTTPHeader hdr;
+    const char *p;
+    char *end;
     int ret;
 
     /* end of header */
-    if (line[0] == '\0') {
+    if (!len) {
         s->end_header = 1;
         return 0;
     }
 
-    p = line;
     if (line_count == 0) {
+        p = line;
         while (!bv_isspace(*p) && *p != '\0')
             p++;
         while (bv_isspace(*p))
             p++;
         s->http_code = strtol(p, &end, 10);
+        if (!strncmp(line, "HTTP/1.0", 8))
+            s->keep_alive = 0;
 
         bv_log(h, BV_LOG_DEBUG, "http_code=%d\n", s->http_code);
 
         if ((ret = check_http_code(h, s->http_code, end)) < 0)
             return ret;
-    } else {
-        while (*p != '\0' && *p != ':')
-            p++;
-        if (*p != ':')
-            return 1;
+        return 1;
+    }
 
-        *p  = '\0';
-        tag = line;
-        p++;
-        while (bv_isspace(*p))
-            p++;
-        if (!bv_strcasecmp(tag, "Location")) {
-            if ((ret = parse_location(s, p)) < 0)
-                return ret;
-            *new_location = 1;
-        } else if (!bv_strcasecmp(tag, "Content-Length") && s->filesize == -1) {
+    /* obsolete line folding, the continuation is dropped */
+    if (*line == ' ' || *line == '\t')
+        return 1;
+    if (bv_http_split_header(line, len, &hdr) < 0)
+        return 1;
+    p = hdr.value;
+    /* the length check makes most mismatches a single compare */
+    if (HEADER_IS(&hdr, "Location")) {
+        if ((ret = parse_location(s, p)) < 0)
+            return ret;
+        *new_location = 1;
+    } else if (HEADER_IS(&hdr, "Content-Length")) {
+        if (s->filesize == -1)
             s->filesize = strtoll(p, NULL, 10);
-        } else if (!bv_strcasecmp(tag, "Content-Range")) {
-            parse_content_range(h, p);
-        } else if (!bv_strcasecmp(tag, "Accept-Ranges") &&
-                   !strncmp(p, "bytes", 5) &&
-                   s->seekable == -1) {
+    } else if (HEADER_IS(&hdr, "Content-Range")) {
+        parse_content_range(h, p);
+    } else if (HEADER_IS(&hdr, "Accept-Ranges")) {
+        if (!strncmp(p, "bytes", 5) && s->seekable == -1)
             h->is_streamed = 0;
-        } else if (!bv_strcasecmp(tag, "Transfer-Encoding") &&
-                   !bv_strncasecmp(p, "chunked", 7)) {
+    } else if (HEADER_IS(&hdr, "Transfer-Encoding")) {
+        if (!bv_strncasecmp(p, "chunked", 7)) {
             s->filesize  = -1;
             s->chunksize = 0;
-        } else if (!bv_strcasecmp(tag, "WWW-Authenticate")) {
-            bv_http_auth_handle_header(&s->auth_state, tag, p);
-        } else if (!bv_strcasecmp(tag, "Authentication-Info")) {
-            bv_http_auth_handle_header(&s->auth_state, tag, p);
-        } else if (!bv_strcasecmp(tag, "Proxy-Authenticate")) {
-            bv_http_auth_handle_header(&s->proxy_auth_state, tag, p);
-        } else if (!bv_strcasecmp(tag, "Connection")) {
-            if (!strcmp(p, "close"))
-                s->willclose = 1;
-        } else if (!bv_strcasecmp(tag, "Server")) {
-            if (!bv_strcasecmp(p, "AkamaiGHost")) {
-                s->is_akamai = 1;
-            } else if (!bv_strncasecmp(p, "MediaGateway", 12)) {
-                s->is_mediagateway = 1;
-            }
-        } else if (!bv_strcasecmp(tag, "Content-Type")) {
-            bv_free(s->mime_type);
-            s->mime_type = bv_strdup(p);
-        } else if (!bv_strcasecmp(tag, "Set-Cookie")) {
-            if (parse_cookie(s, p, &s->cookie_dict))
-                bv_log(h, BV_LOG_WARNING, "Unable to parse '%s'\n", p);
-        } else if (!bv_strcasecmp(tag, "Icy-MetaInt")) {
-            s->icy_metaint = strtoll(p, NULL, 10);
-        } else if (!bv_strncasecmp(tag, "Icy-", 4)) {
-            if ((ret = parse_icy(s, tag, p)) < 0)
-                return ret;
-        } else if (!bv_strcasecmp(tag, "Content-Encoding")) {
-            if ((ret = parse_content_encoding(h, p)) < 0)
-                return ret;
         }
+    } else if (HEADER_IS(&hdr, "WWW-Authenticate") ||
+               HEADER_IS(&hdr, "Authentication-Info")) {
+        bv_http_auth_handle_header(&s->auth_state, hdr.name, p);
+    } else if (HEADER_IS(&hdr, "Proxy-Authenticate")) {
+        bv_http_auth_handle_header(&s->proxy_auth_state, hdr.name, p);
+    } else if (HEADER_IS(&hdr, "Connection")) {
+        if (!strcmp(p, "close")) {
+            s->willclose  = 1;
+            s->keep_alive = 0;
+        } else if (!bv_strcasecmp(p, "keep-alive")) {
+            s->keep_alive = 1;
+        }
+    } else if (HEADER_IS(&hdr, "Server")) {
+        if (!bv_strcasecmp(p, "AkamaiGHost")) {
+            s->is_akamai = 1;
+        } else if (!bv_strncasecmp(p, "MediaGateway", 12)) {
+            s->is_mediagateway = 1;
+        }
+    } else if (HEADER_IS(&hdr, "Content-Type")) {
+        bv_free(s->mime_type);
+        s->mime_type = bv_strndup(p, hdr.value_len);
+    } else if (HEADER_IS(&hdr, "Set-Cookie")) {
+        if (parse_cookie(s, p, &s->cookie_dict))
+            bv_log(h, BV_LOG_WARNING, "Unable to parse '%s'\n", p);
+    } else if (HEADER_IS(&hdr, "Icy-MetaInt")) {
+        s->icy_metaint = strtoll(p, NULL, 10);
+    } else if (hdr.name_len > 4 && !bv_strncasecmp(hdr.name, "Icy-", 4)) {
+        if ((ret = parse_icy(s, hdr.name, p)) < 0)
+            return ret;
+    } else if (HEADER_IS(&hdr, "Content-Encoding")) {
+        if ((ret = parse_content_encoding(h, p)) < 0)
+            return ret;
     }
     return 1;
 }
@@ -741,18 +807,18 @@ static inline int has_header(const char *str, const char *header)
 static int http_read_header(BVURLContext *h, int *new_location)
 {
     HTTPContext *s = h->priv_data;
-    char line[MAX_URL_SIZE];
-    int err = 0;
+    char *line;
+    int len, err = 0;
 
     s->chunksize = -1;
 
     for (;;) {
-        if ((err = http_get_line(s, line, sizeof(line))) < 0)
+        if ((err = http_next_line(h, &line, &len)) < 0)
             return err;
 
         bv_log(h, BV_LOG_DEBUG, "header='%s'\n", line);
 
-        err = process_line(h, line, s->line_count, new_location);
+        err = process_line(h, line, len, s->line_count, new_location);
         if (err < 0)
             return err;
         if (err == 0)
@@ -838,7 +904,7 @@ static int http_connect(BVURLContext *h, const char *path, const char *local_pat
                            "Expect: 100-continue\r\n");
 
     if (!has_header(s->headers, "\r\nConnection: ")) {
-        if (s->multiple_requests)
+        if (s->multiple_requests || s->pool)
             len += bv_strlcpy(headers + len, "Connection: keep-alive\r\n",
                               sizeof(headers) - len);
         else
@@ -903,6 +969,8 @@ static int http_connect(BVURLContext *h, const char *path, const char *local_pat
     s->icy_data_read    = 0;
     s->filesize         = -1;
     s->willclose        = 0;
+    s->keep_alive       = 1;
+    s->chunked_eof      = 0;
     s->end_chunked_post = 0;
     s->end_header       = 0;
     if (post && !s->post_data && !send_expect_100) {
@@ -1005,20 +1073,23 @@ static int http_read_stream(BVURLContext *h, uint8_t *buf, int size)
 
     if (s->chunksize >= 0) {
         if (!s->chunksize) {
-            char line[32];
+            char *line;
+            int len;
 
                 do {
-                    if ((err = http_get_line(s, line, sizeof(line))) < 0)
+                    if ((err = http_next_line(h, &line, &len)) < 0)
                         return err;
-                } while (!*line);    /* skip CR LF from last chunk */
+                } while (!len);    /* skip CR LF from last chunk */
 
                 s->chunksize = strtoll(line, NULL, 16);
 
                 bv_dlog(NULL, "Chunked encoding data size: %"PRId64"'\n",
                         s->chunksize);
 
-                if (!s->chunksize)
+                if (!s->chunksize) {
+                    s->chunked_eof = 1;
                     return 0;
+                }
         }
         size = BBMIN(size, s->chunksize);
     }
@@ -1027,7 +1098,8 @@ static int http_read_stream(BVURLContext *h, uint8_t *buf, int size)
         return http_buf_read_compressed(h, buf, size);
 #endif /* BV_CONFIG_ZLIB */
     read_ret = http_buf_read(h, buf, size);
-    if (read_ret < 0 && s->reconnect && !h->is_streamed && s->filesize > 0 && s->off < s->filesize) {
+    if (read_ret < 0 && read_ret != BVERROR(EAGAIN) && !(h->flags & BV_IO_FLAG_NONBLOCK) &&
+        s->reconnect && !h->is_streamed && s->filesize > 0 && s->off < s->filesize) {
         bv_log(h, BV_LOG_INFO, "Will reconnect at %"PRId64".\n", s->off);
         seek_ret = http_seek_internal(h, s->off, SEEK_SET, 1);
         if (seek_ret != s->off) {
@@ -1121,8 +1193,19 @@ static int store_icy(BVURLContext *h, int size)
 static int http_read(BVURLContext *h, uint8_t *buf, size_t size)
 {
     HTTPContext *s = h->priv_data;
+    int nonblock = h->flags & BV_IO_FLAG_NONBLOCK, hd_flags = 0;
     int rsize = 0;
 
+    if (nonblock) {
+        /* icy metadata and trailing headers are read all at once */
+        if (s->icy_metaint > 0 || (s->end_chunked_post && !s->end_header))
+            return BVERROR(ENOSYS);
+        if (!s->hd)
+            return BVERROR_EOF;
+        hd_flags = s->hd->flags;
+        s->hd->flags |= BV_IO_FLAG_NONBLOCK;
+    }
+
     if (s->icy_metaint > 0) {
         rsize = store_icy(h, size);
         if (rsize < 0)
@@ -1132,6 +1215,8 @@ static int http_read(BVURLContext *h, uint8_t *buf, size_t size)
     rsize = http_read_stream(h, buf, size);
     if (rsize > 0)
         s->icy_data_read += rsize;
+    if (nonblock)
+        s->hd->flags = hd_flags;
     return rsize;
 }
 
@@ -1145,8 +1230,15 @@ static int http_write(BVURLContext *h, const uint8_t *buf, size_t size)
 
     if (!s->chunked_post) {
         /* non-chunked data is sent without any special encoding */
-        return bv_url_write(s->hd, buf, size);
+        int hd_flags = s->hd->flags;
+        s->hd->flags |= h->flags & BV_IO_FLAG_NONBLOCK;
+        ret = bv_url_write(s->hd, buf, size);
+        s->hd->flags = hd_flags;
+        return ret;
     }
+    /* a chunk goes out in three writes, which must not stop halfway */
+    if (h->flags & BV_IO_FLAG_NONBLOCK)
+        return BVERROR(ENOSYS);
 
     /* silently ignore zero-size data since chunk encoding that would
      * signal EOF */
@@ -1178,6 +1270,48 @@ static int http_shutdown(BVURLContext *h, int flags)
     return ret;
 }
 
+/* Whether s->hd is at the start of the next reply, i.e. can be pooled. */
+static int http_cnx_reusable(BVURLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+    char *line;
+    int len, flags, ret;
+
+    if (!s->pool || s->listen || !s->keep_alive || !s->end_header)
+        return 0;
+    if (s->chunksize >= 0) {
+        if (!s->chunked_eof)
+            return 0;
+        /* skip the trailer up to the final empty line, if it is there
+         * already: waiting for it would block the close */
+        flags = s->hd->flags;
+        s->hd->flags |= BV_IO_FLAG_NONBLOCK;
+        do {
+            ret = http_next_line(h, &line, &len);
+        } while (ret >= 0 && len);
+        s->hd->flags = flags;
+        if (ret < 0)
+            return 0;
+        s->chunked_eof = 0;
+    } else if (s->filesize < 0 || s->off < s->filesize) {
+        /* replies which never have a body */
+        if (!(s->http_code == 204 || s->http_code == 304 ||
+              (s->method && !bv_strcasecmp(s->method, "HEAD"))))
+            return 0;
+    }
+    return s->buf_ptr == s->buf_end;
+}
+
+static void http_close_cnx(BVURLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+
+    if (!s->hd)
+        return;
+    bv_http_pool_close(&s->hd, http_cnx_reusable(h),
+                       s->pool_max_idle, s->pool_idle_timeout);
+}
+
 static int http_close(BVURLContext *h)
 {
     int ret = 0;
@@ -1192,8 +1326,7 @@ static int http_close(BVURLContext *h)
         /* Close the write direction by sending the end of chunked encoding. */
         ret = http_shutdown(h, h->flags);
 
-    if (s->hd)
-        bv_url_closep(&s->hd);
+    http_close_cnx(h);
     bv_dict_free(&s->chained_options);
     return ret;
 }
@@ -1242,7 +1375,7 @@ static int64_t http_seek_internal(BVURLContext *h, int64_t off, int whence, int
         return ret;
     }
     bv_dict_free(&options);
-    bv_url_close(old_hd);
+    bv_http_pool_close(&old_hd, 0, 0, 0);
     return off;
 }
 
@@ -1279,7 +1412,7 @@ BVURLProtocol bv_http_protocol = {
     .url_shutdown        = http_shutdown,
     .priv_data_size      = sizeof(HTTPContext),
     .priv_class          = &http_context_class,
-    .flags               = BV_URL_PROTOCOL_FLAG_NETWORK,
+    .flags               = BV_URL_PROTOCOL_FLAG_NETWORK | BV_URL_PROTOCOL_FLAG_NONBLOCK,
 };
 #endif /* BV_CONFIG_HTTP_PROTOCOL */
 
@@ -1297,7 +1430,7 @@ BVURLProtocol bv_https_protocol = {
     .url_shutdown        = http_shutdown,
     .priv_data_size      = sizeof(HTTPContext),
     .priv_class          = &https_context_class,
-    .flags               = URL_PROTOCOL_FLAG_NETWORK,
+    .flags               = BV_URL_PROTOCOL_FLAG_NETWORK | BV_URL_PROTOCOL_FLAG_NONBLOCK,
 };
 #endif /* BV_CONFIG_HTTPS_PROTOCOL */
 
@@ -1410,3 +1543,245 @@ BVURLProtocol bv_httpproxy_protocol = {
     .flags               = BV_URL_PROTOCOL_FLAG_NETWORK,
 };
 #endif /* BV_CONFIG_HTTPPROXY_PROTOCOL */
+
+#ifdef TEST
+#include <pthread.h>
+#include <stdio.h>
+
+#include "libbvutil/time.h"
+
+typedef struct TestServer {
+    int port;
+    const char *reply;
+} TestServer;
+
+/* answer one connection with a canned reply */
+static void *test_server(void *arg)
+{
+    TestServer *t = arg;
+    BVURLContext *c = NULL;
+    char url[64], buf[4096];
+
+    snprintf(url, sizeof(url), "tcp://127.0.0.1:%d?listen=1", t->port);
+    if (bv_url_open(&c, url, BV_IO_FLAG_READ_WRITE, NULL, NULL) < 0)
+        return NULL;
+    bv_url_read(c, buf, sizeof(buf));
+    bv_url_write(c, t->reply, strlen(t->reply));
+    bv_url_closep(&c);
+    return NULL;
+}
+
+/**
+ * Fetch a reply from a local stand-in server.
+ * @return the open result, the body and http context are left in h
+ */
+static int test_fetch(BVURLContext **h, int port, const char *reply)
+{
+    TestServer t = { port, reply };
+    pthread_t thread;
+    char url[64];
+    int ret;
+
+    pthread_create(&thread, NULL, test_server, &t);
+    bv_usleep(50000);
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/", port);
+    ret = bv_url_open(h, url, BV_IO_FLAG_READ, NULL, NULL);
+    pthread_join(thread, NULL);
+    return ret;
+}
+
+typedef struct TestPoolServer {
+    int fd;
+    int conn;                   ///< connection being served
+    int nb_conns;
+    int nb_requests;
+    int drop[2];                ///< requests closed unanswered, from 1
+} TestPoolServer;
+
+/* keep-alive stand-in, serves one connection at a time */
+static void *test_pool_server(void *arg)
+{
+    static const char reply[] =
+        "HTTP/1.1 200 OK\r\nContent-Length: 2\r\nConnection: keep-alive\r\n\r\nok";
+    TestPoolServer *t = arg;
+    char buf[4096];
+    int fd, len, n;
+
+    while ((fd = accept(t->fd, NULL, NULL)) >= 0) {
+        t->conn = fd;
+        t->nb_conns++;
+        len = 0;
+        while ((n = recv(fd, buf + len, sizeof(buf) - 1 - len, 0)) > 0) {
+            len += n;
+            buf[len] = 0;
+            if (!strstr(buf, "\r\n\r\n"))
+                continue;
+            len = 0;
+            t->nb_requests++;
+            /* as if the idle timeout of the server hit just then */
+            if (t->nb_requests == t->drop[0] || t->nb_requests == t->drop[1])
+                break;
+            if (send(fd, reply, sizeof(reply) - 1, MSG_NOSIGNAL) < 0)
+                break;
+        }
+        closesocket(fd);
+    }
+    return NULL;
+}
+
+/**
+ * Fetch the "ok" body through the pool, at most one connection in use.
+ * @return 0, or a negative value on failure; h is left open
+ */
+static int test_pool_get(BVURLContext **h, int port, const char *method)
+{
+    BVDictionary *opts = NULL;
+    char url[64], body[2];
+    int ret;
+
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/", port);
+    bv_dict_set(&opts, "pool", "1", 0);
+    bv_dict_set(&opts, "pool_max_conns", "1", 0);
+    if (method)
+        bv_dict_set(&opts, "method", method, 0);
+    ret = bv_url_open(h, url, BV_IO_FLAG_READ, NULL, &opts);
+    bv_dict_free(&opts);
+    if (ret < 0)
+        return ret;
+    if (bv_url_read_complete(*h, body, sizeof(body)) != sizeof(body) || memcmp(body, "ok", 2))
+        return -1;
+    return 0;
+}
+
+typedef struct TestPoolClient {
+    int port;
+    int ret;
+    int done;
+} TestPoolClient;
+
+static void *test_pool_client(void *arg)
+{
+    TestPoolClient *t = arg;
+    BVURLContext *h = NULL;
+
+    t->ret  = test_pool_get(&h, t->port, NULL);
+    t->done = 1;
+    bv_url_closep(&h);
+    return NULL;
+}
+
+int main(void)
+{
+    static const char folded[] =
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/plain\r\n"
+        "X-Folded: first\r\n"
+        " Content-Length: 999\r\n"
+        "\tContent-Type: bogus\r\n"
+        "X-Empty:\r\n"
+        "X-Blank:   \r\n"
+        ": no name\r\n"
+        "Content-Length: 5\r\n"
+        "\r\n"
+        "hello";
+    static char long_line[BUFFER_SIZE + 256];
+    BVURLContext *h = NULL;
+    HTTPContext *s;
+    TestPoolServer pool = { -1, -1, 0, 0, { 3, 5 } };
+    TestPoolClient waiter = { 0 };
+    struct sockaddr_in addr = { 0 };
+    pthread_t pool_thread, waiter_thread;
+    char body[16];
+    int port = 20000 + getpid() % 20000, ret, err = 0;
+
+    bv_protocol_register_all();
+    bv_network_init();
+
+    /* folded lines are not taken for headers, empty values are fine */
+    if ((ret = test_fetch(&h, port, folded)) < 0) {
+        printf("folded: open failed %d\n", ret);
+        err = 1;
+    } else {
+        s = h->priv_data;
+        ret = bv_url_read_complete(h, body, sizeof(body));
+        if (s->filesize != 5 || !s->mime_type || strcmp(s->mime_type, "text/plain") ||
+            ret != 5 || memcmp(body, "hello", 5)) {
+            printf("folded: size %"PRId64" type %s body %d\n", s->filesize, s->mime_type, ret);
+            err = 1;
+        }
+    }
+    bv_url_closep(&h);
+
+    /* a header line longer than the buffer is refused */
+    snprintf(long_line, sizeof(long_line), "HTTP/1.1 200 OK\r\nX-Long: ");
+    memset(long_line + strlen(long_line), 'a', BUFFER_SIZE);
+    strcat(long_line, "\r\nContent-Length: 0\r\n\r\n");
+    if ((ret = test_fetch(&h, port + 1, long_line)) != BVERROR_INVALIDDATA) {
+        printf("long: open returned %d\n", ret);
+        err = 1;
+    }
+    bv_url_closep(&h);
+
+    /* pooled connections against a keep-alive server */
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port + 2);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if ((pool.fd = socket(AF_INET, SOCK_STREAM, 0)) < 0 ||
+        bind(pool.fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(pool.fd, 4) < 0 ||
+        pthread_create(&pool_thread, NULL, test_pool_server, &pool)) {
+        printf("pool: cannot start the server\n");
+        err = 1;
+        goto end;
+    }
+    /* the second request reuses the idle connection */
+    if (test_pool_get(&h, port + 2, NULL) < 0 || (bv_url_closep(&h), test_pool_get(&h, port + 2, NULL) < 0) ||
+        pool.nb_conns != 1 || pool.nb_requests != 2) {
+        printf("pool: reuse, %d connections for %d requests\n", pool.nb_conns, pool.nb_requests);
+        err = 1;
+    }
+    bv_url_closep(&h);
+    /* request 3 finds the connection closed, a GET is sent again */
+    if (test_pool_get(&h, port + 2, NULL) < 0 || pool.nb_conns != 2 || pool.nb_requests != 4) {
+        printf("pool: retry, %d connections for %d requests\n", pool.nb_conns, pool.nb_requests);
+        err = 1;
+    }
+    bv_url_closep(&h);
+    /* request 5 too, but a POST may have been acted on */
+    if (test_pool_get(&h, port + 2, "POST") >= 0) {
+        printf("pool: POST retried\n");
+        err = 1;
+    }
+    bv_url_closep(&h);
+    /* with one connection in use, the next user waits for it */
+    waiter.port = port + 2;
+    if (test_pool_get(&h, port + 2, NULL) < 0 ||
+        pthread_create(&waiter_thread, NULL, test_pool_client, &waiter)) {
+        printf("pool: cannot start the waiter\n");
+        err = 1;
+    } else {
+        bv_usleep(200000);
+        if (waiter.done) {
+            printf("pool: max_conns not honoured\n");
+            err = 1;
+        }
+        bv_url_closep(&h);
+        pthread_join(waiter_thread, NULL);
+        if (waiter.ret < 0 || pool.nb_conns != 3 || pool.nb_requests != 7) {
+            printf("pool: waiter got %d, %d connections for %d requests\n",
+                   waiter.ret, pool.nb_conns, pool.nb_requests);
+            err = 1;
+        }
+    }
+    bv_url_closep(&h);
+    /* the last connection stays idle in the pool, wake up the server */
+    shutdown(pool.fd, SHUT_RDWR);
+    shutdown(pool.conn, SHUT_RDWR);
+    pthread_join(pool_thread, NULL);
+
+end:
+    if (pool.fd >= 0)
+        closesocket(pool.fd);
+    printf("%s\n", err ? "FAIL" : "OK");
+    return err;
+}
+#endif /* TEST */
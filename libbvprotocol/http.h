@@ -102,6 +102,54 @@ int bv_http_do_new_request(BVURLContext *h, const char *uri);
 
 int bv_http_averror(int status_code, int default_averror);
 
+/**
+ * A header field, pointing into the line it was parsed from.
+ */
+typedef struct BVHTTPHeader {
+    const char *name;
+    int name_len;
+    const char *value;
+    int value_len;
+} BVHTTPHeader;
+
+/**
+ * Split a "Name: value" line of len bytes in place, without copying.
+ * The value is stripped of surrounding white space; name and value are
+ * also NUL-terminated in line.
+ *
+ * @return 0, or BVERROR_INVALIDDATA if there is no name
+ */
+int bv_http_split_header(char *line, int len, BVHTTPHeader *hdr);
+
+/**
+ * Get a connection to url from the process wide pool of persistent
+ * connections, or open a new one if none is idle. Only connections opened
+ * with the same options of the lower protocol, e.g. tls_verify or ca_file
+ * for tls, are shared.
+ *
+ * Idle connections which became readable, i.e. were closed by the server,
+ * are dropped. With max_conns > 0, wait up to timeout microseconds
+ * (forever if 0) while that many connections to url are in use.
+ *
+ * @return 1 if an idle connection was reused, 0 if a new one was opened,
+ *         or a negative error code
+ */
+int bv_http_pool_open(BVURLContext **puc, const char *url, int flags,
+                      const BVIOInterruptCB *int_cb, BVDictionary **options,
+                      int max_conns, int timeout);
+
+/**
+ * Give a connection back to the pool and set *puc to NULL.
+ *
+ * If reusable, the connection is kept idle for idle_timeout microseconds,
+ * at most max_idle of them per url; otherwise, or if it was not obtained
+ * from bv_http_pool_open(), it is closed. Expired connections are only
+ * closed by the next bv_http_pool_open() or bv_http_pool_close() call,
+ * for any url; until then they keep their socket.
+ */
+void bv_http_pool_close(BVURLContext **puc, int reusable,
+                        int max_idle, int64_t idle_timeout);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,377 @@
+/*************************************************************************
+    > File Name: httppool.c
+    > Author: albertfang
+    > Mail: fang.qi@besovideo.com
+    > Created Time: 2026年10月19日 星期一 15时36分08秒
+ ************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) albert@BesoVideo, 2026
+ */
+
+/**
+ * @file
+ * Process wide pool of persistent HTTP client connections.
+ *
+ * Connections are grouped by the url of the lower protocol, e.g.
+ * "tcp://host:80", and the options given to it, so that a tls connection
+ * is only shared by users asking for the same certificate checks. A host
+ * keeps its idle connections, most recently used first, and the
+ * connections handed out by bv_http_pool_open(). There is no timer: idle
+ * connections past their deadline are closed the next time the pool is
+ * used for any host, and hosts left without connections or waiters are
+ * dropped then.
+ */
+
+#include "config.h"
+
+#include <pthread.h>
+
+#include "libbvutil/bprint.h"
+#include "libbvutil/bvstring.h"
+#include "libbvutil/mem.h"
+#include "libbvutil/opt.h"
+#include "libbvutil/time.h"
+#include "libbvutil/network.h"
+#include "libbvutil/os_support.h"
+
+#include "http.h"
+
+typedef struct HTTPPoolConn {
+    BVURLContext *hd;
+    int64_t deadline;
+    struct HTTPPoolConn *next;
+} HTTPPoolConn;
+
+typedef struct HTTPPoolHost {
+    char *key;
+    HTTPPoolConn *idle;
+    int nb_idle;
+    BVURLContext **active;
+    int nb_active;
+    int active_size;
+    int waiters;                ///< threads waiting for a slot, unlocked at times
+    struct HTTPPoolHost *next;
+} HTTPPoolHost;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  pool_cond = PTHREAD_COND_INITIALIZER;
+static HTTPPoolHost *pool_hosts;
+
+static HTTPPoolHost *find_host(const char *key, int create)
+{
+    HTTPPoolHost *host;
+
+    for (host = pool_hosts; host; host = host->next)
+        if (!strcmp(host->key, key))
+            return host;
+    if (!create)
+        return NULL;
+    host = bv_mallocz(sizeof(*host));
+    if (!host)
+        return NULL;
+    host->key = bv_strdup(key);
+    if (!host->key) {
+        bv_free(host);
+        return NULL;
+    }
+    host->next = pool_hosts;
+    pool_hosts = host;
+    return host;
+}
+
+/* url followed by the options the lower protocol knows, in their order */
+static char *pool_key(const char *url, BVDictionary *options)
+{
+    const char *name = bv_url_find_protocol_name(url);
+    const BVURLProtocol *p = NULL;
+    BVDictionaryEntry *e = NULL;
+    BVBPrint bp;
+    char *key;
+
+    while (name && (p = bv_url_protocol_next(p)))
+        if (!strcmp(p->name, name))
+            break;
+    bv_bprint_init(&bp, 0, BV_BPRINT_SIZE_UNLIMITED);
+    bv_bprintf(&bp, "%s", url);
+    if (p && p->priv_class) {
+        const BVClass *class = p->priv_class;
+        while ((e = bv_dict_get(options, "", e, BV_DICT_IGNORE_SUFFIX)))
+            if (bv_opt_find(&class, e->key, NULL, 0, BV_OPT_SEARCH_FAKE_OBJ))
+                bv_bprintf(&bp, "\n%s=%s", e->key, e->value);
+    }
+    if (bv_bprint_finalize(&bp, &key) < 0)
+        return NULL;
+    return key;
+}
+
+static int add_active(HTTPPoolHost *host, BVURLContext *hd)
+{
+    if (host->nb_active == host->active_size) {
+        int size = host->active_size ? 2 * host->active_size : 4;
+        BVURLContext **active = bv_realloc_array(host->active, size, sizeof(*active));
+        if (!active)
+            return BVERROR(ENOMEM);
+        host->active      = active;
+        host->active_size = size;
+    }
+    host->active[host->nb_active++] = hd;
+    return 0;
+}
+
+/* Replace the active entry hd of host by new_hd, or drop it if new_hd is NULL. */
+static void replace_active(HTTPPoolHost *host, BVURLContext *hd, BVURLContext *new_hd)
+{
+    int i;
+
+    for (i = 0; i < host->nb_active; i++)
+        if (host->active[i] == hd) {
+            if (new_hd)
+                host->active[i] = new_hd;
+            else
+                host->active[i] = host->active[--host->nb_active];
+            return;
+        }
+}
+
+static HTTPPoolHost *remove_active(BVURLContext *hd)
+{
+    HTTPPoolHost *host;
+    int i;
+
+    for (host = pool_hosts; host; host = host->next)
+        for (i = 0; i < host->nb_active; i++)
+            if (host->active[i] == hd) {
+                host->active[i] = host->active[--host->nb_active];
+                return host;
+            }
+    return NULL;
+}
+
+/*
+ * Unlink the expired idle connections onto *dead, to be closed unlocked,
+ * and free the hosts nobody uses any more.
+ */
+static void collect_expired(int64_t now, HTTPPoolConn **dead)
+{
+    HTTPPoolHost *host, **h = &pool_hosts;
+    HTTPPoolConn **p, *c;
+
+    while ((host = *h)) {
+        p = &host->idle;
+        while ((c = *p)) {
+            if (c->deadline <= now) {
+                *p      = c->next;
+                c->next = *dead;
+                *dead   = c;
+                host->nb_idle--;
+            } else {
+                p = &c->next;
+            }
+        }
+        if (!host->idle && !host->nb_active && !host->waiters) {
+            *h = host->next;
+            bv_free(host->active);
+            bv_free(host->key);
+            bv_free(host);
+        } else {
+            h = &host->next;
+        }
+    }
+}
+
+static void close_list(HTTPPoolConn *c)
+{
+    HTTPPoolConn *next;
+
+    for (; c; c = next) {
+        next = c->next;
+        bv_url_close(c->hd);
+        bv_free(c);
+    }
+}
+
+/*
+ * An idle connection must have nothing to read: data means the server
+ * closed it (EOF) or sent something we cannot attribute to a request.
+ */
+static int connection_alive(BVURLContext *hd)
+{
+    struct pollfd p;
+    char c;
+    int fd = bv_url_get_file_handle(hd);
+
+    if (fd < 0)
+        return 1;
+    p.fd      = fd;
+    p.events  = POLLIN;
+    p.revents = 0;
+    if (poll(&p, 1, 0) <= 0)
+        return 1;
+    if (p.revents & (POLLERR | POLLHUP | POLLNVAL))
+        return 0;
+    if (recv(fd, &c, 1, MSG_PEEK) < 0 && (bv_neterrno() == BVERROR(EAGAIN) ||
+                                          bv_neterrno() == BVERROR(EINTR)))
+        return 1;
+    return 0;
+}
+
+/*
+ * Wait a little for a slot of host, with the lock held on entry and exit.
+ * The interrupt callback is called unlocked: it may take locks of its own.
+ */
+static int wait_for_slot(HTTPPoolHost *host, const BVIOInterruptCB *int_cb, int64_t deadline)
+{
+    struct timespec ts;
+    int64_t t;
+    int ret = 0;
+
+    t = bv_gettime() + 100000;
+    ts.tv_sec  = t / 1000000;
+    ts.tv_nsec = (t % 1000000) * 1000;
+    host->waiters++;
+    pthread_cond_timedwait(&pool_cond, &pool_lock, &ts);
+    pthread_mutex_unlock(&pool_lock);
+    if (bv_check_interrupt((BVIOInterruptCB *)int_cb))
+        ret = BVERROR_EXIT;
+    else if (deadline && bv_gettime_relative() >= deadline)
+        ret = BVERROR(ETIMEDOUT);
+    pthread_mutex_lock(&pool_lock);
+    host->waiters--;
+    return ret;
+}
+
+int bv_http_pool_open(BVURLContext **puc, const char *url, int flags,
+                      const BVIOInterruptCB *int_cb, BVDictionary **options,
+                      int max_conns, int timeout)
+{
+    HTTPPoolHost *host;
+    HTTPPoolConn *c, *dead = NULL;
+    BVURLContext *hd = NULL;
+    int64_t deadline = timeout > 0 ? bv_gettime_relative() + timeout : 0;
+    char *key;
+    int ret;
+
+    if (!(key = pool_key(url, options ? *options : NULL)))
+        return BVERROR(ENOMEM);
+    pthread_mutex_lock(&pool_lock);
+    collect_expired(bv_gettime_relative(), &dead);
+    host = find_host(key, 1);
+    bv_free(key);
+    if (!host) {
+        pthread_mutex_unlock(&pool_lock);
+        close_list(dead);
+        return BVERROR(ENOMEM);
+    }
+    for (;;) {
+        while ((c = host->idle)) {
+            host->idle = c->next;
+            host->nb_idle--;
+            if (connection_alive(c->hd)) {
+                hd = c->hd;
+                bv_free(c);
+                break;
+            }
+            c->next = dead;
+            dead    = c;
+        }
+        if (hd || max_conns <= 0 || host->nb_active < max_conns)
+            break;
+        if ((ret = wait_for_slot(host, int_cb, deadline)) < 0) {
+            pthread_mutex_unlock(&pool_lock);
+            close_list(dead);
+            return ret;
+        }
+    }
+    /* reserve the slot now, the connect below runs unlocked */
+    if ((ret = add_active(host, hd)) < 0) {
+        pthread_mutex_unlock(&pool_lock);
+        close_list(dead);
+        if (hd)
+            bv_url_close(hd);
+        return ret;
+    }
+    pthread_mutex_unlock(&pool_lock);
+    close_list(dead);
+
+    if (hd) {
+        /* the copy in the context still refers to the previous owner */
+        if (int_cb)
+            hd->interrupt_callback = *int_cb;
+        else
+            memset(&hd->interrupt_callback, 0, sizeof(hd->interrupt_callback));
+        *puc = hd;
+        return 1;
+    }
+
+    ret = bv_url_open(&hd, url, flags, int_cb, options);
+    pthread_mutex_lock(&pool_lock);
+    /* the reserved slot, the NULL entry, kept host alive */
+    replace_active(host, NULL, ret < 0 ? NULL : hd);
+    if (ret < 0)
+        pthread_cond_broadcast(&pool_cond);
+    pthread_mutex_unlock(&pool_lock);
+    if (ret < 0)
+        return ret;
+    *puc = hd;
+    return 0;
+}
+
+void bv_http_pool_close(BVURLContext **puc, int reusable,
+                        int max_idle, int64_t idle_timeout)
+{
+    BVURLContext *hd = *puc;
+    HTTPPoolHost *host;
+    HTTPPoolConn *c, *dead = NULL;
+    int64_t now = bv_gettime_relative();
+
+    *puc = NULL;
+    if (!hd)
+        return;
+
+    pthread_mutex_lock(&pool_lock);
+    host = remove_active(hd);
+    if (host && reusable && max_idle > 0 && idle_timeout > 0 &&
+        (c = bv_mallocz(sizeof(*c)))) {
+        memset(&hd->interrupt_callback, 0, sizeof(hd->interrupt_callback));
+        c->hd       = hd;
+        c->deadline = now + idle_timeout;
+        c->next     = host->idle;
+        host->idle  = c;
+        hd          = NULL;
+        /* drop the least recently used beyond the limit */
+        if (++host->nb_idle > max_idle) {
+            HTTPPoolConn **p = &host->idle;
+            int n = 0;
+            while (*p && n++ < max_idle)
+                p = &(*p)->next;
+            while ((c = *p)) {
+                *p      = c->next;
+                c->next = dead;
+                dead    = c;
+                host->nb_idle--;
+            }
+        }
+    }
+    if (host)
+        pthread_cond_broadcast(&pool_cond);
+    /* last, it may free host */
+    collect_expired(now, &dead);
+    pthread_mutex_unlock(&pool_lock);
+
+    close_list(dead);
+    if (hd)
+        bv_url_close(hd);
+}
@@ -0,0 +1,1526 @@
+/*************************************************************************
+    > File Name: httpserver.c
+    > Author: albertfang
+    > Mail: fang.qi@besovideo.com
+    > Created Time: 2026年10月19日 星期一 09时12分40秒
+ ************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) albert@BesoVideo, 2026
+ */
+
+/**
+ * @file
+ * Embedded HTTP/1.1 server.
+ *
+ * Each client is a BVHTTPRequest that lives on the loop thread. The
+ * request head and body are parsed in place in the input buffer. While a
+ * handler owns a request, responses can be queued from any thread: the
+ * output buffer and the response state are under the request lock and
+ * the loop is asked to flush through bv_event_loop_call(). A request is
+ * freed when the socket is closed and the handler is done with it.
+ */
+
+#include "config.h"
+
+#include <pthread.h>
+#if !BV_HAVE_WINSOCK2_H
+#include <netinet/tcp.h>
+#endif
+
+#include "libbvutil/bvstring.h"
+#include "libbvutil/mem.h"
+#include "libbvutil/network.h"
+#include "libbvutil/opt.h"
+#include "libbvutil/time.h"
+
+#include "bvurl.h"
+#include "http.h"
+#include "httpserver.h"
+
+#define MAX_HEADERS     64
+#define IN_BUFFER_SIZE  4096
+#define URL_CHUNK_SIZE  65536
+#define SWEEP_INTERVAL  1000000
+#define RETRY_TIME      10000
+
+enum RequestState {
+    STATE_HEADER,   ///< waiting for the request head
+    STATE_BODY,     ///< waiting for the request body
+    STATE_HANDLER,  ///< owned by the handler or being answered
+};
+
+typedef struct HTTPRoute {
+    char *prefix;
+    int len;
+    BVHTTPHandler handler;
+    void *opaque;
+} HTTPRoute;
+
+struct BVHTTPServer {
+    const BVClass *class;
+    BVEventLoop *loop;
+    int own_loop;
+    pthread_t thread;
+    int thread_started;
+    int *listen_fds;
+    int nb_listen_fds;
+    HTTPRoute *routes;
+    int nb_routes;
+    BVHTTPRequest *clients;
+    int nb_clients;
+    BVEventTimer *sweep;
+    int idle_timeout;
+    int max_clients;
+    int max_header_size;
+    int max_body_size;
+    int max_queue_size;
+    int reuseport;
+};
+
+struct BVHTTPRequest {
+    BVHTTPServer *srv;
+    BVHTTPRequest *prev, *next;
+    int fd;                     ///< -1 once closed
+    int events;
+    int64_t last_active;
+    int max_queue_size;
+
+    /* loop thread only */
+    enum RequestState state;
+    uint8_t *in;
+    int in_len, in_alloc;
+    int scan;                   ///< bytes already searched for the end of the head
+    int head_len;
+    int body_len;
+    char *method, *path, *query;
+    char *hdr_name[MAX_HEADERS];
+    char *hdr_value[MAX_HEADERS];
+    int nb_headers;
+    int minor;                  ///< HTTP/1.minor
+    int head_only;
+
+    /* under lock */
+    pthread_mutex_t lock;
+    int refs;                   ///< the socket, the owner and posted flushes
+    int owned;                  ///< a handler may still answer
+    int started;
+    int complete;               ///< whole response queued
+    int dead;                   ///< client gone
+    int flush_queued;
+    int keep_alive;
+    int chunked;
+    int64_t announced;          ///< Content-Length of a streaming response
+    int64_t written;
+    char extra[1024];
+    uint8_t *out;
+    int out_start, out_end, out_alloc;
+    BVURLContext *body_url;
+    int64_t body_left;          ///< -1 until the end of body_url
+    int body_reading;           ///< an async read of body_url holds a reference
+};
+
+#define OFFSET(x) offsetof(BVHTTPServer, x)
+#define E BV_OPT_FLAG_ENCODING_PARAM
+static const BVOption options[] = {
+    { "idle_timeout", "close clients idle for this long (in microseconds)", OFFSET(idle_timeout), BV_OPT_TYPE_INT, { .i64 = 30000000 }, 0, INT_MAX, E },
+    { "max_clients", "maximum number of connected clients", OFFSET(max_clients), BV_OPT_TYPE_INT, { .i64 = 256 }, 1, INT_MAX, E },
+    { "max_header_size", "maximum size of a request head", OFFSET(max_header_size), BV_OPT_TYPE_INT, { .i64 = 16384 }, IN_BUFFER_SIZE, INT_MAX, E },
+    { "max_body_size", "maximum size of a request body", OFFSET(max_body_size), BV_OPT_TYPE_INT, { .i64 = 1 << 20 }, 0, INT_MAX / 2, E },
+    { "max_queue_size", "drop streamed data beyond this many unsent bytes", OFFSET(max_queue_size), BV_OPT_TYPE_INT, { .i64 = 4 << 20 }, 0, INT_MAX / 2, E },
+    { "reuseport", "share the listening port with other servers (SO_REUSEPORT)", OFFSET(reuseport), BV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, E },
+    { NULL }
+};
+
+static const BVClass http_server_class = {
+    .class_name = "httpserver",
+    .item_name  = bv_default_item_name,
+    .option     = options,
+    .version    = LIBBVUTIL_VERSION_INT,
+};
+
+static const char *status_text(int status)
+{
+    switch (status) {
+    case 200: return "OK";
+    case 204: return "No Content";
+    case 206: return "Partial Content";
+    case 301: return "Moved Permanently";
+    case 302: return "Found";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 401: return "Unauthorized";
+    case 403: return "Forbidden";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 408: return "Request Timeout";
+    case 411: return "Length Required";
+    case 413: return "Payload Too Large";
+    case 416: return "Range Not Satisfiable";
+    case 431: return "Request Header Fields Too Large";
+    case 500: return "Internal Server Error";
+    case 501: return "Not Implemented";
+    case 503: return "Service Unavailable";
+    case 505: return "HTTP Version Not Supported";
+    }
+    return status < 300 ? "OK" : status < 400 ? "Redirect" : "Error";
+}
+
+static int error_status(int err)
+{
+    switch (err) {
+    case BVERROR(ENOENT): return HTTP_STATUS_NOT_FOUND;
+    case BVERROR(EACCES):
+    case BVERROR(EPERM):  return HTTP_STATUS_FORBIDDEN;
+    case BVERROR(EINVAL): return HTTP_STATUS_BAD_REQUEST;
+    case BVERROR(ENOSYS): return HTTP_STATUS_NOT_IMPLEMENTED;
+    }
+    return HTTP_STATUS_INTERNAL;
+}
+
+static void request_free(BVHTTPRequest *c)
+{
+    bv_url_closep(&c->body_url);
+    pthread_mutex_destroy(&c->lock);
+    bv_free(c->in);
+    bv_free(c->out);
+    bv_free(c);
+}
+
+static void request_unref(BVHTTPRequest *c)
+{
+    int refs;
+
+    pthread_mutex_lock(&c->lock);
+    refs = --c->refs;
+    pthread_mutex_unlock(&c->lock);
+    if (!refs)
+        request_free(c);
+}
+
+/* must hold the lock */
+static int out_append(BVHTTPRequest *c, const void *data, int size)
+{
+    if (c->out_end + size > c->out_alloc) {
+        if (c->out_start) {
+            memmove(c->out, c->out + c->out_start, c->out_end - c->out_start);
+            c->out_end  -= c->out_start;
+            c->out_start = 0;
+        }
+        if (c->out_end + size > c->out_alloc) {
+            int alloc = BBMAX(c->out_end + size, 2 * c->out_alloc);
+            uint8_t *out = bv_realloc(c->out, alloc);
+            if (!out)
+                return BVERROR(ENOMEM);
+            c->out       = out;
+            c->out_alloc = alloc;
+        }
+    }
+    memcpy(c->out + c->out_end, data, size);
+    c->out_end += size;
+    return 0;
+}
+
+static void flush_call(BVEventLoop *loop, void *opaque);
+
+/* must hold the lock */
+static void schedule_flush(BVHTTPRequest *c)
+{
+    if (c->flush_queued || c->dead)
+        return;
+    c->flush_queued = 1;
+    c->refs++;
+    if (bv_event_loop_call(c->srv->loop, flush_call, c) < 0) {
+        c->flush_queued = 0;
+        c->refs--;
+    }
+}
+
+/* must hold the lock, content_length -1 for an unknown length */
+static int queue_head(BVHTTPRequest *c, int status, const char *content_type,
+                      int64_t content_length, int can_chunk)
+{
+    char head[2048];
+    int len;
+
+    len = snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\n", status, status_text(status));
+    if (content_type) {
+        len += snprintf(head + len, sizeof(head) - len, "Content-Type: %s\r\n", content_type);
+        if (len >= sizeof(head))
+            return BVERROR(EINVAL);
+    }
+    if (content_length >= 0) {
+        len += snprintf(head + len, sizeof(head) - len, "Content-Length: %"PRId64"\r\n", content_length);
+    } else if (can_chunk && c->minor >= 1) {
+        c->chunked = 1;
+        len += snprintf(head + len, sizeof(head) - len, "Transfer-Encoding: chunked\r\n");
+    } else {
+        /* the end of the body is the end of the connection */
+        c->keep_alive = 0;
+    }
+    if (len >= sizeof(head))
+        return BVERROR(EINVAL);
+    len += snprintf(head + len, sizeof(head) - len, "Connection: %s\r\n%s\r\n",
+                    c->keep_alive ? "keep-alive" : "close", c->extra);
+    if (len >= sizeof(head))
+        return BVERROR(EINVAL);
+    c->started = 1;
+    return out_append(c, head, len);
+}
+
+/**
+ * Parse a single byte range against size.
+ * @return 1 for a range, 0 to ignore the header, -1 if unsatisfiable
+ */
+static int parse_range(const char *v, int64_t size, int64_t *start, int64_t *end)
+{
+    char *e;
+    int64_t a, b;
+
+    if (!v || !bv_strstart(v, "bytes=", &v) || strchr(v, ','))
+        return 0;
+    if (*v == '-') {
+        b = strtoll(v + 1, &e, 10);
+        if (e == v + 1 || *e)
+            return 0;
+        if (b <= 0 || !size)
+            return -1;
+        *start = size - BBMIN(b, size);
+        *end   = size - 1;
+        return 1;
+    }
+    a = strtoll(v, &e, 10);
+    if (e == v || *e != '-' || a < 0)
+        return 0;
+    v = e + 1;
+    b = size - 1;
+    if (*v) {
+        b = strtoll(v, &e, 10);
+        if (e == v || *e || b < a)
+            return 0;
+    }
+    if (a >= size)
+        return -1;
+    *start = a;
+    *end   = BBMIN(b, size - 1);
+    return 1;
+}
+
+/* must hold the lock; the owner reference goes when the lock is dropped */
+static void release_owner(BVHTTPRequest *c)
+{
+    c->owned    = 0;
+    c->complete = 1;
+    schedule_flush(c);
+}
+
+const char *bv_http_request_get_method(BVHTTPRequest *req)
+{
+    return req->method;
+}
+
+const char *bv_http_request_get_path(BVHTTPRequest *req)
+{
+    return req->path;
+}
+
+const char *bv_http_request_get_query(BVHTTPRequest *req)
+{
+    return req->query;
+}
+
+const char *bv_http_request_get_header(BVHTTPRequest *req, const char *name)
+{
+    int i;
+
+    for (i = 0; i < req->nb_headers; i++)
+        if (!bv_strcasecmp(req->hdr_name[i], name))
+            return req->hdr_value[i];
+    return NULL;
+}
+
+const uint8_t *bv_http_request_get_body(BVHTTPRequest *req, int *size)
+{
+    *size = req->body_len;
+    return req->in + req->head_len;
+}
+
+int bv_http_request_add_header(BVHTTPRequest *req, const char *name, const char *value)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&req->lock);
+    if (!req->owned || req->started)
+        ret = BVERROR(EINVAL);
+    else if (bv_strlcatf(req->extra, sizeof(req->extra), "%s: %s\r\n", name, value) >= sizeof(req->extra))
+        ret = BVERROR(ENOMEM);
+    pthread_mutex_unlock(&req->lock);
+    return ret;
+}
+
+int bv_http_request_respond(BVHTTPRequest *req, int status, const char *content_type,
+                            const uint8_t *body, int64_t size)
+{
+    const char *range = bv_http_request_get_header(req, "Range");
+    int64_t start = 0, end = size - 1;
+    int ret;
+
+    pthread_mutex_lock(&req->lock);
+    if (!req->owned || req->started || size < 0 || size > INT_MAX) {
+        pthread_mutex_unlock(&req->lock);
+        return BVERROR(EINVAL);
+    }
+    if (status == HTTP_STATUS_OK && range) {
+        ret = parse_range(range, size, &start, &end);
+        if (ret > 0) {
+            status = 206;
+            bv_strlcatf(req->extra, sizeof(req->extra), "Content-Range: bytes %"PRId64"-%"PRId64"/%"PRId64"\r\n",
+                        start, end, size);
+        } else if (ret < 0) {
+            status = 416;
+            bv_strlcatf(req->extra, sizeof(req->extra), "Content-Range: bytes */%"PRId64"\r\n", size);
+            start = 0;
+            end   = -1;
+        }
+    }
+    if ((ret = queue_head(req, status, content_type, end - start + 1, 0)) >= 0 && !req->head_only)
+        ret = out_append(req, body + start, end - start + 1);
+    if (ret < 0)
+        req->keep_alive = 0;
+    release_owner(req);
+    pthread_mutex_unlock(&req->lock);
+    request_unref(req);
+    return ret;
+}
+
+static int respond_error(BVHTTPRequest *req, int status)
+{
+    char text[128];
+    int len = snprintf(text, sizeof(text), "%d %s\n", status, status_text(status));
+
+    return bv_http_request_respond(req, status, "text/plain", text, len);
+}
+
+static int request_dead(void *opaque)
+{
+    BVHTTPRequest *c = opaque;
+    int dead;
+
+    pthread_mutex_lock(&c->lock);
+    dead = c->dead;
+    pthread_mutex_unlock(&c->lock);
+    return dead;
+}
+
+/**
+ * Feed the body of a url which would block the loop from the calling
+ * thread, waiting for the client while too much is queued.
+ */
+static int stream_url(BVHTTPRequest *req, BVURLContext *h, int64_t left)
+{
+    uint8_t *buf = bv_malloc(URL_CHUNK_SIZE);
+    int n, ret = buf ? 0 : BVERROR(ENOMEM);
+
+    while (ret >= 0 && left) {
+        n = bv_url_read(h, buf, left < 0 ? URL_CHUNK_SIZE : BBMIN(left, URL_CHUNK_SIZE));
+        if (n <= 0) {
+            /* a short body is caught by bv_http_request_end() */
+            ret = n;
+            break;
+        }
+        while ((ret = bv_http_request_write(req, buf, n)) == BVERROR(EAGAIN))
+            bv_usleep(RETRY_TIME);
+        if (left > 0)
+            left -= n;
+    }
+    bv_free(buf);
+    bv_url_closep(&h);
+    if (ret < 0) {
+        pthread_mutex_lock(&req->lock);
+        req->keep_alive = 0;
+        pthread_mutex_unlock(&req->lock);
+    }
+    bv_http_request_end(req);
+    return ret;
+}
+
+static int respond_url(BVHTTPRequest *req, const char *url, const char *content_type,
+                       const BVIOInterruptCB *int_cb)
+{
+    const char *range = bv_http_request_get_header(req, "Range");
+    BVURLContext *h = NULL;
+    int64_t size, start = 0, end = -1, len = -1;
+    int status = HTTP_STATUS_OK, ret;
+
+    if ((ret = bv_url_open(&h, url, BV_IO_FLAG_READ, int_cb, NULL)) < 0) {
+        respond_error(req, error_status(ret));
+        return ret;
+    }
+    size = bv_url_size(h);
+    if (size >= 0) {
+        len = size;
+        ret = h->is_streamed ? 0 : parse_range(range, size, &start, &end);
+        if (ret > 0 && (ret = bv_url_seek(h, start, SEEK_SET)) < 0) {
+            bv_url_closep(&h);
+            respond_error(req, HTTP_STATUS_INTERNAL);
+            return ret;
+        }
+        if (ret < 0) {
+            bv_url_closep(&h);
+            pthread_mutex_lock(&req->lock);
+            bv_strlcatf(req->extra, sizeof(req->extra), "Content-Range: bytes */%"PRId64"\r\n", size);
+            pthread_mutex_unlock(&req->lock);
+            respond_error(req, 416);
+            return 0;
+        }
+    }
+
+    pthread_mutex_lock(&req->lock);
+    if (!req->owned || req->started) {
+        pthread_mutex_unlock(&req->lock);
+        bv_url_closep(&h);
+        return BVERROR(EINVAL);
+    }
+    if (!h->is_streamed)
+        bv_strlcat(req->extra, "Accept-Ranges: bytes\r\n", sizeof(req->extra));
+    if (end >= 0) {
+        status = 206;
+        len    = end - start + 1;
+        bv_strlcatf(req->extra, sizeof(req->extra), "Content-Range: bytes %"PRId64"-%"PRId64"/%"PRId64"\r\n",
+                    start, end, size);
+    }
+    ret = queue_head(req, status, content_type, len, 0);
+    if (ret >= 0 && !req->head_only && !h->nonblock) {
+        /* stays owned until the whole body is queued */
+        req->announced = len;
+        req->written   = 0;
+        schedule_flush(req);
+        pthread_mutex_unlock(&req->lock);
+        return stream_url(req, h, len);
+    }
+    if (ret < 0 || req->head_only) {
+        if (ret < 0)
+            req->keep_alive = 0;
+        bv_url_closep(&h);
+    } else {
+        /* read by the loop as the client takes it */
+        req->body_url  = h;
+        req->body_left = len;
+    }
+    release_owner(req);
+    pthread_mutex_unlock(&req->lock);
+    request_unref(req);
+    return ret;
+}
+
+typedef struct URLResponse {
+    BVEventJob job;
+    BVEventLoop *loop;
+    BVHTTPRequest *req;
+    char *url;
+    char *content_type;
+} URLResponse;
+
+static void url_response_free(URLResponse *r)
+{
+    bv_free(r->url);
+    bv_free(r->content_type);
+    bv_free(r);
+}
+
+static void url_response_done(BVEventLoop *loop, void *opaque)
+{
+    url_response_free(opaque);
+}
+
+static void url_response_release(BVEventJob *job)
+{
+    url_response_free((URLResponse *)job);
+}
+
+static void *url_response_task(void *arg)
+{
+    URLResponse *r = arg;
+    BVIOInterruptCB int_cb = { request_dead, r->req };
+
+    respond_url(r->req, r->url, r->content_type, &int_cb);
+    bv_event_loop_end_job(r->loop, &r->job, url_response_done, r);
+    return NULL;
+}
+
+int bv_http_request_respond_url(BVHTTPRequest *req, const char *url, const char *content_type)
+{
+    URLResponse *r = bv_mallocz(sizeof(*r));
+    pthread_attr_t attr;
+    pthread_t thread;
+    int ret;
+
+    if (!r || !(r->url = bv_strdup(url)) ||
+        (content_type && !(r->content_type = bv_strdup(content_type)))) {
+        if (r)
+            url_response_free(r);
+        respond_error(req, HTTP_STATUS_INTERNAL);
+        return BVERROR(ENOMEM);
+    }
+    r->req = req;
+    pthread_mutex_lock(&req->lock);
+    if (req->dead) {
+        /* the server may be gone, only the request is left */
+        release_owner(req);
+        pthread_mutex_unlock(&req->lock);
+        request_unref(req);
+        url_response_free(r);
+        return BVERROR(EPIPE);
+    }
+    /* the server frees the loop only after closing req */
+    r->loop = req->srv->loop;
+    bv_event_loop_begin_job(r->loop, &r->job, url_response_release);
+    pthread_mutex_unlock(&req->lock);
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    ret = pthread_create(&thread, &attr, url_response_task, r);
+    pthread_attr_destroy(&attr);
+    if (ret) {
+        respond_error(req, HTTP_STATUS_INTERNAL);
+        bv_event_loop_end_job(r->loop, &r->job, url_response_done, r);
+        return BVERROR(ret);
+    }
+    return 0;
+}
+
+int bv_http_request_begin(BVHTTPRequest *req, int status, const char *content_type,
+                          int64_t content_length)
+{
+    int ret;
+
+    pthread_mutex_lock(&req->lock);
+    if (!req->owned || req->started) {
+        pthread_mutex_unlock(&req->lock);
+        return BVERROR(EINVAL);
+    }
+    req->announced = content_length;
+    req->written   = 0;
+    ret = queue_head(req, status, content_type, content_length, 1);
+    schedule_flush(req);
+    pthread_mutex_unlock(&req->lock);
+    return ret;
+}
+
+int bv_http_request_write(BVHTTPRequest *req, const uint8_t *buf, int size)
+{
+    char chunk[16];
+    int ret = 0;
+
+    if (size <= 0)
+        return 0;
+    pthread_mutex_lock(&req->lock);
+    if (!req->owned || !req->started) {
+        ret = BVERROR(EINVAL);
+    } else if (req->dead) {
+        ret = BVERROR(EPIPE);
+    } else if (req->announced >= 0 && req->written + size > req->announced) {
+        ret = BVERROR(EINVAL);
+    } else if (req->head_only) {
+        req->written += size;
+    } else if (req->out_end - req->out_start > req->max_queue_size) {
+        ret = BVERROR(EAGAIN);
+    } else {
+        if (req->chunked) {
+            snprintf(chunk, sizeof(chunk), "%x\r\n", size);
+            ret = out_append(req, chunk, strlen(chunk));
+        }
+        if (ret >= 0)
+            ret = out_append(req, buf, size);
+        if (ret >= 0 && req->chunked)
+            ret = out_append(req, "\r\n", 2);
+        if (ret >= 0)
+            req->written += size;
+        else
+            req->keep_alive = 0;
+        schedule_flush(req);
+    }
+    pthread_mutex_unlock(&req->lock);
+    return ret;
+}
+
+int bv_http_request_end(BVHTTPRequest *req)
+{
+    pthread_mutex_lock(&req->lock);
+    if (!req->owned || !req->started) {
+        pthread_mutex_unlock(&req->lock);
+        return BVERROR(EINVAL);
+    }
+    if (req->chunked && !req->head_only && out_append(req, "0\r\n\r\n", 5) < 0)
+        req->keep_alive = 0;
+    /* a short body leaves the client waiting for the rest */
+    if (req->announced >= 0 && req->written != req->announced)
+        req->keep_alive = 0;
+    release_owner(req);
+    pthread_mutex_unlock(&req->lock);
+    request_unref(req);
+    return 0;
+}
+
+static void request_close(BVHTTPRequest *c)
+{
+    BVHTTPServer *srv = c->srv;
+
+    if (c->fd < 0)
+        return;
+    bv_event_loop_del_fd(srv->loop, c->fd);
+    closesocket(c->fd);
+    c->fd = -1;
+    if (c->prev)
+        c->prev->next = c->next;
+    else
+        srv->clients = c->next;
+    if (c->next)
+        c->next->prev = c->prev;
+    srv->nb_clients--;
+    pthread_mutex_lock(&c->lock);
+    c->dead = 1;
+    pthread_mutex_unlock(&c->lock);
+    if (c->body_reading) {
+        /* closing cancels the read without calling back */
+        bv_url_closep(&c->body_url);
+        c->body_reading = 0;
+        request_unref(c);
+    }
+    request_unref(c);
+}
+
+static void request_update_events(BVHTTPRequest *c)
+{
+    int events = 0;
+
+    /* keep reading while a handler runs to notice a client going away */
+    if (c->state != STATE_HANDLER || c->in_len < c->in_alloc)
+        events |= BV_EVENT_READ;
+    pthread_mutex_lock(&c->lock);
+    if (c->out_start < c->out_end)
+        events |= BV_EVENT_WRITE;
+    pthread_mutex_unlock(&c->lock);
+    if (events != c->events && bv_event_loop_mod_fd(c->srv->loop, c->fd, events) >= 0)
+        c->events = events;
+}
+
+static int find_head_end(BVHTTPRequest *c)
+{
+    const uint8_t *p = c->in + BBMAX(c->scan - 3, 0), *end = c->in + c->in_len;
+
+    while ((p = memchr(p, '\n', end - p))) {
+        if (p - c->in >= 3 && p[-1] == '\r' && p[-2] == '\n' && p[-3] == '\r')
+            return p + 1 - c->in;
+        p++;
+    }
+    c->scan = c->in_len;
+    return -1;
+}
+
+static char *next_line(char **p, char *end)
+{
+    char *line = *p, *nl = memchr(line, '\n', end - line);
+
+    *nl = 0;
+    if (nl > line && nl[-1] == '\r')
+        nl[-1] = 0;
+    *p = nl + 1;
+    return line;
+}
+
+/**
+ * Split the request head in place.
+ * @return 0 or the status to answer a bad request with
+ */
+static int parse_head(BVHTTPRequest *c)
+{
+    char *p = (char *)c->in, *end = p + c->head_len;
+    char *line, *target, *version, *q;
+    const char *v;
+    int64_t length;
+
+    line = next_line(&p, end);
+    if (!(target = strchr(line, ' ')))
+        return HTTP_STATUS_BAD_REQUEST;
+    *target++ = 0;
+    if (!(version = strchr(target, ' ')))
+        return HTTP_STATUS_BAD_REQUEST;
+    *version++ = 0;
+    if (!bv_strstart(version, "HTTP/1.", &v) || !bv_isdigit(*v) || v[1])
+        return HTTP_STATUS_VERSION;
+    c->method    = line;
+    c->minor     = *v - '0';
+    c->head_only = !strcmp(c->method, "HEAD");
+    /* absolute form, from proxies */
+    if (bv_strstart(target, "http://", &v) && !(target = strchr(v, '/')))
+        return HTTP_STATUS_BAD_REQUEST;
+    if (*target != '/')
+        return HTTP_STATUS_BAD_REQUEST;
+    c->path  = target;
+    c->query = target + strlen(target);
+    if ((q = strchr(target, '?'))) {
+        *q++ = 0;
+        c->query = q;
+    }
+
+    c->nb_headers = 0;
+    while (*(line = next_line(&p, end))) {
+        char *value = strchr(line, ':'), *e;
+
+        /* obsolete line folding is not accepted */
+        if (*line == ' ' || *line == '\t' || !value || value == line)
+            return HTTP_STATUS_BAD_REQUEST;
+        if (c->nb_headers == MAX_HEADERS)
+            return 431;
+        *value++ = 0;
+        while (*value == ' ' || *value == '\t')
+            value++;
+        e = value + strlen(value);
+        while (e > value && (e[-1] == ' ' || e[-1] == '\t'))
+            *--e = 0;
+        c->hdr_name[c->nb_headers]  = line;
+        c->hdr_value[c->nb_headers] = value;
+        c->nb_headers++;
+    }
+
+    v = bv_http_request_get_header(c, "Connection");
+    c->keep_alive = c->minor >= 1 ? !(v && bv_stristr(v, "close")) :
+                                    v && bv_stristr(v, "keep-alive");
+    if (bv_http_request_get_header(c, "Transfer-Encoding"))
+        return HTTP_STATUS_LENGTH_REQUIRED;
+    c->body_len = 0;
+    if ((v = bv_http_request_get_header(c, "Content-Length"))) {
+        length = strtoll(v, &q, 10);
+        if (q == v || *q || length < 0)
+            return HTTP_STATUS_BAD_REQUEST;
+        if (length > c->srv->max_body_size)
+            return HTTP_STATUS_REQ_ENTITY_2LARGE;
+        c->body_len = length;
+    }
+    return 0;
+}
+
+/* grow the input buffer, keeping the parsed pointers into it valid */
+static int grow_input(BVHTTPRequest *c, int size)
+{
+    char **ptrs[3 + 2 * MAX_HEADERS];
+    ptrdiff_t offsets[BV_ARRAY_ELEMS(ptrs)];
+    char *base = (char *)c->in;
+    uint8_t *in;
+    int i, nb = 0;
+
+    ptrs[nb++] = &c->method;
+    ptrs[nb++] = &c->path;
+    ptrs[nb++] = &c->query;
+    for (i = 0; i < c->nb_headers; i++) {
+        ptrs[nb++] = &c->hdr_name[i];
+        ptrs[nb++] = &c->hdr_value[i];
+    }
+    for (i = 0; i < nb; i++) {
+        char *ptr = *ptrs[i];
+        offsets[i] = ptr && ptr >= base && ptr < base + c->in_alloc ? ptr - base : -1;
+    }
+    if (!(in = bv_realloc(c->in, size)))
+        return BVERROR(ENOMEM);
+    c->in       = in;
+    c->in_alloc = size;
+    for (i = 0; i < nb; i++)
+        if (offsets[i] >= 0)
+            *ptrs[i] = (char *)in + offsets[i];
+    return 0;
+}
+
+static void take_owner(BVHTTPRequest *c)
+{
+    c->state = STATE_HANDLER;
+    pthread_mutex_lock(&c->lock);
+    c->owned = 1;
+    c->refs++;
+    pthread_mutex_unlock(&c->lock);
+}
+
+static void send_error(BVHTTPRequest *c, int status)
+{
+    take_owner(c);
+    c->keep_alive = 0;
+    respond_error(c, status);
+}
+
+static const HTTPRoute *find_route(BVHTTPServer *srv, const char *path)
+{
+    const HTTPRoute *best = NULL;
+    int i;
+
+    for (i = 0; i < srv->nb_routes; i++) {
+        const HTTPRoute *r = &srv->routes[i];
+        if (strncmp(path, r->prefix, r->len) ||
+            (path[r->len] && path[r->len] != '/' && r->prefix[r->len - 1] != '/'))
+            continue;
+        if (!best || r->len > best->len)
+            best = r;
+    }
+    return best;
+}
+
+static void dispatch(BVHTTPRequest *c)
+{
+    const HTTPRoute *route = find_route(c->srv, c->path);
+    int ret, owned, started;
+
+    take_owner(c);
+    if (!route) {
+        respond_error(c, HTTP_STATUS_NOT_FOUND);
+        return;
+    }
+    ret = route->handler(c, route->opaque);
+    if (ret >= 0)
+        return;
+    pthread_mutex_lock(&c->lock);
+    owned   = c->owned;
+    started = c->started;
+    if (owned && started)
+        c->keep_alive = 0;
+    pthread_mutex_unlock(&c->lock);
+    if (owned && !started)
+        respond_error(c, error_status(ret));
+    else if (owned)
+        bv_http_request_end(c);
+}
+
+static void request_process(BVHTTPRequest *c)
+{
+    int status;
+
+    if (c->state == STATE_HEADER) {
+        if ((c->head_len = find_head_end(c)) < 0) {
+            c->head_len = 0;
+            if (c->in_len >= c->srv->max_header_size)
+                send_error(c, 431);
+            return;
+        }
+        if ((status = parse_head(c))) {
+            send_error(c, status);
+            return;
+        }
+        if (c->head_len + c->body_len > c->in_alloc &&
+            grow_input(c, c->head_len + c->body_len) < 0) {
+            send_error(c, HTTP_STATUS_INTERNAL);
+            return;
+        }
+        c->state = STATE_BODY;
+    }
+    if (c->state == STATE_BODY && c->in_len >= c->head_len + c->body_len)
+        dispatch(c);
+}
+
+/* the response went out, serve the next request on the connection */
+static void request_next(BVHTTPRequest *c)
+{
+    int rest = c->in_len - c->head_len - c->body_len;
+
+    pthread_mutex_lock(&c->lock);
+    c->started  = c->complete = c->chunked = 0;
+    c->extra[0] = 0;
+    c->out_start = c->out_end = 0;
+    pthread_mutex_unlock(&c->lock);
+    memmove(c->in, c->in + c->head_len + c->body_len, rest);
+    c->in_len   = rest;
+    c->scan     = 0;
+    c->head_len = c->body_len = 0;
+    c->method   = c->path = c->query = NULL;
+    c->nb_headers = 0;
+    c->state    = STATE_HEADER;
+    c->last_active = bv_gettime_relative();
+    request_process(c);
+}
+
+static void body_read_done(BVURLContext *h, int ret, void *opaque);
+
+/**
+ * Read the next part of the body url into the empty output buffer,
+ * asynchronously on the loop. Only nonblock urls get here.
+ *
+ * @return bytes read, 0 at the end, a negative error code, or
+ *         BVERROR(EAGAIN) when body_read_done() gets the result
+ */
+static int body_read(BVHTTPRequest *c, int size)
+{
+    BVURLContext *h = c->body_url;
+    int ret;
+
+    pthread_mutex_lock(&c->lock);
+    c->refs++;
+    pthread_mutex_unlock(&c->lock);
+    c->body_reading = 1;
+    if ((ret = bv_url_read_async(h, c->srv->loop, c->out, size, body_read_done, c)) < 0) {
+        c->body_reading = 0;
+        /* the socket reference is still held */
+        pthread_mutex_lock(&c->lock);
+        c->refs--;
+        pthread_mutex_unlock(&c->lock);
+        return ret;
+    }
+    return BVERROR(EAGAIN);
+}
+
+/* must hold the lock, @return 0 or -1 if the body was cut short */
+static int body_got(BVHTTPRequest *c, int n)
+{
+    if (n <= 0) {
+        /* a body of unknown length ends with the url */
+        int64_t left = c->body_left;
+        c->body_left = 0;
+        return left > 0 ? -1 : 0;
+    }
+    c->out_end = n;
+    if (c->body_left > 0)
+        c->body_left -= n;
+    return 0;
+}
+
+/**
+ * Send what is queued and go on with the next request once the response
+ * is complete.
+ * @return 0, or a negative error code if the request was closed; it may
+ *         be gone then
+ */
+static int request_flush(BVHTTPRequest *c)
+{
+    int err = 0, done = 0, keep_alive, n;
+
+    pthread_mutex_lock(&c->lock);
+    for (;;) {
+        while (c->out_start < c->out_end) {
+            n = send(c->fd, c->out + c->out_start, c->out_end - c->out_start, MSG_NOSIGNAL);
+            if (n < 0) {
+                n = bv_neterrno();
+                if (n != BVERROR(EAGAIN) && n != BVERROR(EINTR))
+                    err = 1;
+                break;
+            }
+            c->out_start  += n;
+            c->last_active = bv_gettime_relative();
+        }
+        if (err || c->out_start < c->out_end)
+            break;
+        c->out_start = c->out_end = 0;
+        if (c->body_url && c->body_left) {
+            int size = c->body_left < 0 ? URL_CHUNK_SIZE : BBMIN(c->body_left, URL_CHUNK_SIZE);
+            if (c->body_reading)
+                break;
+            if (c->out_alloc < URL_CHUNK_SIZE) {
+                uint8_t *out = bv_realloc(c->out, URL_CHUNK_SIZE);
+                if (!out) {
+                    err = 1;
+                    break;
+                }
+                c->out       = out;
+                c->out_alloc = URL_CHUNK_SIZE;
+            }
+            /* the owner is done, nobody else touches the output buffer */
+            pthread_mutex_unlock(&c->lock);
+            n = body_read(c, size);
+            pthread_mutex_lock(&c->lock);
+            if (n == BVERROR(EAGAIN))
+                break;
+            if (body_got(c, n) < 0)
+                err = 1;
+            continue;
+        }
+        done = c->complete;
+        break;
+    }
+    keep_alive = c->keep_alive;
+    pthread_mutex_unlock(&c->lock);
+
+    if (done) {
+        bv_url_closep(&c->body_url);
+        if (!keep_alive) {
+            request_close(c);
+            return BVERROR_EOF;
+        }
+        request_next(c);
+    }
+    if (err) {
+        request_close(c);
+        return BVERROR(EIO);
+    }
+    request_update_events(c);
+    return 0;
+}
+
+static void body_read_done(BVURLContext *h, int ret, void *opaque)
+{
+    BVHTTPRequest *c = opaque;
+    int err;
+
+    c->body_reading = 0;
+    pthread_mutex_lock(&c->lock);
+    err = body_got(c, ret);
+    pthread_mutex_unlock(&c->lock);
+    if (err < 0)
+        request_close(c);
+    else if (c->fd >= 0)
+        request_flush(c);
+    request_unref(c);
+}
+
+static void flush_call(BVEventLoop *loop, void *opaque)
+{
+    BVHTTPRequest *c = opaque;
+
+    pthread_mutex_lock(&c->lock);
+    c->flush_queued = 0;
+    pthread_mutex_unlock(&c->lock);
+    if (c->fd >= 0)
+        request_flush(c);
+    request_unref(c);
+}
+
+static void request_read(BVHTTPRequest *c)
+{
+    BVHTTPServer *srv = c->srv;
+    int n;
+
+    for (;;) {
+        if (c->in_len == c->in_alloc) {
+            /* a handler may look at the buffer, do not move it */
+            if (c->state == STATE_HANDLER || c->in_alloc >= srv->max_header_size ||
+                grow_input(c, BBMIN(2 * c->in_alloc, srv->max_header_size)) < 0)
+                break;
+        }
+        n = recv(c->fd, c->in + c->in_len, c->in_alloc - c->in_len, 0);
+        if (!n) {
+            request_close(c);
+            return;
+        }
+        if (n < 0) {
+            n = bv_neterrno();
+            if (n == BVERROR(EINTR))
+                continue;
+            if (n == BVERROR(EAGAIN))
+                break;
+            request_close(c);
+            return;
+        }
+        c->in_len += n;
+        c->last_active = bv_gettime_relative();
+        if (c->state != STATE_HANDLER)
+            request_process(c);
+    }
+    request_update_events(c);
+}
+
+static void request_cb(BVEventLoop *loop, int fd, int events, void *opaque)
+{
+    BVHTTPRequest *c = opaque;
+
+    if ((events & BV_EVENT_WRITE) && request_flush(c) < 0)
+        return;
+    if (events & (BV_EVENT_READ | BV_EVENT_ERROR))
+        request_read(c);
+}
+
+static void accept_cb(BVEventLoop *loop, int fd, int events, void *opaque)
+{
+    BVHTTPServer *srv = opaque;
+    BVHTTPRequest *c;
+    int cfd, one = 1;
+
+    while ((cfd = accept(fd, NULL, NULL)) >= 0) {
+        if (srv->nb_clients >= srv->max_clients) {
+            bv_log(srv, BV_LOG_WARNING, "Too many clients, refusing one\n");
+            closesocket(cfd);
+            continue;
+        }
+        bv_socket_nonblock(cfd, 1);
+#ifdef TCP_NODELAY
+        setsockopt(cfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+#endif
+        if (!(c = bv_mallocz(sizeof(*c))) || !(c->in = bv_malloc(IN_BUFFER_SIZE))) {
+            if (c)
+                bv_free(c);
+            closesocket(cfd);
+            continue;
+        }
+        c->srv            = srv;
+        c->fd             = cfd;
+        c->in_alloc       = IN_BUFFER_SIZE;
+        c->refs           = 1;
+        c->max_queue_size = srv->max_queue_size;
+        c->events         = BV_EVENT_READ;
+        c->last_active    = bv_gettime_relative();
+        pthread_mutex_init(&c->lock, NULL);
+        if (bv_event_loop_add_fd(loop, cfd, BV_EVENT_READ, request_cb, c) < 0) {
+            closesocket(cfd);
+            request_free(c);
+            continue;
+        }
+        c->next = srv->clients;
+        if (c->next)
+            c->next->prev = c;
+        srv->clients = c;
+        srv->nb_clients++;
+    }
+}
+
+static void sweep_cb(BVEventLoop *loop, BVEventTimer *timer, void *opaque)
+{
+    BVHTTPServer *srv = opaque;
+    BVHTTPRequest *c, *next;
+    int64_t now = bv_gettime_relative();
+
+    for (c = srv->clients; c; c = next) {
+        int pending;
+
+        next = c->next;
+        pthread_mutex_lock(&c->lock);
+        pending = c->out_start < c->out_end;
+        pthread_mutex_unlock(&c->lock);
+        /* idle between requests, a client that stopped reading or a body
+         * url that stopped giving data */
+        if ((c->state != STATE_HANDLER || pending || c->body_reading) &&
+            now - c->last_active > srv->idle_timeout)
+            request_close(c);
+    }
+}
+
+int bv_http_server_alloc(BVHTTPServer **psrv, BVEventLoop *loop, BVDictionary **options)
+{
+    BVHTTPServer *srv = bv_mallocz(sizeof(*srv));
+    int ret;
+
+    if (!srv)
+        return BVERROR(ENOMEM);
+    srv->class = &http_server_class;
+    bv_opt_set_defaults(srv);
+    if (options && (ret = bv_opt_set_dict(srv, options)) < 0)
+        goto fail;
+    srv->loop = loop;
+    if (!loop) {
+        if ((ret = bv_event_loop_alloc(&srv->loop)) < 0)
+            goto fail;
+        srv->own_loop = 1;
+    }
+    srv->sweep = bv_event_loop_add_timer(srv->loop, SWEEP_INTERVAL, SWEEP_INTERVAL, sweep_cb, srv);
+    if (!srv->sweep) {
+        ret = BVERROR(ENOMEM);
+        goto fail;
+    }
+    bv_network_init();
+    *psrv = srv;
+    return 0;
+
+fail:
+    bv_http_server_free(&srv);
+    return ret;
+}
+
+void bv_http_server_free(BVHTTPServer **psrv)
+{
+    BVHTTPServer *srv = *psrv;
+    int i;
+
+    if (!srv)
+        return;
+    if (srv->thread_started) {
+        bv_event_loop_stop(srv->loop);
+        pthread_join(srv->thread, NULL);
+    }
+    while (srv->clients)
+        request_close(srv->clients);
+    for (i = 0; i < srv->nb_listen_fds; i++) {
+        bv_event_loop_del_fd(srv->loop, srv->listen_fds[i]);
+        closesocket(srv->listen_fds[i]);
+    }
+    if (srv->sweep)
+        bv_event_loop_del_timer(srv->loop, srv->sweep);
+    if (srv->own_loop && srv->loop) {
+        /* let posted flushes drop their references */
+        bv_event_loop_run_once(srv->loop, 0);
+        bv_event_loop_free(&srv->loop);
+    }
+    for (i = 0; i < srv->nb_routes; i++)
+        bv_free(srv->routes[i].prefix);
+    bv_free(srv->routes);
+    bv_free(srv->listen_fds);
+    bv_opt_free(srv);
+    bv_freep(psrv);
+}
+
+int bv_http_server_add_handler(BVHTTPServer *srv, const char *prefix,
+                               BVHTTPHandler handler, void *opaque)
+{
+    HTTPRoute *routes, *r;
+
+    if (!prefix || *prefix != '/' || !handler)
+        return BVERROR(EINVAL);
+    routes = bv_realloc_array(srv->routes, srv->nb_routes + 1, sizeof(*routes));
+    if (!routes)
+        return BVERROR(ENOMEM);
+    srv->routes = routes;
+    r = &routes[srv->nb_routes];
+    if (!(r->prefix = bv_strdup(prefix)))
+        return BVERROR(ENOMEM);
+    r->len     = strlen(prefix);
+    r->handler = handler;
+    r->opaque  = opaque;
+    srv->nb_routes++;
+    return 0;
+}
+
+int bv_http_server_listen(BVHTTPServer *srv, const char *host, int port)
+{
+    struct addrinfo hints = { 0 }, *ai, *cur;
+    char portstr[10];
+    int fd = -1, ret, reuse = 1, *fds;
+
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags    = AI_PASSIVE;
+    snprintf(portstr, sizeof(portstr), "%d", port);
+    if ((ret = getaddrinfo(host && *host ? host : NULL, portstr, &hints, &ai))) {
+        bv_log(srv, BV_LOG_ERROR, "Failed to resolve %s: %s\n", host, gai_strerror(ret));
+        return BVERROR(EIO);
+    }
+    ret = BVERROR(EIO);
+    for (cur = ai; cur; cur = cur->ai_next) {
+        if (srv->reuseport) {
+            /* one socket of the group per server, each on its own loop */
+            if ((ret = bv_listen_reuseport(cur, 1, &fd, 0)) < 0) {
+                fd = -1;
+                continue;
+            }
+            break;
+        }
+        if ((fd = bv_socket(cur->ai_family, cur->ai_socktype, cur->ai_protocol)) < 0)
+            continue;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (!bind(fd, cur->ai_addr, cur->ai_addrlen) && !listen(fd, 128))
+            break;
+        ret = bv_neterrno();
+        closesocket(fd);
+        fd = -1;
+    }
+    freeaddrinfo(ai);
+    if (fd < 0) {
+        bv_log(srv, BV_LOG_ERROR, "Cannot listen on port %d\n", port);
+        return ret;
+    }
+    bv_socket_nonblock(fd, 1);
+    fds = bv_realloc_array(srv->listen_fds, srv->nb_listen_fds + 1, sizeof(*fds));
+    if (!fds) {
+        closesocket(fd);
+        return BVERROR(ENOMEM);
+    }
+    srv->listen_fds = fds;
+    if ((ret = bv_event_loop_add_fd(srv->loop, fd, BV_EVENT_READ, accept_cb, srv)) < 0) {
+        closesocket(fd);
+        return ret;
+    }
+    fds[srv->nb_listen_fds++] = fd;
+    return 0;
+}
+
+static void *server_thread(void *arg)
+{
+    BVHTTPServer *srv = arg;
+
+    bv_event_loop_run(srv->loop);
+    return NULL;
+}
+
+int bv_http_server_start(BVHTTPServer *srv)
+{
+    int ret;
+
+    if (!srv->own_loop || srv->thread_started)
+        return 0;
+    if ((ret = pthread_create(&srv->thread, NULL, server_thread, srv)))
+        return BVERROR(ret);
+    srv->thread_started = 1;
+    return 0;
+}
+
+#ifdef TEST
+#include <stdio.h>
+
+#include "libbvutil/file.h"
+
+static char test_file[1024];
+static int test_upstream_port;
+
+static int hello_handler(BVHTTPRequest *req, void *opaque)
+{
+    static const char text[] = "hello world\n";
+    return bv_http_request_respond(req, HTTP_STATUS_OK, "text/plain", text, sizeof(text) - 1);
+}
+
+static int file_handler(BVHTTPRequest *req, void *opaque)
+{
+    return bv_http_request_respond_url(req, test_file, "application/octet-stream");
+}
+
+/* a body from another server, opened on a helper thread and read from the loop */
+static int proxy_handler(BVHTTPRequest *req, void *opaque)
+{
+    char url[256];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/file", test_upstream_port);
+    return bv_http_request_respond_url(req, url, "application/octet-stream");
+}
+
+/* an upstream which accepts but never answers */
+static int stall_handler(BVHTTPRequest *req, void *opaque)
+{
+    char url[256];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/", test_upstream_port + 1);
+    return bv_http_request_respond_url(req, url, "application/octet-stream");
+}
+
+static uint8_t test_buf[1 << 20];
+static int test_len;
+
+/**
+ * Read one response from a connection, the rest stays in test_buf.
+ * @return the status, -1 on error or end of file
+ */
+static int test_response(BVURLContext *h, uint8_t *body, int *body_len)
+{
+    char *end, *p;
+    int n, head, length;
+
+    while (!(end = bv_strnstr(test_buf, "\r\n\r\n", test_len))) {
+        if ((n = bv_url_read(h, test_buf + test_len, sizeof(test_buf) - 1 - test_len)) <= 0)
+            return -1;
+        test_len += n;
+    }
+    head = end + 4 - (char *)test_buf;
+    *end = 0;
+    if (!(p = bv_stristr(test_buf, "Content-Length:")))
+        return -1;
+    length = atoi(p + 15);
+    while (test_len < head + length) {
+        if ((n = bv_url_read(h, test_buf + test_len, sizeof(test_buf) - 1 - test_len)) <= 0)
+            return -1;
+        test_len += n;
+    }
+    memcpy(body, test_buf + head, length);
+    *body_len = length;
+    n = atoi((char *)test_buf + 9);
+    memmove(test_buf, test_buf + head + length, test_len - head - length);
+    test_len -= head + length;
+    return n;
+}
+
+int main(void)
+{
+    static const char requests[] =
+        "GET /hello HTTP/1.1\r\nHost: x\r\n\r\n"
+        "GET /file HTTP/1.1\r\nHost: x\r\n\r\n"
+        "GET /proxy HTTP/1.1\r\nHost: x\r\n\r\n"
+        "GET /none HTTP/1.1\r\nHost: x\r\n\r\n"
+        "GET /hello HTTP/1.1\r\nHost: x\r\nConnection: close\r\n\r\n";
+    static const int expected[] = { 200, 200, 200, 404, 200 };
+    static uint8_t ref[300000], body[300000];
+    BVHTTPServer *srv = NULL, *upstream = NULL;
+    BVURLContext *h = NULL, *stalled = NULL;
+    struct sockaddr_in addr = { 0 };
+    char *name = NULL, url[256];
+    int port = 20000 + getpid() % 20000, i, fd, len, err = 1, stall_fd = -1;
+
+    bv_protocol_register_all();
+    bv_network_init();
+    test_upstream_port = port + 1;
+
+    for (i = 0; i < sizeof(ref); i++)
+        ref[i] = i * 7 + (i >> 11);
+    if ((fd = bv_tempfile("httpserver", &name, 0, NULL)) < 0 ||
+        write(fd, ref, sizeof(ref)) != sizeof(ref)) {
+        printf("cannot write the test file\n");
+        goto end;
+    }
+    close(fd);
+    snprintf(test_file, sizeof(test_file), "file:%s", name);
+
+    if (bv_http_server_alloc(&srv, NULL, NULL) < 0 ||
+        bv_http_server_alloc(&upstream, NULL, NULL) < 0 ||
+        bv_http_server_add_handler(srv, "/hello", hello_handler, NULL) < 0 ||
+        bv_http_server_add_handler(srv, "/file", file_handler, NULL) < 0 ||
+        bv_http_server_add_handler(srv, "/proxy", proxy_handler, NULL) < 0 ||
+        bv_http_server_add_handler(srv, "/stall", stall_handler, NULL) < 0 ||
+        bv_http_server_add_handler(upstream, "/file", file_handler, NULL) < 0 ||
+        bv_http_server_listen(srv, "127.0.0.1", port) < 0 ||
+        bv_http_server_listen(upstream, "127.0.0.1", port + 1) < 0 ||
+        bv_http_server_start(srv) < 0 || bv_http_server_start(upstream) < 0) {
+        printf("cannot start the servers\n");
+        goto end;
+    }
+
+    /* connects complete in the backlog, nothing is ever read or answered */
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port + 2);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if ((stall_fd = socket(AF_INET, SOCK_STREAM, 0)) < 0 ||
+        bind(stall_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(stall_fd, 4) < 0) {
+        printf("cannot start the stalled upstream\n");
+        goto end;
+    }
+    /* its response stays pending, the loop goes on with the others */
+    snprintf(url, sizeof(url), "tcp://127.0.0.1:%d", port);
+    if (bv_url_open(&stalled, url, BV_IO_FLAG_READ_WRITE, NULL, NULL) < 0 ||
+        bv_url_write(stalled, "GET /stall HTTP/1.1\r\nHost: x\r\n\r\n", 32) < 0) {
+        printf("cannot send the stalled request\n");
+        goto end;
+    }
+
+    /* all requests at once on one connection, answered in order */
+    if (bv_url_open(&h, url, BV_IO_FLAG_READ_WRITE, NULL, NULL) < 0 ||
+        bv_url_write(h, requests, sizeof(requests) - 1) < 0) {
+        printf("cannot send the requests\n");
+        goto end;
+    }
+    for (i = 0; i < BV_ARRAY_ELEMS(expected); i++) {
+        int status = test_response(h, body, &len);
+        if (status != expected[i]) {
+            printf("request %d: status %d instead of %d\n", i, status, expected[i]);
+            goto end;
+        }
+        if ((i == 1 || i == 2) && (len != sizeof(ref) || memcmp(body, ref, len))) {
+            printf("request %d: wrong body of %d bytes\n", i, len);
+            goto end;
+        }
+    }
+    /* the last one asked to close */
+    if (test_len || bv_url_read(h, test_buf, sizeof(test_buf)) > 0) {
+        printf("connection not closed\n");
+        goto end;
+    }
+    err = 0;
+end:
+    bv_url_closep(&h);
+    /* interrupts the helper still waiting for the stalled upstream */
+    bv_http_server_free(&srv);
+    bv_http_server_free(&upstream);
+    bv_url_closep(&stalled);
+    if (stall_fd >= 0)
+        closesocket(stall_fd);
+    if (name)
+        unlink(name);
+    bv_free(name);
+    printf("%s\n", err ? "FAIL" : "OK");
+    return err;
+}
+#endif /* TEST */
@@ -0,0 +1,156 @@
+/*************************************************************************
+    > File Name: httpserver.h
+    > Author: albertfang
+    > Mail: fang.qi@besovideo.com
+    > Created Time: 2026年10月19日 星期一 09时12分40秒
+ ************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) albert@BesoVideo, 2026
+ */
+
+#ifndef BV_HTTP_SERVER_H
+#define BV_HTTP_SERVER_H
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/**
+ * @file
+ * Embedded HTTP/1.1 server.
+ *
+ * All clients are served from one event loop thread. Requests are routed
+ * by path prefix to handlers, which answer at once with a whole body or
+ * a url (byte ranges handled by the server), or start a streaming
+ * response and feed it later from any thread (live MJPEG, HTTP-FLV).
+ * Connections are kept alive between requests.
+ */
+
+#include <libbvutil/dict.h>
+#include <libbvutil/eventloop.h>
+
+typedef struct BVHTTPServer BVHTTPServer;
+typedef struct BVHTTPRequest BVHTTPRequest;
+
+/**
+ * Called on the loop thread once a request and its body are in.
+ *
+ * @return 0 if the request was answered or will be answered later by a
+ *         response call, a negative error code to let the server answer
+ *         with a matching error status; req is gone in that case
+ */
+typedef int (*BVHTTPHandler)(BVHTTPRequest *req, void *opaque);
+
+/**
+ * @param loop    loop to serve on, NULL to have the server run its own
+ *                loop thread from bv_http_server_start()
+ * @param options idle_timeout, max_clients, max_header_size,
+ *                max_body_size, max_queue_size, reuseport (several
+ *                servers, each with its own loop, listen on one port and
+ *                the kernel spreads the clients over them)
+ */
+int bv_http_server_alloc(BVHTTPServer **srv, BVEventLoop *loop, BVDictionary **options);
+
+/**
+ * Stop serving and close all clients. Streaming requests must have been
+ * ended. With a caller loop this must run on its thread.
+ */
+void bv_http_server_free(BVHTTPServer **srv);
+
+/**
+ * Route requests whose path is prefix or starts with prefix followed by
+ * a '/' to handler, the longest prefix wins. Call before serving.
+ */
+int bv_http_server_add_handler(BVHTTPServer *srv, const char *prefix,
+                               BVHTTPHandler handler, void *opaque);
+
+/**
+ * Accept clients on host:port, host may be NULL for all addresses.
+ * With a caller loop, call before it runs or from its thread.
+ */
+int bv_http_server_listen(BVHTTPServer *srv, const char *host, int port);
+
+/**
+ * Start the server's own loop thread, nothing to do with a caller loop.
+ */
+int bv_http_server_start(BVHTTPServer *srv);
+
+const char *bv_http_request_get_method(BVHTTPRequest *req);
+
+/**
+ * @return the request path without the query string
+ */
+const char *bv_http_request_get_path(BVHTTPRequest *req);
+
+/**
+ * @return the query string without '?', "" if none
+ */
+const char *bv_http_request_get_query(BVHTTPRequest *req);
+
+/**
+ * @return the value of header name (case insensitive) or NULL
+ */
+const char *bv_http_request_get_header(BVHTTPRequest *req, const char *name);
+
+const uint8_t *bv_http_request_get_body(BVHTTPRequest *req, int *size);
+
+/**
+ * Add a "name: value" line to the response, before it is started.
+ */
+int bv_http_request_add_header(BVHTTPRequest *req, const char *name, const char *value);
+
+/**
+ * Answer with a whole body, copied. A 200 answer honours a Range header.
+ * req is gone afterwards. Callable from any thread.
+ */
+int bv_http_request_respond(BVHTTPRequest *req, int status, const char *content_type,
+                            const uint8_t *body, int64_t size);
+
+/**
+ * Answer with the content of url (file:, bvfs:...), read as the client
+ * takes it. Byte ranges are served when url can seek. The url is opened
+ * on a helper thread, which also reads it unless it is nonblock; open
+ * errors are answered with an error status. req is gone afterwards,
+ * also on error.
+ *
+ * @return 0 once the helper is started, a negative error code otherwise
+ */
+int bv_http_request_respond_url(BVHTTPRequest *req, const char *url, const char *content_type);
+
+/**
+ * Start a streaming response of content_length bytes, -1 for a chunked
+ * response of unknown length. Feed it with bv_http_request_write() and
+ * finish with bv_http_request_end(), from any thread.
+ */
+int bv_http_request_begin(BVHTTPRequest *req, int status, const char *content_type,
+                          int64_t content_length);
+
+/**
+ * @return 0, BVERROR(EAGAIN) if the client is too slow and the data was
+ *         dropped, BVERROR(EPIPE) once the client is gone
+ */
+int bv_http_request_write(BVHTTPRequest *req, const uint8_t *buf, int size);
+
+/**
+ * End a streaming response, req is gone afterwards.
+ */
+int bv_http_request_end(BVHTTPRequest *req);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of include guard: BV_HTTP_SERVER_H */
@@ -0,0 +1,522 @@
+/*************************************************************************
+    > File Name: mem.c
+    > Author: albertfang
+    > Mail: fang.qi@besovideo.com
+    > Created Time: 2026年10月18日 星期日 18时44分06秒
+ ************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) albert@BesoVideo, 2026
+ */
+
+/**
+ * @file
+ * In-process pipe: mem://name connects one writer and one reader of the
+ * same process through a single-producer/single-consumer ring. The data
+ * path is lock free; the mutex is only taken to sleep and to wake up.
+ *
+ * mem://name?buffer_size=N&packet=1&pkt_size=N&policy=block|drop
+ * buffer_size and packet are taken from whichever endpoint opens first.
+ */
+
+#include <pthread.h>
+
+#include "libbvutil/atomic.h"
+#include "libbvutil/bvstring.h"
+#include "libbvutil/intreadwrite.h"
+#include "libbvutil/opt.h"
+#include "libbvutil/parseutils.h"
+#include "libbvutil/time.h"
+
+#include "bvurl.h"
+#include "bvio.h"
+
+#define MEM_POLL_TIME 100000
+
+enum MemPolicy {
+    MEM_POLICY_BLOCK,
+    MEM_POLICY_DROP,
+};
+
+typedef struct MemPipe {
+    struct MemPipe *next;
+    char *name;
+    int refcount;
+    uint8_t *data;
+    unsigned size;              ///< power of two
+    int packet;                 ///< records are [size:32][data], one per write
+    volatile int head;          ///< written by the writer only
+    volatile int tail;          ///< written by the reader only
+    int has_writer;             ///< protected by mem_pipes_lock
+    int has_reader;
+    volatile int writer_done;
+    volatile int reader_done;
+    volatile int sleepers;
+    volatile int dropped;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} MemPipe;
+
+typedef struct MemContext {
+    const BVClass *class;
+    MemPipe *pipe;
+    int writer;
+    int buffer_size;
+    int packet;
+    int pkt_size;
+    int policy;
+    int64_t rw_timeout;
+} MemContext;
+
+static pthread_mutex_t mem_pipes_lock = PTHREAD_MUTEX_INITIALIZER;
+static MemPipe *mem_pipes;
+
+#define OFFSET(x) offsetof(MemContext, x)
+#define D BV_OPT_FLAG_DECODING_PARAM
+#define E BV_OPT_FLAG_ENCODING_PARAM
+static const BVOption mem_options[] = {
+    { "buffer_size", "ring size in bytes, used by the endpoint that creates the pipe", OFFSET(buffer_size), BV_OPT_TYPE_INT, { .i64 = 1 << 20 }, 4096, 1 << 30, D|E },
+    { "packet", "keep write boundaries, each read returns one write", OFFSET(packet), BV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, D|E },
+    { "pkt_size", "maximum packet size in packet mode", OFFSET(pkt_size), BV_OPT_TYPE_INT, { .i64 = 32768 }, 1, INT_MAX, D|E },
+    { "policy", "what a writer does when the ring is full", OFFSET(policy), BV_OPT_TYPE_INT, { .i64 = MEM_POLICY_BLOCK }, MEM_POLICY_BLOCK, MEM_POLICY_DROP, E, "policy" },
+    { "block", "wait for the reader (backpressure)", 0, BV_OPT_TYPE_CONST, { .i64 = MEM_POLICY_BLOCK }, 0, 0, E, "policy" },
+    { "drop",  "discard the whole write", 0, BV_OPT_TYPE_CONST, { .i64 = MEM_POLICY_DROP }, 0, 0, E, "policy" },
+    { "timeout", "set timeout (in microseconds) of blocking reads and writes", OFFSET(rw_timeout), BV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, D|E },
+    { NULL }
+};
+
+static const BVClass mem_class = {
+    .class_name = "mem",
+    .item_name  = bv_default_item_name,
+    .option     = mem_options,
+    .version    = LIBBVUTIL_VERSION_INT,
+};
+
+static void mem_pipe_wakeup(MemPipe *p)
+{
+    if (bvpriv_atomic_int_get(&p->sleepers)) {
+        pthread_mutex_lock(&p->mutex);
+        pthread_cond_broadcast(&p->cond);
+        pthread_mutex_unlock(&p->mutex);
+    }
+}
+
+/**
+ * Sleep until ready() holds, the timeout expires or the caller is interrupted.
+ */
+static int mem_pipe_wait(BVURLContext *h, MemPipe *p, int (*ready)(MemPipe *p, int need), int need)
+{
+    MemContext *s = h->priv_data;
+    int64_t deadline = s->rw_timeout ? bv_gettime() + s->rw_timeout : 0;
+    int ret = 0;
+
+    pthread_mutex_lock(&p->mutex);
+    bvpriv_atomic_int_add_and_fetch(&p->sleepers, 1);
+    while (!ready(p, need)) {
+        int64_t t = bv_gettime() + MEM_POLL_TIME;
+        struct timespec tv;
+        if (bv_check_interrupt(&h->interrupt_callback)) {
+            ret = BVERROR_EXIT;
+            break;
+        }
+        if (deadline && t > deadline) {
+            if (bv_gettime() >= deadline) {
+                ret = BVERROR(ETIMEDOUT);
+                break;
+            }
+            t = deadline;
+        }
+        tv.tv_sec  = t / 1000000;
+        tv.tv_nsec = (t % 1000000) * 1000;
+        pthread_cond_timedwait(&p->cond, &p->mutex, &tv);
+    }
+    bvpriv_atomic_int_add_and_fetch(&p->sleepers, -1);
+    pthread_mutex_unlock(&p->mutex);
+    return ret;
+}
+
+static unsigned mem_pipe_used(MemPipe *p)
+{
+    return (unsigned)bvpriv_atomic_int_get(&p->head) - (unsigned)bvpriv_atomic_int_get(&p->tail);
+}
+
+static int readable(MemPipe *p, int need)
+{
+    return mem_pipe_used(p) > 0 || bvpriv_atomic_int_get(&p->writer_done);
+}
+
+static int writable(MemPipe *p, int need)
+{
+    return p->size - mem_pipe_used(p) >= need || bvpriv_atomic_int_get(&p->reader_done);
+}
+
+static void ring_write(MemPipe *p, unsigned pos, const uint8_t *buf, int size)
+{
+    unsigned off = pos & (p->size - 1);
+    int len = BBMIN(size, p->size - off);
+    memcpy(p->data + off, buf, len);
+    memcpy(p->data, buf + len, size - len);
+}
+
+static void ring_read(MemPipe *p, unsigned pos, uint8_t *buf, int size)
+{
+    unsigned off = pos & (p->size - 1);
+    int len = BBMIN(size, p->size - off);
+    memcpy(buf, p->data + off, len);
+    memcpy(buf + len, p->data, size - len);
+}
+
+static void mem_pipe_unref(MemPipe *p, int writer)
+{
+    MemPipe **pp;
+
+    pthread_mutex_lock(&mem_pipes_lock);
+    /* the pipe may be opened again from this side while the other stays */
+    if (writer)
+        p->has_writer = 0;
+    else
+        p->has_reader = 0;
+    if (--p->refcount) {
+        pthread_mutex_unlock(&mem_pipes_lock);
+        return;
+    }
+    for (pp = &mem_pipes; *pp; pp = &(*pp)->next) {
+        if (*pp == p) {
+            *pp = p->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mem_pipes_lock);
+
+    pthread_cond_destroy(&p->cond);
+    pthread_mutex_destroy(&p->mutex);
+    bv_free(p->data);
+    bv_free(p->name);
+    bv_free(p);
+}
+
+static int mem_pipe_ref(MemContext *s, const char *name, MemPipe **pipe)
+{
+    MemPipe *p;
+    unsigned size = 4096;
+    int ret = 0;
+
+    pthread_mutex_lock(&mem_pipes_lock);
+    for (p = mem_pipes; p; p = p->next)
+        if (!strcmp(p->name, name))
+            break;
+
+    if (!p) {
+        while (size < s->buffer_size)
+            size <<= 1;
+        p = bv_mallocz(sizeof(*p));
+        if (!p) {
+            ret = BVERROR(ENOMEM);
+            goto done;
+        }
+        p->name = bv_strdup(name);
+        p->data = bv_malloc(size);
+        if (!p->name || !p->data) {
+            bv_free(p->name);
+            bv_free(p->data);
+            bv_freep(&p);
+            ret = BVERROR(ENOMEM);
+            goto done;
+        }
+        p->size = size;
+        p->packet = s->packet;
+        pthread_mutex_init(&p->mutex, NULL);
+        pthread_cond_init(&p->cond, NULL);
+        p->next = mem_pipes;
+        mem_pipes = p;
+    }
+
+    if (s->writer ? p->has_writer : p->has_reader) {
+        ret = BVERROR(EBUSY);
+        goto done;
+    }
+    if (s->writer) {
+        p->has_writer = 1;
+        bvpriv_atomic_int_set(&p->writer_done, 0);
+    } else {
+        p->has_reader = 1;
+        bvpriv_atomic_int_set(&p->reader_done, 0);
+    }
+    p->refcount++;
+    *pipe = p;
+done:
+    pthread_mutex_unlock(&mem_pipes_lock);
+    return ret;
+}
+
+static int mem_open(BVURLContext *h, const char *uri, int flags, BVDictionary **options)
+{
+    MemContext *s = h->priv_data;
+    const BVOption *o;
+    const char *name = uri, *p;
+    char buf[256];
+    char pipe_name[256];
+    int ret;
+
+    bv_strstart(uri, "mem:", &name);
+    while (*name == '/')
+        name++;
+    bv_strlcpy(pipe_name, name, sizeof(pipe_name));
+    p = strchr(name, '?');
+    if (p)
+        pipe_name[BBMIN(p - name, sizeof(pipe_name) - 1)] = '\0';
+    /* the query string sets the same options as the dictionary */
+    for (o = mem_options; p && o->name; o++) {
+        if (o->type != BV_OPT_TYPE_CONST &&
+            bv_find_info_tag(buf, sizeof(buf), o->name, p) &&
+            (ret = bv_opt_set(s, o->name, buf, 0)) < 0) {
+            bv_log(h, BV_LOG_ERROR, "Invalid %s '%s'\n", o->name, buf);
+            return ret;
+        }
+    }
+    if (s->buffer_size < 4096 || s->pkt_size <= 0)
+        return BVERROR(EINVAL);
+    name = pipe_name;
+    if (!*name) {
+        bv_log(h, BV_LOG_ERROR, "missing pipe name in %s\n", uri);
+        return BVERROR(EINVAL);
+    }
+    if ((flags & BV_IO_FLAG_READ_WRITE) == BV_IO_FLAG_READ_WRITE) {
+        bv_log(h, BV_LOG_ERROR, "an endpoint is either the reader or the writer\n");
+        return BVERROR(EINVAL);
+    }
+
+    s->writer = !!(flags & BV_IO_FLAG_WRITE);
+    if ((ret = mem_pipe_ref(s, name, &s->pipe)) < 0) {
+        if (ret == BVERROR(EBUSY))
+            bv_log(h, BV_LOG_ERROR, "%s already has a %s\n", name, s->writer ? "writer" : "reader");
+        return ret;
+    }
+
+    if (s->pipe->packet)
+        h->max_packet_size = BBMIN(s->pkt_size, s->pipe->size - 4);
+    h->is_streamed = 1;
+    return 0;
+}
+
+static int mem_read(BVURLContext *h, uint8_t *buf, size_t size)
+{
+    MemContext *s = h->priv_data;
+    MemPipe *p = s->pipe;
+    unsigned tail = bvpriv_atomic_int_get(&p->tail);
+    unsigned used;
+    int ret, len;
+
+    while (!(used = mem_pipe_used(p))) {
+        if (bvpriv_atomic_int_get(&p->writer_done)) {
+            /* the writer may have published data right before leaving */
+            if ((used = mem_pipe_used(p)))
+                break;
+            return BVERROR_EOF;
+        }
+        if (h->flags & BV_IO_FLAG_NONBLOCK)
+            return BVERROR(EAGAIN);
+        if ((ret = mem_pipe_wait(h, p, readable, 0)) < 0)
+            return ret;
+    }
+
+    if (p->packet) {
+        uint8_t hdr[4];
+        int pkt;
+        ring_read(p, tail, hdr, 4);
+        pkt = BV_RL32(hdr);
+        len = BBMIN(pkt, size);
+        ring_read(p, tail + 4, buf, len);
+        tail += 4 + pkt;
+    } else {
+        len = BBMIN(used, size);
+        ring_read(p, tail, buf, len);
+        tail += len;
+    }
+    bvpriv_atomic_int_set(&p->tail, tail);
+    mem_pipe_wakeup(p);
+    return len;
+}
+
+static int mem_write(BVURLContext *h, const uint8_t *buf, size_t size)
+{
+    MemContext *s = h->priv_data;
+    MemPipe *p = s->pipe;
+    unsigned head = bvpriv_atomic_int_get(&p->head);
+    int need = p->packet ? size + 4 : 1;
+    int ret, len;
+
+    if (p->packet && size > h->max_packet_size)
+        return BVERROR(EINVAL);
+
+    while (!writable(p, need) || bvpriv_atomic_int_get(&p->reader_done)) {
+        if (bvpriv_atomic_int_get(&p->reader_done))
+            return BVERROR(EPIPE);
+        if (s->policy == MEM_POLICY_DROP) {
+            bvpriv_atomic_int_add_and_fetch(&p->dropped, 1);
+            return size;
+        }
+        if (h->flags & BV_IO_FLAG_NONBLOCK)
+            return BVERROR(EAGAIN);
+        if ((ret = mem_pipe_wait(h, p, writable, need)) < 0)
+            return ret;
+    }
+
+    if (p->packet) {
+        uint8_t hdr[4];
+        BV_WL32(hdr, size);
+        ring_write(p, head, hdr, 4);
+        ring_write(p, head + 4, buf, size);
+        len = size;
+        head += 4 + len;
+    } else {
+        len = BBMIN(p->size - mem_pipe_used(p), size);
+        if (s->policy == MEM_POLICY_DROP && len < size) {
+            bvpriv_atomic_int_add_and_fetch(&p->dropped, 1);
+            return size;
+        }
+        ring_write(p, head, buf, len);
+        head += len;
+    }
+    bvpriv_atomic_int_set(&p->head, head);
+    mem_pipe_wakeup(p);
+    return len;
+}
+
+static int mem_close(BVURLContext *h)
+{
+    MemContext *s = h->priv_data;
+    MemPipe *p = s->pipe;
+
+    if (s->writer) {
+        bvpriv_atomic_int_set(&p->writer_done, 1);
+        if (p->dropped)
+            bv_log(h, BV_LOG_WARNING, "%d writes dropped on %s\n", p->dropped, p->name);
+    } else {
+        bvpriv_atomic_int_set(&p->reader_done, 1);
+    }
+    pthread_mutex_lock(&p->mutex);
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->mutex);
+    mem_pipe_unref(p, s->writer);
+    return 0;
+}
+
+BVURLProtocol bv_mem_protocol = {
+    .name                = "mem",
+    .url_open            = mem_open,
+    .url_read            = mem_read,
+    .url_write           = mem_write,
+    .url_close           = mem_close,
+    .priv_data_size      = sizeof(MemContext),
+    .priv_class          = &mem_class,
+};
+
+#ifdef TEST
+#include <stdio.h>
+
+#undef printf
+
+#define TEST_SIZE (3 * 4096 + 100)
+
+static void *test_writer(void *arg)
+{
+    BVURLContext *w = NULL;
+    uint8_t buf[TEST_SIZE];
+    int i;
+
+    for (i = 0; i < TEST_SIZE; i++)
+        buf[i] = i * 7;
+    if (bv_url_open(&w, "mem://block?buffer_size=4096", BV_IO_FLAG_WRITE, NULL, NULL) < 0)
+        return (void *)1;
+    /* three times the ring, only gets through with the reader draining it */
+    i = bv_url_write(w, buf, TEST_SIZE);
+    bv_url_close(w);
+    return (void *)(intptr_t)(i != TEST_SIZE);
+}
+
+#define CHECK(x) do { if (!(x)) { printf("line %d: %s\n", __LINE__, #x); goto end; } } while (0)
+
+int main(void)
+{
+    BVURLContext *r = NULL, *w = NULL;
+    uint8_t buf[TEST_SIZE];
+    pthread_t thread;
+    void *res;
+    int i, len, total, err = 1;
+    int64_t t;
+
+    bv_protocol_register_all();
+
+    CHECK(bv_url_open(&r, "mem://bad?policy=bogus", BV_IO_FLAG_READ, NULL, NULL) < 0);
+    CHECK(bv_url_open(&r, "mem://bad?buffer_size=16", BV_IO_FLAG_READ, NULL, NULL) < 0);
+
+    /* block: the writer waits for room, then EOF once it is gone */
+    CHECK(bv_url_open(&r, "mem://block", BV_IO_FLAG_READ, NULL, NULL) >= 0);
+    CHECK(!pthread_create(&thread, NULL, test_writer, NULL));
+    for (total = 0; (len = bv_url_read(r, buf + total, TEST_SIZE - total)) > 0; total += len) {
+        if (!total)
+            bv_usleep(50000);
+    }
+    pthread_join(thread, &res);
+    CHECK(!res && len == 0 && total == TEST_SIZE);
+    for (i = 0; i < TEST_SIZE && buf[i] == (uint8_t)(i * 7); i++);
+    CHECK(i == TEST_SIZE);
+    CHECK(r->prot->url_read(r, buf, 1) == BVERROR_EOF);
+    bv_url_closep(&r);
+
+    /* drop: whole packets go, the first ones are kept */
+    CHECK(bv_url_open(&r, "mem://drop?buffer_size=4096&packet=1", BV_IO_FLAG_READ | BV_IO_FLAG_NONBLOCK, NULL, NULL) >= 0);
+    CHECK(bv_url_open(&w, "mem://drop?policy=drop&pkt_size=1000", BV_IO_FLAG_WRITE, NULL, NULL) >= 0);
+    CHECK(w->max_packet_size == 1000);
+    for (i = 0; i < 10; i++) {
+        memset(buf, i, 1000);
+        CHECK(bv_url_write(w, buf, 1000 - i) == 1000 - i);
+    }
+    for (i = 0; i < 4; i++) {
+        CHECK(bv_url_read(r, buf, sizeof(buf)) == 1000 - i);
+        CHECK(buf[0] == i && buf[999 - i] == i);
+    }
+    /* nonblock: nothing left */
+    CHECK(bv_url_read(r, buf, sizeof(buf)) == BVERROR(EAGAIN));
+    bv_url_closep(&w);
+
+    /* EOF once the writer is gone */
+    CHECK(bv_url_read(r, buf, sizeof(buf)) == BVERROR_EOF);
+    bv_url_closep(&r);
+
+    /* nonblock writer on a full ring, then EPIPE once the reader is gone */
+    CHECK(bv_url_open(&r, "mem://pipe?buffer_size=4096", BV_IO_FLAG_READ, NULL, NULL) >= 0);
+    CHECK(bv_url_open(&w, "mem://pipe", BV_IO_FLAG_WRITE | BV_IO_FLAG_NONBLOCK, NULL, NULL) >= 0);
+    CHECK(bv_url_write(w, buf, 4096) == 4096);
+    CHECK(bv_url_write(w, buf, 1) == BVERROR(EAGAIN));
+    bv_url_closep(&r);
+    CHECK(bv_url_write(w, buf, 1) == BVERROR(EPIPE));
+    bv_url_closep(&w);
+
+    /* a blocking read gives up after the timeout */
+    CHECK(bv_url_open(&r, "mem://idle?timeout=100000", BV_IO_FLAG_READ, NULL, NULL) >= 0);
+    t = bv_gettime_relative();
+    CHECK(bv_url_read(r, buf, 1) == BVERROR(ETIMEDOUT));
+    t = bv_gettime_relative() - t;
+    CHECK(t >= 90000 && t < 1000000);
+    err = 0;
+end:
+    bv_url_closep(&w);
+    bv_url_closep(&r);
+    printf("%s\n", err ? "FAIL" : "OK");
+    return err;
+}
+#endif /* TEST */
@@ -18,6 +18,10 @@
  * License along with FFmpeg; if not, write to the Free Software
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
+
+#define _DEFAULT_SOURCE     /* SO_REUSEPORT with recent glibc */
+#define _BSD_SOURCE
+
 #include "bvurl.h"
 #include "libbvutil/parseutils.h"
 #include "libbvutil/opt.h"
@@ -27,9 +31,13 @@
 //#include "internal.h"
 #include "libbvutil/network.h"
 #include "libbvutil/os_support.h"
+#include "libbvutil/resolver.h"
 #if BV_HAVE_POLL_H
 #include <poll.h>
 #endif
+#if BV_HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
 
 typedef struct TCPContext {
     const BVClass *class;
@@ -38,6 +46,7 @@ typedef struct TCPContext {
     int open_timeout;
     int rw_timeout;
     int listen_timeout;
+    int reuseport;
 } TCPContext;
 
 #define OFFSET(x) offsetof(TCPContext, x)
@@ -47,6 +56,7 @@ static const BVOption options[] = {
     { "listen", "Listen for incoming connections",  OFFSET(listen), BV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, .flags = D|E },
     { "timeout", "set timeout (in microseconds) of socket I/O operations", OFFSET(rw_timeout), BV_OPT_TYPE_INT, { .i64 = -1 }, -1, INT_MAX, .flags = D|E },
     { "listen_timeout", "Connection awaiting timeout", OFFSET(listen_timeout), BV_OPT_TYPE_INT, { .i64 = -1 }, -1, INT_MAX, .flags = D|E },
+    { "reuseport", "Let several listeners bind the same port (SO_REUSEPORT)", OFFSET(reuseport), BV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, .flags = D|E },
     { NULL }
 };
 
@@ -93,6 +103,12 @@ static int tcp_open(BVURLContext *h, const char *uri, int flags, BVDictionary **
         if (bv_find_info_tag(buf, sizeof(buf), "listen_timeout", p)) {
             s->listen_timeout = strtol(buf, NULL, 10);
         }
+        if (bv_find_info_tag(buf, sizeof(buf), "reuseport", p)) {
+            char *endptr = NULL;
+            s->reuseport = strtol(buf, &endptr, 10);
+            if (buf == endptr)
+                s->reuseport = 1;
+        }
     }
     if (s->rw_timeout >= 0) {
         s->open_timeout =
@@ -103,15 +119,25 @@ static int tcp_open(BVURLContext *h, const char *uri, int flags, BVDictionary **
     snprintf(portstr, sizeof(portstr), "%d", port);
     if (s->listen)
         hints.ai_flags |= AI_PASSIVE;
-    if (!hostname[0])
-        ret = getaddrinfo(NULL, portstr, &hints, &ai);
-    else
-        ret = getaddrinfo(hostname, portstr, &hints, &ai);
-    if (ret) {
+    ret = bv_resolve(hostname, portstr, &hints, &ai,
+                     s->open_timeout, &h->interrupt_callback);
+    if (ret < 0) {
         bv_log(h, BV_LOG_ERROR,
                "Failed to resolve hostname %s: %s\n",
-               hostname, gai_strerror(ret));
-        return BVERROR(EIO);
+               hostname, bv_err2str(ret));
+        return ret;
+    }
+
+    if (!s->listen) {
+        /* race the addresses instead of waiting out each dead one */
+        ret = bv_connect_parallel(ai, s->open_timeout / 1000, 3,
+                                  &h->interrupt_callback, &fd);
+        bv_resolve_free(ai);
+        if (ret < 0)
+            return ret;
+        h->is_streamed = 1;
+        s->fd = fd;
+        return 0;
     }
 
     cur_ai = ai;
@@ -125,26 +151,29 @@ static int tcp_open(BVURLContext *h, const char *uri, int flags, BVDictionary **
         goto fail;
     }
 
-    if (s->listen) {
-        if ((fd = bv_listen_bind(fd, cur_ai->ai_addr, cur_ai->ai_addrlen,
-                                 s->listen_timeout, &h->interrupt_callback)) < 0) {
-            ret = fd;
+    if (s->reuseport) {
+#ifdef SO_REUSEPORT
+        int one = 1;
+        if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one))) {
+            ret = bv_neterrno();
+            bv_log(h, BV_LOG_ERROR, "setsockopt(SO_REUSEPORT) failed: %s\n", bv_err2str(ret));
             goto fail1;
         }
-    } else {
-        if ((ret = bv_listen_connect(fd, cur_ai->ai_addr, cur_ai->ai_addrlen,
-                                     s->open_timeout / 1000, &h->interrupt_callback, !!cur_ai->ai_next)) < 0) {
-
-            if (ret == BVERROR_EXIT)
-                goto fail1;
-            else
-                goto fail;
-        }
+#else
+        ret = BVERROR(ENOSYS);
+        bv_log(h, BV_LOG_ERROR, "SO_REUSEPORT is not supported\n");
+        goto fail1;
+#endif
+    }
+    if ((fd = bv_listen_bind(fd, cur_ai->ai_addr, cur_ai->ai_addrlen,
+                             s->listen_timeout, &h->interrupt_callback)) < 0) {
+        ret = fd;
+        goto fail1;
     }
 
     h->is_streamed = 1;
     s->fd = fd;
-    freeaddrinfo(ai);
+    bv_resolve_free(ai);
     return 0;
 
  fail:
@@ -159,7 +188,7 @@ static int tcp_open(BVURLContext *h, const char *uri, int flags, BVDictionary **
  fail1:
     if (fd >= 0)
         closesocket(fd);
-    freeaddrinfo(ai);
+    bv_resolve_free(ai);
     return ret;
 }
 
@@ -191,6 +220,53 @@ static int tcp_write(BVURLContext *h, const uint8_t *buf, size_t size)
     return ret < 0 ? bv_neterrno() : ret;
 }
 
+#if BV_HAVE_SYS_SENDFILE_H
+static int tcp_sendfile(BVURLContext *h, const BVURLSendfile *sf)
+{
+    TCPContext *s = h->priv_data;
+    off_t offset = sf->offset;
+    int64_t sent = 0;
+    ssize_t n;
+    int ret;
+
+    if (sf->size < 0 || sf->size > INT_MAX)
+        return BVERROR(EINVAL);
+    while (sent < sf->size) {
+        if (!(h->flags & BV_IO_FLAG_NONBLOCK)) {
+            ret = bv_network_wait_fd_timeout(s->fd, 1, h->rw_timeout, &h->interrupt_callback);
+            if (ret)
+                return ret;
+        }
+        n = sendfile(s->fd, sf->fd, &offset, sf->size - sent);
+        if (n < 0) {
+            ret = bv_neterrno();
+            if (ret != BVERROR(EAGAIN) || (h->flags & BV_IO_FLAG_NONBLOCK))
+                return sent ? sent : ret;
+            continue;
+        }
+        if (!n)
+            break;
+        sent += n;
+    }
+    return sent;
+}
+#endif
+
+static int tcp_control(BVURLContext *h, int type, BVControlPacket *pkt_in, BVControlPacket *pkt_out)
+{
+    switch (type) {
+#if BV_HAVE_SYS_SENDFILE_H
+    case BV_URL_MESSAGE_TYPE_SENDFILE:
+        if (!pkt_in || !pkt_in->data)
+            return BVERROR(EINVAL);
+        return tcp_sendfile(h, pkt_in->data);
+#endif
+    default:
+        break;
+    }
+    return BVERROR(ENOSYS);
+}
+
 static int tcp_shutdown(BVURLContext *h, int flags)
 {
     TCPContext *s = h->priv_data;
@@ -225,10 +301,76 @@ BVURLProtocol bv_tcp_protocol = {
     .url_open            = tcp_open,
     .url_read            = tcp_read,
     .url_write           = tcp_write,
+    .url_control         = tcp_control,
     .url_close           = tcp_close,
     .url_get_file_handle = tcp_get_file_handle,
     .url_shutdown        = tcp_shutdown,
     .priv_data_size      = sizeof(TCPContext),
-    .flags               = BV_URL_PROTOCOL_FLAG_NETWORK,
+    .flags               = BV_URL_PROTOCOL_FLAG_NETWORK | BV_URL_PROTOCOL_FLAG_NONBLOCK,
     .priv_class          = &tcp_class,
 };
+
+#ifdef TEST
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
+#undef printf
+
+#define CHECK(x) do { if (!(x)) { printf("line %d: %s\n", __LINE__, #x); goto end; } } while (0)
+
+typedef struct TestListener {
+    int port;
+    int ret;
+    int done;
+} TestListener;
+
+static void *test_listen(void *arg)
+{
+    TestListener *t = arg;
+    BVURLContext *h = NULL;
+    char url[128];
+
+    snprintf(url, sizeof(url), "tcp://127.0.0.1:%d?listen=1&reuseport=1&listen_timeout=3000", t->port);
+    t->ret  = bv_url_open(&h, url, BV_IO_FLAG_READ_WRITE, NULL, NULL);
+    t->done = 1;
+    bv_url_closep(&h);
+    return NULL;
+}
+
+int main(void)
+{
+    TestListener l[2] = { { 0 } };
+    BVURLContext *h = NULL;
+    pthread_t threads[2];
+    int port = 20000 + getpid() % 20000, i, started = 0, err = 1;
+    char url[128];
+
+    bv_protocol_register_all();
+    bv_network_init();
+
+    /* two listeners bound to one port, each takes a connection */
+    for (; started < 2; started++) {
+        l[started].port = port;
+        CHECK(!pthread_create(&threads[started], NULL, test_listen, &l[started]));
+    }
+    bv_usleep(100000);
+    CHECK(!l[0].done && !l[1].done);
+    /* a listener stops listening once it accepted, later connections
+     * go to the other one */
+    snprintf(url, sizeof(url), "tcp://127.0.0.1:%d", port);
+    for (i = 0; i < 20 && !(l[0].done && l[1].done); i++) {
+        CHECK(bv_url_open(&h, url, BV_IO_FLAG_READ_WRITE, NULL, NULL) >= 0);
+        bv_url_closep(&h);
+        bv_usleep(20000);
+    }
+    CHECK(l[0].done && l[1].done);
+    CHECK(l[0].ret >= 0 && l[1].ret >= 0);
+
+    err = 0;
+end:
+    for (i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+    printf(err ? "FAIL\n" : "OK\n");
+    return err;
+}
+#endif /* TEST */
@@ -0,0 +1,855 @@
+/*************************************************************************
+    > File Name: tls.c
+    > Author: albertfang
+    > Mail: fang.qi@besovideo.com
+    > Created Time: 2026年10月19日 星期一 21时12分40秒
+ ************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) albert@BesoVideo, 2026
+ */
+
+/**
+ * @file
+ * TLS protocol over tcp, based on OpenSSL.
+ *
+ * tls://host:port[?listen][&cafile=file][&verify=1][&cert=file][&key=file]
+ *
+ * OpenSSL works on the socket of the tcp context directly. It writes with
+ * send(MSG_NOSIGNAL), so that a peer gone away does not raise SIGPIPE.
+ * With the ktls option, OpenSSL's own socket BIO is used instead, to hand
+ * the connection to kernel TLS once the handshake is done; its writes
+ * raise SIGPIPE where SO_NOSIGPIPE does not exist, so the application
+ * must ignore that signal. Sessions and tickets the servers send are kept
+ * process wide, per host, port, verification mode, CA and certificate
+ * file, and offered on the next connection, which then resumes without a
+ * full handshake. A listening context encrypts its tickets with process
+ * wide keys, so that clients resume on any of its connections. These keys
+ * are made once and never rotated: a ticket stays valid for the life of
+ * the process, up to the ticket lifetime OpenSSL gives it.
+ */
+
+#include "config.h"
+
+#include <pthread.h>
+
+#include <openssl/err.h>
+#include <openssl/rand.h>
+#include <openssl/ssl.h>
+
+#include "libbvutil/bvstring.h"
+#include "libbvutil/mem.h"
+#include "libbvutil/opt.h"
+#include "libbvutil/parseutils.h"
+#include "libbvutil/network.h"
+#include "libbvutil/os_support.h"
+#include "libbvutil/time.h"
+
+#include "bvurl.h"
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+#define TLS_client_method SSLv23_client_method
+#define TLS_server_method SSLv23_server_method
+#endif
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(OPENSSL_NO_KTLS)
+#define TLS_HAVE_SENDFILE 1
+#else
+#define TLS_HAVE_SENDFILE 0
+#endif
+
+#define MAX_CACHED_SESSIONS 64
+#define OPEN_TIMEOUT 5000000
+
+typedef struct TLSContext {
+    const BVClass *class;
+    BVURLContext *tcp;
+    SSL_CTX *ctx;
+    SSL *ssl;
+    int fd;
+    int listen;
+    int verify;
+    char *ca_file;
+    char *cert_file;
+    char *key_file;
+    int session_cache;
+    int ktls;
+    int ktls_send;
+    char *session_key;
+} TLSContext;
+
+typedef struct TLSSession {
+    char *key;
+    SSL_SESSION *session;
+    struct TLSSession *next;
+} TLSSession;
+
+static pthread_mutex_t session_lock = PTHREAD_MUTEX_INITIALIZER;
+static TLSSession *sessions;
+static int nb_sessions;
+
+static pthread_once_t ticket_keys_once = PTHREAD_ONCE_INIT;
+static unsigned char ticket_keys[80];
+static int ticket_keys_set;
+
+/* Take over the reference of session, most recently stored first. */
+static int session_store(const char *key, SSL_SESSION *session)
+{
+    TLSSession **p, *s, *dead = NULL;
+    int n = 0;
+
+    pthread_mutex_lock(&session_lock);
+    for (p = &sessions; (s = *p); p = &s->next)
+        if (!strcmp(s->key, key)) {
+            *p = s->next;
+            nb_sessions--;
+            break;
+        }
+    if (!s) {
+        if (!(s = bv_mallocz(sizeof(*s))) || !(s->key = bv_strdup(key))) {
+            pthread_mutex_unlock(&session_lock);
+            bv_free(s);
+            return BVERROR(ENOMEM);
+        }
+    } else {
+        SSL_SESSION_free(s->session);
+    }
+    s->session = session;
+    s->next    = sessions;
+    sessions   = s;
+    if (++nb_sessions > MAX_CACHED_SESSIONS) {
+        for (p = &sessions; *p && n++ < MAX_CACHED_SESSIONS; p = &(*p)->next)
+            ;
+        dead = *p;
+        *p   = NULL;
+        nb_sessions = MAX_CACHED_SESSIONS;
+    }
+    pthread_mutex_unlock(&session_lock);
+
+    for (; dead; dead = s) {
+        s = dead->next;
+        SSL_SESSION_free(dead->session);
+        bv_free(dead->key);
+        bv_free(dead);
+    }
+    return 0;
+}
+
+/* Return a new reference to the session stored for key, or NULL. */
+static SSL_SESSION *session_lookup(const char *key)
+{
+    SSL_SESSION *session = NULL;
+    TLSSession *s;
+
+    pthread_mutex_lock(&session_lock);
+    for (s = sessions; s; s = s->next)
+        if (!strcmp(s->key, key)) {
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+            if (!SSL_SESSION_is_resumable(s->session))
+                break;
+#endif
+            session = s->session;
+            SSL_SESSION_up_ref(session);
+            break;
+        }
+    pthread_mutex_unlock(&session_lock);
+    return session;
+}
+
+/* Called for every session or TLS 1.3 ticket the server hands out. */
+static int tls_new_session(SSL *ssl, SSL_SESSION *session)
+{
+    TLSContext *c = SSL_get_app_data(ssl);
+
+    if (!c || !c->session_key)
+        return 0;
+    /* 1 keeps the reference, which the cache owns from now on */
+    return session_store(c->session_key, session) >= 0;
+}
+
+static void init_ticket_keys(void)
+{
+    ticket_keys_set = RAND_bytes(ticket_keys, sizeof(ticket_keys)) == 1;
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+static pthread_once_t bio_once = PTHREAD_ONCE_INIT;
+static BIO_METHOD *bio_method;
+
+static int bio_sock_write(BIO *b, const char *buf, int len)
+{
+    TLSContext *c = BIO_get_data(b);
+    int ret = send(c->fd, buf, len, MSG_NOSIGNAL);
+
+    BIO_clear_retry_flags(b);
+    if (ret < 0 && BIO_sock_should_retry(ret))
+        BIO_set_retry_write(b);
+    return ret;
+}
+
+static int bio_sock_read(BIO *b, char *buf, int len)
+{
+    TLSContext *c = BIO_get_data(b);
+    int ret = recv(c->fd, buf, len, 0);
+
+    BIO_clear_retry_flags(b);
+    if (ret < 0 && BIO_sock_should_retry(ret))
+        BIO_set_retry_read(b);
+    return ret;
+}
+
+static int bio_sock_puts(BIO *b, const char *str)
+{
+    return bio_sock_write(b, str, strlen(str));
+}
+
+static long bio_sock_ctrl(BIO *b, int cmd, long num, void *ptr)
+{
+    return cmd == BIO_CTRL_FLUSH;
+}
+
+static void init_bio_method(void)
+{
+    BIO_METHOD *m = BIO_meth_new(BIO_get_new_index() | BIO_TYPE_SOURCE_SINK,
+                                 "bvtls socket");
+
+    if (!m)
+        return;
+    BIO_meth_set_write(m, bio_sock_write);
+    BIO_meth_set_read(m, bio_sock_read);
+    BIO_meth_set_puts(m, bio_sock_puts);
+    BIO_meth_set_ctrl(m, bio_sock_ctrl);
+    bio_method = m;
+}
+#endif
+
+/* Make OpenSSL use c->fd, as explained at the top. */
+static int tls_set_fd(TLSContext *c)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+    BIO *bio;
+
+    if (!c->ktls) {
+        pthread_once(&bio_once, init_bio_method);
+        if (!bio_method || !(bio = BIO_new(bio_method)))
+            return 0;
+        BIO_set_data(bio, c);
+        BIO_set_init(bio, 1);
+        SSL_set_bio(c->ssl, bio, bio);
+        return 1;
+    }
+#endif
+#ifdef SO_NOSIGPIPE
+    {
+        int one = 1;
+        setsockopt(c->fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+    }
+#endif
+    return SSL_set_fd(c->ssl, c->fd);
+}
+
+static void print_tls_error(BVURLContext *h)
+{
+    unsigned long e;
+    char buf[256];
+
+    while ((e = ERR_get_error())) {
+        ERR_error_string_n(e, buf, sizeof(buf));
+        bv_log(h, BV_LOG_ERROR, "%s\n", buf);
+    }
+}
+
+/*
+ * Map the result ret of an SSL call to an error code, or wait and return 0
+ * when the call is to be repeated.
+ */
+static int tls_wait(BVURLContext *h, int ret, int64_t timeout)
+{
+    TLSContext *c = h->priv_data;
+    int err = SSL_get_error(c->ssl, ret);
+
+    switch (err) {
+    case SSL_ERROR_WANT_READ:
+    case SSL_ERROR_WANT_WRITE:
+        if (h->flags & BV_IO_FLAG_NONBLOCK)
+            return BVERROR(EAGAIN);
+        return bv_network_wait_fd_timeout(c->fd, err == SSL_ERROR_WANT_WRITE,
+                                          timeout, &h->interrupt_callback);
+    case SSL_ERROR_ZERO_RETURN:
+        return BVERROR_EOF;
+    case SSL_ERROR_SYSCALL:
+        if (!ERR_peek_error()) {
+            if (ret == 0 || errno == ECONNRESET)
+                return BVERROR_EOF;
+            return BVERROR(errno);
+        }
+        /* fall through */
+    default:
+        print_tls_error(h);
+        return BVERROR(EIO);
+    }
+}
+
+/* The timeout covers the whole handshake, not each of its round trips. */
+static int tls_handshake(BVURLContext *h)
+{
+    TLSContext *c = h->priv_data;
+    int64_t deadline = bv_gettime_relative() + (h->rw_timeout > 0 ? h->rw_timeout : OPEN_TIMEOUT);
+    int ret;
+
+    for (;;) {
+        ERR_clear_error();
+        ret = SSL_do_handshake(c->ssl);
+        if (ret == 1)
+            return 0;
+        /* at least 1, 0 would wait forever */
+        if ((ret = tls_wait(h, ret, BBMAX(deadline - bv_gettime_relative(), 1))) < 0)
+            return ret;
+    }
+}
+
+static int is_numeric_host(const char *host)
+{
+    struct in6_addr addr;
+
+    return inet_pton(AF_INET, host, &addr) > 0 || inet_pton(AF_INET6, host, &addr) > 0;
+}
+
+static int tls_setup_ctx(BVURLContext *h)
+{
+    TLSContext *c = h->priv_data;
+
+    c->ctx = SSL_CTX_new(c->listen ? TLS_server_method() : TLS_client_method());
+    if (!c->ctx) {
+        print_tls_error(h);
+        return BVERROR(EIO);
+    }
+    SSL_CTX_set_options(c->ctx, SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3);
+#ifdef SSL_OP_ENABLE_KTLS
+    if (c->ktls)
+        SSL_CTX_set_options(c->ctx, SSL_OP_ENABLE_KTLS);
+#endif
+    if (c->ca_file) {
+        if (!SSL_CTX_load_verify_locations(c->ctx, c->ca_file, NULL)) {
+            bv_log(h, BV_LOG_ERROR, "Failed to load CA file %s\n", c->ca_file);
+            print_tls_error(h);
+            return BVERROR(EIO);
+        }
+    } else if (c->verify) {
+        SSL_CTX_set_default_verify_paths(c->ctx);
+    }
+    if (c->cert_file && !SSL_CTX_use_certificate_chain_file(c->ctx, c->cert_file)) {
+        bv_log(h, BV_LOG_ERROR, "Unable to load cert file %s\n", c->cert_file);
+        print_tls_error(h);
+        return BVERROR(EIO);
+    }
+    if (c->key_file && !SSL_CTX_use_PrivateKey_file(c->ctx, c->key_file, SSL_FILETYPE_PEM)) {
+        bv_log(h, BV_LOG_ERROR, "Unable to load key file %s\n", c->key_file);
+        print_tls_error(h);
+        return BVERROR(EIO);
+    }
+    if (c->verify)
+        SSL_CTX_set_verify(c->ctx, SSL_VERIFY_PEER |
+                           (c->listen ? SSL_VERIFY_FAIL_IF_NO_PEER_CERT : 0), NULL);
+
+    if (c->listen) {
+        static const unsigned char sid_ctx[] = "bvbase";
+        SSL_CTX_set_session_id_context(c->ctx, sid_ctx, sizeof(sid_ctx) - 1);
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+        pthread_once(&ticket_keys_once, init_ticket_keys);
+        if (ticket_keys_set)
+            SSL_CTX_set_tlsext_ticket_keys(c->ctx, ticket_keys, sizeof(ticket_keys));
+#endif
+    } else if (c->session_cache) {
+        SSL_CTX_set_session_cache_mode(c->ctx, SSL_SESS_CACHE_CLIENT |
+                                               SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(c->ctx, tls_new_session);
+    }
+    return 0;
+}
+
+static int tls_open(BVURLContext *h, const char *uri, int flags, BVDictionary **options)
+{
+    TLSContext *c = h->priv_data;
+    SSL_SESSION *session = NULL;
+    char buf[1024], host[1024];
+    const char *p;
+    int port, ret;
+
+    bv_url_split(NULL, 0, NULL, 0, host, sizeof(host), &port, NULL, 0, uri);
+    p = strchr(uri, '?');
+    if (!p) {
+        p = "";
+    } else {
+        if (bv_find_info_tag(buf, sizeof(buf), "listen", p))
+            c->listen = 1;
+        if (bv_find_info_tag(buf, sizeof(buf), "cafile", p)) {
+            bv_free(c->ca_file);
+            c->ca_file = bv_strdup(buf);
+        }
+        if (bv_find_info_tag(buf, sizeof(buf), "verify", p)) {
+            char *endptr = NULL;
+            c->verify = strtol(buf, &endptr, 10);
+            if (buf == endptr)
+                c->verify = 1;
+        }
+        if (bv_find_info_tag(buf, sizeof(buf), "cert", p)) {
+            bv_free(c->cert_file);
+            c->cert_file = bv_strdup(buf);
+        }
+        if (bv_find_info_tag(buf, sizeof(buf), "key", p)) {
+            bv_free(c->key_file);
+            c->key_file = bv_strdup(buf);
+        }
+    }
+    if (port <= 0)
+        port = 443;
+
+    bv_url_join(buf, sizeof(buf), "tcp", NULL, host, port, "%s%s", p,
+                c->listen && !strstr(p, "listen") ? (*p ? "&listen" : "?listen") : "");
+    if ((ret = bv_url_open(&c->tcp, buf, BV_IO_FLAG_READ_WRITE,
+                           &h->interrupt_callback, options)) < 0)
+        return ret;
+    c->fd = bv_url_get_file_handle(c->tcp);
+    if (!h->rw_timeout)
+        h->rw_timeout = c->tcp->rw_timeout;
+    bv_socket_nonblock(c->fd, 1);
+
+    if ((ret = tls_setup_ctx(h)) < 0)
+        goto fail;
+    if (!(c->ssl = SSL_new(c->ctx)) || !tls_set_fd(c)) {
+        print_tls_error(h);
+        ret = BVERROR(EIO);
+        goto fail;
+    }
+    SSL_set_app_data(c->ssl, c);
+
+    if (c->listen) {
+        SSL_set_accept_state(c->ssl);
+    } else {
+        SSL_set_connect_state(c->ssl);
+        if (!is_numeric_host(host))
+            SSL_set_tlsext_host_name(c->ssl, host);
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+        if (c->verify)
+            SSL_set1_host(c->ssl, host);
+#endif
+        if (c->session_cache) {
+            /* a session verified differently must not be resumed */
+            c->session_key = bv_asprintf("%s:%d:%d:%s:%s", host, port, c->verify,
+                                         c->ca_file ? c->ca_file : "",
+                                         c->cert_file ? c->cert_file : "");
+            if (!c->session_key) {
+                ret = BVERROR(ENOMEM);
+                goto fail;
+            }
+            if ((session = session_lookup(c->session_key))) {
+                SSL_set_session(c->ssl, session);
+                SSL_SESSION_free(session);
+            }
+        }
+    }
+
+    if ((ret = tls_handshake(h)) < 0) {
+        bv_log(h, BV_LOG_ERROR, "TLS handshake with %s:%d failed\n", host, port);
+        goto fail;
+    }
+    if (SSL_session_reused(c->ssl))
+        bv_log(h, BV_LOG_DEBUG, "Resumed TLS session with %s:%d\n", host, port);
+#ifdef BIO_get_ktls_send
+    c->ktls_send = BIO_get_ktls_send(SSL_get_wbio(c->ssl));
+    bv_log(h, BV_LOG_DEBUG, "kernel TLS send %s, receive %s\n",
+           c->ktls_send ? "on" : "off",
+           BIO_get_ktls_recv(SSL_get_rbio(c->ssl)) ? "on" : "off");
+#endif
+    h->is_streamed = 1;
+    return 0;
+
+fail:
+    if (c->ssl)
+        SSL_free(c->ssl);
+    c->ssl = NULL;
+    if (c->ctx)
+        SSL_CTX_free(c->ctx);
+    c->ctx = NULL;
+    bv_url_closep(&c->tcp);
+    bv_freep(&c->session_key);
+    return ret;
+}
+
+static int tls_read(BVURLContext *h, uint8_t *buf, size_t size)
+{
+    TLSContext *c = h->priv_data;
+    int ret;
+
+    for (;;) {
+        ERR_clear_error();
+        ret = SSL_read(c->ssl, buf, BBMIN(size, INT_MAX));
+        if (ret > 0)
+            return ret;
+        if ((ret = tls_wait(h, ret, h->rw_timeout)) < 0)
+            return ret;
+    }
+}
+
+static int tls_write(BVURLContext *h, const uint8_t *buf, size_t size)
+{
+    TLSContext *c = h->priv_data;
+    int ret;
+
+    for (;;) {
+        ERR_clear_error();
+        ret = SSL_write(c->ssl, buf, BBMIN(size, INT_MAX));
+        if (ret > 0)
+            return ret;
+        if ((ret = tls_wait(h, ret, h->rw_timeout)) < 0)
+            return ret;
+    }
+}
+
+/* Without kernel TLS the file is read and encrypted here after all. */
+static int tls_sendfile_copy(BVURLContext *h, const BVURLSendfile *sf)
+{
+    uint8_t *buf = bv_malloc(65536);
+    int64_t sent = 0;
+    int ret = 0, n, off;
+
+    if (!buf)
+        return BVERROR(ENOMEM);
+    while (sent < sf->size) {
+        n = pread(sf->fd, buf, BBMIN(sf->size - sent, 65536), sf->offset + sent);
+        if (n < 0) {
+            ret = BVERROR(errno);
+            break;
+        }
+        if (!n)
+            break;
+        for (off = 0; off < n; off += ret)
+            if ((ret = tls_write(h, buf + off, n - off)) < 0)
+                goto end;
+        sent += n;
+    }
+end:
+    bv_free(buf);
+    return ret < 0 ? ret : sent;
+}
+
+static int tls_sendfile(BVURLContext *h, const BVURLSendfile *sf)
+{
+#if TLS_HAVE_SENDFILE
+    TLSContext *c = h->priv_data;
+#endif
+
+    if (sf->size < 0 || sf->size > INT_MAX)
+        return BVERROR(EINVAL);
+#if TLS_HAVE_SENDFILE
+    if (c->ktls_send) {
+        int64_t sent = 0;
+        ossl_ssize_t n;
+        int ret;
+
+        while (sent < sf->size) {
+            ERR_clear_error();
+            n = SSL_sendfile(c->ssl, sf->fd, sf->offset + sent, sf->size - sent, 0);
+            if (n > 0)
+                sent += n;
+            else if (n == 0)
+                break;
+            else if ((ret = tls_wait(h, n, h->rw_timeout)) < 0)
+                return ret;
+        }
+        return sent;
+    }
+#endif
+    return tls_sendfile_copy(h, sf);
+}
+
+static int tls_control(BVURLContext *h, int type, BVControlPacket *pkt_in, BVControlPacket *pkt_out)
+{
+    switch (type) {
+    case BV_URL_MESSAGE_TYPE_SENDFILE:
+        if (!pkt_in || !pkt_in->data)
+            return BVERROR(EINVAL);
+        return tls_sendfile(h, pkt_in->data);
+    default:
+        break;
+    }
+    return BVERROR(ENOSYS);
+}
+
+static int tls_shutdown(BVURLContext *h, int flags)
+{
+    TLSContext *c = h->priv_data;
+
+    if (flags & BV_IO_FLAG_WRITE) {
+        /* send close_notify, do not wait for the peer's */
+        SSL_shutdown(c->ssl);
+    }
+    return bv_url_shutdown(c->tcp, flags);
+}
+
+static int tls_close(BVURLContext *h)
+{
+    TLSContext *c = h->priv_data;
+
+    if (c->ssl) {
+        SSL_shutdown(c->ssl);
+        SSL_free(c->ssl);
+    }
+    if (c->ctx)
+        SSL_CTX_free(c->ctx);
+    bv_url_closep(&c->tcp);
+    bv_freep(&c->session_key);
+    return 0;
+}
+
+static int tls_get_file_handle(BVURLContext *h)
+{
+    TLSContext *c = h->priv_data;
+    return c->fd;
+}
+
+#define OFFSET(x) offsetof(TLSContext, x)
+#define D BV_OPT_FLAG_DECODING_PARAM
+#define E BV_OPT_FLAG_ENCODING_PARAM
+static const BVOption options[] = {
+    { "ca_file", "Certificate Authority database file", OFFSET(ca_file), BV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, D|E },
+    { "cafile", "Certificate Authority database file", OFFSET(ca_file), BV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, D|E },
+    { "tls_verify", "Verify the peer certificate", OFFSET(verify), BV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, D|E },
+    { "cert_file", "Certificate file", OFFSET(cert_file), BV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, D|E },
+    { "key_file", "Private key file", OFFSET(key_file), BV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, D|E },
+    { "listen", "Listen for incoming connections", OFFSET(listen), BV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, D|E },
+    { "session_cache", "Resume sessions of earlier connections to the same server", OFFSET(session_cache), BV_OPT_TYPE_INT, { .i64 = 1 }, 0, 1, D|E },
+    { "ktls", "Let the kernel encrypt and decrypt once the handshake is done, SIGPIPE must be ignored", OFFSET(ktls), BV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, D|E },
+    { NULL }
+};
+
+static const BVClass tls_class = {
+    .class_name = "tls",
+    .item_name  = bv_default_item_name,
+    .option     = options,
+    .version    = LIBBVUTIL_VERSION_INT,
+};
+
+BVURLProtocol bv_tls_protocol = {
+    .name                = "tls",
+    .url_open            = tls_open,
+    .url_read            = tls_read,
+    .url_write           = tls_write,
+    .url_control         = tls_control,
+    .url_close           = tls_close,
+    .url_get_file_handle = tls_get_file_handle,
+    .url_shutdown        = tls_shutdown,
+    .priv_data_size      = sizeof(TLSContext),
+    .flags               = BV_URL_PROTOCOL_FLAG_NETWORK | BV_URL_PROTOCOL_FLAG_NONBLOCK,
+    .priv_class          = &tls_class,
+};
+
+#ifdef TEST
+#include <stdio.h>
+#include <unistd.h>
+
+#include <openssl/ec.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+#undef printf
+
+#define CHECK(x) do { if (!(x)) { printf("line %d: %s\n", __LINE__, #x); goto end; } } while (0)
+
+/* self-signed EC certificate for 127.0.0.1, valid for an hour */
+static int test_make_cert(const char *cert_path, const char *key_path)
+{
+    EVP_PKEY_CTX *pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+    EVP_PKEY *pkey = NULL;
+    X509 *x509 = X509_new();
+    X509_NAME *name;
+    X509_EXTENSION *ext;
+    FILE *f = NULL;
+    int ret = -1;
+
+    if (!pctx || !x509 || EVP_PKEY_keygen_init(pctx) <= 0 ||
+        EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pctx, NID_X9_62_prime256v1) <= 0 ||
+        EVP_PKEY_keygen(pctx, &pkey) <= 0)
+        goto end;
+    X509_set_version(x509, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(x509), 1);
+    X509_gmtime_adj(X509_getm_notBefore(x509), -60);
+    X509_gmtime_adj(X509_getm_notAfter(x509), 3600);
+    X509_set_pubkey(x509, pkey);
+    name = X509_get_subject_name(x509);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char *)"127.0.0.1", -1, -1, 0);
+    X509_set_issuer_name(x509, name);
+    /* what a host check on an address looks at */
+    if (!(ext = X509V3_EXT_conf_nid(NULL, NULL, NID_subject_alt_name, "IP:127.0.0.1")))
+        goto end;
+    X509_add_ext(x509, ext, -1);
+    X509_EXTENSION_free(ext);
+    if (!X509_sign(x509, pkey, EVP_sha256()))
+        goto end;
+    if (!(f = fopen(cert_path, "w")) || !PEM_write_X509(f, x509))
+        goto end;
+    fclose(f);
+    if (!(f = fopen(key_path, "w")) || !PEM_write_PrivateKey(f, pkey, NULL, NULL, 0, NULL, NULL))
+        goto end;
+    ret = 0;
+end:
+    if (f)
+        fclose(f);
+    X509_free(x509);
+    EVP_PKEY_free(pkey);
+    EVP_PKEY_CTX_free(pctx);
+    return ret;
+}
+
+typedef struct TestServer {
+    char url[1024];
+    int nb;                     ///< connections to take
+    int accepted;
+} TestServer;
+
+/* echo one message per connection */
+static void *test_server(void *arg)
+{
+    TestServer *t = arg;
+    BVURLContext *h = NULL;
+    uint8_t buf[64];
+    int i, n;
+
+    for (i = 0; i < t->nb; i++) {
+        if (bv_url_open(&h, t->url, BV_IO_FLAG_READ_WRITE, NULL, NULL) < 0)
+            continue;
+        t->accepted++;
+        if ((n = bv_url_read(h, buf, sizeof(buf))) > 0)
+            bv_url_write(h, buf, n);
+        bv_url_closep(&h);
+    }
+    return NULL;
+}
+
+/*
+ * Answer the hello with a record sent a byte every 100ms: each byte
+ * wakes up the client, only an overall deadline stops it.
+ */
+static void *test_trickle(void *arg)
+{
+    static const uint8_t record[] = { 0x16, 0x03, 0x03, 0x40, 0x00 };
+    int fd = accept(*(int *)arg, NULL, NULL), i;
+    uint8_t c;
+
+    if (fd < 0)
+        return NULL;
+    for (i = 0; i < 30; i++) {
+        c = i < sizeof(record) ? record[i] : 0;
+        if (send(fd, &c, 1, MSG_NOSIGNAL) < 0)
+            break;
+        bv_usleep(100000);
+    }
+    closesocket(fd);
+    return NULL;
+}
+
+/* the server may not listen yet */
+static int test_connect(BVURLContext **h, int port, const char *query)
+{
+    char url[1024];
+    int i, ret;
+
+    snprintf(url, sizeof(url), "tls://127.0.0.1:%d%s", port, query);
+    for (i = 0; i < 50; i++) {
+        if ((ret = bv_url_open(h, url, BV_IO_FLAG_READ_WRITE, NULL, NULL)) != BVERROR(ECONNREFUSED))
+            break;
+        bv_usleep(20000);
+    }
+    return ret;
+}
+
+static int test_echo(BVURLContext *h)
+{
+    uint8_t buf[4];
+
+    return bv_url_write(h, "ping", 4) == 4 &&
+           bv_url_read_complete(h, buf, 4) == 4 && !memcmp(buf, "ping", 4);
+}
+
+int main(void)
+{
+    TestServer server = { { 0 } };
+    BVURLContext *h = NULL;
+    struct sockaddr_in addr = { 0 };
+    char cert[256], key[256], query[600];
+    int port = 20000 + getpid() % 20000, started = 0, stall_fd = -1, err = 1;
+    pthread_t thread;
+    int64_t t;
+
+    bv_protocol_register_all();
+    bv_network_init();
+    snprintf(cert, sizeof(cert), "/tmp/tls-test-%d-cert.pem", getpid());
+    snprintf(key, sizeof(key), "/tmp/tls-test-%d-key.pem", getpid());
+    CHECK(test_make_cert(cert, key) >= 0);
+
+    snprintf(server.url, sizeof(server.url),
+             "tls://127.0.0.1:%d?listen=1&cert=%s&key=%s&listen_timeout=5000", port, cert, key);
+    server.nb = 4;
+    CHECK(!pthread_create(&thread, NULL, test_server, &server));
+    started = 1;
+
+    /* a full handshake, then the next connection resumes its session */
+    CHECK(test_connect(&h, port, "") >= 0);
+    CHECK(test_echo(h));
+    CHECK(!SSL_session_reused(((TLSContext *)h->priv_data)->ssl));
+    bv_url_closep(&h);
+    CHECK(test_connect(&h, port, "") >= 0);
+    CHECK(test_echo(h));
+    CHECK(SSL_session_reused(((TLSContext *)h->priv_data)->ssl));
+    bv_url_closep(&h);
+
+    /* nobody vouches for a self-signed certificate */
+    CHECK(test_connect(&h, port, "?verify=1") < 0);
+    /* unless it is the CA */
+    snprintf(query, sizeof(query), "?verify=1&cafile=%s", cert);
+    CHECK(test_connect(&h, port, query) >= 0);
+    CHECK(test_echo(h));
+    bv_url_closep(&h);
+    pthread_join(thread, NULL);
+    started = 0;
+    CHECK(server.accepted == 3);
+
+    /* a server which keeps the handshake going forever */
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port + 1);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    CHECK((stall_fd = socket(AF_INET, SOCK_STREAM, 0)) >= 0);
+    CHECK(!bind(stall_fd, (struct sockaddr *)&addr, sizeof(addr)) && !listen(stall_fd, 4));
+    CHECK(!pthread_create(&thread, NULL, test_trickle, &stall_fd));
+    started = 1;
+    t = bv_gettime_relative();
+    CHECK(test_connect(&h, port + 1, "?timeout=500000") == BVERROR(ETIMEDOUT));
+    t = bv_gettime_relative() - t;
+    CHECK(t >= 500000 && t < 1500000);
+
+    err = 0;
+end:
+    if (started)
+        pthread_join(thread, NULL);
+    if (stall_fd >= 0)
+        closesocket(stall_fd);
+    bv_url_closep(&h);
+    unlink(cert);
+    unlink(key);
+    printf(err ? "FAIL\n" : "OK\n");
+    return err;
+}
+#endif /* TEST */
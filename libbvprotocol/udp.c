@@ -24,6 +24,7 @@
  * UDP protocol
  */
 
+#define _DEFAULT_SOURCE /* SO_REUSEPORT with recent glibc */
 #define _BSD_SOURCE     /* Needed for using struct ip_mreq with recent glibc */
 
 #include "bvurl.h"
@@ -36,6 +37,7 @@
 #include "libbvutil/time.h"
 #include "libbvutil/network.h"
 #include "libbvutil/os_support.h"
+#include "libbvutil/resolver.h"
 
 #if BV_HAVE_UDPLITE_H
 #include "udplite.h"
@@ -78,6 +80,7 @@ typedef struct {
     int is_broadcast;
     int local_port;
     int reuse_socket;
+    int reuse_port;
     int overrun_nonfatal;
     struct sockaddr_storage dest_addr;
     int dest_addr_len;
@@ -111,6 +114,7 @@ static const BVOption options[] = {
 {"udplite_coverage", "choose UDPLite head size which should be validated by checksum", OFFSET(udplite_coverage), BV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, D|E },
 {"pkt_size", "set size of UDP packets", OFFSET(packet_size), BV_OPT_TYPE_INT, {.i64 = 1472}, 0, INT_MAX, D|E },
 {"reuse", "explicitly allow or disallow reusing UDP sockets", OFFSET(reuse_socket), BV_OPT_TYPE_INT, {.i64 = 0}, 0, 1, D|E },
+{"reuseport", "spread datagrams over sockets bound to the same port (SO_REUSEPORT)", OFFSET(reuse_port), BV_OPT_TYPE_INT, {.i64 = 0}, 0, 1, D|E },
 {"broadcast", "explicitly allow or disallow broadcast destination", OFFSET(is_broadcast), BV_OPT_TYPE_INT, {.i64 = 0}, 0, 1, E },
 {"ttl", "set the time to live value (for multicast only)", OFFSET(ttl), BV_OPT_TYPE_INT, {.i64 = 16}, 0, INT_MAX, E },
 {"connect", "set if connect() should be called on socket", OFFSET(is_connected), BV_OPT_TYPE_INT, {.i64 = 0}, 0, 1, D|E },
@@ -228,7 +232,8 @@ static int udp_leave_multicast_group(int sockfd, struct sockaddr *addr,struct so
     return 0;
 }
 
-static struct addrinfo* udp_resolve_host(const char *hostname, int port,
+static struct addrinfo* udp_resolve_host(BVURLContext *h,
+                                         const char *hostname, int port,
                                          int type, int family, int flags)
 {
     struct addrinfo hints = { 0 }, *res = 0;
@@ -246,15 +251,16 @@ static struct addrinfo* udp_resolve_host(const char *hostname, int port,
     hints.ai_socktype = type;
     hints.ai_family   = family;
     hints.ai_flags = flags;
-    if ((error = getaddrinfo(node, service, &hints, &res))) {
+    if ((error = bv_resolve(node, service, &hints, &res, h->rw_timeout,
+                            &h->interrupt_callback)) < 0) {
         res = NULL;
-        bv_log(NULL, BV_LOG_ERROR, "udp_resolve_host: %s\n", gai_strerror(error));
+        bv_log(h, BV_LOG_ERROR, "udp_resolve_host: %s\n", bv_err2str(error));
     }
 
     return res;
 }
 
-static int udp_set_multicast_sources(int sockfd, struct sockaddr *addr,
+static int udp_set_multicast_sources(BVURLContext *h, int sockfd, struct sockaddr *addr,
                                      int addr_len, char **sources,
                                      int nb_sources, int include)
 {
@@ -265,7 +271,7 @@ static int udp_set_multicast_sources(int sockfd, struct sockaddr *addr,
     for (i = 0; i < nb_sources; i++) {
         struct group_source_req mreqs;
         int level = addr->sa_family == AF_INET ? IPPROTO_IP : IPPROTO_IPV6;
-        struct addrinfo *sourceaddr = udp_resolve_host(sources[i], 0,
+        struct addrinfo *sourceaddr = udp_resolve_host(h, sources[i], 0,
                                                        SOCK_DGRAM, AF_UNSPEC,
                                                        0);
         if (!sourceaddr)
@@ -274,7 +280,7 @@ static int udp_set_multicast_sources(int sockfd, struct sockaddr *addr,
         mreqs.gsr_interface = 0;
         memcpy(&mreqs.gsr_group, addr, addr_len);
         memcpy(&mreqs.gsr_source, sourceaddr->ai_addr, sourceaddr->ai_addrlen);
-        freeaddrinfo(sourceaddr);
+        bv_resolve_free(sourceaddr);
 
         if (setsockopt(sockfd, level,
                        include ? MCAST_JOIN_SOURCE_GROUP : MCAST_BLOCK_SOURCE,
@@ -295,13 +301,13 @@ static int udp_set_multicast_sources(int sockfd, struct sockaddr *addr,
     }
     for (i = 0; i < nb_sources; i++) {
         struct ip_mreq_source mreqs;
-        struct addrinfo *sourceaddr = udp_resolve_host(sources[i], 0,
+        struct addrinfo *sourceaddr = udp_resolve_host(h, sources[i], 0,
                                                        SOCK_DGRAM, AF_UNSPEC,
                                                        0);
         if (!sourceaddr)
             return BVERROR(ENOENT);
         if (sourceaddr->ai_addr->sa_family != AF_INET) {
-            freeaddrinfo(sourceaddr);
+            bv_resolve_free(sourceaddr);
             bv_log(NULL, BV_LOG_ERROR, "%s is of incorrect protocol family\n",
                    sources[i]);
             return BVERROR(EINVAL);
@@ -310,7 +316,7 @@ static int udp_set_multicast_sources(int sockfd, struct sockaddr *addr,
         mreqs.imr_multiaddr.s_addr = ((struct sockaddr_in *)addr)->sin_addr.s_addr;
         mreqs.imr_interface.s_addr = INADDR_ANY;
         mreqs.imr_sourceaddr.s_addr = ((struct sockaddr_in *)sourceaddr->ai_addr)->sin_addr.s_addr;
-        freeaddrinfo(sourceaddr);
+        bv_resolve_free(sourceaddr);
 
         if (setsockopt(sockfd, IPPROTO_IP,
                        include ? IP_ADD_SOURCE_MEMBERSHIP : IP_BLOCK_SOURCE,
@@ -327,31 +333,32 @@ static int udp_set_multicast_sources(int sockfd, struct sockaddr *addr,
 #endif
     return 0;
 }
-static int udp_set_url(struct sockaddr_storage *addr,
+static int udp_set_url(BVURLContext *h, struct sockaddr_storage *addr,
                        const char *hostname, int port)
 {
     struct addrinfo *res0;
     int addr_len;
 
-    res0 = udp_resolve_host(hostname, port, SOCK_DGRAM, AF_UNSPEC, 0);
+    res0 = udp_resolve_host(h, hostname, port, SOCK_DGRAM, AF_UNSPEC, 0);
     if (!res0) return BVERROR(EIO);
     memcpy(addr, res0->ai_addr, res0->ai_addrlen);
     addr_len = res0->ai_addrlen;
-    freeaddrinfo(res0);
+    bv_resolve_free(res0);
 
     return addr_len;
 }
 
-static int udp_socket_create(UDPContext *s, struct sockaddr_storage *addr,
+static int udp_socket_create(BVURLContext *h, struct sockaddr_storage *addr,
                              socklen_t *addr_len, const char *localaddr)
 {
+    UDPContext *s = h->priv_data;
     int udp_fd = -1;
     struct addrinfo *res0, *res;
     int family = AF_UNSPEC;
 
     if (((struct sockaddr *) &s->dest_addr)->sa_family)
         family = ((struct sockaddr *) &s->dest_addr)->sa_family;
-    res0 = udp_resolve_host(localaddr[0] ? localaddr : NULL, s->local_port,
+    res0 = udp_resolve_host(h, localaddr[0] ? localaddr : NULL, s->local_port,
                             SOCK_DGRAM, family, AI_PASSIVE);
     if (!res0)
         goto fail;
@@ -370,7 +377,7 @@ static int udp_socket_create(UDPContext *s, struct sockaddr_storage *addr,
     memcpy(addr, res->ai_addr, res->ai_addrlen);
     *addr_len = res->ai_addrlen;
 
-    freeaddrinfo(res0);
+    bv_resolve_free(res0);
 
     return udp_fd;
 
@@ -378,7 +385,7 @@ static int udp_socket_create(UDPContext *s, struct sockaddr_storage *addr,
     if (udp_fd >= 0)
         closesocket(udp_fd);
     if(res0)
-        freeaddrinfo(res0);
+        bv_resolve_free(res0);
     return -1;
 }
 
@@ -406,6 +413,7 @@ static int udp_port(struct sockaddr_storage *addr, int addr_len)
  *         'localport=n' : set the local port
  *         'pkt_size=n'  : set max packet size
  *         'reuse=1'     : enable reusing the socket
+ *         'reuseport=1' : share the port with other sockets (SO_REUSEPORT)
  *         'overrun_nonfatal=1': survive in case of circular buffer overrun
  *
  * @param h media file context
@@ -422,7 +430,7 @@ static int bv_udp_set_remote_url(BVURLContext *h, const char *uri)
     bv_url_split(NULL, 0, NULL, 0, hostname, sizeof(hostname), &port, NULL, 0, uri);
 
     /* set the destination address */
-    s->dest_addr_len = udp_set_url(&s->dest_addr, hostname, port);
+    s->dest_addr_len = udp_set_url(h, &s->dest_addr, hostname, port);
     if (s->dest_addr_len < 0) {
         return BVERROR(EIO);
     }
@@ -580,6 +588,12 @@ static int udp_open(BVURLContext *h, const char *uri, int flags, BVDictionary **
                 s->reuse_socket = 1;
             reuse_specified = 1;
         }
+        if (bv_find_info_tag(buf, sizeof(buf), "reuseport", p)) {
+            char *endptr = NULL;
+            s->reuse_port = strtol(buf, &endptr, 10);
+            if (buf == endptr)
+                s->reuse_port = 1;
+        }
         if (bv_find_info_tag(buf, sizeof(buf), "overrun_nonfatal", p)) {
             char *endptr = NULL;
             s->overrun_nonfatal = strtol(buf, &endptr, 10);
@@ -661,7 +675,7 @@ static int udp_open(BVURLContext *h, const char *uri, int flags, BVDictionary **
 
     if ((s->is_multicast || !s->local_port) && (h->flags & BV_IO_FLAG_READ))
         s->local_port = port;
-    udp_fd = udp_socket_create(s, &my_addr, &len, localaddr[0] ? localaddr : s->local_addr);
+    udp_fd = udp_socket_create(h, &my_addr, &len, localaddr[0] ? localaddr : s->local_addr);
     if (udp_fd < 0)
         goto fail;
 
@@ -676,6 +690,18 @@ static int udp_open(BVURLContext *h, const char *uri, int flags, BVDictionary **
             goto fail;
     }
 
+    if (s->reuse_port) {
+#ifdef SO_REUSEPORT
+        if (setsockopt (udp_fd, SOL_SOCKET, SO_REUSEPORT, &(s->reuse_port), sizeof(s->reuse_port)) != 0) {
+            bv_log(h, BV_LOG_ERROR, "setsockopt(SO_REUSEPORT) failed: %s\n", bv_err2str(bv_neterrno()));
+            goto fail;
+        }
+#else
+        bv_log(h, BV_LOG_ERROR, "SO_REUSEPORT is not supported\n");
+        goto fail;
+#endif
+    }
+
     if (s->is_broadcast) {
 #ifdef SO_BROADCAST
         if (setsockopt (udp_fd, SOL_SOCKET, SO_BROADCAST, &(s->is_broadcast), sizeof(s->is_broadcast)) != 0)
@@ -733,14 +759,14 @@ static int udp_open(BVURLContext *h, const char *uri, int flags, BVDictionary **
                 goto fail;
             }
             if (num_include_sources) {
-                if (udp_set_multicast_sources(udp_fd, (struct sockaddr *)&s->dest_addr, s->dest_addr_len, include_sources, num_include_sources, 1) < 0)
+                if (udp_set_multicast_sources(h, udp_fd, (struct sockaddr *)&s->dest_addr, s->dest_addr_len, include_sources, num_include_sources, 1) < 0)
                     goto fail;
             } else {
                 if (udp_join_multicast_group(udp_fd, (struct sockaddr *)&s->dest_addr,(struct sockaddr *)&s->local_addr_storage) < 0)
                     goto fail;
             }
             if (num_exclude_sources) {
-                if (udp_set_multicast_sources(udp_fd, (struct sockaddr *)&s->dest_addr, s->dest_addr_len, exclude_sources, num_exclude_sources, 0) < 0)
+                if (udp_set_multicast_sources(h, udp_fd, (struct sockaddr *)&s->dest_addr, s->dest_addr_len, exclude_sources, num_exclude_sources, 0) < 0)
                     goto fail;
             }
         }
@@ -767,10 +793,9 @@ static int udp_open(BVURLContext *h, const char *uri, int flags, BVDictionary **
             if(tmp < s->buffer_size)
                 bv_log(h, BV_LOG_WARNING, "attempted to set receive buffer to size %d but it only ended up set as %d", s->buffer_size, tmp);
         }
-
-        /* make the socket non-blocking */
-        bv_socket_nonblock(udp_fd, 1);
     }
+    /* make the socket non-blocking, reads and writes wait for it themselves */
+    bv_socket_nonblock(udp_fd, 1);
     if (s->is_connected) {
         if (connect(udp_fd, (struct sockaddr *) &s->dest_addr, s->dest_addr_len)) {
             log_net_error(h, BV_LOG_ERROR, "connect");
@@ -807,6 +832,8 @@ static int udp_open(BVURLContext *h, const char *uri, int flags, BVDictionary **
             goto thread_fail;
         }
         s->thread_started = 1;
+        /* the thread drains the socket, its readiness tells nothing */
+        h->nonblock = 0;
     }
 #endif
 
@@ -888,7 +915,7 @@ static int udp_read(BVURLContext *h, uint8_t *buf, size_t size)
 #endif
 
     if (!(h->flags & BV_IO_FLAG_NONBLOCK)) {
-        ret = bv_network_wait_fd(s->udp_fd, 0);
+        ret = bv_network_wait_fd_timeout(s->udp_fd, 0, h->rw_timeout, &h->interrupt_callback);
         if (ret < 0)
             return ret;
     }
@@ -903,7 +930,7 @@ static int udp_write(BVURLContext *h, const uint8_t *buf, size_t size)
     int ret;
 
     if (!(h->flags & BV_IO_FLAG_NONBLOCK)) {
-        ret = bv_network_wait_fd(s->udp_fd, 1);
+        ret = bv_network_wait_fd_timeout(s->udp_fd, 1, h->rw_timeout, &h->interrupt_callback);
         if (ret < 0)
             return ret;
     }
@@ -949,7 +976,7 @@ BVURLProtocol bv_udp_protocol = {
     .url_get_file_handle = udp_get_file_handle,
     .priv_data_size      = sizeof(UDPContext),
     .priv_class          = &udp_context_class,
-    .flags               = BV_URL_PROTOCOL_FLAG_NETWORK,
+    .flags               = BV_URL_PROTOCOL_FLAG_NETWORK | BV_URL_PROTOCOL_FLAG_NONBLOCK,
 };
 
 BVURLProtocol bv_udplite_protocol = {
@@ -961,5 +988,57 @@ BVURLProtocol bv_udplite_protocol = {
     .url_get_file_handle = udp_get_file_handle,
     .priv_data_size      = sizeof(UDPContext),
     .priv_class          = &udplite_context_class,
-    .flags               = BV_URL_PROTOCOL_FLAG_NETWORK,
+    .flags               = BV_URL_PROTOCOL_FLAG_NETWORK | BV_URL_PROTOCOL_FLAG_NONBLOCK,
 };
+
+#ifdef TEST
+#include <stdio.h>
+#include <unistd.h>
+#undef printf
+
+#define CHECK(x) do { if (!(x)) { printf("line %d: %s\n", __LINE__, #x); goto end; } } while (0)
+
+int main(void)
+{
+    BVURLContext *a = NULL, *b = NULL, *c = NULL, *tx = NULL;
+    int port = 20000 + getpid() % 20000, i, na = 0, nb = 0, err = 1;
+    uint8_t bufa[16], bufb[16];
+    char url[128];
+
+    bv_protocol_register_all();
+    bv_network_init();
+
+    /* two readers share the port, the kernel picks one per datagram */
+    snprintf(url, sizeof(url), "udp://127.0.0.1:%d?localport=%d&reuseport=1&fifo_size=0", port, port);
+    CHECK(bv_url_open(&a, url, BV_IO_FLAG_READ | BV_IO_FLAG_NONBLOCK, NULL, NULL) >= 0);
+    CHECK(bv_url_open(&b, url, BV_IO_FLAG_READ | BV_IO_FLAG_NONBLOCK, NULL, NULL) >= 0);
+    /* both must ask for it */
+    snprintf(url, sizeof(url), "udp://127.0.0.1:%d?localport=%d&fifo_size=0", port, port);
+    CHECK(bv_url_open(&c, url, BV_IO_FLAG_READ, NULL, NULL) < 0);
+
+    snprintf(url, sizeof(url), "udp://127.0.0.1:%d", port);
+    CHECK(bv_url_open(&tx, url, BV_IO_FLAG_WRITE, NULL, NULL) >= 0);
+    CHECK(bv_url_write(tx, (const uint8_t *)"ping", 4) == 4);
+    for (i = 0; i < 100 && !na && !nb; i++) {
+        na = bv_url_read(a, bufa, sizeof(bufa));
+        nb = bv_url_read(b, bufb, sizeof(bufb));
+        if (na == BVERROR(EAGAIN))
+            na = 0;
+        if (nb == BVERROR(EAGAIN))
+            nb = 0;
+        if (!na && !nb)
+            bv_usleep(10000);
+    }
+    CHECK((na == 4) != (nb == 4) && na >= 0 && nb >= 0);
+    CHECK(!memcmp(na == 4 ? bufa : bufb, "ping", 4));
+
+    err = 0;
+end:
+    bv_url_closep(&a);
+    bv_url_closep(&b);
+    bv_url_closep(&c);
+    bv_url_closep(&tx);
+    printf(err ? "FAIL\n" : "OK\n");
+    return err;
+}
+#endif /* TEST */
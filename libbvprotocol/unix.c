@@ -0,0 +1,536 @@
+/*************************************************************************
+    > File Name: unix.c
+    > Author: albertfang
+    > Mail: fang.qi@besovideo.com
+    > Created Time: 2026年10月18日 星期日 20时12分35秒
+ ************************************************************************/
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) albert@BesoVideo, 2026
+ */
+
+/**
+ * @file
+ * Unix domain socket: unix:/path/to/socket?type=stream|seqpacket|datagram
+ *
+ * Besides plain reads and writes, BV_URL_MESSAGE_TYPE_SEND_BUFFER and
+ * BV_URL_MESSAGE_TYPE_RECV_BUFFER pass buffers from bv_buffer_alloc_shared()
+ * to the peer as file descriptors (SCM_RIGHTS), so a frame is shared between
+ * processes instead of being copied through the socket. Mixing them with
+ * plain data is only safe on seqpacket sockets, which keep message
+ * boundaries.
+ */
+
+#include <sys/un.h>
+
+#include "libbvutil/bvstring.h"
+#include "libbvutil/buffer.h"
+#include "libbvutil/intreadwrite.h"
+#include "libbvutil/network.h"
+#include "libbvutil/opt.h"
+#include "libbvutil/os_support.h"
+#include "libbvutil/parseutils.h"
+
+#include "bvurl.h"
+
+typedef struct UnixContext {
+    const BVClass *class;
+    struct sockaddr_un addr;
+    int fd;
+    int type;
+    int listen;
+    int rw_timeout;
+    int listen_timeout;
+} UnixContext;
+
+#define OFFSET(x) offsetof(UnixContext, x)
+#define D BV_OPT_FLAG_DECODING_PARAM
+#define E BV_OPT_FLAG_ENCODING_PARAM
+static const BVOption unix_options[] = {
+    { "listen", "Open socket for listening", OFFSET(listen), BV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, D|E },
+    { "timeout", "set timeout (in microseconds) of socket I/O operations", OFFSET(rw_timeout), BV_OPT_TYPE_INT, { .i64 = -1 }, -1, INT_MAX, D|E },
+    { "listen_timeout", "Connection awaiting timeout (in milliseconds)", OFFSET(listen_timeout), BV_OPT_TYPE_INT, { .i64 = -1 }, -1, INT_MAX, D|E },
+    { "type", "Socket type", OFFSET(type), BV_OPT_TYPE_INT, { .i64 = SOCK_STREAM }, INT_MIN, INT_MAX, D|E, "type" },
+    { "stream",    "Stream (reliable stream-oriented)", 0, BV_OPT_TYPE_CONST, { .i64 = SOCK_STREAM }, INT_MIN, INT_MAX, D|E, "type" },
+    { "datagram",  "Datagram (unreliable packet-oriented)", 0, BV_OPT_TYPE_CONST, { .i64 = SOCK_DGRAM }, INT_MIN, INT_MAX, D|E, "type" },
+    { "seqpacket", "Seqpacket (reliable packet-oriented)", 0, BV_OPT_TYPE_CONST, { .i64 = SOCK_SEQPACKET }, INT_MIN, INT_MAX, D|E, "type" },
+    { NULL }
+};
+
+static const BVClass unix_class = {
+    .class_name = "unix",
+    .item_name  = bv_default_item_name,
+    .option     = unix_options,
+    .version    = LIBBVUTIL_VERSION_INT,
+};
+
+static int unix_open(BVURLContext *h, const char *filename, int flags, BVDictionary **options)
+{
+    UnixContext *s = h->priv_data;
+    const BVOption *o;
+    const char *p;
+    char buf[256];
+    int fd, ret;
+
+    bv_strstart(filename, "unix:", &filename);
+    p = strchr(filename, '?');
+    /* the query string sets the same options as the dictionary */
+    for (o = unix_options; p && o->name; o++) {
+        if (o->type != BV_OPT_TYPE_CONST &&
+            bv_find_info_tag(buf, sizeof(buf), o->name, p) &&
+            (ret = bv_opt_set(s, o->name, buf, 0)) < 0) {
+            bv_log(h, BV_LOG_ERROR, "Invalid %s '%s'\n", o->name, buf);
+            return ret;
+        }
+    }
+    if (s->rw_timeout >= 0)
+        h->rw_timeout = s->rw_timeout;
+
+    s->addr.sun_family = AF_UNIX;
+    if ((p ? p - filename : strlen(filename)) >= sizeof(s->addr.sun_path)) {
+        bv_log(h, BV_LOG_ERROR, "socket path too long\n");
+        return BVERROR(ENAMETOOLONG);
+    }
+    bv_strlcpy(s->addr.sun_path, filename, p ? p - filename + 1 : sizeof(s->addr.sun_path));
+
+    if ((fd = bv_socket(AF_UNIX, s->type, 0)) < 0)
+        return bv_neterrno();
+
+    if (s->listen) {
+        if (s->type == SOCK_DGRAM) {
+            ret = bind(fd, (struct sockaddr *)&s->addr, sizeof(s->addr));
+            if (ret < 0) {
+                ret = bv_neterrno();
+                goto fail;
+            }
+            if (bv_socket_nonblock(fd, 1) < 0)
+                bv_log(h, BV_LOG_DEBUG, "bv_socket_nonblock failed\n");
+        } else {
+            ret = bv_listen_bind(fd, (struct sockaddr *)&s->addr, sizeof(s->addr),
+                                 s->listen_timeout, &h->interrupt_callback);
+            if (ret < 0)
+                goto fail;
+            fd = ret;
+        }
+    } else {
+        ret = bv_listen_connect(fd, (struct sockaddr *)&s->addr, sizeof(s->addr),
+                                s->listen_timeout, &h->interrupt_callback, 0);
+        if (ret < 0)
+            goto fail;
+    }
+
+    s->fd = fd;
+    h->is_streamed = 1;
+    return 0;
+
+fail:
+    if (s->listen && ret != BVERROR(EADDRINUSE))
+        unlink(s->addr.sun_path);
+    closesocket(fd);
+    return ret;
+}
+
+static int unix_wait(BVURLContext *h, int write)
+{
+    UnixContext *s = h->priv_data;
+
+    if (h->flags & BV_IO_FLAG_NONBLOCK)
+        return 0;
+    return bv_network_wait_fd_timeout(s->fd, write, h->rw_timeout, &h->interrupt_callback);
+}
+
+static int unix_read(BVURLContext *h, uint8_t *buf, size_t size)
+{
+    UnixContext *s = h->priv_data;
+    int ret;
+
+    if ((ret = unix_wait(h, 0)))
+        return ret;
+    ret = recv(s->fd, buf, size, 0);
+    if (!ret && s->type == SOCK_STREAM)
+        return BVERROR_EOF;
+    return ret < 0 ? bv_neterrno() : ret;
+}
+
+static int unix_write(BVURLContext *h, const uint8_t *buf, size_t size)
+{
+    UnixContext *s = h->priv_data;
+    int ret;
+
+    if ((ret = unix_wait(h, 1)))
+        return ret;
+    ret = send(s->fd, buf, size, MSG_NOSIGNAL);
+    return ret < 0 ? bv_neterrno() : ret;
+}
+
+/**
+ * Each buffer travels as a 4 byte little endian payload size with the
+ * memfd attached as SCM_RIGHTS ancillary data.
+ */
+static int unix_send_buffer(BVURLContext *h, const BVControlPacket *pkt)
+{
+    UnixContext *s = h->priv_data;
+    BVBufferRef *ref = pkt ? pkt->data : NULL;
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } cmsg = { { 0 } };
+    struct msghdr msg = { 0 };
+    struct cmsghdr *c;
+    struct iovec iov;
+    uint8_t hdr[4];
+    int fd, ret;
+
+    if (!ref || pkt->size < 0 || pkt->size > ref->size)
+        return BVERROR(EINVAL);
+    if ((fd = bv_buffer_get_shared_fd(ref)) < 0) {
+        bv_log(h, BV_LOG_ERROR, "buffer is not from bv_buffer_alloc_shared()\n");
+        return fd;
+    }
+    BV_WL32(hdr, pkt->size);
+    iov.iov_base       = hdr;
+    iov.iov_len        = sizeof(hdr);
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = cmsg.buf;
+    msg.msg_controllen = sizeof(cmsg.buf);
+    c = CMSG_FIRSTHDR(&msg);
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type  = SCM_RIGHTS;
+    c->cmsg_len   = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(c), &fd, sizeof(int));
+
+    for (;;) {
+        if ((ret = unix_wait(h, 1)))
+            return ret;
+        ret = sendmsg(s->fd, &msg, MSG_NOSIGNAL);
+        if (ret >= 0)
+            break;
+        ret = bv_neterrno();
+        if (ret != BVERROR(EAGAIN) || (h->flags & BV_IO_FLAG_NONBLOCK))
+            return ret;
+    }
+    /* a stream socket may take the header in pieces, the fd went with the first */
+    while (ret < (int)sizeof(hdr)) {
+        int n;
+        if ((n = unix_wait(h, 1)))
+            return n;
+        n = send(s->fd, hdr + ret, sizeof(hdr) - ret, MSG_NOSIGNAL);
+        if (n < 0 && (n = bv_neterrno()) != BVERROR(EAGAIN))
+            return n;
+        if (n > 0)
+            ret += n;
+    }
+    return 0;
+}
+
+/* room for a peer sending more than the one descriptor, so they get closed */
+#define UNIX_MAX_FDS 8
+
+static int unix_recv_buffer(BVURLContext *h, BVControlPacket *pkt)
+{
+    UnixContext *s = h->priv_data;
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof(int) * UNIX_MAX_FDS)];
+    } cmsg;
+    struct msghdr msg = { 0 };
+    struct cmsghdr *c;
+    struct iovec iov;
+    BVBufferRef *ref;
+    uint8_t hdr[4];
+    int fd = -1, nb_fds = 0, ret, size, i;
+
+    if (!pkt)
+        return BVERROR(EINVAL);
+    iov.iov_base       = hdr;
+    iov.iov_len        = sizeof(hdr);
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = cmsg.buf;
+    msg.msg_controllen = sizeof(cmsg.buf);
+
+    for (;;) {
+        if ((ret = unix_wait(h, 0)))
+            return ret;
+        ret = recvmsg(s->fd, &msg, MSG_CMSG_CLOEXEC);
+        if (ret > 0)
+            break;
+        if (!ret)
+            return BVERROR_EOF;
+        ret = bv_neterrno();
+        if (ret != BVERROR(EAGAIN) || (h->flags & BV_IO_FLAG_NONBLOCK))
+            return ret;
+    }
+    for (c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+        if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS)
+            continue;
+        for (i = 0; i < (int)((c->cmsg_len - CMSG_LEN(0)) / sizeof(int)); i++) {
+            int tmp;
+            memcpy(&tmp, CMSG_DATA(c) + i * sizeof(int), sizeof(int));
+            if (fd < 0)
+                fd = tmp;
+            else
+                close(tmp);
+            nb_fds++;
+        }
+    }
+    if (msg.msg_flags & MSG_CTRUNC) {
+        bv_log(h, BV_LOG_ERROR, "ancillary data truncated\n");
+        if (fd >= 0)
+            close(fd);
+        return BVERROR_INVALIDDATA;
+    }
+    if (nb_fds != 1) {
+        bv_log(h, BV_LOG_ERROR, "%d file descriptors in message, expected 1\n", nb_fds);
+        if (fd >= 0)
+            close(fd);
+        return BVERROR_INVALIDDATA;
+    }
+    while (ret < (int)sizeof(hdr)) {
+        int n = unix_wait(h, 0);
+        if (!n) {
+            n = recv(s->fd, hdr + ret, sizeof(hdr) - ret, 0);
+            if (!n)
+                n = BVERROR_EOF;
+            else if (n < 0 && (n = bv_neterrno()) == BVERROR(EAGAIN))
+                n = 0;
+        }
+        if (n < 0) {
+            close(fd);
+            return n;
+        }
+        ret += n;
+    }
+
+    size = BV_RL32(hdr);
+    ref = bv_buffer_map_shared(fd);
+    if (!ref) {
+        close(fd);
+        return BVERROR(ENOMEM);
+    }
+    if (size < 0 || size > ref->size) {
+        bv_buffer_unref(&ref);
+        return BVERROR_INVALIDDATA;
+    }
+    pkt->data = ref;
+    pkt->size = size;
+    return 0;
+}
+
+static int unix_control(BVURLContext *h, int type, BVControlPacket *pkt_in, BVControlPacket *pkt_out)
+{
+    switch (type) {
+    case BV_URL_MESSAGE_TYPE_SEND_BUFFER:
+        return unix_send_buffer(h, pkt_in);
+    case BV_URL_MESSAGE_TYPE_RECV_BUFFER:
+        return unix_recv_buffer(h, pkt_out);
+    default:
+        break;
+    }
+    return BVERROR(ENOSYS);
+}
+
+static int unix_shutdown(BVURLContext *h, int flags)
+{
+    UnixContext *s = h->priv_data;
+    int how;
+
+    if (flags & BV_IO_FLAG_WRITE && flags & BV_IO_FLAG_READ) {
+        how = SHUT_RDWR;
+    } else if (flags & BV_IO_FLAG_WRITE) {
+        how = SHUT_WR;
+    } else {
+        how = SHUT_RD;
+    }
+
+    return shutdown(s->fd, how);
+}
+
+static int unix_close(BVURLContext *h)
+{
+    UnixContext *s = h->priv_data;
+    if (s->listen)
+        unlink(s->addr.sun_path);
+    closesocket(s->fd);
+    return 0;
+}
+
+static int unix_get_file_handle(BVURLContext *h)
+{
+    UnixContext *s = h->priv_data;
+    return s->fd;
+}
+
+BVURLProtocol bv_unix_protocol = {
+    .name                = "unix",
+    .url_open            = unix_open,
+    .url_read            = unix_read,
+    .url_write           = unix_write,
+    .url_control         = unix_control,
+    .url_close           = unix_close,
+    .url_get_file_handle = unix_get_file_handle,
+    .url_shutdown        = unix_shutdown,
+    .priv_data_size      = sizeof(UnixContext),
+    .flags               = BV_URL_PROTOCOL_FLAG_NETWORK | BV_URL_PROTOCOL_FLAG_NONBLOCK,
+    .priv_class          = &unix_class,
+};
+
+#ifdef TEST
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+
+#undef printf
+
+static int test_count_fds(void)
+{
+    DIR *dir = opendir("/proc/self/fd");
+    int n = 0;
+
+    if (!dir)
+        return -1;
+    while (readdir(dir))
+        n++;
+    closedir(dir);
+    return n;
+}
+
+/**
+ * Send the 4 byte header with nb_fds descriptors of /dev/null attached.
+ */
+static int test_send_fds(int sock, int nb_fds)
+{
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof(int) * 16)];
+    } cmsg = { { 0 } };
+    struct msghdr msg = { 0 };
+    struct cmsghdr *c;
+    struct iovec iov;
+    uint8_t hdr[4] = { 0 };
+    int fds[16], i, ret;
+
+    for (i = 0; i < nb_fds; i++)
+        fds[i] = open("/dev/null", O_RDONLY);
+    iov.iov_base    = hdr;
+    iov.iov_len     = sizeof(hdr);
+    msg.msg_iov     = &iov;
+    msg.msg_iovlen  = 1;
+    if (nb_fds) {
+        msg.msg_control    = cmsg.buf;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * nb_fds);
+        c = CMSG_FIRSTHDR(&msg);
+        c->cmsg_level = SOL_SOCKET;
+        c->cmsg_type  = SCM_RIGHTS;
+        c->cmsg_len   = CMSG_LEN(sizeof(int) * nb_fds);
+        memcpy(CMSG_DATA(c), fds, sizeof(int) * nb_fds);
+    }
+    ret = sendmsg(sock, &msg, 0);
+    for (i = 0; i < nb_fds; i++)
+        close(fds[i]);
+    return ret;
+}
+
+/**
+ * Wrap one end of a socketpair in a unix context.
+ */
+static int test_wrap(BVURLContext **h, int fd, int flags)
+{
+    UnixContext *s;
+    int ret;
+
+    if ((ret = bv_url_alloc(h, "unix:/nonexistent?type=seqpacket", flags, NULL)) < 0)
+        return ret;
+    s = (*h)->priv_data;
+    s->fd   = fd;
+    s->type = SOCK_SEQPACKET;
+    (*h)->rw_timeout   = 1000000;
+    (*h)->is_connected = 1;
+    return 0;
+}
+
+#define CHECK(x) do { if (!(x)) { printf("line %d: %s\n", __LINE__, #x); goto end; } } while (0)
+
+int main(void)
+{
+    BVURLContext *tx = NULL, *rx = NULL, *h = NULL;
+    BVBufferRef *ref = NULL;
+    BVControlPacket in = { 0 }, out = { 0 };
+    BVBufferRef *got = NULL;
+    int sv[2], i, nb_fds, err = 1;
+
+    bv_protocol_register_all();
+    bv_network_init();
+
+    CHECK(bv_url_open(&h, "unix:/nonexistent?type=bogus", BV_IO_FLAG_READ, NULL, NULL) == BVERROR(EINVAL));
+    CHECK(bv_url_open(&h, "unix:/nonexistent?timeout=x", BV_IO_FLAG_READ, NULL, NULL) < 0);
+
+    CHECK(!socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv));
+    CHECK(test_wrap(&tx, sv[0], BV_IO_FLAG_WRITE) >= 0);
+    CHECK(test_wrap(&rx, sv[1], BV_IO_FLAG_READ) >= 0);
+
+    if (!(ref = bv_buffer_alloc_shared(65536))) {
+        printf("no shared memory, skipped\n");
+        err = 0;
+        goto end;
+    }
+    for (i = 0; i < ref->size; i++)
+        ref->data[i] = i * 3;
+    in.data = ref;
+    in.size = 1000;
+    CHECK(bv_url_control(tx, BV_URL_MESSAGE_TYPE_SEND_BUFFER, &in, NULL) >= 0);
+    CHECK(bv_url_control(rx, BV_URL_MESSAGE_TYPE_RECV_BUFFER, NULL, &out) >= 0);
+    got = out.data;
+    CHECK(got && out.size == 1000 && got->size >= 65536);
+    for (i = 0; i < got->size && got->data[i] == (uint8_t)(i * 3); i++);
+    CHECK(i == got->size);
+    /* the same pages, not a copy */
+    got->data[10] = 0x55;
+    CHECK(ref->data[10] == 0x55);
+    bv_buffer_unref(&got);
+
+    /* an extra descriptor, none, or more than fit are refused and closed */
+    nb_fds = test_count_fds();
+    CHECK(test_send_fds(sv[0], 2) == 4);
+    CHECK(bv_url_control(rx, BV_URL_MESSAGE_TYPE_RECV_BUFFER, NULL, &out) == BVERROR_INVALIDDATA);
+    CHECK(test_send_fds(sv[0], 0) == 4);
+    CHECK(bv_url_control(rx, BV_URL_MESSAGE_TYPE_RECV_BUFFER, NULL, &out) == BVERROR_INVALIDDATA);
+    CHECK(test_send_fds(sv[0], UNIX_MAX_FDS + 4) == 4);
+    CHECK(bv_url_control(rx, BV_URL_MESSAGE_TYPE_RECV_BUFFER, NULL, &out) == BVERROR_INVALIDDATA);
+    CHECK(test_count_fds() == nb_fds);
+
+    /* and the socket stays usable */
+    in.size = 10;
+    CHECK(bv_url_control(tx, BV_URL_MESSAGE_TYPE_SEND_BUFFER, &in, NULL) >= 0);
+    CHECK(bv_url_control(rx, BV_URL_MESSAGE_TYPE_RECV_BUFFER, NULL, &out) >= 0);
+    got = out.data;
+    CHECK(got && out.size == 10 && got->data[10] == 0x55);
+
+    /* a buffer that is not shared cannot go */
+    bv_buffer_unref(&got);
+    CHECK(got = bv_buffer_alloc(100));
+    in.data = got;
+    CHECK(bv_url_control(tx, BV_URL_MESSAGE_TYPE_SEND_BUFFER, &in, NULL) < 0);
+    err = 0;
+end:
+    bv_buffer_unref(&got);
+    bv_buffer_unref(&ref);
+    bv_url_closep(&tx);
+    bv_url_closep(&rx);
+    printf("%s\n", err ? "FAIL" : "OK");
+    return err;
+}
+#endif /* TEST */
@@ -0,0 +1,94 @@
+/*
+ * This file is part of BVBase.
+ *
+ * BVBase is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * BVBase is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BVBase; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include "libbvutil/aes_internal.h"
+#include "libbvutil/attributes.h"
+#include "libbvutil/cpu.h"
+#include "libbvutil/intreadwrite.h"
+#include "cpu.h"
+
+#if BV_HAVE_INLINE_ASM && BV_HAVE_NEON
+#include <arm_neon.h>
+
+/* aese: AddRoundKey, SubBytes, ShiftRows; aesmc: MixColumns */
+#define AES_ROUND(b, k)                                                 \
+    __asm__ (".arch armv8-a+crypto\n\t"                                 \
+             "aese  %0.16b, %1.16b\n\t"                                 \
+             "aesmc %0.16b, %0.16b" : "+w"(b) : "w"(k))
+#define AES_LAST(b, k)                                                  \
+    __asm__ (".arch armv8-a+crypto\n\t"                                 \
+             "aese  %0.16b, %1.16b" : "+w"(b) : "w"(k))
+
+static void aes_ctr_armv8(const BVAES *a, uint8_t *dst, const uint8_t *src, int blocks, uint8_t *counter)
+{
+    uint8x16_t rk[15];
+    uint8_t block[16];
+    int rounds = a->rounds;
+    uint64_t ctr = BV_RB64(counter + 8);
+    int i, r;
+
+    for (i = 0; i <= rounds; i++)
+        rk[i] = vld1q_u8(a->round_key[rounds - i].u8);
+    memcpy(block, counter, 8);
+
+    for (; blocks >= 2; blocks -= 2) {
+        uint8x16_t b0, b1;
+        BV_WB64(block + 8, ctr);
+        b0 = vld1q_u8(block);
+        BV_WB64(block + 8, ctr + 1);
+        b1 = vld1q_u8(block);
+        for (r = 0; r < rounds - 1; r++) {
+            AES_ROUND(b0, rk[r]);
+            AES_ROUND(b1, rk[r]);
+        }
+        AES_LAST(b0, rk[rounds - 1]);
+        AES_LAST(b1, rk[rounds - 1]);
+        b0 = veorq_u8(b0, rk[rounds]);
+        b1 = veorq_u8(b1, rk[rounds]);
+        vst1q_u8(dst,      veorq_u8(b0, vld1q_u8(src)));
+        vst1q_u8(dst + 16, veorq_u8(b1, vld1q_u8(src + 16)));
+        ctr += 2;
+        dst += 32;
+        src += 32;
+    }
+    if (blocks) {
+        uint8x16_t b;
+        BV_WB64(block + 8, ctr);
+        b = vld1q_u8(block);
+        for (r = 0; r < rounds - 1; r++)
+            AES_ROUND(b, rk[r]);
+        AES_LAST(b, rk[rounds - 1]);
+        b = veorq_u8(b, rk[rounds]);
+        vst1q_u8(dst, veorq_u8(b, vld1q_u8(src)));
+        ctr++;
+    }
+    BV_WB64(counter + 8, ctr);
+}
+#endif /* BV_HAVE_INLINE_ASM && BV_HAVE_NEON */
+
+bv_cold void bb_aes_dsp_init_aarch64(BBAESDSPContext *c)
+{
+#if BV_HAVE_INLINE_ASM && BV_HAVE_NEON
+    int cpu_flags = bv_get_cpu_flags();
+
+    if (have_aes(cpu_flags))
+        c->ctr = aes_ctr_armv8;
+#endif
+}
@@ -20,9 +20,28 @@
 #include "libbvutil/cpu_internal.h"
 #include "config.h"
 
+#if defined(__linux__)
+#include <sys/auxv.h>
+#ifndef HWCAP_AES
+#define HWCAP_AES (1 << 3)
+#endif
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+#endif
+
 int bb_get_cpu_flags_aarch64(void)
 {
-    return BV_CPU_FLAG_ARMV8 * BV_HAVE_ARMV8 |
-           BV_CPU_FLAG_NEON  * BV_HAVE_NEON  |
-           BV_CPU_FLAG_VFP   * BV_HAVE_VFP;
+    int flags = BV_CPU_FLAG_ARMV8 * BV_HAVE_ARMV8 |
+                BV_CPU_FLAG_NEON  * BV_HAVE_NEON  |
+                BV_CPU_FLAG_VFP   * BV_HAVE_VFP;
+
+#if defined(__linux__)
+    /* optional in ARMv8.0, so ask the kernel */
+    if (getauxval(AT_HWCAP) & HWCAP_CRC32)
+        flags |= BV_CPU_FLAG_CRC32;
+    if (getauxval(AT_HWCAP) & HWCAP_AES)
+        flags |= BV_CPU_FLAG_AES;
+#endif
+    return flags;
 }
@@ -26,5 +26,7 @@
 #define have_armv8(flags) CPUEXT(flags, ARMV8)
 #define have_neon(flags) CPUEXT(flags, NEON)
 #define have_vfp(flags)  CPUEXT(flags, VFP)
+#define have_crc32(flags) (BV_HAVE_ARMV8 && ((flags) & BV_CPU_FLAG_CRC32))
+#define have_aes(flags)   (BV_HAVE_ARMV8 && ((flags) & BV_CPU_FLAG_AES))
 
 #endif /* BVUTIL_AARCH64_CPU_H */
@@ -0,0 +1,74 @@
+/*
+ * This file is part of BVBase.
+ *
+ * BVBase is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * BVBase is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BVBase; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include "libbvutil/attributes.h"
+#include "libbvutil/cpu.h"
+#include "libbvutil/crc_internal.h"
+#include "cpu.h"
+
+#if BV_HAVE_INLINE_ASM
+
+#define CRC32_FUNC(name, insn_b, insn_w, insn_x)                            \
+static uint32_t name(uint32_t crc, const uint8_t *buffer, size_t length)    \
+{                                                                           \
+    while (length && ((intptr_t) buffer & 7)) {                             \
+        __asm__ (".arch_extension crc\n\t"                                  \
+                 insn_b " %w0, %w0, %w1" : "+r"(crc) : "r"(*buffer));       \
+        buffer++;                                                           \
+        length--;                                                           \
+    }                                                                       \
+    while (length >= 8) {                                                   \
+        __asm__ (".arch_extension crc\n\t"                                  \
+                 insn_x " %w0, %w0, %x1"                                    \
+                 : "+r"(crc) : "r"(*(const uint64_t *) buffer));            \
+        buffer += 8;                                                        \
+        length -= 8;                                                        \
+    }                                                                       \
+    if (length >= 4) {                                                      \
+        __asm__ (".arch_extension crc\n\t"                                  \
+                 insn_w " %w0, %w0, %w1"                                    \
+                 : "+r"(crc) : "r"(*(const uint32_t *) buffer));            \
+        buffer += 4;                                                        \
+        length -= 4;                                                        \
+    }                                                                       \
+    while (length--) {                                                      \
+        __asm__ (".arch_extension crc\n\t"                                  \
+                 insn_b " %w0, %w0, %w1" : "+r"(crc) : "r"(*buffer));       \
+        buffer++;                                                           \
+    }                                                                       \
+    return crc;                                                             \
+}
+
+CRC32_FUNC(crc32c_armv8,   "crc32cb", "crc32cw", "crc32cx")
+CRC32_FUNC(crc32_le_armv8, "crc32b",  "crc32w",  "crc32x")
+
+#endif /* BV_HAVE_INLINE_ASM */
+
+bv_cold void bb_crc_dsp_init_aarch64(BBCRCDSPContext *c)
+{
+#if BV_HAVE_INLINE_ASM
+    int cpu_flags = bv_get_cpu_flags();
+
+    if (have_crc32(cpu_flags)) {
+        c->crc32c   = crc32c_armv8;
+        c->crc32_le = crc32_le_armv8;
+    }
+#endif
+}
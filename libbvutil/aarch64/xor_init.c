@@ -0,0 +1,57 @@
+/*
+ * This file is part of BVBase.
+ *
+ * BVBase is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * BVBase is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BVBase; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include "libbvutil/attributes.h"
+#include "libbvutil/cpu.h"
+#include "libbvutil/xor_internal.h"
+#include "cpu.h"
+
+#if BV_HAVE_NEON
+#include <arm_neon.h>
+
+static void memxor_neon(uint8_t *dst, const uint8_t *src, int size)
+{
+    int i = 0;
+
+    for (; i + 64 <= size; i += 64) {
+        uint8x16x4_t d = vld1q_u8_x4(dst + i);
+        uint8x16x4_t s = vld1q_u8_x4(src + i);
+        d.val[0] = veorq_u8(d.val[0], s.val[0]);
+        d.val[1] = veorq_u8(d.val[1], s.val[1]);
+        d.val[2] = veorq_u8(d.val[2], s.val[2]);
+        d.val[3] = veorq_u8(d.val[3], s.val[3]);
+        vst1q_u8_x4(dst + i, d);
+    }
+    for (; i + 16 <= size; i += 16)
+        vst1q_u8(dst + i, veorq_u8(vld1q_u8(dst + i), vld1q_u8(src + i)));
+    for (; i < size; i++)
+        dst[i] ^= src[i];
+}
+#endif /* BV_HAVE_NEON */
+
+bv_cold void bb_xor_dsp_init_aarch64(BBXORDSPContext *c)
+{
+#if BV_HAVE_NEON
+    int cpu_flags = bv_get_cpu_flags();
+
+    if (have_neon(cpu_flags))
+        c->memxor = memxor_neon;
+#endif
+}
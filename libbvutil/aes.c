@@ -22,24 +22,10 @@
 
 #include "common.h"
 #include "aes.h"
+#include "aes_internal.h"
 #include "intreadwrite.h"
 #include "timer.h"
 
-typedef union {
-    uint64_t u64[2];
-    uint32_t u32[4];
-    uint8_t u8x4[4][4];
-    uint8_t u8[16];
-} bv_aes_block;
-
-typedef struct BVAES {
-    // Note: round_key[16] is accessed in the init code, but this only
-    // overwrites state, which does not matter (see also commit ba554c0).
-    bv_aes_block round_key[15];
-    bv_aes_block state[2];
-    int rounds;
-} BVAES;
-
 const int bv_aes_size= sizeof(BVAES);
 
 struct BVAES *bv_aes_alloc(void)
@@ -0,0 +1,243 @@
+/*
+ * This file is part of BVBase.
+ *
+ * BVBase is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * BVBase is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BVBase; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "common.h"
+#include "aes.h"
+#include "aes_ctr.h"
+#include "aes_internal.h"
+#include "intreadwrite.h"
+#include "mem.h"
+
+typedef struct BVAESCTR {
+    BVAES aes;
+    BBAESDSPContext dsp;
+    uint8_t iv[BV_AES_CTR_IV_SIZE];
+    uint8_t counter[16];        ///< next counter block
+    uint8_t keystream[16];
+    int keystream_pos;          ///< bytes of keystream used, 16 when empty
+} BVAESCTR;
+
+static void counter_add(uint8_t *counter, uint64_t n)
+{
+    uint64_t lo = BV_RB64(counter + 8);
+
+    BV_WB64(counter + 8, lo + n);
+    if (lo + n < lo)
+        BV_WB64(counter, BV_RB64(counter) + 1);
+}
+
+static void aes_ctr_c(const BVAES *a, uint8_t *dst, const uint8_t *src, int blocks, uint8_t *counter)
+{
+    uint8_t keystream[16];
+    int i;
+
+    while (blocks--) {
+        bv_aes_crypt((BVAES *)a, keystream, counter, 1, NULL, 0);
+        for (i = 0; i < 16; i++)
+            dst[i] = src[i] ^ keystream[i];
+        BV_WB64(counter + 8, BV_RB64(counter + 8) + 1);
+        dst += 16;
+        src += 16;
+    }
+}
+
+struct BVAESCTR *bv_aes_ctr_alloc(void)
+{
+    return bv_mallocz(sizeof(struct BVAESCTR));
+}
+
+int bv_aes_ctr_init(struct BVAESCTR *a, const uint8_t *key, int key_bits)
+{
+    if (key_bits != 128 && key_bits != 256)
+        return BVERROR(EINVAL);
+    if (bv_aes_init(&a->aes, key, key_bits, 0) < 0)
+        return BVERROR(EINVAL);
+
+    a->dsp.ctr = aes_ctr_c;
+    if (BV_ARCH_AARCH64)
+        bb_aes_dsp_init_aarch64(&a->dsp);
+    if (BV_ARCH_X86)
+        bb_aes_dsp_init_x86(&a->dsp);
+
+    memset(a->iv, 0, sizeof(a->iv));
+    bv_aes_ctr_seek(a, 0);
+    return 0;
+}
+
+void bv_aes_ctr_free(struct BVAESCTR *a)
+{
+    bv_free(a);
+}
+
+void bv_aes_ctr_set_iv(struct BVAESCTR *a, const uint8_t *iv)
+{
+    memcpy(a->iv, iv, sizeof(a->iv));
+    bv_aes_ctr_seek(a, 0);
+}
+
+void bv_aes_ctr_seek(struct BVAESCTR *a, uint64_t offset)
+{
+    memcpy(a->counter, a->iv, sizeof(a->counter));
+    counter_add(a->counter, offset >> 4);
+    a->keystream_pos = 16;
+    if (offset & 15) {
+        bv_aes_crypt(&a->aes, a->keystream, a->counter, 1, NULL, 0);
+        counter_add(a->counter, 1);
+        a->keystream_pos = offset & 15;
+    }
+}
+
+void bv_aes_ctr_crypt(struct BVAESCTR *a, uint8_t *dst, const uint8_t *src, int size)
+{
+    while (size > 0 && a->keystream_pos < 16) {
+        *dst++ = *src++ ^ a->keystream[a->keystream_pos++];
+        size--;
+    }
+    while (size >= 16) {
+        /* split where the low half of the counter wraps */
+        uint64_t left = ~BV_RB64(a->counter + 8) + UINT64_C(1);
+        int blocks = size >> 4;
+        if (left && left < blocks)
+            blocks = left;
+        a->dsp.ctr(&a->aes, dst, src, blocks, a->counter);
+        if (blocks == left)
+            BV_WB64(a->counter, BV_RB64(a->counter) + 1);
+        dst  += blocks << 4;
+        src  += blocks << 4;
+        size -= blocks << 4;
+    }
+    if (size > 0) {
+        bv_aes_crypt(&a->aes, a->keystream, a->counter, 1, NULL, 0);
+        counter_add(a->counter, 1);
+        a->keystream_pos = 0;
+        while (size--)
+            *dst++ = *src++ ^ a->keystream[a->keystream_pos++];
+    }
+}
+
+#ifdef TEST
+#include <stdio.h>
+
+#include "cpu.h"
+#include "lfg.h"
+#include "log.h"
+
+/* NIST SP 800-38A F.5.1 and F.5.5 */
+static const uint8_t plain[64] = {
+    0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+    0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+    0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+    0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10,
+};
+
+static const uint8_t counter0[16] = {
+    0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff,
+};
+
+static const uint8_t key128[16] = {
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c,
+};
+
+static const uint8_t cipher128[64] = {
+    0x87, 0x4d, 0x61, 0x91, 0xb6, 0x20, 0xe3, 0x26, 0x1b, 0xef, 0x68, 0x64, 0x99, 0x0d, 0xb6, 0xce,
+    0x98, 0x06, 0xf6, 0x6b, 0x79, 0x70, 0xfd, 0xff, 0x86, 0x17, 0x18, 0x7b, 0xb9, 0xff, 0xfd, 0xff,
+    0x5a, 0xe4, 0xdf, 0x3e, 0xdb, 0xd5, 0xd3, 0x5e, 0x5b, 0x4f, 0x09, 0x02, 0x0d, 0xb0, 0x3e, 0xab,
+    0x1e, 0x03, 0x1d, 0xda, 0x2f, 0xbe, 0x03, 0xd1, 0x79, 0x21, 0x70, 0xa0, 0xf3, 0x00, 0x9c, 0xee,
+};
+
+static const uint8_t key256[32] = {
+    0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe, 0x2b, 0x73, 0xae, 0xf0, 0x85, 0x7d, 0x77, 0x81,
+    0x1f, 0x35, 0x2c, 0x07, 0x3b, 0x61, 0x08, 0xd7, 0x2d, 0x98, 0x10, 0xa3, 0x09, 0x14, 0xdf, 0xf4,
+};
+
+static const uint8_t cipher256[64] = {
+    0x60, 0x1e, 0xc3, 0x13, 0x77, 0x57, 0x89, 0xa5, 0xb7, 0xa7, 0xf5, 0x04, 0xbb, 0xf3, 0xd2, 0x28,
+    0xf4, 0x43, 0xe3, 0xca, 0x4d, 0x62, 0xb5, 0x9a, 0xca, 0x84, 0xe9, 0x90, 0xca, 0xca, 0xf5, 0xc5,
+    0x2b, 0x09, 0x30, 0xda, 0xa2, 0x3d, 0xe9, 0x4c, 0xe8, 0x70, 0x17, 0xba, 0x2d, 0x84, 0x98, 0x8d,
+    0xdf, 0xc9, 0xc5, 0x8d, 0xb6, 0x7a, 0xad, 0xa6, 0x13, 0xc2, 0xdd, 0x08, 0x45, 0x79, 0x41, 0xa6,
+};
+
+#define STREAM_SIZE 4099
+
+int main(void)
+{
+    static uint8_t in[STREAM_SIZE], out[2][STREAM_SIZE], tmp[STREAM_SIZE];
+    struct BVAESCTR *a = bv_aes_ctr_alloc(), *ref = bv_aes_ctr_alloc();
+    uint8_t iv[16];
+    BVLFG prng;
+    int cpu_flags = bv_get_cpu_flags();
+    int i, pass, err = 0;
+
+    if (!a || !ref)
+        return 1;
+
+    for (pass = 0; pass < 2; pass++) {
+        bv_aes_ctr_init(a, pass ? key256 : key128, pass ? 256 : 128);
+        bv_aes_ctr_set_iv(a, counter0);
+        bv_aes_ctr_crypt(a, tmp, plain, 64);
+        if (memcmp(tmp, pass ? cipher256 : cipher128, 64)) {
+            printf("AES-%d-CTR test vector mismatch\n", pass ? 256 : 128);
+            err = 1;
+        }
+        /* decrypting is the same operation, in odd sized pieces */
+        bv_aes_ctr_seek(a, 0);
+        bv_aes_ctr_crypt(a, tmp, pass ? cipher256 : cipher128, 7);
+        bv_aes_ctr_crypt(a, tmp + 7, (pass ? cipher256 : cipher128) + 7, 57);
+        if (memcmp(tmp, plain, 64)) {
+            printf("AES-%d-CTR decryption mismatch\n", pass ? 256 : 128);
+            err = 1;
+        }
+    }
+
+    /* the dispatched kernel must match the C one, also across a counter
+     * wrap and after seeking into the middle of a block */
+    bv_lfg_init(&prng, 1);
+    for (i = 0; i < STREAM_SIZE; i++)
+        in[i] = bv_lfg_get(&prng);
+    memset(iv, 0xff, sizeof(iv));
+    iv[0] = 0;
+    iv[15] = 0xf0;
+    bv_aes_ctr_init(a, key256, 256);
+    bv_aes_ctr_set_iv(a, iv);
+    bv_aes_ctr_crypt(a, out[0], in, STREAM_SIZE);
+
+    bv_force_cpu_flags(0);
+    bv_aes_ctr_init(ref, key256, 256);
+    bv_force_cpu_flags(cpu_flags);
+    bv_aes_ctr_set_iv(ref, iv);
+    bv_aes_ctr_crypt(ref, out[1], in, STREAM_SIZE);
+    if (memcmp(out[0], out[1], STREAM_SIZE)) {
+        printf("accelerated and C keystreams differ\n");
+        err = 1;
+    }
+    bv_aes_ctr_seek(a, 1234);
+    bv_aes_ctr_crypt(a, tmp, in + 1234, STREAM_SIZE - 1234);
+    if (memcmp(tmp, out[1] + 1234, STREAM_SIZE - 1234)) {
+        printf("seek mismatch\n");
+        err = 1;
+    }
+
+    bv_aes_ctr_free(a);
+    bv_aes_ctr_free(ref);
+    return err;
+}
+#endif
@@ -0,0 +1,82 @@
+/*
+ * This file is part of BVBase.
+ *
+ * BVBase is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * BVBase is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BVBase; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef BVUTIL_AES_CTR_H
+#define BVUTIL_AES_CTR_H
+
+#include <stdint.h>
+
+#include "attributes.h"
+#include "version.h"
+
+/**
+ * @defgroup lavu_aes_ctr AES-CTR
+ * @ingroup lavu_crypto
+ * AES in counter mode. Encryption and decryption are the same operation and
+ * any byte offset of the stream can be reached directly with
+ * bv_aes_ctr_seek(). Uses AES-NI or the ARMv8 AES instructions when the CPU
+ * has them.
+ * @{
+ */
+
+#define BV_AES_CTR_KEY_SIZE_128 16
+#define BV_AES_CTR_KEY_SIZE_256 32
+#define BV_AES_CTR_IV_SIZE      16
+
+struct BVAESCTR;
+
+/**
+ * Allocate an BVAESCTR context.
+ */
+struct BVAESCTR *bv_aes_ctr_alloc(void);
+
+/**
+ * Initialize an BVAESCTR context with a 128 or 256 bit key.
+ * The counter starts at zero until bv_aes_ctr_set_iv() is called.
+ * @return 0 on success, a negative BVERROR code otherwise
+ */
+int bv_aes_ctr_init(struct BVAESCTR *a, const uint8_t *key, int key_bits);
+
+/**
+ * Release an BVAESCTR context.
+ */
+void bv_aes_ctr_free(struct BVAESCTR *a);
+
+/**
+ * Set the initial counter block, a 128 bit big endian number, and rewind
+ * to offset 0.
+ */
+void bv_aes_ctr_set_iv(struct BVAESCTR *a, const uint8_t *iv);
+
+/**
+ * Position the keystream at byte offset of the stream, counting from the
+ * initial counter block.
+ */
+void bv_aes_ctr_seek(struct BVAESCTR *a, uint64_t offset);
+
+/**
+ * Encrypt or decrypt size bytes, continuing the keystream.
+ * @param dst destination array, can be equal to src
+ */
+void bv_aes_ctr_crypt(struct BVAESCTR *a, uint8_t *dst, const uint8_t *src, int size);
+
+/**
+ * @}
+ */
+
+#endif /* BVUTIL_AES_CTR_H */
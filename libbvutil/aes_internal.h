@@ -0,0 +1,57 @@
+/*
+ * This file is part of BVBase.
+ *
+ * BVBase is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * BVBase is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BVBase; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef BVUTIL_AES_INTERNAL_H
+#define BVUTIL_AES_INTERNAL_H
+
+#include <stdint.h>
+
+typedef union {
+    uint64_t u64[2];
+    uint32_t u32[4];
+    uint8_t u8x4[4][4];
+    uint8_t u8[16];
+} bv_aes_block;
+
+/**
+ * For encryption round_key[rounds - i] is the standard round key i, so the
+ * schedule can be fed directly to AES instructions.
+ */
+typedef struct BVAES {
+    // Note: round_key[16] is accessed in the init code, but this only
+    // overwrites state, which does not matter (see also commit ba554c0).
+    bv_aes_block round_key[15];
+    bv_aes_block state[2];
+    int rounds;
+} BVAES;
+
+typedef struct BBAESDSPContext {
+    /**
+     * XOR blocks * 16 bytes of src with the keystream of counter mode and
+     * advance the big endian counter by blocks. The low 64 bits of counter
+     * must not wrap within one call.
+     *
+     * @param a context initialized for encryption
+     */
+    void (*ctr)(const BVAES *a, uint8_t *dst, const uint8_t *src, int blocks, uint8_t *counter);
+} BBAESDSPContext;
+
+void bb_aes_dsp_init_aarch64(BBAESDSPContext *c);
+void bb_aes_dsp_init_x86(BBAESDSPContext *c);
+
+#endif /* BVUTIL_AES_INTERNAL_H */
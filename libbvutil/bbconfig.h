@@ -0,0 +1,7 @@
+/* Generated by bvconf */
+#ifndef BVUTIL_BBCONFIG_H
+#define BVUTIL_BBCONFIG_H
+#define BV_HAVE_BIGENDIAN 0
+#define BV_HAVE_FAST_UNALIGNED 1
+#define BV_HAVE_INCOMPATIBLE_LIBBV_ABI 0
+#endif /* BVUTIL_BBCONFIG_H */
@@ -0,0 +1,4 @@
+#ifndef BVUTIL_BBVERSION_H
+#define BVUTIL_BBVERSION_H
+#define BVBASE_VERSION "7f0e2fe"
+#endif /* BVUTIL_BBVERSION_H */
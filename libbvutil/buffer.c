@@ -16,8 +16,25 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+/* syscall() */
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+
+#include "config.h"
+
 #include <stdint.h>
 #include <string.h>
+#if BV_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#if BV_HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
 
 #include "atomic.h"
 #include "buffer_internal.h"
@@ -204,6 +221,97 @@ int bv_buffer_realloc(BVBufferRef **pbuf, int size)
     return 0;
 }
 
+#if BV_HAVE_MMAP && defined(__linux__) && defined(SYS_memfd_create)
+#define HAVE_SHARED_BUFFER 1
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+typedef struct SharedBuffer {
+    int fd;
+    int size;
+} SharedBuffer;
+
+static void buffer_shared_free(void *opaque, uint8_t *data)
+{
+    SharedBuffer *sb = opaque;
+
+    munmap(data, sb->size);
+    close(sb->fd);
+    bv_free(sb);
+}
+
+static BVBufferRef *buffer_map_fd(int fd, int size)
+{
+    SharedBuffer *sb;
+    BVBufferRef *ret;
+    void *data;
+
+    sb = bv_mallocz(sizeof(*sb));
+    if (!sb)
+        return NULL;
+    data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        bv_free(sb);
+        return NULL;
+    }
+    sb->fd   = fd;
+    sb->size = size;
+    ret = bv_buffer_create(data, size, buffer_shared_free, sb, 0);
+    if (!ret) {
+        munmap(data, size);
+        bv_free(sb);
+    }
+    return ret;
+}
+#else
+#define HAVE_SHARED_BUFFER 0
+#endif
+
+BVBufferRef *bv_buffer_alloc_shared(int size)
+{
+#if HAVE_SHARED_BUFFER
+    BVBufferRef *ret;
+    int fd;
+
+    if (size <= 0)
+        return NULL;
+    fd = syscall(SYS_memfd_create, "bvbuffer", MFD_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+    if (ftruncate(fd, size) < 0 || !(ret = buffer_map_fd(fd, size))) {
+        close(fd);
+        return NULL;
+    }
+    return ret;
+#else
+    return NULL;
+#endif
+}
+
+BVBufferRef *bv_buffer_map_shared(int fd)
+{
+#if HAVE_SHARED_BUFFER
+    struct stat st;
+
+    if (fstat(fd, &st) < 0 || st.st_size <= 0 || st.st_size > INT_MAX)
+        return NULL;
+    return buffer_map_fd(fd, st.st_size);
+#else
+    return NULL;
+#endif
+}
+
+int bv_buffer_get_shared_fd(const BVBufferRef *buf)
+{
+#if HAVE_SHARED_BUFFER
+    if (buf && buf->buffer->free == buffer_shared_free)
+        return ((SharedBuffer *)buf->buffer->opaque)->fd;
+#endif
+    return BVERROR(EINVAL);
+}
+
 BVBufferPool *bv_buffer_pool_init(int size, BVBufferRef* (*alloc)(int size))
 {
     BVBufferPool *pool = bv_mallocz(sizeof(*pool));
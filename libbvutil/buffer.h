@@ -197,6 +197,32 @@ int bv_buffer_make_writable(BVBufferRef **buf);
  */
 int bv_buffer_realloc(BVBufferRef **buf, int size);
 
+/**
+ * Allocate a buffer backed by an anonymous shared memory file (memfd), so
+ * that its file descriptor can be handed to another process, e.g. over the
+ * unix protocol, which then maps the same pages with bv_buffer_map_shared().
+ *
+ * @return a BVBufferRef of size bytes or NULL when shared memory is not
+ *         available on this system
+ */
+BVBufferRef *bv_buffer_alloc_shared(int size);
+
+/**
+ * Map a shared memory file descriptor received from another process.
+ * The whole file is mapped read/write. On success fd is owned by the
+ * returned buffer and closed when it is freed.
+ *
+ * @return a new BVBufferRef, NULL on failure (fd is left open then)
+ */
+BVBufferRef *bv_buffer_map_shared(int fd);
+
+/**
+ * @return the file descriptor behind a buffer created with
+ *         bv_buffer_alloc_shared() or bv_buffer_map_shared(),
+ *         BVERROR(EINVAL) for any other buffer. It stays owned by the buffer.
+ */
+int bv_buffer_get_shared_fd(const BVBufferRef *buf);
+
 /**
  * @}
  */
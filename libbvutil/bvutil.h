@@ -289,9 +289,12 @@ typedef struct _BVProbeData {
 
 #define BV_PROBE_PADDING_SIZE 32             ///< extra allocated bytes at the end of the probe buffer
 
+struct BVCancelToken;
+
 typedef struct BVIOInterruptCB {
     int (*callback)(void*);
     void *opaque;
+    struct BVCancelToken *token;    ///< optional, see libbvutil/cancel.h
 } BVIOInterruptCB;
 
 int bv_check_interrupt(BVIOInterruptCB *cb);
@@ -0,0 +1,170 @@
+/*
+ * This file is part of BVBase.
+ *
+ * BVBase is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * BVBase is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BVBase; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include <fcntl.h>
+#if BV_HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if BV_HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
+
+#include "atomic.h"
+#include "cancel.h"
+#include "error.h"
+#include "mem.h"
+
+struct BVCancelToken {
+    volatile int cancelled;
+    int rfd, wfd;       ///< the same eventfd, or the ends of a pipe
+};
+
+int bv_cancel_token_alloc(BVCancelToken **ptoken)
+{
+    BVCancelToken *token = bv_mallocz(sizeof(*token));
+    int ret;
+
+    if (!token)
+        return BVERROR(ENOMEM);
+#if BV_HAVE_SYS_EVENTFD_H
+    token->rfd = token->wfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (token->rfd < 0) {
+        ret = BVERROR(errno);
+        bv_free(token);
+        return ret;
+    }
+#else
+    {
+        int fds[2];
+        if (pipe(fds) < 0) {
+            ret = BVERROR(errno);
+            bv_free(token);
+            return ret;
+        }
+        fcntl(fds[0], F_SETFL, O_NONBLOCK);
+        fcntl(fds[1], F_SETFL, O_NONBLOCK);
+        token->rfd = fds[0];
+        token->wfd = fds[1];
+    }
+#endif
+    *ptoken = token;
+    return 0;
+}
+
+void bv_cancel_token_free(BVCancelToken **ptoken)
+{
+    BVCancelToken *token = *ptoken;
+
+    if (!token)
+        return;
+    if (token->wfd != token->rfd)
+        close(token->wfd);
+    close(token->rfd);
+    bv_freep(ptoken);
+}
+
+void bv_cancel_token_cancel(BVCancelToken *token)
+{
+#if BV_HAVE_SYS_EVENTFD_H
+    uint64_t one = 1;
+#else
+    uint8_t one = 1;
+#endif
+
+    /* the handle stays readable until reset, one write is enough */
+    if (bvpriv_atomic_int_add_and_fetch(&token->cancelled, 1) == 1)
+        if (write(token->wfd, &one, sizeof(one)) < 0)
+            return;
+}
+
+void bv_cancel_token_reset(BVCancelToken *token)
+{
+    uint8_t buf[8];
+
+    while (read(token->rfd, buf, sizeof(buf)) > 0)
+        ;
+    bvpriv_atomic_int_set(&token->cancelled, 0);
+}
+
+int bv_cancel_token_is_cancelled(BVCancelToken *token)
+{
+    return !!bvpriv_atomic_int_get(&token->cancelled);
+}
+
+int bv_cancel_token_get_fd(const BVCancelToken *token)
+{
+    return token->rfd;
+}
+
+#ifdef TEST
+#include <stdio.h>
+
+#include "log.h"
+#include "network.h"
+#include "time.h"
+
+int main(void)
+{
+    BVCancelToken *token;
+    BVIOInterruptCB cb = { 0 };
+    int fds[2], ret, errors = 0;
+    int64_t t0;
+
+    if (bv_cancel_token_alloc(&token) < 0 || pipe(fds) < 0)
+        return 1;
+    cb.token = token;
+
+    /* not cancelled: waits for the whole timeout */
+    t0  = bv_gettime_relative();
+    ret = bv_network_wait_fd_timeout(fds[0], 0, 30000, &cb);
+    t0  = bv_gettime_relative() - t0;
+    if (ret != BVERROR(ETIMEDOUT) || t0 < 30000) {
+        bv_log(NULL, BV_LOG_ERROR, "timeout: ret %d after %"PRId64" us\n", ret, t0);
+        errors++;
+    }
+
+    /* cancelled: returns at once even without a timeout */
+    bv_cancel_token_cancel(token);
+    bv_cancel_token_cancel(token);
+    t0  = bv_gettime_relative();
+    ret = bv_network_wait_fd_timeout(fds[0], 0, 0, &cb);
+    t0  = bv_gettime_relative() - t0;
+    if (ret != BVERROR_EXIT || t0 > 10000 || !bv_check_interrupt(&cb)) {
+        bv_log(NULL, BV_LOG_ERROR, "cancel: ret %d after %"PRId64" us\n", ret, t0);
+        errors++;
+    }
+
+    /* reset: readiness of the fd itself is reported again */
+    bv_cancel_token_reset(token);
+    if (write(fds[1], "x", 1) != 1)
+        return 1;
+    ret = bv_network_wait_fd_timeout(fds[0], 0, 1000000, &cb);
+    if (ret || bv_check_interrupt(&cb)) {
+        bv_log(NULL, BV_LOG_ERROR, "reset: ret %d\n", ret);
+        errors++;
+    }
+
+    close(fds[0]);
+    close(fds[1]);
+    bv_cancel_token_free(&token);
+    printf("%d errors\n", errors);
+    return !!errors;
+}
+#endif
@@ -0,0 +1,59 @@
+/*
+ * This file is part of BVBase.
+ *
+ * BVBase is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * BVBase is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BVBase; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef BVUTIL_CANCEL_H
+#define BVUTIL_CANCEL_H
+
+/**
+ * @file
+ * Cancellation token for blocking I/O.
+ *
+ * Set BVIOInterruptCB.token and every wait in the network code also
+ * watches the token's file handle, so bv_cancel_token_cancel() wakes
+ * blocked calls at once instead of at their next interrupt poll, and
+ * waits without an interrupt callback do not wake up periodically.
+ */
+
+typedef struct BVCancelToken BVCancelToken;
+
+int bv_cancel_token_alloc(BVCancelToken **token);
+
+/**
+ * Free a token, no operation may be using it any more.
+ */
+void bv_cancel_token_free(BVCancelToken **token);
+
+/**
+ * Cancel all operations waiting on token now and later, until
+ * bv_cancel_token_reset(). Safe to call from any thread or more than once.
+ */
+void bv_cancel_token_cancel(BVCancelToken *token);
+
+/**
+ * Make a cancelled token usable again.
+ */
+void bv_cancel_token_reset(BVCancelToken *token);
+
+int bv_cancel_token_is_cancelled(BVCancelToken *token);
+
+/**
+ * @return a file handle that polls readable once token is cancelled
+ */
+int bv_cancel_token_get_fd(const BVCancelToken *token);
+
+#endif /* BVUTIL_CANCEL_H */
@@ -116,6 +116,8 @@ int bv_parse_cpu_flags(const char *s)
 #define CPUFLAG_AVX2     (BV_CPU_FLAG_AVX2     | CPUFLAG_AVX)
 #define CPUFLAG_BMI1     (BV_CPU_FLAG_BMI1)
 #define CPUFLAG_BMI2     (BV_CPU_FLAG_BMI2     | CPUFLAG_BMI1)
+#define CPUFLAG_PCLMUL   (BV_CPU_FLAG_PCLMUL   | CPUFLAG_SSE2)
+#define CPUFLAG_AESNI    (BV_CPU_FLAG_AESNI    | CPUFLAG_SSE2)
     static const BVOption cpuflags_opts[] = {
         { "flags"   , NULL, 0, BV_OPT_TYPE_FLAGS, { .i64 = 0 }, INT64_MIN, INT64_MAX, .unit = "flags" },
 #if   BV_ARCH_PPC
@@ -139,6 +141,8 @@ int bv_parse_cpu_flags(const char *s)
         { "avx2"    , NULL, 0, BV_OPT_TYPE_CONST, { .i64 = CPUFLAG_AVX2         },    .unit = "flags" },
         { "bmi1"    , NULL, 0, BV_OPT_TYPE_CONST, { .i64 = CPUFLAG_BMI1         },    .unit = "flags" },
         { "bmi2"    , NULL, 0, BV_OPT_TYPE_CONST, { .i64 = CPUFLAG_BMI2         },    .unit = "flags" },
+        { "pclmul"  , NULL, 0, BV_OPT_TYPE_CONST, { .i64 = CPUFLAG_PCLMUL       },    .unit = "flags" },
+        { "aesni"   , NULL, 0, BV_OPT_TYPE_CONST, { .i64 = CPUFLAG_AESNI        },    .unit = "flags" },
         { "3dnow"   , NULL, 0, BV_OPT_TYPE_CONST, { .i64 = CPUFLAG_3DNOW        },    .unit = "flags" },
         { "3dnowext", NULL, 0, BV_OPT_TYPE_CONST, { .i64 = CPUFLAG_3DNOWEXT     },    .unit = "flags" },
         { "cmov",     NULL, 0, BV_OPT_TYPE_CONST, { .i64 = BV_CPU_FLAG_CMOV     },    .unit = "flags" },
@@ -153,6 +157,8 @@ int bv_parse_cpu_flags(const char *s)
         { "armv8",    NULL, 0, BV_OPT_TYPE_CONST, { .i64 = BV_CPU_FLAG_ARMV8    },    .unit = "flags" },
         { "neon",     NULL, 0, BV_OPT_TYPE_CONST, { .i64 = BV_CPU_FLAG_NEON     },    .unit = "flags" },
         { "vfp",      NULL, 0, BV_OPT_TYPE_CONST, { .i64 = BV_CPU_FLAG_VFP      },    .unit = "flags" },
+        { "crc32",    NULL, 0, BV_OPT_TYPE_CONST, { .i64 = BV_CPU_FLAG_CRC32    },    .unit = "flags" },
+        { "aes",      NULL, 0, BV_OPT_TYPE_CONST, { .i64 = BV_CPU_FLAG_AES      },    .unit = "flags" },
 #endif
         { NULL },
     };
@@ -198,6 +204,8 @@ int bv_parse_cpu_caps(unsigned *flags, const char *s)
         { "avx2"    , NULL, 0, BV_OPT_TYPE_CONST, { .i64 = BV_CPU_FLAG_AVX2     },    .unit = "flags" },
         { "bmi1"    , NULL, 0, BV_OPT_TYPE_CONST, { .i64 = BV_CPU_FLAG_BMI1     },    .unit = "flags" },
         { "bmi2"    , NULL, 0, BV_OPT_TYPE_CONST, { .i64 = BV_CPU_FLAG_BMI2     },    .unit = "flags" },
+        { "pclmul"  , NULL, 0, BV_OPT_TYPE_CONST, { .i64 = BV_CPU_FLAG_PCLMUL   },    .unit = "flags" },
+        { "aesni"   , NULL, 0, BV_OPT_TYPE_CONST, { .i64 = BV_CPU_FLAG_AESNI    },    .unit = "flags" },
         { "3dnow"   , NULL, 0, BV_OPT_TYPE_CONST, { .i64 = BV_CPU_FLAG_3DNOW    },    .unit = "flags" },
         { "3dnowext", NULL, 0, BV_OPT_TYPE_CONST, { .i64 = BV_CPU_FLAG_3DNOWEXT },    .unit = "flags" },
         { "cmov",     NULL, 0, BV_OPT_TYPE_CONST, { .i64 = BV_CPU_FLAG_CMOV     },    .unit = "flags" },
@@ -230,6 +238,8 @@ int bv_parse_cpu_caps(unsigned *flags, const char *s)
         { "armv8",    NULL, 0, BV_OPT_TYPE_CONST, { .i64 = BV_CPU_FLAG_ARMV8    },    .unit = "flags" },
         { "neon",     NULL, 0, BV_OPT_TYPE_CONST, { .i64 = BV_CPU_FLAG_NEON     },    .unit = "flags" },
         { "vfp",      NULL, 0, BV_OPT_TYPE_CONST, { .i64 = BV_CPU_FLAG_VFP      },    .unit = "flags" },
+        { "crc32",    NULL, 0, BV_OPT_TYPE_CONST, { .i64 = BV_CPU_FLAG_CRC32    },    .unit = "flags" },
+        { "aes",      NULL, 0, BV_OPT_TYPE_CONST, { .i64 = BV_CPU_FLAG_AES      },    .unit = "flags" },
 #endif
         { NULL },
     };
@@ -297,6 +307,8 @@ static const struct {
     { BV_CPU_FLAG_ARMV8,     "armv8"      },
     { BV_CPU_FLAG_NEON,      "neon"       },
     { BV_CPU_FLAG_VFP,       "vfp"        },
+    { BV_CPU_FLAG_CRC32,     "crc32"      },
+    { BV_CPU_FLAG_AES,       "aes"        },
 #elif BV_ARCH_ARM
     { BV_CPU_FLAG_ARMV5TE,   "armv5te"    },
     { BV_CPU_FLAG_ARMV6,     "armv6"      },
@@ -329,6 +341,8 @@ static const struct {
     { BV_CPU_FLAG_AVX2,      "avx2"       },
     { BV_CPU_FLAG_BMI1,      "bmi1"       },
     { BV_CPU_FLAG_BMI2,      "bmi2"       },
+    { BV_CPU_FLAG_PCLMUL,    "pclmul"     },
+    { BV_CPU_FLAG_AESNI,     "aesni"      },
 #endif
     { 0 }
 };
@@ -54,6 +54,8 @@
 #define BV_CPU_FLAG_FMA3        0x10000 ///< Haswell FMA3 functions
 #define BV_CPU_FLAG_BMI1        0x20000 ///< Bit Manipulation Instruction Set 1
 #define BV_CPU_FLAG_BMI2        0x40000 ///< Bit Manipulation Instruction Set 2
+#define BV_CPU_FLAG_PCLMUL      0x80000 ///< carry-less multiplication (PCLMULQDQ)
+#define BV_CPU_FLAG_AESNI      0x100000 ///< Advanced Encryption Standard New Instructions
 
 #define BV_CPU_FLAG_ALTIVEC      0x0001 ///< standard
 
@@ -64,6 +66,8 @@
 #define BV_CPU_FLAG_VFPV3        (1 << 4)
 #define BV_CPU_FLAG_NEON         (1 << 5)
 #define BV_CPU_FLAG_ARMV8        (1 << 6)
+#define BV_CPU_FLAG_CRC32        (1 << 7) ///< ARMv8 CRC32 instructions
+#define BV_CPU_FLAG_AES          (1 << 8) ///< ARMv8 AES instructions
 #define BV_CPU_FLAG_SETEND       (1 <<16)
 
 /**
@@ -22,6 +22,8 @@
 #include "common.h"
 #include "bswap.h"
 #include "crc.h"
+#include "crc_internal.h"
+#include "thread.h"
 
 #if BV_CONFIG_HARDCODED_TABLES
 static const BVCRC bv_crc_table[BV_CRC_MAX][257] = {
@@ -288,7 +290,7 @@ static const BVCRC bv_crc_table[BV_CRC_MAX][257] = {
 #if BV_CONFIG_SMALL
 #define CRC_TABLE_SIZE 257
 #else
-#define CRC_TABLE_SIZE 1024
+#define CRC_TABLE_SIZE 2049
 #endif
 static struct {
     uint8_t  le;
@@ -313,7 +315,8 @@ int bv_crc_init(BVCRC *ctx, int le, int bits, uint32_t poly, int ctx_size)
 
     if (bits < 8 || bits > 32 || poly >= (1LL << bits))
         return -1;
-    if (ctx_size != sizeof(BVCRC) * 257 && ctx_size != sizeof(BVCRC) * 1024)
+    if (ctx_size != sizeof(BVCRC) * 257 && ctx_size != sizeof(BVCRC) * 1024 &&
+        ctx_size != sizeof(BVCRC) * 2049)
         return -1;
 
     for (i = 0; i < 256; i++) {
@@ -329,11 +332,22 @@ int bv_crc_init(BVCRC *ctx, int le, int bits, uint32_t poly, int ctx_size)
     }
     ctx[256] = 1;
 #if !BV_CONFIG_SMALL
-    if (ctx_size >= sizeof(BVCRC) * 1024)
+    if (ctx_size == sizeof(BVCRC) * 1024) {
         for (i = 0; i < 256; i++)
             for (j = 0; j < 3; j++)
                 ctx[256 *(j + 1) + i] =
                     (ctx[256 * j + i] >> 8) ^ ctx[ctx[256 * j + i] & 0xFF];
+    } else if (ctx_size == sizeof(BVCRC) * 2049) {
+        /* table 0 is followed by the layout marker, tables 1..7 by index 257 */
+        ctx[256] = 2;
+        for (i = 0; i < 256; i++) {
+            c = ctx[i];
+            for (j = 1; j < 8; j++) {
+                c = (c >> 8) ^ ctx[c & 0xFF];
+                ctx[1 + 256 * j + i] = c;
+            }
+        }
+    }
 #endif
 
     return 0;
@@ -359,7 +373,25 @@ uint32_t bv_crc(const BVCRC *ctx, uint32_t crc,
     const uint8_t *end = buffer + length;
 
 #if !BV_CONFIG_SMALL
-    if (!ctx[256]) {
+    if (ctx[256] == 2) {
+        const BVCRC *t = ctx + 1;
+        while (((intptr_t) buffer & 7) && buffer < end)
+            crc = ctx[((uint8_t) crc) ^ *buffer++] ^ (crc >> 8);
+
+        while (buffer < end - 7) {
+            uint32_t a = crc ^ bv_le2ne32(*(const uint32_t *) buffer);
+            uint32_t b = bv_le2ne32(*(const uint32_t *) (buffer + 4));
+            buffer += 8;
+            crc = t[7 * 256 + ( a        & 0xFF)] ^
+                  t[6 * 256 + ((a >> 8 ) & 0xFF)] ^
+                  t[5 * 256 + ((a >> 16) & 0xFF)] ^
+                  t[4 * 256 + ((a >> 24)       )] ^
+                  t[3 * 256 + ( b        & 0xFF)] ^
+                  t[2 * 256 + ((b >> 8 ) & 0xFF)] ^
+                  t[1 * 256 + ((b >> 16) & 0xFF)] ^
+                  ctx[         (b >> 24)        ];
+        }
+    } else if (!ctx[256]) {
         while (((intptr_t) buffer & 3) && buffer < end)
             crc = ctx[((uint8_t) crc) ^ *buffer++] ^ (crc >> 8);
 
@@ -378,6 +410,59 @@ uint32_t bv_crc(const BVCRC *ctx, uint32_t crc,
     return crc;
 }
 
+#if BV_CONFIG_SMALL
+#define CRC_DSP_TABLE_SIZE 257
+#else
+#define CRC_DSP_TABLE_SIZE 2049
+#endif
+
+static BVCRC crc32c_table[CRC_DSP_TABLE_SIZE];
+static const BVCRC *crc32_le_table;
+static BBCRCDSPContext crc_dsp;
+static BVOnce crc_dsp_once = BV_ONCE_INIT;
+
+static uint32_t crc32c_c(uint32_t crc, const uint8_t *buffer, size_t length)
+{
+    return bv_crc(crc32c_table, crc, buffer, length);
+}
+
+static uint32_t crc32_le_c(uint32_t crc, const uint8_t *buffer, size_t length)
+{
+    return bv_crc(crc32_le_table, crc, buffer, length);
+}
+
+/* the tables are filled here too, so that the C versions never write */
+static void crc_dsp_init(void)
+{
+    BBCRCDSPContext c = {
+        .crc32c   = crc32c_c,
+        .crc32_le = crc32_le_c,
+    };
+
+    bv_crc_init(crc32c_table, 1, 32, 0x82F63B78, sizeof(crc32c_table));
+    crc32_le_table = bv_crc_get_table(BV_CRC_32_IEEE_LE);
+
+    if (BV_ARCH_AARCH64)
+        bb_crc_dsp_init_aarch64(&c);
+    if (BV_ARCH_X86)
+        bb_crc_dsp_init_x86(&c);
+
+    crc_dsp.crc32_le = c.crc32_le;
+    crc_dsp.crc32c   = c.crc32c;
+}
+
+uint32_t bv_crc32c(uint32_t crc, const uint8_t *buffer, size_t length)
+{
+    bv_thread_once(&crc_dsp_once, crc_dsp_init);
+    return crc_dsp.crc32c(crc, buffer, length);
+}
+
+uint32_t bv_crc32_ieee_le(uint32_t crc, const uint8_t *buffer, size_t length)
+{
+    bv_thread_once(&crc_dsp_once, crc_dsp_init);
+    return crc_dsp.crc32_le(crc, buffer, length);
+}
+
 #ifdef TEST
 int main(void)
 {
@@ -399,6 +484,28 @@ int main(void)
         ctx = bv_crc_get_table(p[i][0]);
         printf("crc %08X = %X\n", p[i][1], bv_crc(ctx, 0, buf, sizeof(buf)));
     }
+
+    for (i = 0; i < 6; i++) {
+        BVCRC small[257], big[2049];
+        int le = p[i][0] == BV_CRC_32_IEEE_LE || p[i][0] == BV_CRC_16_ANSI_LE;
+        int bits = p[i][0] == BV_CRC_8_ATM ? 8 : p[i][0] == BV_CRC_24_IEEE ? 24 :
+                   p[i][0] == BV_CRC_32_IEEE || p[i][0] == BV_CRC_32_IEEE_LE ? 32 : 16;
+        bv_crc_init(small, le, bits, p[i][1], sizeof(small));
+        bv_crc_init(big,   le, bits, p[i][1], sizeof(big));
+        if (bv_crc(small, 0, buf + 3, sizeof(buf) - 3) != bv_crc(big, 0, buf + 3, sizeof(buf) - 3))
+            printf("slicing-by-8 mismatch for %08X\n", p[i][1]);
+    }
+
+    printf("crc32c(\"123456789\") = %08X\n",
+           ~bv_crc32c(~0U, (const uint8_t *)"123456789", 9));
+    ctx = bv_crc_get_table(BV_CRC_32_IEEE_LE);
+    for (i = 0; i < sizeof(buf); i += 37) {
+        if (bv_crc32_ieee_le(~0U, buf + i % 13, sizeof(buf) - i) !=
+            bv_crc(ctx, ~0U, buf + i % 13, sizeof(buf) - i))
+            printf("crc32 mismatch at length %d\n", (int)sizeof(buf) - i);
+        if (bv_crc32c(0, buf, i) != bv_crc32c(bv_crc32c(0, buf, i / 3), buf + i / 3, i - i / 3))
+            printf("crc32c mismatch at length %d\n", i);
+    }
     return 0;
 }
 #endif
@@ -46,7 +46,9 @@ typedef enum {
 
 /**
  * Initialize a CRC table.
- * @param ctx must be an array of size sizeof(BVCRC)*257 or sizeof(BVCRC)*1024
+ * @param ctx must be an array of size sizeof(BVCRC)*257, sizeof(BVCRC)*1024
+ *            or sizeof(BVCRC)*2049; the larger tables let bv_crc() process
+ *            4 respectively 8 bytes per step
  * @param le If 1, the lowest bit represents the coefficient for the highest
  *           exponent of the corresponding polynomial (both for poly and
  *           actual CRC).
@@ -79,6 +81,22 @@ const BVCRC *bv_crc_get_table(BVCRCId crc_id);
 uint32_t bv_crc(const BVCRC *ctx, uint32_t crc,
                 const uint8_t *buffer, size_t length) bv_pure;
 
+/**
+ * Calculate the CRC-32C (Castagnoli, reflected polynomial 0x82F63B78) of a
+ * block, using the SSE4.2 or ARMv8 CRC32 instructions when the CPU has them.
+ * Like bv_crc(), no initial or final inversion is applied.
+ *
+ * The signature matches BVIOContext.update_checksum, so it can be passed
+ * to bv_io_init_checksum() directly.
+ */
+uint32_t bv_crc32c(uint32_t crc, const uint8_t *buffer, size_t length);
+
+/**
+ * Same as bv_crc() with the BV_CRC_32_IEEE_LE table, accelerated with
+ * PCLMULQDQ or the ARMv8 CRC32 instructions when available.
+ */
+uint32_t bv_crc32_ieee_le(uint32_t crc, const uint8_t *buffer, size_t length);
+
 /**
  * @}
  */
@@ -0,0 +1,33 @@
+/*
+ * This file is part of BVBase.
+ *
+ * BVBase is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * BVBase is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BVBase; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef BVUTIL_CRC_INTERNAL_H
+#define BVUTIL_CRC_INTERNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct BBCRCDSPContext {
+    uint32_t (*crc32c)(uint32_t crc, const uint8_t *buffer, size_t length);
+    uint32_t (*crc32_le)(uint32_t crc, const uint8_t *buffer, size_t length);
+} BBCRCDSPContext;
+
+void bb_crc_dsp_init_aarch64(BBCRCDSPContext *c);
+void bb_crc_dsp_init_x86(BBCRCDSPContext *c);
+
+#endif /* BVUTIL_CRC_INTERNAL_H */
@@ -0,0 +1,775 @@
+/*
+ * This file is part of BVBase.
+ *
+ * BVBase is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * BVBase is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BVBase; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include <fcntl.h>
+#if BV_HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if BV_HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#elif BV_HAVE_POLL_H
+#include <poll.h>
+#endif
+#if BV_HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
+
+#include "common.h"
+#include "error.h"
+#include "eventloop.h"
+#include "mem.h"
+#include "time.h"
+#include "timerwheel.h"
+#if BV_HAVE_THREADS
+#include "thread.h"
+#endif
+
+#define MAX_EVENTS 64
+#define TIMER_RESOLUTION 1000   ///< epoll_wait() has millisecond precision
+
+typedef struct EventWatch {
+    int events;
+    BVEventFdCallback cb;
+    void *opaque;
+} EventWatch;
+
+struct BVEventTimer {
+    BVEventTimer *prev, *next;  ///< all timers of the loop
+    BVTimer timer;
+    BVEventLoop *loop;
+    int64_t due;
+    int64_t interval;
+    BVEventTimerCallback cb;
+    void *opaque;
+    int cancelled;
+};
+
+struct BVEventLoop {
+#if BV_HAVE_SYS_EPOLL_H
+    int epfd;
+#elif BV_HAVE_POLL_H
+    struct pollfd *pfds;
+    int nb_pfds;
+#endif
+    int wake_rfd, wake_wfd;
+    EventWatch **watches;       ///< indexed by fd
+    int nb_watches;
+    BVTimerWheel *wheel;
+    BVEventTimer timers;        ///< list head
+    int64_t now;
+    BVEventTimer *running;      ///< timer whose callback runs
+#if BV_HAVE_THREADS
+    BVMutex lock;
+    BVCond job_cond;            ///< signalled when a job ends
+#endif
+    BVEventCall *calls, **calls_tail;
+    BVEventJob *jobs;           ///< begun and not delivered yet
+    int nb_running_jobs;
+    int stop;
+};
+
+static void lock(BVEventLoop *loop)
+{
+#if BV_HAVE_THREADS
+    bv_mutex_lock(&loop->lock);
+#endif
+}
+
+static void unlock(BVEventLoop *loop)
+{
+#if BV_HAVE_THREADS
+    bv_mutex_unlock(&loop->lock);
+#endif
+}
+
+static int wake_open(BVEventLoop *loop)
+{
+#if BV_HAVE_SYS_EVENTFD_H
+    loop->wake_rfd = loop->wake_wfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (loop->wake_rfd < 0)
+        return BVERROR(errno);
+#else
+    int fds[2];
+
+    if (pipe(fds) < 0)
+        return BVERROR(errno);
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    loop->wake_rfd = fds[0];
+    loop->wake_wfd = fds[1];
+#endif
+    return 0;
+}
+
+static void wake_drain(BVEventLoop *loop)
+{
+    uint8_t buf[64];
+    while (read(loop->wake_rfd, buf, sizeof(buf)) > 0)
+        ;
+}
+
+int bv_event_loop_alloc(BVEventLoop **ploop)
+{
+    BVEventLoop *loop;
+    int ret;
+
+    if (!(loop = bv_mallocz(sizeof(*loop))))
+        return BVERROR(ENOMEM);
+    loop->timers.next = loop->timers.prev = &loop->timers;
+    loop->calls_tail  = &loop->calls;
+    loop->wake_rfd    = loop->wake_wfd = -1;
+    if ((ret = bv_timer_wheel_alloc(&loop->wheel, TIMER_RESOLUTION, bv_gettime_relative())) < 0) {
+        bv_free(loop);
+        return ret;
+    }
+#if BV_HAVE_SYS_EPOLL_H
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epfd < 0) {
+        ret = BVERROR(errno);
+        bv_timer_wheel_free(&loop->wheel);
+        bv_free(loop);
+        return ret;
+    }
+#elif !BV_HAVE_POLL_H
+    bv_timer_wheel_free(&loop->wheel);
+    bv_free(loop);
+    return BVERROR(ENOSYS);
+#endif
+#if BV_HAVE_THREADS
+    if ((ret = bv_mutex_init(&loop->lock, NULL))) {
+        ret = BVERROR(ret);
+        goto fail;
+    }
+    if ((ret = bv_cond_init(&loop->job_cond, NULL))) {
+        ret = BVERROR(ret);
+        goto fail;
+    }
+#endif
+    if ((ret = wake_open(loop)) < 0)
+        goto fail;
+#if BV_HAVE_SYS_EPOLL_H
+    {
+        struct epoll_event ev = { .events = EPOLLIN, .data.fd = loop->wake_rfd };
+        if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->wake_rfd, &ev) < 0) {
+            ret = BVERROR(errno);
+            goto fail;
+        }
+    }
+#endif
+    *ploop = loop;
+    return 0;
+
+fail:
+    bv_event_loop_free(&loop);
+    return ret;
+}
+
+void bv_event_loop_free(BVEventLoop **ploop)
+{
+    BVEventLoop *loop = *ploop;
+    BVEventTimer *t;
+    BVEventJob *job;
+    int i;
+
+    if (!loop)
+        return;
+#if BV_HAVE_THREADS
+    if (loop->jobs) {
+        lock(loop);
+        while (loop->nb_running_jobs)
+            bv_cond_wait(&loop->job_cond, &loop->lock);
+        unlock(loop);
+    }
+#endif
+    for (i = 0; i < loop->nb_watches; i++)
+        bv_freep(&loop->watches[i]);
+    bv_freep(&loop->watches);
+    while ((t = loop->timers.next) != &loop->timers) {
+        loop->timers.next = t->next;
+        bv_free(t);
+    }
+    bv_timer_wheel_free(&loop->wheel);
+    while (loop->calls) {
+        BVEventCall *c = loop->calls;
+        loop->calls = c->next;
+        if (c->allocated)
+            bv_free(c);
+    }
+    while ((job = loop->jobs)) {
+        loop->jobs = job->next;
+        job->release(job);
+    }
+    if (loop->wake_wfd >= 0 && loop->wake_wfd != loop->wake_rfd)
+        close(loop->wake_wfd);
+    if (loop->wake_rfd >= 0)
+        close(loop->wake_rfd);
+#if BV_HAVE_SYS_EPOLL_H
+    if (loop->epfd >= 0)
+        close(loop->epfd);
+#elif BV_HAVE_POLL_H
+    bv_freep(&loop->pfds);
+#endif
+#if BV_HAVE_THREADS
+    bv_cond_destroy(&loop->job_cond);
+    bv_mutex_destroy(&loop->lock);
+#endif
+    bv_freep(ploop);
+}
+
+#if BV_HAVE_SYS_EPOLL_H
+static int epoll_update(BVEventLoop *loop, int op, int fd, int events)
+{
+    struct epoll_event ev = { 0 };
+
+    ev.data.fd = fd;
+    if (events & BV_EVENT_READ)
+        ev.events |= EPOLLIN;
+    if (events & BV_EVENT_WRITE)
+        ev.events |= EPOLLOUT;
+    return epoll_ctl(loop->epfd, op, fd, &ev) < 0 ? BVERROR(errno) : 0;
+}
+#endif
+
+int bv_event_loop_add_fd(BVEventLoop *loop, int fd, int events,
+                         BVEventFdCallback cb, void *opaque)
+{
+    EventWatch *w;
+    int ret;
+
+    if (fd < 0 || !cb)
+        return BVERROR(EINVAL);
+    if (fd >= loop->nb_watches) {
+        int nb = BBMAX(fd + 1, 2 * loop->nb_watches);
+        EventWatch **watches = bv_realloc_array(loop->watches, nb, sizeof(*watches));
+        if (!watches)
+            return BVERROR(ENOMEM);
+        memset(watches + loop->nb_watches, 0, (nb - loop->nb_watches) * sizeof(*watches));
+        loop->watches    = watches;
+        loop->nb_watches = nb;
+    }
+    if (loop->watches[fd])
+        return BVERROR(EEXIST);
+    if (!(w = bv_mallocz(sizeof(*w))))
+        return BVERROR(ENOMEM);
+#if BV_HAVE_SYS_EPOLL_H
+    if ((ret = epoll_update(loop, EPOLL_CTL_ADD, fd, events)) < 0) {
+        bv_free(w);
+        return ret;
+    }
+#else
+    ret = 0;
+#endif
+    w->events  = events;
+    w->cb      = cb;
+    w->opaque  = opaque;
+    loop->watches[fd] = w;
+    return ret;
+}
+
+int bv_event_loop_mod_fd(BVEventLoop *loop, int fd, int events)
+{
+    EventWatch *w = fd >= 0 && fd < loop->nb_watches ? loop->watches[fd] : NULL;
+
+    if (!w)
+        return BVERROR(ENOENT);
+    if (w->events == events)
+        return 0;
+#if BV_HAVE_SYS_EPOLL_H
+    {
+        int ret = epoll_update(loop, EPOLL_CTL_MOD, fd, events);
+        if (ret < 0)
+            return ret;
+    }
+#endif
+    w->events = events;
+    return 0;
+}
+
+int bv_event_loop_del_fd(BVEventLoop *loop, int fd)
+{
+    EventWatch *w = fd >= 0 && fd < loop->nb_watches ? loop->watches[fd] : NULL;
+
+    if (!w)
+        return BVERROR(ENOENT);
+#if BV_HAVE_SYS_EPOLL_H
+    epoll_ctl(loop->epfd, EPOLL_CTL_DEL, fd, NULL);
+#endif
+    bv_freep(&loop->watches[fd]);
+    return 0;
+}
+
+static void timer_fire(BVTimer *timer, void *opaque);
+
+BVEventTimer *bv_event_loop_add_timer(BVEventLoop *loop, int64_t timeout, int64_t interval,
+                                      BVEventTimerCallback cb, void *opaque)
+{
+    BVEventTimer *t = bv_mallocz(sizeof(*t));
+
+    if (!t)
+        return NULL;
+    t->loop     = loop;
+    t->due      = bv_gettime_relative() + BBMAX(timeout, 0);
+    t->interval = interval;
+    t->cb       = cb;
+    t->opaque   = opaque;
+    t->prev = &loop->timers;
+    t->next = loop->timers.next;
+    t->next->prev = t;
+    loop->timers.next = t;
+    bv_timer_init(&t->timer, timer_fire, t);
+    bv_timer_wheel_add(loop->wheel, &t->timer, t->due);
+    return t;
+}
+
+static void timer_free(BVEventTimer *t)
+{
+    t->prev->next = t->next;
+    t->next->prev = t->prev;
+    bv_free(t);
+}
+
+void bv_event_loop_del_timer(BVEventLoop *loop, BVEventTimer *t)
+{
+    if (!t)
+        return;
+    if (t == loop->running) {
+        t->cancelled = 1;
+        return;
+    }
+    bv_timer_wheel_cancel(loop->wheel, &t->timer);
+    timer_free(t);
+}
+
+static void timer_fire(BVTimer *timer, void *opaque)
+{
+    BVEventTimer *t = opaque;
+    BVEventLoop *loop = t->loop;
+
+    loop->running = t;
+    t->cb(loop, t, t->opaque);
+    loop->running = NULL;
+    if (t->interval && !t->cancelled) {
+        /* do not try to catch up after a stall */
+        t->due = BBMAX(t->due + t->interval, loop->now);
+        bv_timer_wheel_add(loop->wheel, &t->timer, t->due);
+    } else {
+        timer_free(t);
+    }
+}
+
+static int run_timers(BVEventLoop *loop)
+{
+    loop->now = bv_gettime_relative();
+    return bv_timer_wheel_advance(loop->wheel, loop->now);
+}
+
+static void queue_call(BVEventLoop *loop, BVEventCall *c, BVEventCallback cb, void *opaque)
+{
+    c->next   = NULL;
+    c->cb     = cb;
+    c->opaque = opaque;
+    lock(loop);
+    *loop->calls_tail = c;
+    loop->calls_tail  = &c->next;
+    unlock(loop);
+    bv_event_loop_wakeup(loop);
+}
+
+int bv_event_loop_call(BVEventLoop *loop, BVEventCallback cb, void *opaque)
+{
+    BVEventCall *c = bv_malloc(sizeof(*c));
+
+    if (!c)
+        return BVERROR(ENOMEM);
+    c->allocated = 1;
+    queue_call(loop, c, cb, opaque);
+    return 0;
+}
+
+void bv_event_loop_post(BVEventLoop *loop, BVEventCall *call, BVEventCallback cb, void *opaque)
+{
+    call->allocated = 0;
+    queue_call(loop, call, cb, opaque);
+}
+
+void bv_event_loop_begin_job(BVEventLoop *loop, BVEventJob *job,
+                             void (*release)(BVEventJob *job))
+{
+    job->release = release;
+    lock(loop);
+    job->next  = loop->jobs;
+    loop->jobs = job;
+    loop->nb_running_jobs++;
+    unlock(loop);
+}
+
+static void deliver_job(BVEventLoop *loop, void *opaque)
+{
+    BVEventJob **p, *job = opaque;
+
+    lock(loop);
+    for (p = &loop->jobs; *p; p = &(*p)->next) {
+        if (*p == job) {
+            *p = job->next;
+            break;
+        }
+    }
+    unlock(loop);
+    job->cb(loop, job->opaque);
+}
+
+void bv_event_loop_end_job(BVEventLoop *loop, BVEventJob *job, BVEventCallback cb, void *opaque)
+{
+    job->cb     = cb;
+    job->opaque = opaque;
+    job->call.next      = NULL;
+    job->call.cb        = deliver_job;
+    job->call.opaque    = job;
+    job->call.allocated = 0;
+    /* all under the lock: once it is released the loop may be gone */
+    lock(loop);
+    *loop->calls_tail = &job->call;
+    loop->calls_tail  = &job->call.next;
+    loop->nb_running_jobs--;
+    bv_event_loop_wakeup(loop);
+#if BV_HAVE_THREADS
+    bv_cond_broadcast(&loop->job_cond);
+#endif
+    unlock(loop);
+}
+
+static int run_calls(BVEventLoop *loop)
+{
+    BVEventCall *c, *next;
+    int n = 0, allocated;
+
+    lock(loop);
+    c = loop->calls;
+    loop->calls      = NULL;
+    loop->calls_tail = &loop->calls;
+    unlock(loop);
+    for (; c; c = next, n++) {
+        next      = c->next;
+        allocated = c->allocated;
+        c->cb(loop, c->opaque);
+        if (allocated)
+            bv_free(c);
+    }
+    return n;
+}
+
+void bv_event_loop_wakeup(BVEventLoop *loop)
+{
+#if BV_HAVE_SYS_EVENTFD_H
+    uint64_t one = 1;
+    if (write(loop->wake_wfd, &one, sizeof(one)) < 0)
+        return;
+#else
+    if (write(loop->wake_wfd, "", 1) < 0)
+        return;
+#endif
+}
+
+static int dispatch_fd(BVEventLoop *loop, int fd, int events)
+{
+    EventWatch *w = fd < loop->nb_watches ? loop->watches[fd] : NULL;
+
+    /* removed by an earlier callback of this round */
+    if (!w)
+        return 0;
+    if (events & BV_EVENT_ERROR)
+        events |= w->events;
+    events &= w->events | BV_EVENT_ERROR;
+    if (!events)
+        return 0;
+    w->cb(loop, fd, events, w->opaque);
+    return 1;
+}
+
+int bv_event_loop_run_once(BVEventLoop *loop, int64_t timeout)
+{
+    int64_t wait = timeout;
+    int i, nfds, n = 0, ms;
+
+    if (loop->timers.next != &loop->timers) {
+        int64_t due = bv_timer_wheel_timeout(loop->wheel, bv_gettime_relative());
+        if (due >= 0)
+            wait = wait < 0 ? due : BBMIN(wait, due);
+    }
+    lock(loop);
+    if (loop->calls || loop->stop)
+        wait = 0;
+    unlock(loop);
+    /* round up, waking early only costs another round */
+    ms = wait < 0 ? -1 : (int)BBMIN((wait + 999) / 1000, INT_MAX);
+
+#if BV_HAVE_SYS_EPOLL_H
+    {
+        struct epoll_event ev[MAX_EVENTS];
+
+        nfds = epoll_wait(loop->epfd, ev, MAX_EVENTS, ms);
+        if (nfds < 0 && errno != EINTR)
+            return BVERROR(errno);
+        for (i = 0; i < nfds; i++) {
+            int fd = ev[i].data.fd, events = 0;
+            if (fd == loop->wake_rfd) {
+                wake_drain(loop);
+                continue;
+            }
+            if (ev[i].events & EPOLLIN)
+                events |= BV_EVENT_READ;
+            if (ev[i].events & EPOLLOUT)
+                events |= BV_EVENT_WRITE;
+            if (ev[i].events & (EPOLLERR | EPOLLHUP))
+                events |= BV_EVENT_ERROR;
+            n += dispatch_fd(loop, fd, events);
+        }
+    }
+#elif BV_HAVE_POLL_H
+    {
+        int count = 1;
+
+        for (i = 0; i < loop->nb_watches; i++)
+            count += !!loop->watches[i];
+        if (count > loop->nb_pfds) {
+            struct pollfd *pfds = bv_realloc_array(loop->pfds, count, sizeof(*pfds));
+            if (!pfds)
+                return BVERROR(ENOMEM);
+            loop->pfds    = pfds;
+            loop->nb_pfds = count;
+        }
+        loop->pfds[0].fd     = loop->wake_rfd;
+        loop->pfds[0].events = POLLIN;
+        for (i = 0, count = 1; i < loop->nb_watches; i++) {
+            EventWatch *w = loop->watches[i];
+            if (!w)
+                continue;
+            loop->pfds[count].fd     = i;
+            loop->pfds[count].events = (w->events & BV_EVENT_READ  ? POLLIN  : 0) |
+                                       (w->events & BV_EVENT_WRITE ? POLLOUT : 0);
+            count++;
+        }
+        nfds = poll(loop->pfds, count, ms);
+        if (nfds < 0 && errno != EINTR)
+            return BVERROR(errno);
+        if (nfds > 0 && loop->pfds[0].revents)
+            wake_drain(loop);
+        for (i = 1; nfds > 0 && i < count; i++) {
+            int re = loop->pfds[i].revents, events = 0;
+            if (!re)
+                continue;
+            if (re & POLLIN)
+                events |= BV_EVENT_READ;
+            if (re & POLLOUT)
+                events |= BV_EVENT_WRITE;
+            if (re & (POLLERR | POLLHUP | POLLNVAL))
+                events |= BV_EVENT_ERROR;
+            n += dispatch_fd(loop, loop->pfds[i].fd, events);
+        }
+    }
+#endif
+    n += run_timers(loop);
+    n += run_calls(loop);
+    return n;
+}
+
+int bv_event_loop_run(BVEventLoop *loop)
+{
+    int ret, stop;
+
+    for (;;) {
+        if ((ret = bv_event_loop_run_once(loop, -1)) < 0)
+            return ret;
+        lock(loop);
+        stop = loop->stop;
+        loop->stop = 0;
+        unlock(loop);
+        if (stop)
+            return 0;
+    }
+}
+
+void bv_event_loop_stop(BVEventLoop *loop)
+{
+    lock(loop);
+    loop->stop = 1;
+    unlock(loop);
+    bv_event_loop_wakeup(loop);
+}
+
+#ifdef TEST
+#include <stdio.h>
+
+#include "log.h"
+
+static int order[8], nb_order;
+
+static void timer_cb(BVEventLoop *loop, BVEventTimer *t, void *opaque)
+{
+    order[nb_order++] = (intptr_t)opaque;
+}
+
+static int ticks;
+static void tick_cb(BVEventLoop *loop, BVEventTimer *t, void *opaque)
+{
+    if (++ticks == 3)
+        bv_event_loop_del_timer(loop, t);
+}
+
+static int readable;
+static void fd_cb(BVEventLoop *loop, int fd, int events, void *opaque)
+{
+    char c;
+    if ((events & BV_EVENT_READ) && read(fd, &c, 1) == 1)
+        readable++;
+}
+
+static void stop_cb(BVEventLoop *loop, void *opaque)
+{
+    *(int *)opaque = 1;
+    bv_event_loop_stop(loop);
+}
+
+#if BV_HAVE_THREADS
+static int jobs_delivered, jobs_released;
+
+static void job_done(BVEventLoop *loop, void *opaque)
+{
+    jobs_delivered++;
+}
+
+static void job_release(BVEventJob *job)
+{
+    jobs_released++;
+}
+
+static BVEventLoop *job_loop;
+
+/* ends at once, or after the loop is asked to be freed */
+static void *job_task(void *arg)
+{
+    BVEventJob *job = arg;
+
+    if (job->opaque)
+        bv_usleep(100000);
+    bv_event_loop_end_job(job_loop, job, job_done, NULL);
+    return NULL;
+}
+
+static void *poster(void *arg)
+{
+    static int called;
+    bv_usleep(20000);
+    bv_event_loop_call(arg, stop_cb, &called);
+    return NULL;
+}
+#endif
+
+int main(void)
+{
+    BVEventLoop *loop;
+    BVEventTimer *t;
+    int fds[2], ret = 0, i, called = 0;
+    int64_t start;
+
+    if (bv_event_loop_alloc(&loop) < 0 || pipe(fds) < 0)
+        return 1;
+
+    /* timers fire in due order, a cancelled one never */
+    bv_event_loop_add_timer(loop, 3000, 0, timer_cb, (void *)3);
+    bv_event_loop_add_timer(loop, 1000, 0, timer_cb, (void *)1);
+    t = bv_event_loop_add_timer(loop, 2000, 0, timer_cb, (void *)9);
+    bv_event_loop_add_timer(loop, 2000, 0, timer_cb, (void *)2);
+    bv_event_loop_del_timer(loop, t);
+    bv_event_loop_add_timer(loop, 1000, 1000, tick_cb, NULL);
+    start = bv_gettime_relative();
+    while (bv_gettime_relative() - start < 10000)
+        bv_event_loop_run_once(loop, 1000);
+    if (nb_order != 3 || order[0] != 1 || order[1] != 2 || order[2] != 3) {
+        bv_log(NULL, BV_LOG_ERROR, "timer order wrong\n");
+        ret = 1;
+    }
+    if (ticks != 3) {
+        bv_log(NULL, BV_LOG_ERROR, "repeating timer ran %d times\n", ticks);
+        ret = 1;
+    }
+
+    /* fd readiness */
+    bv_event_loop_add_fd(loop, fds[0], BV_EVENT_READ, fd_cb, NULL);
+    for (i = 0; i < 5; i++) {
+        if (write(fds[1], "x", 1) != 1)
+            return 1;
+        bv_event_loop_run_once(loop, 100000);
+    }
+    bv_event_loop_del_fd(loop, fds[0]);
+    if (write(fds[1], "x", 1) != 1)
+        return 1;
+    bv_event_loop_run_once(loop, 1000);
+    if (readable != 5) {
+        bv_log(NULL, BV_LOG_ERROR, "fd became readable %d times\n", readable);
+        ret = 1;
+    }
+
+    /* stop from a call posted by another thread */
+#if BV_HAVE_THREADS
+    {
+        pthread_t thread;
+        pthread_create(&thread, NULL, poster, loop);
+        bv_event_loop_run(loop);
+        pthread_join(thread, NULL);
+    }
+#else
+    bv_event_loop_call(loop, stop_cb, &called);
+    bv_event_loop_run(loop);
+#endif
+    (void)called;
+
+    /* a job that ended is delivered, one still running is waited for */
+#if BV_HAVE_THREADS
+    {
+        static BVEventJob jobs[2];
+        pthread_t threads[2];
+        job_loop = loop;
+        for (i = 0; i < 2; i++) {
+            jobs[i].opaque = (void *)(intptr_t)i;
+            bv_event_loop_begin_job(loop, &jobs[i], job_release);
+            pthread_create(&threads[i], NULL, job_task, &jobs[i]);
+        }
+        start = bv_gettime_relative();
+        while (!jobs_delivered && bv_gettime_relative() - start < 1000000)
+            bv_event_loop_run_once(loop, 10000);
+        bv_event_loop_free(&loop);
+        for (i = 0; i < 2; i++)
+            pthread_join(threads[i], NULL);
+        if (jobs_delivered != 1 || jobs_released != 1) {
+            bv_log(NULL, BV_LOG_ERROR, "%d jobs delivered, %d released\n", jobs_delivered, jobs_released);
+            ret = 1;
+        }
+    }
+#endif
+
+    bv_event_loop_free(&loop);
+    close(fds[0]);
+    close(fds[1]);
+    if (!ret)
+        printf("ok\n");
+    return ret;
+}
+#endif
@@ -0,0 +1,169 @@
+/*
+ * This file is part of BVBase.
+ *
+ * BVBase is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * BVBase is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BVBase; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef BVUTIL_EVENTLOOP_H
+#define BVUTIL_EVENTLOOP_H
+
+#include <stdint.h>
+
+/**
+ * @defgroup lavu_eventloop Event loop
+ * @ingroup lavu_misc
+ * Single threaded dispatch of file descriptor readiness, timers and calls
+ * posted from other threads. Uses epoll where available, poll() otherwise.
+ *
+ * Watches and timers are added, changed and removed from the thread that
+ * runs the loop, normally from inside callbacks. bv_event_loop_call(),
+ * bv_event_loop_post(), bv_event_loop_wakeup() and bv_event_loop_stop()
+ * may be called from any thread.
+ * @{
+ */
+
+#define BV_EVENT_READ   0x1
+#define BV_EVENT_WRITE  0x2
+#define BV_EVENT_ERROR  0x4     ///< error or hangup, always reported
+
+typedef struct BVEventLoop BVEventLoop;
+typedef struct BVEventTimer BVEventTimer;
+
+typedef void (*BVEventFdCallback)(BVEventLoop *loop, int fd, int events, void *opaque);
+typedef void (*BVEventTimerCallback)(BVEventLoop *loop, BVEventTimer *timer, void *opaque);
+typedef void (*BVEventCallback)(BVEventLoop *loop, void *opaque);
+
+/**
+ * Storage of a queued call, see bv_event_loop_post(). The fields are
+ * private to the loop.
+ */
+typedef struct BVEventCall {
+    struct BVEventCall *next;
+    BVEventCallback cb;
+    void *opaque;
+    int allocated;
+} BVEventCall;
+
+/**
+ * Work another thread does for the loop, see bv_event_loop_begin_job().
+ * The fields are private to the loop.
+ */
+typedef struct BVEventJob {
+    struct BVEventJob *next;
+    BVEventCall call;
+    BVEventCallback cb;
+    void *opaque;
+    void (*release)(struct BVEventJob *job);
+} BVEventJob;
+
+/**
+ * Allocate an event loop.
+ * @return 0 on success, a negative BVERROR code otherwise
+ */
+int bv_event_loop_alloc(BVEventLoop **loop);
+
+/**
+ * Free an event loop and everything still registered on it, without
+ * calling any callback. Jobs still running are waited for, then every job
+ * whose completion was not delivered is released.
+ * *loop is set to NULL.
+ */
+void bv_event_loop_free(BVEventLoop **loop);
+
+/**
+ * Watch fd for the BV_EVENT_* conditions in events. A fd has at most one
+ * watch, cb receives the conditions that are met.
+ */
+int bv_event_loop_add_fd(BVEventLoop *loop, int fd, int events,
+                         BVEventFdCallback cb, void *opaque);
+
+/**
+ * Change the conditions watched on fd.
+ */
+int bv_event_loop_mod_fd(BVEventLoop *loop, int fd, int events);
+
+/**
+ * Stop watching fd. Safe from inside any callback.
+ */
+int bv_event_loop_del_fd(BVEventLoop *loop, int fd);
+
+/**
+ * Call cb after timeout microseconds, then every interval microseconds if
+ * interval is not 0.
+ * @return the timer, NULL on allocation failure
+ */
+BVEventTimer *bv_event_loop_add_timer(BVEventLoop *loop, int64_t timeout, int64_t interval,
+                                      BVEventTimerCallback cb, void *opaque);
+
+/**
+ * Cancel and free a timer. Safe from inside any callback, including the
+ * timer's own.
+ */
+void bv_event_loop_del_timer(BVEventLoop *loop, BVEventTimer *timer);
+
+/**
+ * Run cb on the loop thread at the next iteration. Thread safe.
+ */
+int bv_event_loop_call(BVEventLoop *loop, BVEventCallback cb, void *opaque);
+
+/**
+ * Like bv_event_loop_call(), for callers which cannot handle a failure:
+ * call is provided by the caller and must stay valid until cb runs, cb may
+ * free it. Thread safe.
+ */
+void bv_event_loop_post(BVEventLoop *loop, BVEventCall *call, BVEventCallback cb, void *opaque);
+
+/**
+ * Register work that another thread does on behalf of the loop and ends
+ * with bv_event_loop_end_job(). Should the loop be freed first, release is
+ * called for the job on the freeing thread instead of its completion.
+ * Thread safe.
+ */
+void bv_event_loop_begin_job(BVEventLoop *loop, BVEventJob *job,
+                             void (*release)(BVEventJob *job));
+
+/**
+ * End a job from its thread and have cb run on the loop. The job must not
+ * be touched afterwards. Thread safe.
+ */
+void bv_event_loop_end_job(BVEventLoop *loop, BVEventJob *job, BVEventCallback cb, void *opaque);
+
+/**
+ * Make a blocked bv_event_loop_run_once() return. Thread safe.
+ */
+void bv_event_loop_wakeup(BVEventLoop *loop);
+
+/**
+ * Wait for at most timeout microseconds (-1 for no limit) and dispatch
+ * whatever became due.
+ * @return number of callbacks run, a negative BVERROR code on failure
+ */
+int bv_event_loop_run_once(BVEventLoop *loop, int64_t timeout);
+
+/**
+ * Dispatch until bv_event_loop_stop() is called.
+ */
+int bv_event_loop_run(BVEventLoop *loop);
+
+/**
+ * Make bv_event_loop_run() return after the current iteration. Thread safe.
+ */
+void bv_event_loop_stop(BVEventLoop *loop);
+
+/**
+ * @}
+ */
+
+#endif /* BVUTIL_EVENTLOOP_H */
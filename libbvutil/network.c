@@ -18,9 +18,16 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#define _DEFAULT_SOURCE     /* SO_REUSEPORT with recent glibc */
+#define _BSD_SOURCE
+
 #include <fcntl.h>
 #include "network.h"
+#if BV_HAVE_LINUX_FILTER_H
+#include <linux/filter.h>
+#endif
 #include "libbvutil/bvutil.h"
+#include "libbvutil/cancel.h"
 #include "libbvutil/mem.h"
 #include "libbvutil/time.h"
 
@@ -37,7 +44,8 @@
 #if BV_CONFIG_OPENSSL
 #include <openssl/ssl.h>
 static int openssl_init;
-#if BV_HAVE_THREADS
+/* OpenSSL 1.1.0 and later lock on their own */
+#if BV_HAVE_THREADS && OPENSSL_VERSION_NUMBER < 0x10100000L
 #include <openssl/crypto.h>
 pthread_mutex_t *openssl_mutexes;
 static void openssl_lock(int mode, int type, const char *file, int line)
@@ -70,7 +78,7 @@ static int bb_tls_init(void)
     if (!openssl_init) {
         SSL_library_init();
         SSL_load_error_strings();
-#if BV_HAVE_THREADS
+#if BV_HAVE_THREADS && OPENSSL_VERSION_NUMBER < 0x10100000L
         if (!CRYPTO_get_locking_callback()) {
             int i;
             openssl_mutexes = bv_malloc_array(sizeof(pthread_mutex_t), CRYPTO_num_locks());
@@ -100,7 +108,7 @@ static void bb_tls_deinit(void)
 #if BV_CONFIG_OPENSSL
     openssl_init--;
     if (!openssl_init) {
-#if BV_HAVE_THREADS
+#if BV_HAVE_THREADS && OPENSSL_VERSION_NUMBER < 0x10100000L
         if (CRYPTO_get_locking_callback() == openssl_lock) {
             int i;
             CRYPTO_set_locking_callback(NULL);
@@ -185,26 +193,6 @@ int bv_network_wait_fd(int fd, int write)
     return ret < 0 ? bv_neterrno() : p.revents & (ev | POLLERR | POLLHUP) ? 0 : BVERROR(EAGAIN);
 }
 
-int bv_network_wait_fd_timeout(int fd, int write, int64_t timeout, BVIOInterruptCB *int_cb)
-{
-    int ret;
-    int64_t wait_start = 0;
-
-    while (1) {
-        if (bv_check_interrupt(int_cb))
-            return BVERROR_EXIT;
-        ret = bv_network_wait_fd(fd, write);
-        if (ret != BVERROR(EAGAIN))
-            return ret;
-        if (timeout > 0) {
-            if (!wait_start)
-                wait_start = bv_gettime_relative();
-            else if (bv_gettime_relative() - wait_start > timeout)
-                return BVERROR(ETIMEDOUT);
-        }
-    }
-}
-
 #if BV_HAVE_WINSOCK2_H
 int bv_neterrno(void)
 {
@@ -241,25 +229,57 @@ int bv_is_multicast_address(struct sockaddr *addr)
     return 0;
 }
 
-static int bv_poll_interrupt(struct pollfd *p, nfds_t nfds, int timeout,
+/**
+ * Poll one descriptor, also waking up when the cancel token of cb fires.
+ * The interrupt callback, if any, is still checked every POLLING_TIME.
+ *
+ * @param timeout in milliseconds, <= 0 to wait forever
+ */
+static int bv_poll_interrupt(struct pollfd *p, int timeout,
                              BVIOInterruptCB *cb)
 {
-    int runs = timeout / POLLING_TIME;
-    int ret = 0;
+    struct pollfd pfds[2] = { *p, { -1, POLLIN, 0 } };
+    int64_t deadline = timeout > 0 ? bv_gettime_relative() + timeout * 1000LL : 0;
+    int slice = cb && cb->callback ? POLLING_TIME : -1;
+    int ret;
+
+    if (cb && cb->token)
+        pfds[1].fd = bv_cancel_token_get_fd(cb->token);
+    for (;;) {
+        int wait = slice;
 
-    do {
         if (bv_check_interrupt(cb))
             return BVERROR_EXIT;
-        ret = poll(p, nfds, POLLING_TIME);
-        if (ret != 0)
-            break;
-    } while (timeout <= 0 || runs-- > 0);
+        if (deadline) {
+            int64_t left = deadline - bv_gettime_relative();
+            if (left <= 0)
+                return BVERROR(ETIMEDOUT);
+            left = (left + 999) / 1000;
+            wait = wait < 0 ? (int)BBMIN(left, INT_MAX) : BBMIN(wait, left);
+        }
+        ret = poll(pfds, 2, wait);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return BVERROR(errno);
+        }
+        if (pfds[1].revents)
+            return BVERROR_EXIT;
+        if (ret > 0) {
+            p->revents = pfds[0].revents;
+            return ret;
+        }
+    }
+}
 
-    if (!ret)
-        return BVERROR(ETIMEDOUT);
-    if (ret < 0)
-        return BVERROR(errno);
-    return ret;
+int bv_network_wait_fd_timeout(int fd, int write, int64_t timeout, BVIOInterruptCB *int_cb)
+{
+    struct pollfd p = { .fd = fd, .events = write ? POLLOUT : POLLIN, .revents = 0 };
+    int ret;
+
+    /* round up, 0 would mean no timeout */
+    ret = bv_poll_interrupt(&p, timeout > 0 ? (int)BBMIN((timeout + 999) / 1000, INT_MAX) : 0, int_cb);
+    return ret < 0 ? ret : 0;
 }
 
 int bv_socket(int af, int type, int proto)
@@ -299,7 +319,7 @@ int bv_listen_bind(int fd, const struct sockaddr *addr,
     if (ret)
         return bv_neterrno();
 
-    ret = bv_poll_interrupt(&lp, 1, timeout, cb);
+    ret = bv_poll_interrupt(&lp, timeout, cb);
     if (ret < 0)
         return ret;
 
@@ -339,7 +359,7 @@ int bv_listen_connect(int fd, const struct sockaddr *addr,
             continue;
         case BVERROR(EINPROGRESS):
         case BVERROR(EAGAIN):
-            ret = bv_poll_interrupt(&p, 1, timeout, cb);
+            ret = bv_poll_interrupt(&p, timeout, cb);
             if (ret < 0)
                 return ret;
             optlen = sizeof(ret);
@@ -364,6 +384,242 @@ int bv_listen_connect(int fd, const struct sockaddr *addr,
     return ret;
 }
 
+#define NEXT_ATTEMPT_DELAY_MS 250
+#define MAX_PARALLEL 8
+
+typedef struct ConnectionAttempt {
+    int fd;
+    int64_t deadline_us;
+} ConnectionAttempt;
+
+/* Reorder the list to alternate address families, the first one first. */
+static void interleave_addrinfo(struct addrinfo *base)
+{
+    struct addrinfo **next = &base->ai_next;
+
+    while (*next) {
+        struct addrinfo *cur = *next;
+
+        /* look for the next entry of another family */
+        if (cur->ai_family == base->ai_family) {
+            next = &cur->ai_next;
+            continue;
+        }
+        if (cur == base->ai_next) {
+            base = cur;
+            next = &base->ai_next;
+            continue;
+        }
+        /* move cur right after base; everything between them has the
+         * family of base, so next stays valid and the new base is the
+         * entry after cur */
+        *next         = cur->ai_next;
+        cur->ai_next  = base->ai_next;
+        base->ai_next = cur;
+        base          = cur->ai_next;
+    }
+}
+
+static int start_connect_attempt(ConnectionAttempt *attempt,
+                                 struct addrinfo **ptr, int timeout_ms)
+{
+    struct addrinfo *ai = *ptr;
+    int ret;
+
+    *ptr = ai->ai_next;
+
+    attempt->fd = bv_socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (attempt->fd < 0)
+        return bv_neterrno();
+    attempt->deadline_us = timeout_ms > 0 ? bv_gettime_relative() + timeout_ms * 1000LL
+                                          : INT64_MAX;
+    if (bv_socket_nonblock(attempt->fd, 1) < 0)
+        bv_log(NULL, BV_LOG_DEBUG, "bv_socket_nonblock failed\n");
+    while ((ret = connect(attempt->fd, ai->ai_addr, ai->ai_addrlen))) {
+        ret = bv_neterrno();
+        switch (ret) {
+        case BVERROR(EINTR):
+            continue;
+        case BVERROR(EINPROGRESS):
+        case BVERROR(EAGAIN):
+            return 0;
+        default:
+            closesocket(attempt->fd);
+            attempt->fd = -1;
+            return ret;
+        }
+    }
+    return 1;
+}
+
+int bv_connect_parallel(struct addrinfo *addrs, int timeout_ms_per_address,
+                        int parallel, BVIOInterruptCB *cb, int *fd)
+{
+    ConnectionAttempt attempts[MAX_PARALLEL];
+    struct pollfd pfd[MAX_PARALLEL + 1];
+    int nb_attempts = 0, i, j;
+    int64_t next_attempt_us = bv_gettime_relative(), next_deadline_us;
+    int last_err = BVERROR(EIO);
+    socklen_t optlen;
+    char errbuf[100];
+
+    parallel = BBMAX(1, BBMIN(parallel, MAX_PARALLEL));
+    *fd = -1;
+    if (!addrs)
+        return BVERROR(EINVAL);
+    interleave_addrinfo(addrs);
+
+    while (nb_attempts > 0 || addrs) {
+        int64_t left;
+        int wait, ret;
+
+        /* start a new attempt after the stagger delay, or at once if all
+         * pending ones failed */
+        if (nb_attempts < parallel && addrs &&
+            (!nb_attempts || bv_gettime_relative() >= next_attempt_us)) {
+            ret = start_connect_attempt(&attempts[nb_attempts], &addrs,
+                                        timeout_ms_per_address);
+            if (ret < 0) {
+                bv_strerror(ret, errbuf, sizeof(errbuf));
+                bv_log(NULL, BV_LOG_VERBOSE, "Connection attempt failed: %s\n", errbuf);
+                last_err = ret;
+                continue;
+            }
+            if (ret > 0) {
+                /* connected at once */
+                *fd = attempts[nb_attempts].fd;
+                goto done;
+            }
+            nb_attempts++;
+            next_attempt_us = bv_gettime_relative() + NEXT_ATTEMPT_DELAY_MS * 1000;
+            continue;
+        }
+
+        next_deadline_us = attempts[0].deadline_us;
+        for (i = 0; i < nb_attempts; i++) {
+            pfd[i].fd      = attempts[i].fd;
+            pfd[i].events  = POLLOUT;
+            pfd[i].revents = 0;
+            next_deadline_us = BBMIN(next_deadline_us, attempts[i].deadline_us);
+        }
+        pfd[nb_attempts].fd      = cb && cb->token ? bv_cancel_token_get_fd(cb->token) : -1;
+        pfd[nb_attempts].events  = POLLIN;
+        pfd[nb_attempts].revents = 0;
+        if (nb_attempts < parallel && addrs)
+            next_deadline_us = BBMIN(next_deadline_us, next_attempt_us);
+        left = next_deadline_us - bv_gettime_relative();
+        wait = left <= 0 ? 0 : (int)BBMIN(left / 1000 + 1, INT_MAX);
+        if (cb && cb->callback)
+            wait = BBMIN(wait, POLLING_TIME);
+
+        if (bv_check_interrupt(cb)) {
+            last_err = BVERROR_EXIT;
+            break;
+        }
+        ret = poll(pfd, nb_attempts + 1, wait);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            last_err = BVERROR(errno);
+            break;
+        }
+        if (pfd[nb_attempts].revents) {
+            last_err = BVERROR_EXIT;
+            break;
+        }
+
+        for (i = 0, j = 0; i < nb_attempts; i++) {
+            int err = 0;
+
+            if (pfd[i].revents) {
+                optlen = sizeof(err);
+                if (getsockopt(attempts[i].fd, SOL_SOCKET, SO_ERROR, &err, &optlen))
+                    err = AVUNERROR(bv_neterrno());
+                if (!err) {
+                    *fd = attempts[i].fd;
+                    while (++i < nb_attempts)
+                        attempts[j++] = attempts[i];
+                    nb_attempts = j;
+                    goto done;
+                }
+                err = BVERROR(err);
+            } else if (bv_gettime_relative() >= attempts[i].deadline_us) {
+                err = BVERROR(ETIMEDOUT);
+            }
+            if (err) {
+                bv_strerror(err, errbuf, sizeof(errbuf));
+                bv_log(NULL, addrs || nb_attempts > 1 ? BV_LOG_VERBOSE : BV_LOG_ERROR,
+                       "Connection attempt failed: %s\n", errbuf);
+                closesocket(attempts[i].fd);
+                last_err = err;
+                /* the next address need not wait for the stagger delay */
+                next_attempt_us = 0;
+                continue;
+            }
+            attempts[j++] = attempts[i];
+        }
+        nb_attempts = j;
+    }
+
+done:
+    for (i = 0; i < nb_attempts; i++)
+        closesocket(attempts[i].fd);
+    return *fd >= 0 ? 0 : last_err;
+}
+
+int bv_listen_reuseport(const struct addrinfo *ai, int n, int *fds, int steer_cpu)
+{
+#ifdef SO_REUSEPORT
+    int i, ret, one = 1;
+
+    if (n <= 0)
+        return BVERROR(EINVAL);
+    for (i = 0; i < n; i++) {
+        fds[i] = bv_socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fds[i] < 0) {
+            ret = bv_neterrno();
+            goto fail;
+        }
+        if (setsockopt(fds[i], SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) ||
+            setsockopt(fds[i], SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) ||
+            bind(fds[i], ai->ai_addr, ai->ai_addrlen) ||
+            (ai->ai_socktype == SOCK_STREAM && listen(fds[i], SOMAXCONN))) {
+            ret = bv_neterrno();
+            closesocket(fds[i]);
+            goto fail;
+        }
+        if (bv_socket_nonblock(fds[i], 1) < 0)
+            bv_log(NULL, BV_LOG_DEBUG, "bv_socket_nonblock failed\n");
+    }
+
+    if (steer_cpu) {
+#if BV_HAVE_LINUX_FILTER_H && defined(SO_ATTACH_REUSEPORT_CBPF)
+        /* socket index = CPU the packet is processed on, modulo n */
+        struct sock_filter code[] = {
+            { BPF_LD  | BPF_W | BPF_ABS, 0, 0, SKF_AD_OFF + SKF_AD_CPU },
+            { BPF_ALU | BPF_MOD | BPF_K, 0, 0, n },
+            { BPF_RET | BPF_A,           0, 0, 0 },
+        };
+        struct sock_fprog prog = { BV_ARRAY_ELEMS(code), code };
+
+        /* the program applies to the whole group */
+        if (setsockopt(fds[0], SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)))
+            bv_log(NULL, BV_LOG_WARNING, "setsockopt(SO_ATTACH_REUSEPORT_CBPF) failed\n");
+#else
+        bv_log(NULL, BV_LOG_WARNING, "CPU steering of SO_REUSEPORT sockets is not supported\n");
+#endif
+    }
+    return 0;
+
+fail:
+    while (i-- > 0)
+        closesocket(fds[i]);
+    return ret;
+#else
+    return BVERROR(ENOSYS);
+#endif
+}
+
 static int match_host_pattern(const char *pattern, const char *hostname)
 {
     int len_p, len_h;
@@ -417,3 +673,123 @@ int bv_http_match_no_proxy(const char *no_proxy, const char *hostname)
     bv_free(buf);
     return ret;
 }
+
+#ifdef TEST
+#include <stdio.h>
+
+#include "log.h"
+
+#define NB_FILLERS 4
+
+/* a loopback socket on a free port, listening if backlog >= 0 */
+static int test_socket(int backlog, struct sockaddr_in *addr)
+{
+    socklen_t len = sizeof(*addr);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family      = AF_INET;
+    addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || bind(fd, (struct sockaddr *)addr, sizeof(*addr)) ||
+        (backlog >= 0 && listen(fd, backlog)) ||
+        getsockname(fd, (struct sockaddr *)addr, &len)) {
+        if (fd >= 0)
+            closesocket(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Connect to first or second.
+ * @return the port of the peer, or a negative error code
+ */
+static int test_connect(struct sockaddr_in *first, struct sockaddr_in *second,
+                        int timeout_ms, int parallel, int64_t *elapsed)
+{
+    struct addrinfo ai[2];
+    struct sockaddr_in peer;
+    socklen_t len = sizeof(peer);
+    int64_t t;
+    int i, fd, ret;
+
+    memset(ai, 0, sizeof(ai));
+    for (i = 0; i < 2; i++) {
+        ai[i].ai_family   = AF_INET;
+        ai[i].ai_socktype = SOCK_STREAM;
+        ai[i].ai_addrlen  = sizeof(*first);
+        ai[i].ai_addr     = (struct sockaddr *)(i ? second : first);
+    }
+    ai[0].ai_next = &ai[1];
+    t = bv_gettime_relative();
+    ret = bv_connect_parallel(ai, timeout_ms, parallel, NULL, &fd);
+    *elapsed = bv_gettime_relative() - t;
+    if (ret < 0)
+        return ret;
+    ret = getpeername(fd, (struct sockaddr *)&peer, &len) ? bv_neterrno() : ntohs(peer.sin_port);
+    closesocket(fd);
+    return ret;
+}
+
+int main(void)
+{
+    struct sockaddr_in working, refused, blackhole;
+    int fillers[NB_FILLERS];
+    int working_fd, refused_fd, blackhole_fd, i, ret, errors = 0;
+    int64_t elapsed;
+
+    bv_network_init();
+    working_fd   = test_socket(16, &working);
+    /* bound but not listening: refused at once */
+    refused_fd   = test_socket(-1, &refused);
+    /* a listener with a full accept queue drops the SYNs */
+    blackhole_fd = test_socket(0, &blackhole);
+    if (working_fd < 0 || refused_fd < 0 || blackhole_fd < 0) {
+        bv_log(NULL, BV_LOG_ERROR, "cannot create the test sockets\n");
+        return 1;
+    }
+    for (i = 0; i < NB_FILLERS; i++) {
+        fillers[i] = socket(AF_INET, SOCK_STREAM, 0);
+        bv_socket_nonblock(fillers[i], 1);
+        connect(fillers[i], (struct sockaddr *)&blackhole, sizeof(blackhole));
+    }
+    bv_usleep(50000);
+
+    /* a refused attempt hands over without the stagger delay */
+    ret = test_connect(&refused, &working, 5000, 2, &elapsed);
+    if (ret != ntohs(working.sin_port) || elapsed >= NEXT_ATTEMPT_DELAY_MS * 1000) {
+        bv_log(NULL, BV_LOG_ERROR, "refused first: %d after %"PRId64"us\n", ret, elapsed);
+        errors++;
+    }
+
+    /* a silent one keeps going while the next starts after the delay */
+    ret = test_connect(&blackhole, &working, 5000, 2, &elapsed);
+    if (ret != ntohs(working.sin_port) || elapsed < NEXT_ATTEMPT_DELAY_MS * 1000 ||
+        elapsed >= 4 * NEXT_ATTEMPT_DELAY_MS * 1000) {
+        bv_log(NULL, BV_LOG_ERROR, "blackholed first: %d after %"PRId64"us\n", ret, elapsed);
+        errors++;
+    }
+
+    /* one at a time, the next waits for the timeout */
+    ret = test_connect(&blackhole, &working, 2 * NEXT_ATTEMPT_DELAY_MS, 1, &elapsed);
+    if (ret != ntohs(working.sin_port) || elapsed < 2 * NEXT_ATTEMPT_DELAY_MS * 1000) {
+        bv_log(NULL, BV_LOG_ERROR, "sequential: %d after %"PRId64"us\n", ret, elapsed);
+        errors++;
+    }
+
+    /* nothing works: the last failure */
+    ret = test_connect(&blackhole, &refused, 2 * NEXT_ATTEMPT_DELAY_MS, 2, &elapsed);
+    if (ret != BVERROR(ETIMEDOUT)) {
+        bv_log(NULL, BV_LOG_ERROR, "none: %d after %"PRId64"us\n", ret, elapsed);
+        errors++;
+    }
+
+    for (i = 0; i < NB_FILLERS; i++)
+        closesocket(fillers[i]);
+    closesocket(working_fd);
+    closesocket(refused_fd);
+    closesocket(blackhole_fd);
+    bv_network_deinit();
+    return !!errors;
+}
+#endif /* TEST */
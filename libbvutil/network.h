@@ -77,12 +77,12 @@ int bv_network_wait_fd(int fd, int write);
 
 /**
  * This works similarly to bv_network_wait_fd, but waits up to 'timeout' microseconds
- * Uses bv_network_wait_fd in a loop
+ * and returns at once when the cancel token of int_cb is cancelled
  *
  * @fd Socket descriptor
  * @write Set 1 to wait for socket able to be read, 0 to be written
- * @timeout Timeout interval, in microseconds. Actual precision is 100000 mcs, due to bv_network_wait_fd usage
- * @param int_cb Interrupt callback, is checked before each bv_network_wait_fd call
+ * @timeout Timeout interval, in microseconds, 0 for none
+ * @param int_cb Interrupt callback, is checked every POLLING_TIME if set
  * @return 0 if data can be read/written, BVERROR(ETIMEDOUT) if timeout expired, or negative error code
  */
 int bv_network_wait_fd_timeout(int fd, int write, int64_t timeout, BVIOInterruptCB *cb);
@@ -265,6 +265,40 @@ int bv_listen_connect(int fd, const struct sockaddr *addr,
                       socklen_t addrlen, int timeout,
                       BVIOInterruptCB *cb, int will_try_next);
 
+/**
+ * Connect to any of the addresses, racing several attempts (RFC 8305).
+ *
+ * The addresses are reordered to alternate between families. An attempt
+ * starts every 250 milliseconds, or as soon as a pending one fails, with
+ * at most parallel attempts at a time; the first socket to connect wins.
+ *
+ * @param addrs    Addresses to try, the list is reordered in place but
+ *                 keeps its head.
+ * @param timeout_ms_per_address Timeout of each attempt in milliseconds.
+ * @param parallel Maximum number of pending attempts.
+ * @param cb       Interrupt callback, may be NULL.
+ * @param fd       Set to the connected, non-blocking socket.
+ * @return         0 on success, BVERROR of the last failure otherwise.
+ */
+int bv_connect_parallel(struct addrinfo *addrs, int timeout_ms_per_address,
+                        int parallel, BVIOInterruptCB *cb, int *fd);
+
+/**
+ * Open n sockets bound to the same address with SO_REUSEPORT. The kernel
+ * spreads incoming connections or datagrams over them, so that each can
+ * be served by its own thread or event loop.
+ *
+ * @param ai        Address to bind to. Stream sockets are also made to
+ *                  listen, none is accepted.
+ * @param n         Number of sockets.
+ * @param fds       Filled with n non-blocking sockets.
+ * @param steer_cpu If set, attach a BPF program handing each packet to the
+ *                  socket with the index of the CPU that received it,
+ *                  modulo n (Linux only, a warning is logged otherwise).
+ * @return          0 on success, BVERROR on failure with no socket left open.
+ */
+int bv_listen_reuseport(const struct addrinfo *ai, int n, int *fds, int steer_cpu);
+
 int bv_http_match_no_proxy(const char *no_proxy, const char *hostname);
 
 int bv_socket(int domain, int type, int protocol);
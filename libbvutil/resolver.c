@@ -0,0 +1,469 @@
+/*
+ * This file is part of BVBase.
+ *
+ * BVBase is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * BVBase is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BVBase; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#if BV_HAVE_PTHREADS
+#include <pthread.h>
+#endif
+#include <string.h>
+
+#include "bvstring.h"
+#include "error.h"
+#include "log.h"
+#include "mem.h"
+#include "resolver.h"
+#include "time.h"
+
+#if BV_HAVE_PTHREADS
+#define MAX_ENTRIES 256
+#define MAX_THREADS 4
+
+typedef struct ResolverEntry {
+    char *node;
+    char *service;
+    int family, socktype, protocol, flags;
+    struct addrinfo *ai;        ///< last successful answer, or NULL
+    int64_t expires;            ///< the answer or the failure is used until then
+    int64_t stale_until;        ///< ai may be served until then
+    int64_t last_used;
+    int pending;                ///< a lookup is queued or running
+    int refs;                   ///< callers waiting for the lookup
+    struct ResolverEntry *next;
+    struct ResolverEntry *next_job;
+} ResolverEntry;
+
+static pthread_mutex_t resolver_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  job_cond      = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  done_cond     = PTHREAD_COND_INITIALIZER;
+static ResolverEntry *entries;
+static int nb_entries;
+static ResolverEntry *jobs, **jobs_tail = &jobs;
+static int nb_threads, idle_threads;
+static int lookups;
+static int64_t resolver_ttl          = 60000000;
+static int64_t resolver_negative_ttl =  5000000;
+static int64_t resolver_max_stale    = 3600000000LL;
+
+static int str_equal(const char *a, const char *b)
+{
+    return a == b || (a && b && !strcmp(a, b));
+}
+
+static ResolverEntry *find_entry(const char *node, const char *service,
+                                 const struct addrinfo *hints)
+{
+    ResolverEntry *e;
+
+    for (e = entries; e; e = e->next)
+        if (!strcmp(e->node, node) && str_equal(e->service, service) &&
+            e->family   == hints->ai_family   &&
+            e->socktype == hints->ai_socktype &&
+            e->protocol == hints->ai_protocol &&
+            e->flags    == hints->ai_flags)
+            return e;
+    return NULL;
+}
+
+static void free_entry(ResolverEntry *e)
+{
+    if (e->ai)
+        freeaddrinfo(e->ai);
+    bv_free(e->node);
+    bv_free(e->service);
+    bv_free(e);
+}
+
+/* Drop the least recently used entry nobody is using. */
+static void evict_entry(void)
+{
+    ResolverEntry **p, **victim = NULL;
+
+    for (p = &entries; *p; p = &(*p)->next)
+        if (!(*p)->pending && !(*p)->refs &&
+            (!victim || (*p)->last_used < (*victim)->last_used))
+            victim = p;
+    if (victim) {
+        ResolverEntry *e = *victim;
+        *victim = e->next;
+        nb_entries--;
+        free_entry(e);
+    }
+}
+
+static ResolverEntry *add_entry(const char *node, const char *service,
+                                const struct addrinfo *hints)
+{
+    ResolverEntry *e;
+
+    if (nb_entries >= MAX_ENTRIES)
+        evict_entry();
+    e = bv_mallocz(sizeof(*e));
+    if (!e)
+        return NULL;
+    e->node    = bv_strdup(node);
+    e->service = service ? bv_strdup(service) : NULL;
+    if (!e->node || (service && !e->service)) {
+        free_entry(e);
+        return NULL;
+    }
+    e->family   = hints->ai_family;
+    e->socktype = hints->ai_socktype;
+    e->protocol = hints->ai_protocol;
+    e->flags    = hints->ai_flags;
+    e->next     = entries;
+    entries     = e;
+    nb_entries++;
+    return e;
+}
+
+static void *resolver_thread(void *arg)
+{
+    struct addrinfo hints = { 0 }, *ai;
+    ResolverEntry *e;
+    int64_t now;
+    int ret;
+
+    pthread_mutex_lock(&resolver_lock);
+    for (;;) {
+        while (!jobs) {
+            idle_threads++;
+            pthread_cond_wait(&job_cond, &resolver_lock);
+            idle_threads--;
+        }
+        e    = jobs;
+        jobs = e->next_job;
+        if (!jobs)
+            jobs_tail = &jobs;
+        hints.ai_family   = e->family;
+        hints.ai_socktype = e->socktype;
+        hints.ai_protocol = e->protocol;
+        hints.ai_flags    = e->flags;
+        lookups++;
+        /* the entry cannot go away while pending */
+        pthread_mutex_unlock(&resolver_lock);
+
+        ai  = NULL;
+        ret = getaddrinfo(e->node, e->service, &hints, &ai);
+        if (ret)
+            bv_log(NULL, BV_LOG_ERROR, "Failed to resolve hostname %s: %s\n",
+                   e->node, gai_strerror(ret));
+
+        pthread_mutex_lock(&resolver_lock);
+        now = bv_gettime_relative();
+        if (!ret) {
+            if (e->ai)
+                freeaddrinfo(e->ai);
+            e->ai          = ai;
+            e->expires     = now + resolver_ttl;
+            e->stale_until = e->expires + resolver_max_stale;
+        } else {
+            /* keep serving the old answer while the server is failing */
+            if (e->ai && now >= e->stale_until) {
+                freeaddrinfo(e->ai);
+                e->ai = NULL;
+            }
+            e->expires = now + resolver_negative_ttl;
+        }
+        e->pending = 0;
+        pthread_cond_broadcast(&done_cond);
+    }
+    return NULL;
+}
+
+/* Queue a lookup of e, with resolver_lock held. */
+static int start_lookup(ResolverEntry *e)
+{
+    e->pending  = 1;
+    e->next_job = NULL;
+    *jobs_tail  = e;
+    jobs_tail   = &e->next_job;
+    if (!idle_threads && nb_threads < MAX_THREADS) {
+        pthread_attr_t attr;
+        pthread_t thread;
+        int ret;
+
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        ret = pthread_create(&thread, &attr, resolver_thread, NULL);
+        pthread_attr_destroy(&attr);
+        if (!ret) {
+            nb_threads++;
+        } else if (!nb_threads) {
+            jobs       = NULL;
+            jobs_tail  = &jobs;
+            e->pending = 0;
+            return BVERROR(ret);
+        }
+    }
+    pthread_cond_signal(&job_cond);
+    return 0;
+}
+
+#endif /* BV_HAVE_PTHREADS */
+
+/* Copy a list into a single allocation, so bv_free() releases it. */
+static struct addrinfo *copy_addrinfo(const struct addrinfo *src)
+{
+    const struct addrinfo *cur;
+    struct addrinfo *res, *dst;
+    uint8_t *addr;
+    size_t size = 0;
+    int n = 0;
+
+    for (cur = src; cur; cur = cur->ai_next) {
+        n++;
+        size += BBALIGN(cur->ai_addrlen, sizeof(void *));
+    }
+    if (!n)
+        return NULL;
+    res = bv_mallocz(n * sizeof(*res) + size);
+    if (!res)
+        return NULL;
+    addr = (uint8_t *)(res + n);
+    for (cur = src, dst = res; cur; cur = cur->ai_next, dst++) {
+        dst->ai_flags     = cur->ai_flags;
+        dst->ai_family    = cur->ai_family;
+        dst->ai_socktype  = cur->ai_socktype;
+        dst->ai_protocol  = cur->ai_protocol;
+        dst->ai_addrlen   = cur->ai_addrlen;
+        dst->ai_addr      = (struct sockaddr *)addr;
+        dst->ai_canonname = NULL;
+        dst->ai_next      = cur->ai_next ? dst + 1 : NULL;
+        memcpy(addr, cur->ai_addr, cur->ai_addrlen);
+        addr += BBALIGN(cur->ai_addrlen, sizeof(void *));
+    }
+    return res;
+}
+
+static int resolve_direct(const char *node, const char *service,
+                          const struct addrinfo *hints, struct addrinfo **res)
+{
+    struct addrinfo *ai = NULL;
+    int ret = getaddrinfo(node, service, hints, &ai);
+
+    if (ret)
+        return ret;
+    *res = copy_addrinfo(ai);
+    freeaddrinfo(ai);
+    return *res ? 0 : EAI_MEMORY;
+}
+
+int bv_resolve(const char *node, const char *service,
+               const struct addrinfo *hints, struct addrinfo **res,
+               int64_t timeout, BVIOInterruptCB *int_cb)
+{
+    struct addrinfo h = { 0 };
+#if BV_HAVE_PTHREADS
+    ResolverEntry *e;
+    int64_t now = bv_gettime_relative();
+    int64_t deadline = timeout > 0 ? now + timeout : 0;
+#endif
+    int ret = 0;
+
+    *res = NULL;
+    if (hints)
+        h = *hints;
+    if (!node || !node[0]) {
+        ret = resolve_direct(NULL, service, &h, res);
+        return ret ? (ret == EAI_MEMORY ? BVERROR(ENOMEM) : BVERROR(EIO)) : 0;
+    }
+    h.ai_flags |= AI_NUMERICHOST;
+    if (!(ret = resolve_direct(node, service, &h, res)))
+        return 0;
+    if (ret == EAI_MEMORY)
+        return BVERROR(ENOMEM);
+    if (hints && (hints->ai_flags & AI_NUMERICHOST))
+        return BVERROR(EIO);
+    h.ai_flags &= ~AI_NUMERICHOST;
+
+#if !BV_HAVE_PTHREADS
+    /* no lookup threads, nothing to share the cache with */
+    ret = resolve_direct(node, service, &h, res);
+    return ret ? (ret == EAI_MEMORY ? BVERROR(ENOMEM) : BVERROR(EIO)) : 0;
+#else
+    ret = 0;
+
+    pthread_mutex_lock(&resolver_lock);
+    if (!(e = find_entry(node, service, &h)) &&
+        !(e = add_entry(node, service, &h))) {
+        pthread_mutex_unlock(&resolver_lock);
+        return BVERROR(ENOMEM);
+    }
+    e->last_used = now;
+    if (!e->pending && now >= e->expires) {
+        if ((ret = start_lookup(e)) < 0) {
+            pthread_mutex_unlock(&resolver_lock);
+            return ret;
+        }
+    }
+    /* a stale answer is better than waiting for a refresh */
+    if (e->pending && !(e->ai && now < e->stale_until)) {
+        e->refs++;
+        while (e->pending) {
+            struct timespec ts;
+            int64_t t;
+
+            if (bv_check_interrupt(int_cb)) {
+                ret = BVERROR_EXIT;
+                break;
+            }
+            if (deadline && bv_gettime_relative() >= deadline) {
+                ret = BVERROR(ETIMEDOUT);
+                break;
+            }
+            t = bv_gettime() + 100000;
+            ts.tv_sec  = t / 1000000;
+            ts.tv_nsec = (t % 1000000) * 1000;
+            pthread_cond_timedwait(&done_cond, &resolver_lock, &ts);
+        }
+        e->refs--;
+    }
+    if (!ret) {
+        if (!e->ai)
+            ret = BVERROR(EIO);
+        else if (!(*res = copy_addrinfo(e->ai)))
+            ret = BVERROR(ENOMEM);
+    }
+    pthread_mutex_unlock(&resolver_lock);
+    return ret;
+#endif /* BV_HAVE_PTHREADS */
+}
+
+void bv_resolve_free(struct addrinfo *res)
+{
+    bv_free(res);
+}
+
+void bv_resolver_set_ttl(int64_t ttl, int64_t negative_ttl, int64_t max_stale)
+{
+#if BV_HAVE_PTHREADS
+    pthread_mutex_lock(&resolver_lock);
+    resolver_ttl          = ttl;
+    resolver_negative_ttl = negative_ttl;
+    resolver_max_stale    = max_stale;
+    pthread_mutex_unlock(&resolver_lock);
+#endif
+}
+
+void bv_resolver_flush(void)
+{
+#if BV_HAVE_PTHREADS
+    ResolverEntry **p = &entries, *e;
+
+    pthread_mutex_lock(&resolver_lock);
+    while ((e = *p)) {
+        if (!e->pending && !e->refs) {
+            *p = e->next;
+            nb_entries--;
+            free_entry(e);
+        } else {
+            p = &e->next;
+        }
+    }
+    pthread_mutex_unlock(&resolver_lock);
+#endif
+}
+
+#ifdef TEST
+#include <stdio.h>
+
+#if BV_HAVE_PTHREADS
+
+static void *resolve_task(void *arg)
+{
+    struct addrinfo hints = { 0 }, *ai;
+
+    hints.ai_socktype = SOCK_STREAM;
+    *(int *)arg = bv_resolve("localhost", "80", &hints, &ai, 0, NULL);
+    if (!*(int *)arg)
+        bv_resolve_free(ai);
+    return NULL;
+}
+
+int main(void)
+{
+    struct addrinfo hints = { 0 }, *ai, *cur;
+    pthread_t threads[8];
+    int rets[8], i, ret, errors = 0;
+
+    hints.ai_socktype = SOCK_STREAM;
+
+    /* numeric addresses bypass the cache */
+    ret = bv_resolve("127.0.0.1", "554", &hints, &ai, 0, NULL);
+    if (ret < 0 || ai->ai_family != AF_INET || ai->ai_next ||
+        ntohs(((struct sockaddr_in *)ai->ai_addr)->sin_port) != 554) {
+        bv_log(NULL, BV_LOG_ERROR, "numeric lookup failed: %d\n", ret);
+        errors++;
+    }
+    if (!ret)
+        bv_resolve_free(ai);
+    if (lookups) {
+        bv_log(NULL, BV_LOG_ERROR, "numeric address was looked up\n");
+        errors++;
+    }
+
+    /* concurrent lookups of one name share a single query */
+    for (i = 0; i < 8; i++)
+        pthread_create(&threads[i], NULL, resolve_task, &rets[i]);
+    for (i = 0; i < 8; i++) {
+        pthread_join(threads[i], NULL);
+        if (rets[i] < 0) {
+            bv_log(NULL, BV_LOG_ERROR, "lookup %d failed: %d\n", i, rets[i]);
+            errors++;
+        }
+    }
+    if (lookups != 1) {
+        bv_log(NULL, BV_LOG_ERROR, "%d lookups instead of 1\n", lookups);
+        errors++;
+    }
+
+    /* answered from the cache, the copy is complete */
+    ret = bv_resolve("localhost", "80", &hints, &ai, 0, NULL);
+    if (ret < 0 || lookups != 1) {
+        bv_log(NULL, BV_LOG_ERROR, "cached lookup: ret %d, %d lookups\n", ret, lookups);
+        errors++;
+    }
+    for (cur = ret < 0 ? NULL : ai; cur; cur = cur->ai_next)
+        if (cur->ai_socktype != SOCK_STREAM || !cur->ai_addr) {
+            bv_log(NULL, BV_LOG_ERROR, "bad cached address\n");
+            errors++;
+        }
+    if (!ret)
+        bv_resolve_free(ai);
+
+    /* expired answers are served while being refreshed */
+    bv_resolver_set_ttl(0, 0, 3600000000LL);
+    ret = bv_resolve("localhost", "80", &hints, &ai, 0, NULL);
+    if (ret < 0) {
+        bv_log(NULL, BV_LOG_ERROR, "stale lookup failed: %d\n", ret);
+        errors++;
+    } else {
+        bv_resolve_free(ai);
+    }
+
+    bv_resolver_flush();
+    return !!errors;
+}
+#else
+int main(void)
+{
+    return 0;
+}
+#endif /* BV_HAVE_PTHREADS */
+#endif /* TEST */
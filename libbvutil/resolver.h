@@ -0,0 +1,75 @@
+/*
+ * This file is part of BVBase.
+ *
+ * BVBase is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * BVBase is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BVBase; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef BVUTIL_RESOLVER_H
+#define BVUTIL_RESOLVER_H
+
+/**
+ * @file
+ * Caching host name resolver.
+ *
+ * Lookups run on resolver threads, concurrent lookups of the same name
+ * share one getaddrinfo() call. Answers are cached for a fixed time, as
+ * getaddrinfo() does not report record TTLs, failures for a shorter time.
+ * Once an answer expired it is still served while a refresh runs in the
+ * background, and for as long as the DNS server keeps failing, up to the
+ * stale limit. Without thread support, names are looked up in place and
+ * not cached.
+ */
+
+#include <stdint.h>
+
+#include "bvutil.h"
+#include "network.h"
+
+/**
+ * Resolve node and service like getaddrinfo().
+ *
+ * Numeric addresses and a NULL node are resolved at once, without the
+ * cache. The caller gives up after timeout or when int_cb fires; the
+ * lookup itself goes on and its answer is cached.
+ *
+ * @param hints   as for getaddrinfo(), may be NULL
+ * @param res     set to the list of addresses, to be freed with bv_resolve_free()
+ * @param timeout microseconds to wait for the answer, 0 to wait as long
+ *                as the lookup takes
+ * @param int_cb  checked while waiting, may be NULL
+ * @return 0 on success, BVERROR(EIO) if the name does not resolve,
+ *         BVERROR(ETIMEDOUT), BVERROR_EXIT or another negative error code
+ */
+int bv_resolve(const char *node, const char *service,
+               const struct addrinfo *hints, struct addrinfo **res,
+               int64_t timeout, BVIOInterruptCB *int_cb);
+
+void bv_resolve_free(struct addrinfo *res);
+
+/**
+ * Set how long answers are cached, in microseconds.
+ *
+ * @param ttl          time a successful answer is used without lookup
+ * @param negative_ttl time a failure is returned without lookup
+ * @param max_stale    time an expired answer is still served after ttl
+ */
+void bv_resolver_set_ttl(int64_t ttl, int64_t negative_ttl, int64_t max_stale);
+
+/**
+ * Drop all cached answers which no lookup is using.
+ */
+void bv_resolver_flush(void);
+
+#endif /* BVUTIL_RESOLVER_H */
@@ -52,6 +52,11 @@
 #define bv_cond_broadcast   pthread_cond_broadcast
 #define bv_cond_destroy     pthread_cond_destroy
 
+#define BVOnce pthread_once_t
+#define BV_ONCE_INIT PTHREAD_ONCE_INIT
+
+#define bv_thread_once      pthread_once
+
 #else
 
 #define USE_ATOMICS 1
@@ -70,6 +75,18 @@
 #define bv_cond_broadcast(cond)         (0)
 #define bv_cond_destroy(cond)           (0)
 
+#define BVOnce char
+#define BV_ONCE_INIT 0
+
+static inline int bv_thread_once(char *control, void (*routine)(void))
+{
+    if (!*control) {
+        routine();
+        *control = 1;
+    }
+    return 0;
+}
+
 #endif
 
 #endif /* BVUTIL_THREAD_H */
@@ -0,0 +1,327 @@
+/*
+ * This file is part of BVBase.
+ *
+ * BVBase is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * BVBase is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BVBase; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "common.h"
+#include "error.h"
+#include "intmath.h"
+#include "mem.h"
+#include "timerwheel.h"
+
+#define WHEEL_BITS   6
+#define WHEEL_SIZE   (1 << WHEEL_BITS)
+#define WHEEL_MASK   (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 6      ///< 2^36 ticks, over two years at 1 ms
+
+struct BVTimerWheel {
+    int64_t origin;
+    int64_t resolution;
+    uint64_t tick;          ///< next tick to process
+    uint64_t occupied[WHEEL_LEVELS];  ///< nonempty slots, may have stale bits
+    BVTimer slots[WHEEL_LEVELS][WHEEL_SIZE];
+};
+
+static inline int ctz64(uint64_t v)
+{
+    return (uint32_t)v ? bb_ctz((uint32_t)v) : 32 + bb_ctz(v >> 32);
+}
+
+static inline uint64_t rotr64(uint64_t v, int n)
+{
+    return n ? v >> n | v << (64 - n) : v;
+}
+
+static void list_init(BVTimer *head)
+{
+    head->next = head->prev = head;
+}
+
+static void list_unlink(BVTimer *t)
+{
+    t->prev->next = t->next;
+    t->next->prev = t->prev;
+    t->prev = t->next = NULL;
+}
+
+int bv_timer_wheel_alloc(BVTimerWheel **pwheel, int64_t resolution, int64_t now)
+{
+    BVTimerWheel *w;
+    int l, i;
+
+    if (resolution <= 0)
+        return BVERROR(EINVAL);
+    if (!(w = bv_mallocz(sizeof(*w))))
+        return BVERROR(ENOMEM);
+    w->origin     = now;
+    w->resolution = resolution;
+    for (l = 0; l < WHEEL_LEVELS; l++)
+        for (i = 0; i < WHEEL_SIZE; i++)
+            list_init(&w->slots[l][i]);
+    *pwheel = w;
+    return 0;
+}
+
+void bv_timer_wheel_free(BVTimerWheel **pwheel)
+{
+    BVTimerWheel *w = *pwheel;
+    int l, i;
+
+    if (!w)
+        return;
+    /* leave the dropped timers in a state bv_timer_pending() reports */
+    for (l = 0; l < WHEEL_LEVELS; l++)
+        for (i = 0; i < WHEEL_SIZE; i++)
+            while (w->slots[l][i].next != &w->slots[l][i])
+                list_unlink(w->slots[l][i].next);
+    bv_freep(pwheel);
+}
+
+void bv_timer_init(BVTimer *t, BVTimerCallback cb, void *opaque)
+{
+    t->prev = t->next = NULL;
+    t->expires = 0;
+    t->cb      = cb;
+    t->opaque  = opaque;
+}
+
+static void wheel_insert(BVTimerWheel *w, BVTimer *t)
+{
+    int64_t rel = t->expires - w->origin;
+    uint64_t when, delta;
+    BVTimer *head;
+    int level, idx;
+
+    /* round up so that a timer never fires early */
+    when  = rel <= 0 ? 0 : (rel + w->resolution - 1) / w->resolution;
+    when  = BBMAX(when, w->tick);
+    delta = when - w->tick;
+    for (level = 0; level < WHEEL_LEVELS - 1; level++)
+        if (delta < (uint64_t)1 << (WHEEL_BITS * (level + 1)))
+            break;
+    if (level == WHEEL_LEVELS - 1 &&
+        delta >= (uint64_t)1 << (WHEEL_BITS * WHEEL_LEVELS)) {
+        /* beyond the wheel, park in the last slot and re-file it later */
+        when = w->tick + ((uint64_t)1 << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+    }
+    idx  = (when >> (WHEEL_BITS * level)) & WHEEL_MASK;
+    head = &w->slots[level][idx];
+    t->next = head;
+    t->prev = head->prev;
+    head->prev->next = t;
+    head->prev = t;
+    w->occupied[level] |= (uint64_t)1 << idx;
+}
+
+void bv_timer_wheel_add(BVTimerWheel *w, BVTimer *t, int64_t expires)
+{
+    if (t->next)
+        list_unlink(t);
+    t->expires = expires;
+    wheel_insert(w, t);
+}
+
+void bv_timer_wheel_cancel(BVTimerWheel *w, BVTimer *t)
+{
+    if (t->next)
+        list_unlink(t);
+}
+
+/* move the timers of a coarse slot down to the finer levels */
+static void cascade(BVTimerWheel *w, int level, int idx)
+{
+    BVTimer *head = &w->slots[level][idx], *t;
+
+    w->occupied[level] &= ~((uint64_t)1 << idx);
+    while ((t = head->next) != head) {
+        list_unlink(t);
+        wheel_insert(w, t);
+    }
+}
+
+int bv_timer_wheel_advance(BVTimerWheel *w, int64_t now)
+{
+    uint64_t target;
+    BVTimer list, *t;
+    int n = 0;
+
+    if (now < w->origin)
+        return 0;
+    target = (now - w->origin) / w->resolution;
+    while (w->tick <= target) {
+        int idx = w->tick & WHEEL_MASK, level;
+        uint64_t ahead;
+
+        if (!idx) {
+            for (level = 1; level < WHEEL_LEVELS; level++) {
+                int i = (w->tick >> (WHEEL_BITS * level)) & WHEEL_MASK;
+                if (w->occupied[level] & (uint64_t)1 << i)
+                    cascade(w, level, i);
+                if (i)
+                    break;
+            }
+        }
+
+        ahead = rotr64(w->occupied[0], idx);
+        if (!(ahead & 1)) {
+            /* skip empty ticks up to the next timer or cascade */
+            int skip = ahead ? ctz64(ahead) : WHEEL_SIZE;
+            skip = BBMIN(skip, WHEEL_SIZE - idx);
+            w->tick = BBMIN(w->tick + skip, target + 1);
+            continue;
+        }
+
+        list_init(&list);
+        if (w->slots[0][idx].next != &w->slots[0][idx]) {
+            list.next = w->slots[0][idx].next;
+            list.prev = w->slots[0][idx].prev;
+            list.next->prev = list.prev->next = &list;
+            list_init(&w->slots[0][idx]);
+        }
+        w->occupied[0] &= ~((uint64_t)1 << idx);
+        /* timers added by the callbacks for this tick go to the next one */
+        w->tick++;
+        while ((t = list.next) != &list) {
+            list_unlink(t);
+            t->cb(t, t->opaque);
+            n++;
+        }
+    }
+    return n;
+}
+
+int64_t bv_timer_wheel_timeout(BVTimerWheel *w, int64_t now)
+{
+    uint64_t best = UINT64_MAX;
+    int64_t when;
+    int level;
+
+    for (level = 0; level < WHEEL_LEVELS; level++) {
+        int shift = WHEEL_BITS * level;
+        uint64_t base, ahead;
+
+        if (!w->occupied[level])
+            continue;
+        /* first tick at which this level is looked at again */
+        base  = ((w->tick + ((uint64_t)1 << shift) - 1) >> shift) << shift;
+        ahead = rotr64(w->occupied[level], (base >> shift) & WHEEL_MASK);
+        best  = BBMIN(best, base + ((uint64_t)ctz64(ahead) << shift));
+    }
+    if (best == UINT64_MAX)
+        return -1;
+    when = w->origin + (int64_t)best * w->resolution;
+    return BBMAX(when - now, 0);
+}
+
+#ifdef TEST
+#include <stdio.h>
+
+#include "lfg.h"
+#include "log.h"
+#include "time.h"
+
+#define NB_TIMERS 100000
+
+typedef struct TestTimer {
+    BVTimer timer;
+    int64_t deadline;
+    int fired;
+    int cancelled;
+} TestTimer;
+
+static int64_t clock_now, start_time;
+static int errors, fired;
+static TestTimer timers[NB_TIMERS];
+
+static void test_cb(BVTimer *timer, void *opaque)
+{
+    TestTimer *tt = opaque;
+
+    fired++;
+    /* late by at most a tick plus the jitter of the test loop */
+    if (tt->fired++ || tt->cancelled || clock_now < tt->deadline ||
+        clock_now >= BBMAX(tt->deadline, start_time) + 2 * 1000) {
+        if (errors++ < 10)
+            bv_log(NULL, BV_LOG_ERROR, "timer %d fired at %"PRId64" for %"PRId64"\n",
+                   (int)(tt - timers), clock_now, tt->deadline);
+    }
+}
+
+static int rearmed;
+static void periodic_cb(BVTimer *timer, void *opaque)
+{
+    BVTimerWheel *w = opaque;
+    if (++rearmed < 100)
+        bv_timer_wheel_add(w, timer, clock_now + 10000);
+}
+
+int main(void)
+{
+    BVTimerWheel *w;
+    BVLFG lfg;
+    BVTimer periodic;
+    int64_t t0, to;
+    int i, expected = 0;
+
+    bv_lfg_init(&lfg, 1);
+    clock_now = start_time = 123456789;
+    if (bv_timer_wheel_alloc(&w, 1000, clock_now) < 0)
+        return 1;
+    if (bv_timer_wheel_timeout(w, clock_now) != -1)
+        errors++;
+
+    /* spread from now to hours away, a few in the past */
+    for (i = 0; i < NB_TIMERS; i++) {
+        int64_t d = bv_lfg_get(&lfg) % (1 << (i % 24 + 4));
+        timers[i].deadline = clock_now + d - (i % 1000 == 0 ? 5000 : 0);
+        bv_timer_init(&timers[i].timer, test_cb, &timers[i]);
+        bv_timer_wheel_add(w, &timers[i].timer, timers[i].deadline);
+    }
+    /* reschedule some, cancel some */
+    for (i = 0; i < NB_TIMERS; i += 7) {
+        timers[i].deadline += 250000;
+        bv_timer_wheel_add(w, &timers[i].timer, timers[i].deadline);
+    }
+    for (i = 3; i < NB_TIMERS; i += 11) {
+        timers[i].cancelled = 1;
+        bv_timer_wheel_cancel(w, &timers[i].timer);
+    }
+    for (i = 0; i < NB_TIMERS; i++)
+        expected += !timers[i].cancelled;
+
+    bv_timer_init(&periodic, periodic_cb, w);
+    bv_timer_wheel_add(w, &periodic, clock_now + 10000);
+
+    /* follow the timeout like an event loop, with some jitter */
+    t0 = bv_gettime_relative();
+    while ((to = bv_timer_wheel_timeout(w, clock_now)) >= 0) {
+        clock_now += to + bv_lfg_get(&lfg) % 1000;
+        bv_timer_wheel_advance(w, clock_now);
+    }
+    t0 = bv_gettime_relative() - t0;
+
+    if (fired != expected || rearmed != 100) {
+        bv_log(NULL, BV_LOG_ERROR, "fired %d of %d, periodic %d\n", fired, expected, rearmed);
+        errors++;
+    }
+    for (i = 0; i < NB_TIMERS; i++)
+        if (!timers[i].cancelled && !timers[i].fired)
+            errors++;
+    printf("%d timers in %"PRId64" us, %d errors\n", fired, t0, errors);
+    bv_timer_wheel_free(&w);
+    return !!errors;
+}
+#endif
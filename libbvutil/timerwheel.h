@@ -0,0 +1,98 @@
+/*
+ * This file is part of BVBase.
+ *
+ * BVBase is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * BVBase is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BVBase; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef BVUTIL_TIMERWHEEL_H
+#define BVUTIL_TIMERWHEEL_H
+
+/**
+ * @file
+ * Hierarchical timer wheel.
+ *
+ * Adding, cancelling and firing a timer are O(1) whatever the number of
+ * pending timers. Timers are embedded in the caller's structures, so the
+ * wheel never allocates per timer. Times are in microseconds on the
+ * bv_gettime_relative() clock, which is monotonic where available.
+ * Timers never fire early and fire at most one resolution step late.
+ */
+
+#include <stdint.h>
+
+typedef struct BVTimerWheel BVTimerWheel;
+typedef struct BVTimer BVTimer;
+
+typedef void (*BVTimerCallback)(BVTimer *timer, void *opaque);
+
+/**
+ * Set up by bv_timer_init(), the remaining fields are private.
+ */
+struct BVTimer {
+    BVTimer *prev, *next;
+    int64_t expires;
+    BVTimerCallback cb;
+    void *opaque;
+};
+
+/**
+ * Allocate a wheel.
+ *
+ * @param resolution length of one tick in microseconds, e.g. 1000
+ * @param now        current bv_gettime_relative() time
+ */
+int bv_timer_wheel_alloc(BVTimerWheel **wheel, int64_t resolution, int64_t now);
+
+/**
+ * Free a wheel. Pending timers are dropped without firing.
+ */
+void bv_timer_wheel_free(BVTimerWheel **wheel);
+
+void bv_timer_init(BVTimer *timer, BVTimerCallback cb, void *opaque);
+
+/**
+ * Schedule timer to fire at the absolute time expires, replacing any
+ * earlier schedule. Expiry times in the past fire on the next advance.
+ */
+void bv_timer_wheel_add(BVTimerWheel *wheel, BVTimer *timer, int64_t expires);
+
+/**
+ * Cancel timer, nothing happens if it is not pending.
+ */
+void bv_timer_wheel_cancel(BVTimerWheel *wheel, BVTimer *timer);
+
+static inline int bv_timer_pending(const BVTimer *timer)
+{
+    return !!timer->next;
+}
+
+/**
+ * Fire all timers that expired by now, in expiry tick order. Callbacks
+ * may add and cancel any timer, including the one firing.
+ *
+ * @return number of timers fired
+ */
+int bv_timer_wheel_advance(BVTimerWheel *wheel, int64_t now);
+
+/**
+ * Time from now until the next bv_timer_wheel_advance() call may fire a
+ * timer, to be used as a poll or epoll timeout. It may be shorter than
+ * the next expiry when timers wait on a coarse level of the wheel.
+ *
+ * @return microseconds, 0 if timers are due, -1 if no timer is pending
+ */
+int64_t bv_timer_wheel_timeout(BVTimerWheel *wheel, int64_t now);
+
+#endif /* BVUTIL_TIMERWHEEL_H */
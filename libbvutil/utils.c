@@ -19,6 +19,7 @@
 #include "config.h"
 #include "bvutil.h"
 #include "bvassert.h"
+#include "cancel.h"
 #include "samplefmt.h"
 #include "pixdesc.h"
 
@@ -87,6 +88,8 @@ const char *bv_get_media_type_string(enum BVMediaType media_type)
 int bv_check_interrupt(BVIOInterruptCB *cb)
 {
     int ret;
+    if (cb && cb->token && bv_cancel_token_is_cancelled(cb->token))
+        return 1;
     if (cb && cb->callback && (ret = cb->callback(cb->opaque)))
         return ret;
     return 0;
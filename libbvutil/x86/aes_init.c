@@ -0,0 +1,96 @@
+/*
+ * This file is part of BVBase.
+ *
+ * BVBase is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * BVBase is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BVBase; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include "libbvutil/aes_internal.h"
+#include "libbvutil/attributes.h"
+#include "libbvutil/bswap.h"
+#include "libbvutil/cpu.h"
+#include "libbvutil/intreadwrite.h"
+#include "cpu.h"
+
+#if BV_HAVE_SSE42_INLINE && (defined(__clang__) || BV_GCC_VERSION_AT_LEAST(4,9))
+#define HAVE_AESNI_INTRINSICS 1
+#include <immintrin.h>
+#else
+#define HAVE_AESNI_INTRINSICS 0
+#endif
+
+#if HAVE_AESNI_INTRINSICS
+#define COUNTER(n) _mm_set_epi64x((long long)bv_bswap64(ctr + (n)), (long long)iv)
+
+/* four independent blocks hide the latency of aesenc */
+__attribute__((target("aes,sse2")))
+static void aes_ctr_aesni(const BVAES *a, uint8_t *dst, const uint8_t *src, int blocks, uint8_t *counter)
+{
+    __m128i rk[15];
+    int rounds = a->rounds;
+    uint64_t iv  = BV_RN64(counter);
+    uint64_t ctr = BV_RB64(counter + 8);
+    int i, r;
+
+    for (i = 0; i <= rounds; i++)
+        rk[i] = _mm_loadu_si128((const __m128i *)a->round_key[rounds - i].u8);
+
+    for (; blocks >= 4; blocks -= 4) {
+        __m128i b0 = _mm_xor_si128(COUNTER(0), rk[0]);
+        __m128i b1 = _mm_xor_si128(COUNTER(1), rk[0]);
+        __m128i b2 = _mm_xor_si128(COUNTER(2), rk[0]);
+        __m128i b3 = _mm_xor_si128(COUNTER(3), rk[0]);
+        for (r = 1; r < rounds; r++) {
+            b0 = _mm_aesenc_si128(b0, rk[r]);
+            b1 = _mm_aesenc_si128(b1, rk[r]);
+            b2 = _mm_aesenc_si128(b2, rk[r]);
+            b3 = _mm_aesenc_si128(b3, rk[r]);
+        }
+        b0 = _mm_aesenclast_si128(b0, rk[rounds]);
+        b1 = _mm_aesenclast_si128(b1, rk[rounds]);
+        b2 = _mm_aesenclast_si128(b2, rk[rounds]);
+        b3 = _mm_aesenclast_si128(b3, rk[rounds]);
+        _mm_storeu_si128((__m128i *)(dst +  0), _mm_xor_si128(b0, _mm_loadu_si128((const __m128i *)(src +  0))));
+        _mm_storeu_si128((__m128i *)(dst + 16), _mm_xor_si128(b1, _mm_loadu_si128((const __m128i *)(src + 16))));
+        _mm_storeu_si128((__m128i *)(dst + 32), _mm_xor_si128(b2, _mm_loadu_si128((const __m128i *)(src + 32))));
+        _mm_storeu_si128((__m128i *)(dst + 48), _mm_xor_si128(b3, _mm_loadu_si128((const __m128i *)(src + 48))));
+        ctr += 4;
+        dst += 64;
+        src += 64;
+    }
+    for (; blocks > 0; blocks--) {
+        __m128i b = _mm_xor_si128(COUNTER(0), rk[0]);
+        for (r = 1; r < rounds; r++)
+            b = _mm_aesenc_si128(b, rk[r]);
+        b = _mm_aesenclast_si128(b, rk[rounds]);
+        _mm_storeu_si128((__m128i *)dst, _mm_xor_si128(b, _mm_loadu_si128((const __m128i *)src)));
+        ctr++;
+        dst += 16;
+        src += 16;
+    }
+    BV_WB64(counter + 8, ctr);
+}
+#endif /* HAVE_AESNI_INTRINSICS */
+
+bv_cold void bb_aes_dsp_init_x86(BBAESDSPContext *c)
+{
+#if HAVE_AESNI_INTRINSICS
+    int cpu_flags = bv_get_cpu_flags();
+
+    if (cpu_flags & BV_CPU_FLAG_AESNI)
+        c->ctr = aes_ctr_aesni;
+#endif
+}
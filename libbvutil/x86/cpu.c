@@ -126,6 +126,10 @@ int bb_get_cpu_flags_x86(void)
             rval |= BV_CPU_FLAG_SSE4;
         if (ecx & 0x00100000 )
             rval |= BV_CPU_FLAG_SSE42;
+        if (ecx & 0x00000002 )
+            rval |= BV_CPU_FLAG_PCLMUL;
+        if (ecx & 0x02000000 )
+            rval |= BV_CPU_FLAG_AESNI;
 #if BV_HAVE_AVX
         /* Check OXSAVE and AVX bits */
         if ((ecx & 0x18000000) == 0x18000000) {
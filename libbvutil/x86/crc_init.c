@@ -0,0 +1,178 @@
+/*
+ * This file is part of BVBase.
+ *
+ * BVBase is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * BVBase is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BVBase; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include "libbvutil/attributes.h"
+#include "libbvutil/cpu.h"
+#include "libbvutil/crc.h"
+#include "libbvutil/crc_internal.h"
+#include "libbvutil/mem.h"
+#include "cpu.h"
+
+#if BV_HAVE_SSE42_INLINE && (defined(__clang__) || BV_GCC_VERSION_AT_LEAST(4,9))
+#define HAVE_PCLMUL_INTRINSICS 1
+#include <immintrin.h>
+#else
+#define HAVE_PCLMUL_INTRINSICS 0
+#endif
+
+#if BV_HAVE_SSE42_INLINE
+static uint32_t crc32c_sse42(uint32_t crc, const uint8_t *buffer, size_t length)
+{
+    while (length && ((intptr_t) buffer & 7)) {
+        __asm__ ("crc32b %1, %0" : "+r"(crc) : "rm"(*buffer));
+        buffer++;
+        length--;
+    }
+#if BV_ARCH_X86_64
+    {
+        uint64_t crc64 = crc;
+        while (length >= 8) {
+            __asm__ ("crc32q %1, %0" : "+r"(crc64) : "rm"(*(const uint64_t *) buffer));
+            buffer += 8;
+            length -= 8;
+        }
+        crc = crc64;
+    }
+#endif
+    while (length >= 4) {
+        __asm__ ("crc32l %1, %0" : "+r"(crc) : "rm"(*(const uint32_t *) buffer));
+        buffer += 4;
+        length -= 4;
+    }
+    while (length--) {
+        __asm__ ("crc32b %1, %0" : "+r"(crc) : "rm"(*buffer));
+        buffer++;
+    }
+    return crc;
+}
+#endif /* BV_HAVE_SSE42_INLINE */
+
+#if HAVE_PCLMUL_INTRINSICS
+/*
+ * Folding with carry-less multiplication, see Intel's "Fast CRC Computation
+ * for Generic Polynomials Using PCLMULQDQ Instruction". The constants are
+ * the bit-reflected x^n mod P(x) values for the IEEE polynomial.
+ */
+bv_unused __attribute__((target("sse4.1,pclmul")))
+static uint32_t crc32_le_pclmul(uint32_t crc, const uint8_t *buffer, size_t length)
+{
+    static const BV_DECLARE_ALIGNED(16, uint64_t, k1k2)[] = { 0x0154442bd4, 0x01c6e41596 };
+    static const BV_DECLARE_ALIGNED(16, uint64_t, k3k4)[] = { 0x01751997d0, 0x00ccaa009e };
+    static const BV_DECLARE_ALIGNED(16, uint64_t, k5k0)[] = { 0x0163cd6124, 0x0000000000 };
+    static const BV_DECLARE_ALIGNED(16, uint64_t, poly)[] = { 0x01db710641, 0x01f7011641 };
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+    size_t tail;
+
+    if (length < 64)
+        return bv_crc(bv_crc_get_table(BV_CRC_32_IEEE_LE), crc, buffer, length);
+    tail    = length & 15;
+    length -= tail;
+
+    x1 = _mm_loadu_si128((const __m128i *)(buffer + 0x00));
+    x2 = _mm_loadu_si128((const __m128i *)(buffer + 0x10));
+    x3 = _mm_loadu_si128((const __m128i *)(buffer + 0x20));
+    x4 = _mm_loadu_si128((const __m128i *)(buffer + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+    x0 = _mm_load_si128((const __m128i *) k1k2);
+    buffer += 64;
+    length -= 64;
+
+    /* fold 4x128 bits in parallel */
+    while (length >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        y5 = _mm_loadu_si128((const __m128i *)(buffer + 0x00));
+        y6 = _mm_loadu_si128((const __m128i *)(buffer + 0x10));
+        y7 = _mm_loadu_si128((const __m128i *)(buffer + 0x20));
+        y8 = _mm_loadu_si128((const __m128i *)(buffer + 0x30));
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+        buffer += 64;
+        length -= 64;
+    }
+
+    /* fold into 128 bits */
+    x0 = _mm_load_si128((const __m128i *) k3k4);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    while (length >= 16) {
+        x2 = _mm_loadu_si128((const __m128i *) buffer);
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        buffer += 16;
+        length -= 16;
+    }
+
+    /* fold 128 to 64 bits */
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+    x0 = _mm_loadl_epi64((const __m128i *) k5k0);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    /* Barrett reduction to 32 bits */
+    x0 = _mm_load_si128((const __m128i *) poly);
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    crc = _mm_extract_epi32(x1, 1);
+
+    if (tail)
+        crc = bv_crc(bv_crc_get_table(BV_CRC_32_IEEE_LE), crc, buffer, tail);
+    return crc;
+}
+#endif /* HAVE_PCLMUL_INTRINSICS */
+
+bv_cold void bb_crc_dsp_init_x86(BBCRCDSPContext *c)
+{
+    int cpu_flags = bv_get_cpu_flags();
+
+#if BV_HAVE_SSE42_INLINE
+    if (INLINE_SSE42(cpu_flags))
+        c->crc32c = crc32c_sse42;
+#endif
+#if HAVE_PCLMUL_INTRINSICS
+    if (INLINE_SSE42(cpu_flags) && (cpu_flags & BV_CPU_FLAG_PCLMUL))
+        c->crc32_le = crc32_le_pclmul;
+#endif
+}
@@ -0,0 +1,94 @@
+/*
+ * This file is part of BVBase.
+ *
+ * BVBase is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * BVBase is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BVBase; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include "libbvutil/attributes.h"
+#include "libbvutil/cpu.h"
+#include "libbvutil/xor_internal.h"
+#include "cpu.h"
+
+#if BV_HAVE_SSE2_INLINE && (defined(__clang__) || BV_GCC_VERSION_AT_LEAST(4,9))
+#define HAVE_XOR_INTRINSICS 1
+#include <immintrin.h>
+#else
+#define HAVE_XOR_INTRINSICS 0
+#endif
+
+#if HAVE_XOR_INTRINSICS
+__attribute__((target("sse2")))
+static void memxor_sse2(uint8_t *dst, const uint8_t *src, int size)
+{
+    int i = 0;
+
+    for (; i + 64 <= size; i += 64) {
+        __m128i d0 = _mm_loadu_si128((const __m128i *)(dst + i +  0));
+        __m128i d1 = _mm_loadu_si128((const __m128i *)(dst + i + 16));
+        __m128i d2 = _mm_loadu_si128((const __m128i *)(dst + i + 32));
+        __m128i d3 = _mm_loadu_si128((const __m128i *)(dst + i + 48));
+        d0 = _mm_xor_si128(d0, _mm_loadu_si128((const __m128i *)(src + i +  0)));
+        d1 = _mm_xor_si128(d1, _mm_loadu_si128((const __m128i *)(src + i + 16)));
+        d2 = _mm_xor_si128(d2, _mm_loadu_si128((const __m128i *)(src + i + 32)));
+        d3 = _mm_xor_si128(d3, _mm_loadu_si128((const __m128i *)(src + i + 48)));
+        _mm_storeu_si128((__m128i *)(dst + i +  0), d0);
+        _mm_storeu_si128((__m128i *)(dst + i + 16), d1);
+        _mm_storeu_si128((__m128i *)(dst + i + 32), d2);
+        _mm_storeu_si128((__m128i *)(dst + i + 48), d3);
+    }
+    for (; i + 16 <= size; i += 16)
+        _mm_storeu_si128((__m128i *)(dst + i),
+                         _mm_xor_si128(_mm_loadu_si128((const __m128i *)(dst + i)),
+                                       _mm_loadu_si128((const __m128i *)(src + i))));
+    for (; i < size; i++)
+        dst[i] ^= src[i];
+}
+
+__attribute__((target("avx2")))
+static void memxor_avx2(uint8_t *dst, const uint8_t *src, int size)
+{
+    int i = 0;
+
+    for (; i + 64 <= size; i += 64) {
+        __m256i d0 = _mm256_loadu_si256((const __m256i *)(dst + i +  0));
+        __m256i d1 = _mm256_loadu_si256((const __m256i *)(dst + i + 32));
+        d0 = _mm256_xor_si256(d0, _mm256_loadu_si256((const __m256i *)(src + i +  0)));
+        d1 = _mm256_xor_si256(d1, _mm256_loadu_si256((const __m256i *)(src + i + 32)));
+        _mm256_storeu_si256((__m256i *)(dst + i +  0), d0);
+        _mm256_storeu_si256((__m256i *)(dst + i + 32), d1);
+    }
+    for (; i + 16 <= size; i += 16)
+        _mm_storeu_si128((__m128i *)(dst + i),
+                         _mm_xor_si128(_mm_loadu_si128((const __m128i *)(dst + i)),
+                                       _mm_loadu_si128((const __m128i *)(src + i))));
+    for (; i < size; i++)
+        dst[i] ^= src[i];
+    _mm256_zeroupper();
+}
+#endif /* HAVE_XOR_INTRINSICS */
+
+bv_cold void bb_xor_dsp_init_x86(BBXORDSPContext *c)
+{
+#if HAVE_XOR_INTRINSICS
+    int cpu_flags = bv_get_cpu_flags();
+
+    if (X86_SSE2(cpu_flags))
+        c->memxor = memxor_sse2;
+    if (X86_AVX2(cpu_flags))
+        c->memxor = memxor_avx2;
+#endif
+}
@@ -0,0 +1,105 @@
+/*
+ * This file is part of BVBase.
+ *
+ * BVBase is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * BVBase is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BVBase; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "common.h"
+#include "intreadwrite.h"
+#include "xor.h"
+#include "xor_internal.h"
+#include "thread.h"
+
+static BBXORDSPContext xor_dsp;
+static BVOnce xor_dsp_once = BV_ONCE_INIT;
+
+static void memxor_c(uint8_t *dst, const uint8_t *src, int size)
+{
+    int i = 0;
+
+    for (; i + 8 <= size; i += 8)
+        BV_WN64(dst + i, BV_RN64(dst + i) ^ BV_RN64(src + i));
+    for (; i < size; i++)
+        dst[i] ^= src[i];
+}
+
+static void xor_dsp_init(void)
+{
+    BBXORDSPContext c = {
+        .memxor = memxor_c,
+    };
+
+    if (BV_ARCH_AARCH64)
+        bb_xor_dsp_init_aarch64(&c);
+    if (BV_ARCH_X86)
+        bb_xor_dsp_init_x86(&c);
+
+    xor_dsp.memxor = c.memxor;
+}
+
+void bv_memxor(uint8_t *dst, const uint8_t *src, int size)
+{
+    bv_thread_once(&xor_dsp_once, xor_dsp_init);
+    xor_dsp.memxor(dst, src, size);
+}
+
+#ifdef TEST
+#include <stdio.h>
+
+#include "cpu.h"
+#include "lfg.h"
+#include "log.h"
+#include "time.h"
+
+int main(void)
+{
+    static uint8_t a[4099], b[4099], ref[4099];
+    BVLFG prng;
+    int off, size, i, ret = 0;
+    int64_t t;
+
+    bv_lfg_init(&prng, 1);
+    for (i = 0; i < sizeof(a); i++) {
+        a[i] = bv_lfg_get(&prng);
+        b[i] = bv_lfg_get(&prng);
+    }
+
+    /* every alignment and tail length against the scalar loop */
+    for (off = 0; off < 33; off++) {
+        for (size = 0; size + off <= 4096; size += size < 80 ? 1 : 61) {
+            memcpy(ref, a, sizeof(a));
+            for (i = 0; i < size; i++)
+                ref[off + i] ^= b[i + 1];
+            bv_memxor(a + off, b + 1, size);
+            if (memcmp(a, ref, sizeof(a))) {
+                bv_log(NULL, BV_LOG_ERROR, "mismatch at offset %d size %d\n", off, size);
+                ret = 1;
+            }
+            memcpy(a, ref, sizeof(a));
+        }
+    }
+
+    t = bv_gettime_relative();
+    for (i = 0; i < 100000; i++)
+        bv_memxor(a, b, 1472);
+    t = bv_gettime_relative() - t;
+    printf("%d MB/s\n", t > 0 ? (int)(100000LL * 1472 / t) : 0);
+    return ret;
+}
+#endif
@@ -0,0 +1,42 @@
+/*
+ * This file is part of BVBase.
+ *
+ * BVBase is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * BVBase is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BVBase; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef BVUTIL_XOR_H
+#define BVUTIL_XOR_H
+
+#include <stdint.h>
+
+/**
+ * @defgroup lavu_xor XOR
+ * @ingroup lavu_crypto
+ * Bulk XOR of byte buffers, the parity operation of XOR based forward
+ * error correction. Uses SSE2/AVX2 or NEON when available.
+ * @{
+ */
+
+/**
+ * dst[i] ^= src[i] for 0 <= i < size.
+ * The buffers need no particular alignment.
+ */
+void bv_memxor(uint8_t *dst, const uint8_t *src, int size);
+
+/**
+ * @}
+ */
+
+#endif /* BVUTIL_XOR_H */
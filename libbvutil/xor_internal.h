@@ -0,0 +1,31 @@
+/*
+ * This file is part of BVBase.
+ *
+ * BVBase is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * BVBase is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BVBase; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef BVUTIL_XOR_INTERNAL_H
+#define BVUTIL_XOR_INTERNAL_H
+
+#include <stdint.h>
+
+typedef struct BBXORDSPContext {
+    void (*memxor)(uint8_t *dst, const uint8_t *src, int size);
+} BBXORDSPContext;
+
+void bb_xor_dsp_init_aarch64(BBXORDSPContext *c);
+void bb_xor_dsp_init_x86(BBXORDSPContext *c);
+
+#endif /* BVUTIL_XOR_INTERNAL_H */